@@ -0,0 +1,123 @@
+// `any` benchmark: the same arithmetic is compiled once with int/float
+// annotations and once with every parameter and result left as `any`, then
+// run on the bytecode interpreter and as native code.
+//
+// Usage: lithium_any_bench [min-milliseconds-per-measurement]
+
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ast_builder.hpp"
+#include "timing.hpp"
+#include "codegen.hpp"
+#include "bytecode.hpp"
+#include "jit.hpp"
+#include "x86.hpp"
+#include "vm.hpp"
+
+namespace {
+    using namespace bench;
+
+    struct Benchmark {
+        std::string name;
+        long opsPerRun;
+        std::function<std::unique_ptr<ProgramNode>(bool typed)> build;
+    };
+
+    // 1023 additions and subtractions over a parameter; small enough that
+    // `any` ints never leave the 48-bit range
+    std::unique_ptr<ProgramNode> intArithmetic(bool typed) {
+        auto program = std::make_unique<ProgramNode>();
+        int counter = 0;
+        auto leaf = [](int i) { return i % 2 ? identifier("x") : intLiteral(i % 7 + 1); };
+        addFunction(*program, "compute", {Parameter("x", typed ? "int" : "")}, typed ? "int" : "",
+                    expressionTree(10, {"+", "-", "+", "+"}, leaf, counter));
+        addFunction(*program, "main", {}, "int", call("compute", intLiteral(3)));
+        return program;
+    }
+
+    // 1023 float operations; the `any` version takes the widening path
+    std::unique_ptr<ProgramNode> floatArithmetic(bool typed) {
+        auto program = std::make_unique<ProgramNode>();
+        int counter = 0;
+        auto leaf = [](int i) { return i % 2 ? identifier("x") : floatLiteral(i % 7 + 0.5); };
+        addFunction(*program, "compute", {Parameter("x", typed ? "float" : "")}, typed ? "float" : "",
+                    expressionTree(10, {"+", "-", "*", "/"}, leaf, counter));
+        addFunction(*program, "main", {}, "void", call("compute", floatLiteral(1.25)));
+        return program;
+    }
+
+    // 64 calls to a two-argument helper
+    std::unique_ptr<ProgramNode> callHelpers(bool typed) {
+        auto program = std::make_unique<ProgramNode>();
+        std::string type = typed ? "int" : "";
+        addFunction(*program, "combine", {Parameter("a", type), Parameter("b", type)}, type,
+                    binary(binary(identifier("a"), "+", identifier("b")), "-", intLiteral(1)));
+        std::unique_ptr<Expression> sum = intLiteral(0);
+        for (int i = 0; i < 64; ++i) {
+            std::vector<std::unique_ptr<Expression>> args;
+            args.push_back(std::move(sum));
+            args.push_back(intLiteral(i));
+            sum = call("combine", std::move(args));
+        }
+        addFunction(*program, "main", {}, "int", std::move(sum));
+        return program;
+    }
+
+    bool measure(const Benchmark& benchmark, bool typed, double minMillis, double& vmNanos, double& jitNanos) {
+        ErrorReporter bytecodeErrors;
+        auto bytecodeProgram = benchmark.build(typed);
+        CodeGenerator bytecodeGenerator(Target(TargetType::BYTECODE, ""), bytecodeErrors);
+        BytecodeModule bytecode;
+        if (!bytecodeGenerator.generateBytecodeInMemory(bytecodeProgram.get(), bytecode)) {
+            bytecodeErrors.printErrors();
+            return false;
+        }
+        VirtualMachine vm(bytecode);
+        vmNanos = nanosPerRun(minMillis, [&] { vm.runMain(); }) / static_cast<double>(benchmark.opsPerRun);
+
+        ErrorReporter machineErrors;
+        auto machineProgram = benchmark.build(typed);
+        CodeGenerator machineGenerator(Target(TargetType::EXECUTABLE, ""), machineErrors);
+        MachineModule machine;
+        JitModule jit(machineErrors);
+        if (!machineGenerator.generateInMemory(machineProgram.get(), machine) || !jit.load(machine)) {
+            machineErrors.printErrors();
+            return false;
+        }
+        if (jit.runMain() != VirtualMachine(bytecode).runMain()) {
+            std::fprintf(stderr, "%s: native and bytecode results differ\n", benchmark.name.c_str());
+            return false;
+        }
+        jitNanos = nanosPerRun(minMillis, [&] { jit.runMain(); }) / static_cast<double>(benchmark.opsPerRun);
+        return true;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    double minMillis = argc > 1 ? std::atof(argv[1]) : 200.0;
+
+    std::vector<Benchmark> benchmarks = {
+        {"int_arith", 1023, intArithmetic},
+        {"float_arith", 1023, floatArithmetic},
+        {"call_helpers", 64, callHelpers},
+    };
+
+    std::printf("%-14s %-6s %12s %12s\n", "benchmark", "types", "vm ns/op", "jit ns/op");
+    for (const auto& benchmark : benchmarks) {
+        for (bool typed : {true, false}) {
+            double vmNanos = 0;
+            double jitNanos = 0;
+            if (!measure(benchmark, typed, minMillis, vmNanos, jitNanos)) {
+                return EXIT_FAILURE;
+            }
+            std::printf("%-14s %-6s %12.2f %12.2f\n", benchmark.name.c_str(), typed ? "static" : "any",
+                        vmNanos, jitNanos);
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+// Helpers for building benchmark programs directly as ASTs
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ast.hpp"
+
+namespace bench {
+    inline std::unique_ptr<Expression> intLiteral(int64_t value) {
+        return std::make_unique<NumberLiteral>(std::to_string(value), false);
+    }
+
+    inline std::unique_ptr<Expression> floatLiteral(double value) {
+        return std::make_unique<NumberLiteral>(std::to_string(value), true);
+    }
+
+    inline std::unique_ptr<Expression> identifier(const std::string& name) {
+        return std::make_unique<Identifier>(name);
+    }
+
+    inline std::unique_ptr<Expression> binary(std::unique_ptr<Expression> left, const std::string& op,
+                                              std::unique_ptr<Expression> right) {
+        auto node = std::make_unique<BinaryOp>();
+        node->left = std::move(left);
+        node->operator_ = op;
+        node->right = std::move(right);
+        return node;
+    }
+
+    inline std::unique_ptr<Expression> call(const std::string& name, std::vector<std::unique_ptr<Expression>> args) {
+        auto node = std::make_unique<FunctionCall>();
+        node->functionName = name;
+        node->arguments = std::move(args);
+        return node;
+    }
+
+    inline std::unique_ptr<Expression> call(const std::string& name, std::unique_ptr<Expression> arg) {
+        std::vector<std::unique_ptr<Expression>> args;
+        args.push_back(std::move(arg));
+        return call(name, std::move(args));
+    }
+
+    inline std::unique_ptr<Expression> call(const std::string& name) {
+        return call(name, std::vector<std::unique_ptr<Expression>>());
+    }
+
+    inline void addFunction(ProgramNode& program, const std::string& name, std::vector<Parameter> params,
+                            const std::string& returnType, std::unique_ptr<Expression> body) {
+        auto function = std::make_unique<FunctionDecl>();
+        function->name = name;
+        function->parameters = std::move(params);
+        function->returnType = returnType;
+        function->body = std::move(body);
+        program.declarations.push_back(std::move(function));
+    }
+
+    // Balanced tree of `depth` levels cycling through the given operators
+    inline std::unique_ptr<Expression> expressionTree(int depth, const std::vector<std::string>& ops,
+                                                      const std::function<std::unique_ptr<Expression>(int)>& leaf,
+                                                      int& counter) {
+        if (depth == 0) {
+            return leaf(counter++);
+        }
+        auto left = expressionTree(depth - 1, ops, leaf, counter);
+        auto right = expressionTree(depth - 1, ops, leaf, counter);
+        return binary(std::move(left), ops[depth % ops.size()], std::move(right));
+    }
+}
@@ -0,0 +1,427 @@
+// Compiler benchmark suite: generates a deterministic corpus of each shape
+// (many small functions, deep expressions, long string literals, comment-
+// heavy files, wide include graphs) and times Lexer::tokenize,
+// Parser::parseProgram, SemanticAnalyzer::analyze and
+// CodeGenerator::generate separately and back to back. Reports the median
+// time, source throughput, items produced and heap allocations of each
+// stage, and with --baseline flags stages that got slower or allocate more
+// than a saved run; the exit status is 1 when any did.
+//
+// Until the parser builds declarations, analysis and code generation run on
+// the tree the corpus was printed from; end to end copies that tree in place
+// of the parser's output. A build configured with -DLITHIUM_MEM_TRACKING=ON
+// also shows where the memory went, by category.
+//
+// Usage: lithium_bench [--shape=<name>] [--scale=<n>] [--iterations=<n>] [--seed=<n>]
+//                      [--target=obj|ir|bc] [--save=<file>] [--baseline=<file>]
+//                      [--threshold=<percent>] [--write-corpus=<directory>]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "corpus.hpp"
+#include "codegen.hpp"
+#include "lexar.hpp"
+#include "memtrack.hpp"
+#include "modulecache.hpp"
+#include "parser.hpp"
+#include "semantic.hpp"
+#include "stats.hpp"
+
+namespace {
+    using namespace bench;
+
+    struct Options {
+        std::vector<std::string> shapes;
+        int scale = 1;
+        int iterations = 5;
+        uint64_t seed = 1;
+        TargetType target = TargetType::OBJECT;
+        std::string targetName = "obj";
+        std::string save;
+        std::string baseline;
+        double threshold = 10;
+        std::string corpusDirectory;
+    };
+
+    struct Result {
+        std::string shape;
+        std::string stage;
+        double ms = 0;
+        size_t bytes = 0;
+        size_t items = 0;
+        std::string itemName;
+        uint64_t allocations = 0;
+        uint64_t allocatedBytes = 0;
+    };
+
+    bool numberArgument(const std::string& arg, const char* prefix, long& value) {
+        std::string text = arg.substr(std::string(prefix).size());
+        if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos || text.size() > 9) {
+            std::fprintf(stderr, "Invalid value in '%s'\n", arg.c_str());
+            return false;
+        }
+        value = std::stol(text);
+        return true;
+    }
+
+    bool parseOptions(int argc, char* argv[], Options& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            auto starts = [&](const char* prefix) { return arg.compare(0, std::string(prefix).size(), prefix) == 0; };
+            long value = 0;
+            if (starts("--shape=")) {
+                std::string shape = arg.substr(8);
+                const auto& shapes = corpusShapes();
+                if (std::find(shapes.begin(), shapes.end(), shape) == shapes.end()) {
+                    std::fprintf(stderr, "Unknown shape '%s'\n", shape.c_str());
+                    return false;
+                }
+                options.shapes.push_back(shape);
+            } else if (starts("--scale=")) {
+                if (!numberArgument(arg, "--scale=", value) || value < 1) return false;
+                options.scale = static_cast<int>(value);
+            } else if (starts("--iterations=")) {
+                if (!numberArgument(arg, "--iterations=", value) || value < 1) return false;
+                options.iterations = static_cast<int>(value);
+            } else if (starts("--seed=")) {
+                if (!numberArgument(arg, "--seed=", value)) return false;
+                options.seed = static_cast<uint64_t>(value);
+            } else if (starts("--threshold=")) {
+                if (!numberArgument(arg, "--threshold=", value)) return false;
+                options.threshold = static_cast<double>(value);
+            } else if (arg == "--target=obj" || arg == "--target=ir" || arg == "--target=bc") {
+                options.targetName = arg.substr(9);
+                options.target = options.targetName == "obj" ? TargetType::OBJECT
+                               : options.targetName == "ir"  ? TargetType::INTERMEDIATE
+                                                             : TargetType::BYTECODE;
+            } else if (starts("--save=") && arg.size() > 7) {
+                options.save = arg.substr(7);
+            } else if (starts("--baseline=") && arg.size() > 11) {
+                options.baseline = arg.substr(11);
+            } else if (starts("--write-corpus=") && arg.size() > 15) {
+                options.corpusDirectory = arg.substr(15);
+            } else {
+                std::fprintf(stderr, "Unknown option '%s'\n", arg.c_str());
+                return false;
+            }
+        }
+        if (options.shapes.empty()) {
+            options.shapes = corpusShapes();
+        }
+        return true;
+    }
+
+    bool reportErrors(ErrorReporter& errors, const std::string& shape, const char* stage) {
+        if (!errors.hasAnyErrors()) {
+            return true;
+        }
+        std::fprintf(stderr, "%s: %s failed\n", shape.c_str(), stage);
+        errors.printErrors();
+        return false;
+    }
+
+    // Runs `prepare` untimed and `run` timed `iterations` times; the median
+    // time and the allocations of the last run are kept
+    bool measure(int iterations, const std::function<void()>& prepare, const std::function<bool(Result&)>& run,
+                 Result& result) {
+        std::vector<double> samples;
+        for (int i = 0; i < iterations; ++i) {
+            prepare();
+            uint64_t allocations = CompileStats::allocationCount();
+            uint64_t bytes = CompileStats::allocatedBytes();
+            auto start = std::chrono::steady_clock::now();
+            result.items = 0;
+            if (!run(result)) {
+                return false;
+            }
+            samples.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            result.allocations = CompileStats::allocationCount() - allocations;
+            result.allocatedBytes = CompileStats::allocatedBytes() - bytes;
+        }
+        std::sort(samples.begin(), samples.end());
+        result.ms = samples[samples.size() / 2];
+        return true;
+    }
+
+    // What the later stages compile: the parser's declarations, moved out
+    // of `parsed`, once it produces any; the generated tree until then
+    std::unique_ptr<ProgramNode> programToCompile(const Corpus& corpus,
+                                                  std::vector<std::unique_ptr<ProgramNode>>& parsed) {
+        auto program = std::make_unique<ProgramNode>();
+        for (auto& part : parsed) {
+            for (auto& declaration : part->declarations) {
+                program->declarations.push_back(std::move(declaration));
+            }
+        }
+        if (program->declarations.empty()) {
+            return ModuleCache::copy(*corpus.program);
+        }
+        return program;
+    }
+
+    bool runShape(const Options& options, const Corpus& corpus, const std::string& output,
+                  std::vector<Result>& results) {
+        const auto& files = corpus.files;
+        std::vector<std::vector<Token>> tokens(files.size());
+        std::vector<std::vector<Token>> tokenCopies;
+        std::vector<std::unique_ptr<ProgramNode>> parsed;
+        std::unique_ptr<ProgramNode> program;
+
+        auto tokenize = [&](Result& result) {
+            ErrorReporter errors;
+            for (size_t i = 0; i < files.size(); ++i) {
+                Lexer lexer(files[i].source, files[i].name, &errors);
+                tokens[i] = lexer.tokenize();
+                result.items += tokens[i].size();
+            }
+            return reportErrors(errors, corpus.shape, "tokenize");
+        };
+        auto parse = [&](Result& result) {
+            ErrorReporter errors;
+            for (auto& fileTokens : tokenCopies) {
+                Parser parser(std::move(fileTokens), errors);
+                parsed.push_back(parser.parseProgram());
+                result.items += CompileStats::countNodes(*parsed.back());
+            }
+            return reportErrors(errors, corpus.shape, "parse");
+        };
+        auto analyze = [&](Result& result) {
+            ErrorReporter errors;
+            SemanticAnalyzer analyzer(errors);
+            analyzer.analyze(program.get());
+            result.items = analyzer.getSymbolCount();
+            return reportErrors(errors, corpus.shape, "analyze");
+        };
+        auto generate = [&](Result& result) {
+            ErrorReporter errors;
+            CodeGenerator codeGenerator(Target(options.target, output), errors);
+            codeGenerator.setThreadCount(1);
+            bool generated = codeGenerator.generate(program.get(), output);
+            result.items = codeGenerator.getInstructionCount();
+            return reportErrors(errors, corpus.shape, "generate") && generated;
+        };
+
+        auto stage = [&](const char* name, const char* itemName, const std::function<void()>& prepare,
+                         const std::function<bool(Result&)>& run) {
+            Result result;
+            result.shape = corpus.shape;
+            result.stage = name;
+            result.bytes = corpus.sourceBytes();
+            result.itemName = itemName;
+            if (!measure(options.iterations, prepare, run, result)) {
+                return false;
+            }
+            results.push_back(result);
+            return true;
+        };
+        // Results of the previous run are freed before the clock starts
+        auto copyTokens = [&]() {
+            parsed.clear();
+            tokenCopies = tokens;
+        };
+        auto freshProgram = [&]() {
+            std::vector<std::unique_ptr<ProgramNode>> copies;
+            for (const auto& part : parsed) {
+                copies.push_back(ModuleCache::copy(*part));
+            }
+            program = programToCompile(corpus, copies);
+        };
+        auto reset = [&]() {
+            tokens.assign(files.size(), {});
+            parsed.clear();
+            program.reset();
+        };
+        auto endToEnd = [&](Result& result) {
+            if (!tokenize(result)) return false;
+            tokenCopies = std::move(tokens);
+            if (!parse(result)) return false;
+            program = programToCompile(corpus, parsed);
+            return analyze(result) && generate(result);
+        };
+
+        return stage("tokenize", "tokens", reset, tokenize) &&
+               stage("parse", "AST nodes", copyTokens, parse) &&
+               stage("analyze", "symbols", freshProgram, analyze) &&
+               stage("generate", "IR instructions", freshProgram, generate) &&
+               stage("end to end", "IR instructions", reset, endToEnd);
+    }
+
+    void writeCorpus(const std::string& directory, const Corpus& corpus) {
+        auto path = std::filesystem::path(directory) / corpus.shape;
+        std::filesystem::create_directories(path);
+        for (const auto& file : corpus.files) {
+            std::ofstream out(path / file.name, std::ios::binary);
+            out << file.source;
+        }
+    }
+
+    bool saveResults(const std::string& path, const Options& options, const std::vector<Result>& results) {
+        std::ofstream out(path);
+        if (!out.is_open()) {
+            return false;
+        }
+        out << "{\"scale\": " << options.scale << ", \"seed\": " << options.seed << ", \"target\": \""
+            << options.targetName << "\", \"results\": [\n";
+        char line[320];
+        for (size_t i = 0; i < results.size(); ++i) {
+            const auto& result = results[i];
+            std::snprintf(line, sizeof(line),
+                          "  {\"shape\": \"%s\", \"stage\": \"%s\", \"ms\": %.4f, \"bytes\": %zu, \"items\": %zu, "
+                          "\"allocations\": %ju, \"allocated_bytes\": %ju}%s\n",
+                          result.shape.c_str(), result.stage.c_str(), result.ms, result.bytes, result.items,
+                          static_cast<uintmax_t>(result.allocations), static_cast<uintmax_t>(result.allocatedBytes),
+                          i + 1 < results.size() ? "," : "");
+            out << line;
+        }
+        out << "]}\n";
+        return static_cast<bool>(out);
+    }
+
+    // The text of `key`'s value in a flat JSON object, without quotes
+    std::string jsonField(const std::string& object, const std::string& key) {
+        size_t at = object.find("\"" + key + "\":");
+        if (at == std::string::npos) {
+            return "";
+        }
+        at = object.find_first_not_of(' ', at + key.size() + 3);
+        if (at == std::string::npos) {
+            return "";
+        }
+        if (object[at] == '"') {
+            size_t end = object.find('"', at + 1);
+            return object.substr(at + 1, end == std::string::npos ? std::string::npos : end - at - 1);
+        }
+        size_t end = object.find_first_of(",}", at);
+        return object.substr(at, end == std::string::npos ? std::string::npos : end - at);
+    }
+
+    // Reads a file written by --save
+    bool loadResults(const std::string& path, const Options& options, std::vector<Result>& results) {
+        std::ifstream in(path);
+        if (!in.is_open()) {
+            std::fprintf(stderr, "Could not open baseline %s\n", path.c_str());
+            return false;
+        }
+        std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        std::string header = text.substr(0, text.find('['));
+        if (jsonField(header, "scale") != std::to_string(options.scale) ||
+            jsonField(header, "seed") != std::to_string(options.seed) ||
+            jsonField(header, "target") != options.targetName) {
+            std::fprintf(stderr, "Baseline %s was measured with another --scale, --seed or --target\n", path.c_str());
+            return false;
+        }
+        for (size_t at = text.find("{\"shape\""); at != std::string::npos; at = text.find("{\"shape\"", at + 1)) {
+            std::string object = text.substr(at, text.find('}', at) - at + 1);
+            Result result;
+            result.shape = jsonField(object, "shape");
+            result.stage = jsonField(object, "stage");
+            result.ms = std::atof(jsonField(object, "ms").c_str());
+            result.allocations = std::strtoull(jsonField(object, "allocations").c_str(), nullptr, 10);
+            results.push_back(result);
+        }
+        return true;
+    }
+
+    const Result* findResult(const std::vector<Result>& results, const Result& like) {
+        for (const auto& result : results) {
+            if (result.shape == like.shape && result.stage == like.stage) {
+                return &result;
+            }
+        }
+        return nullptr;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::fprintf(stderr, "Usage: %s [--shape=<name>] [--scale=<n>] [--iterations=<n>] [--seed=<n>]\n"
+                             "       [--target=obj|ir|bc] [--save=<file>] [--baseline=<file>]\n"
+                             "       [--threshold=<percent>] [--write-corpus=<directory>]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    std::vector<Result> baseline;
+    if (!options.baseline.empty() && !loadResults(options.baseline, options, baseline)) {
+        return EXIT_FAILURE;
+    }
+
+    // Allocations are counted while this exists
+    CompileStats counting;
+    std::string output = (std::filesystem::temp_directory_path() /
+                          ("lithium_bench_" + std::to_string(getpid()) + "." + options.targetName)).string();
+    std::vector<Result> results;
+    bool ok = true;
+    for (const auto& shape : options.shapes) {
+        Corpus corpus = generateCorpus(shape, options.scale, options.seed);
+        if (!options.corpusDirectory.empty()) {
+            writeCorpus(options.corpusDirectory, corpus);
+        }
+        if (!runShape(options, corpus, output, results)) {
+            ok = false;
+            break;
+        }
+    }
+    std::filesystem::remove(output);
+    if (!ok) {
+        return EXIT_FAILURE;
+    }
+
+    std::printf("scale %d, seed %ju, -t %s, median of %d runs\n", options.scale, static_cast<uintmax_t>(options.seed),
+                options.targetName.c_str(), options.iterations);
+    std::printf("%-10s %-11s %10s %9s %12s %-16s %10s %10s", "shape", "stage", "ms", "MB/s", "items", "",
+                "allocs", "alloc KB");
+    std::printf(baseline.empty() ? "\n" : " %9s\n", "vs base");
+    int regressions = 0;
+    for (const auto& result : results) {
+        double throughput = result.ms > 0 ? static_cast<double>(result.bytes) / 1e3 / result.ms : 0;
+        std::printf("%-10s %-11s %10.3f %9.1f %12zu %-16s %10ju %10.1f", result.shape.c_str(), result.stage.c_str(),
+                    result.ms, throughput, result.items, result.itemName.c_str(),
+                    static_cast<uintmax_t>(result.allocations), static_cast<double>(result.allocatedBytes) / 1024.0);
+        const Result* base = baseline.empty() ? nullptr : findResult(baseline, result);
+        if (base) {
+            double limit = 1 + options.threshold / 100;
+            // Below a tenth of a millisecond the difference is mostly noise
+            bool slower = result.ms > base->ms * limit && result.ms - base->ms > 0.1;
+            bool allocating = static_cast<double>(result.allocations) > static_cast<double>(base->allocations) * limit;
+            std::printf(" %+8.1f%%", base->ms > 0 ? (result.ms / base->ms - 1) * 100 : 0.0);
+            if (slower || allocating) {
+                std::printf("  REGRESSION (%s)", slower && allocating ? "time, allocations" : slower ? "time" : "allocations");
+                ++regressions;
+            }
+        } else if (!baseline.empty()) {
+            std::printf(" %9s", "new");
+        }
+        std::printf("\n");
+    }
+
+    if (MemoryTracker::compiledIn) {
+        std::fflush(stdout);
+        MemoryTracker::printReport(std::cout);
+    }
+
+    if (!options.save.empty()) {
+        if (!saveResults(options.save, options, results)) {
+            std::fprintf(stderr, "Could not write %s\n", options.save.c_str());
+            return EXIT_FAILURE;
+        }
+        std::printf("saved to %s\n", options.save.c_str());
+    }
+    if (regressions) {
+        std::printf("%d regressions over %.0f%% against %s\n", regressions, options.threshold, options.baseline.c_str());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,131 @@
+// String concatenation benchmark: builds a large string in the interpreter
+// from one long `+` chain, which is joined with a single allocation, and
+// from a chain of calls that each append once, which builds a rope that is
+// flattened when the result is read. Both are compared with copying the
+// whole string on every `+`, as the interpreter did before.
+//
+// Usage: lithium_concat_bench [pieces] [min-milliseconds-per-measurement]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ast_builder.hpp"
+#include "codegen.hpp"
+#include "bytecode.hpp"
+#include "vm.hpp"
+
+namespace {
+    using namespace bench;
+
+    const char* const PIECE = "0123456789abcdef";
+
+    template <typename Run>
+    double millisPerRun(double minMillis, Run run) {
+        long runs = 0;
+        auto start = std::chrono::steady_clock::now();
+        double elapsed = 0;
+        do {
+            run();
+            ++runs;
+            elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        } while (elapsed < minMillis);
+        return elapsed / static_cast<double>(runs);
+    }
+
+    // build(s) = s + s + ... + s
+    std::unique_ptr<ProgramNode> chain(int pieces) {
+        auto program = std::make_unique<ProgramNode>();
+        std::unique_ptr<Expression> body = identifier("s");
+        for (int i = 1; i < pieces; ++i) {
+            body = binary(std::move(body), "+", identifier("s"));
+        }
+        addFunction(*program, "build", {Parameter("s", "string")}, "string", std::move(body));
+        return program;
+    }
+
+    // build(s) = append_n(s), append_i(s) = append_i-1(s) + s
+    std::unique_ptr<ProgramNode> calls(int pieces) {
+        auto program = std::make_unique<ProgramNode>();
+        addFunction(*program, "append_1", {Parameter("s", "string")}, "string", identifier("s"));
+        for (int i = 2; i <= pieces; ++i) {
+            addFunction(*program, "append_" + std::to_string(i), {Parameter("s", "string")}, "string",
+                        binary(call("append_" + std::to_string(i - 1), identifier("s")), "+", identifier("s")));
+        }
+        addFunction(*program, "build", {Parameter("s", "string")}, "string",
+                    call("append_" + std::to_string(pieces), identifier("s")));
+        return program;
+    }
+
+    // What every `+` cost when each result was a fresh copy of both operands
+    size_t copyEveryTime(int pieces) {
+        std::string piece = PIECE;
+        std::string result = piece;
+        for (int i = 1; i < pieces; ++i) {
+            result = result + piece;
+        }
+        return result.size();
+    }
+
+    bool measure(const std::function<std::unique_ptr<ProgramNode>(int)>& build, int pieces, double minMillis,
+                 double& millis) {
+        ErrorReporter errors;
+        auto program = build(pieces);
+        addFunction(*program, "main", {}, "int", intLiteral(0));
+        CodeGenerator generator(Target(TargetType::BYTECODE, ""), errors);
+        BytecodeModule bytecode;
+        if (!generator.generateBytecodeInMemory(program.get(), bytecode)) {
+            errors.printErrors();
+            return false;
+        }
+        uint32_t function = 0;
+        while (bytecode.functions[function].name != "build") {
+            ++function;
+        }
+
+        std::string expected;
+        for (int i = 0; i < pieces; ++i) {
+            expected += PIECE;
+        }
+        VmString piece(PIECE);
+        Value arg{0};
+        arg.s = &piece;
+        bool correct = true;
+        millis = millisPerRun(minMillis, [&] {
+            // A fresh interpreter each run, so strings from earlier runs are freed
+            VirtualMachine vm(bytecode);
+            correct = correct && vm.call(function, {arg}).s->view() == expected;
+        });
+        if (!correct) {
+            std::fprintf(stderr, "wrong result\n");
+        }
+        return correct;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int pieces = argc > 1 ? std::atoi(argv[1]) : 2000;
+    double minMillis = argc > 2 ? std::atof(argv[2]) : 200.0;
+
+    volatile size_t copied = 0;
+    double copyMillis = millisPerRun(minMillis, [&] { copied = copyEveryTime(pieces); });
+    std::printf("%-10s %10s %12s %12s %10s\n", "benchmark", "bytes", "copy ms", "vm ms", "speedup");
+    struct {
+        const char* name;
+        std::function<std::unique_ptr<ProgramNode>(int)> build;
+    } benchmarks[] = {{"chain", chain}, {"calls", calls}};
+    for (const auto& benchmark : benchmarks) {
+        double millis = 0;
+        if (!measure(benchmark.build, pieces, minMillis, millis)) {
+            return EXIT_FAILURE;
+        }
+        std::printf("%-10s %10zu %12.3f %12.3f %9.1fx\n", benchmark.name,
+                    static_cast<size_t>(pieces) * std::char_traits<char>::length(PIECE), copyMillis, millis,
+                    copyMillis / millis);
+    }
+    return EXIT_SUCCESS;
+}
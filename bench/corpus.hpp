@@ -0,0 +1,237 @@
+#pragma once
+
+// Deterministic generator of benchmark programs. Each shape is built as an
+// AST and printed as .lh source, so the same program can be fed to the
+// lexer and parser as text and to the later phases as a tree. The same
+// shape, scale and seed always give the same bytes.
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ast_builder.hpp"
+#include "utils.hpp"
+
+namespace bench {
+    // splitmix64; unlike the <random> distributions its sequence is the same everywhere
+    class CorpusRandom {
+    private:
+        uint64_t state;
+
+    public:
+        explicit CorpusRandom(uint64_t seed) : state(seed) {}
+
+        uint64_t next() {
+            uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            return z ^ (z >> 31);
+        }
+
+        // In [0, bound)
+        int below(int bound) { return static_cast<int>(next() % static_cast<uint64_t>(bound)); }
+    };
+
+    struct CorpusFile {
+        std::string name;
+        std::string source;
+    };
+
+    struct Corpus {
+        std::string shape;
+        std::vector<CorpusFile> files;
+        // Every file's declarations, in file order
+        std::unique_ptr<ProgramNode> program;
+
+        size_t sourceBytes() const {
+            size_t bytes = 0;
+            for (const auto& file : files) {
+                bytes += file.source.size();
+            }
+            return bytes;
+        }
+    };
+
+    inline const std::vector<std::string>& corpusShapes() {
+        static const std::vector<std::string> shapes = {"functions", "deep", "strings", "comments", "includes"};
+        return shapes;
+    }
+
+    inline void printExpression(const Expression& expr, std::string& out) {
+        if (auto* binary = dynamic_cast<const BinaryOp*>(&expr)) {
+            bool leftNested = dynamic_cast<const BinaryOp*>(binary->left.get()) != nullptr;
+            bool rightNested = dynamic_cast<const BinaryOp*>(binary->right.get()) != nullptr;
+            out += leftNested ? "(" : "";
+            printExpression(*binary->left, out);
+            out += leftNested ? ") " : " ";
+            out += binary->operator_;
+            out += rightNested ? " (" : " ";
+            printExpression(*binary->right, out);
+            out += rightNested ? ")" : "";
+        } else if (auto* call = dynamic_cast<const FunctionCall*>(&expr)) {
+            out += call->functionName + "(";
+            for (size_t i = 0; i < call->arguments.size(); ++i) {
+                out += i ? ", " : "";
+                printExpression(*call->arguments[i], out);
+            }
+            out += ")";
+        } else if (auto* number = dynamic_cast<const NumberLiteral*>(&expr)) {
+            out += number->value;
+        } else if (auto* string = dynamic_cast<const StringLiteral*>(&expr)) {
+            out += "\"" + CompilerUtils::escapeString(string->value) + "\"";
+        } else if (auto* name = dynamic_cast<const Identifier*>(&expr)) {
+            out += name->name;
+        }
+    }
+
+    inline void printDeclaration(const ASTNode& decl, std::string& out) {
+        if (auto* function = dynamic_cast<const FunctionDecl*>(&decl)) {
+            out += "fn " + function->name + "(";
+            for (size_t i = 0; i < function->parameters.size(); ++i) {
+                out += (i ? ", " : "") + function->parameters[i].name + ": " + function->parameters[i].type;
+            }
+            out += ") -> " + function->returnType + " {\n    ";
+            printExpression(*function->body, out);
+            out += "\n}\n\n";
+        } else if (auto* include = dynamic_cast<const IncludeDirective*>(&decl)) {
+            out += "include \"" + include->filename + "\"\n";
+        }
+    }
+
+    // Builds a file from declarations added to `program` since `first`
+    inline void addFile(Corpus& corpus, const std::string& name, size_t first) {
+        std::string source;
+        auto& declarations = corpus.program->declarations;
+        for (size_t i = first; i < declarations.size(); ++i) {
+            declarations[i]->setPosition(Position(name, static_cast<int>(i - first) + 1, 1));
+            printDeclaration(*declarations[i], source);
+        }
+        corpus.files.push_back({name, std::move(source)});
+    }
+
+    inline std::unique_ptr<Expression> callWith(const std::string& name, int first, int second) {
+        std::vector<std::unique_ptr<Expression>> args;
+        args.push_back(intLiteral(first));
+        args.push_back(intLiteral(second));
+        return call(name, std::move(args));
+    }
+
+    inline void addMain(Corpus& corpus, std::unique_ptr<Expression> result) {
+        size_t first = corpus.program->declarations.size();
+        addFunction(*corpus.program, "main", {}, "int", std::move(result));
+        addFile(corpus, "main.lh", first);
+    }
+
+    // Short arithmetic bodies, some calling an earlier function
+    inline void smallFunctions(Corpus& corpus, CorpusRandom& random, int count, const std::string& prefix,
+                               const std::vector<std::string>& callees) {
+        static const std::vector<std::string> ops = {"+", "-", "*", "+"};
+        for (int i = 0; i < count; ++i) {
+            auto body = binary(identifier("x"), ops[random.below(4)], intLiteral(random.below(1000)));
+            body = binary(std::move(body), ops[random.below(4)], identifier("y"));
+            if (!callees.empty() && random.below(3) == 0) {
+                std::vector<std::unique_ptr<Expression>> args;
+                args.push_back(identifier("y"));
+                args.push_back(intLiteral(random.below(100)));
+                body = binary(std::move(body), "+", call(callees[random.below(static_cast<int>(callees.size()))],
+                                                         std::move(args)));
+            }
+            addFunction(*corpus.program, prefix + std::to_string(i), {Parameter("x", "int"), Parameter("y", "int")},
+                        "int", std::move(body));
+        }
+    }
+
+    inline std::string randomText(CorpusRandom& random, size_t length) {
+        static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 .,;:-";
+        std::string text;
+        text.reserve(length);
+        for (size_t i = 0; i < length; ++i) {
+            int pick = random.below(200);
+            // Some escapes for the lexer to decode
+            text += pick == 0 ? '\n' : pick == 1 ? '"' : pick == 2 ? '\\' : alphabet[pick % (sizeof(alphabet) - 1)];
+        }
+        return text;
+    }
+
+    // A program of the given shape; `scale` multiplies its size
+    inline Corpus generateCorpus(const std::string& shape, int scale, uint64_t seed) {
+        Corpus corpus;
+        corpus.shape = shape;
+        corpus.program = std::make_unique<ProgramNode>();
+        CorpusRandom random(seed);
+        auto& declarations = corpus.program->declarations;
+
+        if (shape == "functions") {
+            // Many small functions in a few files
+            std::vector<std::string> callees;
+            for (int file = 0; file < 4; ++file) {
+                size_t first = declarations.size();
+                std::string prefix = "m" + std::to_string(file) + "_f";
+                smallFunctions(corpus, random, 500 * scale, prefix, callees);
+                callees.push_back(prefix + "0");
+                addFile(corpus, "module" + std::to_string(file) + ".lh", first);
+            }
+            addMain(corpus, callWith("m3_f0", 1, 2));
+        } else if (shape == "deep") {
+            // Expressions nested 200 levels deep
+            static const std::vector<std::string> ops = {"+", "-", "*"};
+            for (int i = 0; i < 25 * scale; ++i) {
+                std::unique_ptr<Expression> body = identifier("x");
+                for (int level = 0; level < 200; ++level) {
+                    auto operand = random.below(2) ? identifier("x") : intLiteral(random.below(100) + 1);
+                    body = random.below(2) ? binary(std::move(operand), ops[random.below(3)], std::move(body))
+                                           : binary(std::move(body), ops[random.below(3)], std::move(operand));
+                }
+                addFunction(*corpus.program, "deep" + std::to_string(i), {Parameter("x", "int")}, "int",
+                            std::move(body));
+            }
+            addFile(corpus, "deep.lh", 0);
+            addMain(corpus, call("deep0", intLiteral(1)));
+        } else if (shape == "strings") {
+            // Literals of 1 to 8 KB, some concatenated
+            for (int i = 0; i < 100 * scale; ++i) {
+                std::unique_ptr<Expression> body =
+                    std::make_unique<StringLiteral>(randomText(random, 1024 + random.below(7 * 1024)));
+                if (random.below(2)) {
+                    body = binary(std::move(body), "+",
+                                  std::make_unique<StringLiteral>(randomText(random, 1024 + random.below(1024))));
+                }
+                addFunction(*corpus.program, "text" + std::to_string(i), {}, "string", std::move(body));
+            }
+            addFile(corpus, "strings.lh", 0);
+            addMain(corpus, intLiteral(0));
+        } else if (shape == "comments") {
+            // Ten lines of comment before each of a few small functions
+            smallFunctions(corpus, random, 300 * scale, "f", {});
+            std::string source;
+            for (size_t i = 0; i < declarations.size(); ++i) {
+                declarations[i]->setPosition(Position("comments.lh", static_cast<int>(i * 14) + 11, 1));
+                for (int line = 0; line < 10; ++line) {
+                    std::string text = randomText(random, 20 + random.below(60));
+                    std::replace(text.begin(), text.end(), '\n', ' ');
+                    source += "// " + text + "\n";
+                }
+                printDeclaration(*declarations[i], source);
+            }
+            corpus.files.push_back({"comments.lh", std::move(source)});
+            addMain(corpus, callWith("f0", 1, 2));
+        } else if (shape == "includes") {
+            // Many files each including 16 others and calling into them
+            int files = 64 * scale;
+            for (int file = 0; file < files; ++file) {
+                size_t first = declarations.size();
+                std::vector<std::string> callees;
+                for (int i = 0; i < 16 && file > 0; ++i) {
+                    int other = random.below(file);
+                    declarations.push_back(std::make_unique<IncludeDirective>("lib" + std::to_string(other) + ".lh"));
+                    callees.push_back("lib" + std::to_string(other) + "_f" + std::to_string(random.below(10)));
+                }
+                smallFunctions(corpus, random, 10, "lib" + std::to_string(file) + "_f", callees);
+                addFile(corpus, "lib" + std::to_string(file) + ".lh", first);
+            }
+            addMain(corpus, callWith("lib" + std::to_string(files - 1) + "_f0", 1, 2));
+        }
+        return corpus;
+    }
+}
@@ -0,0 +1,100 @@
+// Dead code benchmark: a small program includes a large shared library and
+// a second library it never uses. Compiles it to native code in memory with
+// and without removing unreachable functions, and reports functions
+// lowered, code size and compile time.
+//
+// Usage: lithium_dce_bench [library-functions] [repetitions]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ast_builder.hpp"
+#include "codegen.hpp"
+#include "reachability.hpp"
+#include "x86.hpp"
+
+namespace {
+    using namespace bench;
+
+    // Chains of 50 functions, each calling the one before it
+    void addLibrary(ProgramNode& program, const std::string& file, const std::string& prefix, int functions) {
+        auto include = std::make_unique<IncludeDirective>(file);
+        include->setPosition(Position("main.lh", static_cast<int>(program.declarations.size()) + 1, 1));
+        program.declarations.insert(program.declarations.begin(), std::move(include));
+
+        for (int i = 0; i < functions; ++i) {
+            int counter = 0;
+            auto leaf = [](int j) { return j % 2 ? identifier("x") : intLiteral(j % 7 + 1); };
+            auto body = expressionTree(5, {"+", "-", "*", "+"}, leaf, counter);
+            if (i % 50 != 0) {
+                body = binary(std::move(body), "+", call(prefix + std::to_string(i - 1), identifier("x")));
+            }
+            addFunction(program, prefix + std::to_string(i), {Parameter("x", "int")}, "int", std::move(body));
+            program.declarations.back()->setPosition(Position(file, i + 1, 1));
+        }
+    }
+
+    std::unique_ptr<ProgramNode> buildProgram(int libraryFunctions) {
+        auto program = std::make_unique<ProgramNode>();
+        addLibrary(*program, "extra.lh", "extra_", libraryFunctions / 4);
+        addLibrary(*program, "lib.lh", "lib_", libraryFunctions);
+        auto sum = binary(call("lib_" + std::to_string(49), intLiteral(1)), "+",
+                          call("lib_" + std::to_string(libraryFunctions / 2 + 49), intLiteral(2)));
+        addFunction(*program, "main", {}, "int", std::move(sum));
+        program->declarations.back()->setPosition(Position("main.lh", 10, 1));
+        return program;
+    }
+
+    struct Measurement {
+        size_t functions = 0;
+        size_t codeBytes = 0;
+        double millis = 1e30;
+    };
+
+    bool measure(int libraryFunctions, int repetitions, bool eliminate, Measurement& out) {
+        for (int i = 0; i < repetitions; ++i) {
+            auto program = buildProgram(libraryFunctions);
+            auto start = std::chrono::steady_clock::now();
+            if (eliminate) {
+                DeadCodeEliminator eliminator;
+                eliminator.run(*program);
+            }
+            ErrorReporter errors;
+            CodeGenerator generator(Target(TargetType::EXECUTABLE, ""), errors);
+            MachineModule module;
+            if (!generator.generateInMemory(program.get(), module)) {
+                errors.printErrors();
+                return false;
+            }
+            double millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            out.millis = std::min(out.millis, millis);
+            out.codeBytes = module.text.size() + module.rodata.size();
+            out.functions = 0;
+            for (const auto& symbol : module.symbols) {
+                out.functions += symbol.isFunction ? 1 : 0;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int libraryFunctions = argc > 1 ? std::atoi(argv[1]) : 4000;
+    int repetitions = argc > 2 ? std::atoi(argv[2]) : 5;
+
+    std::printf("%-10s %10s %12s %12s\n", "unused", "functions", "code bytes", "compile ms");
+    for (bool eliminate : {false, true}) {
+        Measurement result;
+        if (!measure(libraryFunctions, repetitions, eliminate, result)) {
+            return EXIT_FAILURE;
+        }
+        std::printf("%-10s %10zu %12zu %12.2f\n", eliminate ? "removed" : "kept", result.functions,
+                    result.codeBytes, result.millis);
+    }
+    return EXIT_SUCCESS;
+}
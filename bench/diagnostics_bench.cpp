@@ -0,0 +1,109 @@
+// Diagnostics benchmark: reports many errors into one ErrorReporter from 1,
+// 2, 4 ... threads at once, then prints them, and checks the printed text
+// is the same for every thread count, also with an error limit and the
+// errors reported last to first, where the first errors by position must
+// still be the ones printed. Also lexes a file with an error on
+// every line. Reports ns per report and print throughput.
+//
+// Usage: lithium_diagnostics_bench [errors] [max-threads]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+#include "error.hpp"
+#include "lexar.hpp"
+#include "threadpool.hpp"
+
+namespace {
+    double millisSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // The errors are spread over 16 files in order, 4 to a line
+    void reportOne(ErrorReporter& errors, size_t i, size_t count) {
+        size_t perFile = (count + 15) / 16;
+        size_t inFile = i % perFile;
+        Position position("module" + std::to_string(i / perFile) + ".lh", static_cast<int>(inFile / 4) + 1,
+                          static_cast<int>(inFile % 4) * 8 + 1);
+        errors.reportSemanticError(position, "Undefined variable 'value" + std::to_string(i) + "'");
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    unsigned maxThreads = argc > 2 ? static_cast<unsigned>(std::atoi(argv[2])) : ThreadPool::defaultThreadCount();
+    if (count == 0 || maxThreads == 0) {
+        std::fprintf(stderr, "Usage: %s [errors] [max-threads]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::printf("%zu errors\n", count);
+    std::printf("%-8s %12s %12s %12s %10s\n", "threads", "report ms", "ns/report", "print ms", "print MB/s");
+    const size_t limit = 100;
+    std::string expected;
+    std::string expectedLimited;
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        ErrorReporter errors;
+        ThreadPool pool(threads);
+        auto start = std::chrono::steady_clock::now();
+        pool.parallelFor(count, [&](size_t i) { reportOne(errors, i, count); });
+        double reportMs = millisSince(start);
+
+        std::ostringstream out;
+        start = std::chrono::steady_clock::now();
+        errors.printErrors(out);
+        double printMs = millisSince(start);
+
+        std::string text = out.str();
+        if (threads == 1) {
+            expected = text;
+        } else if (text != expected) {
+            std::fprintf(stderr, "output with %u threads differs from 1 thread\n", threads);
+            return EXIT_FAILURE;
+        }
+        // One thread reporting in order gives the expected errors; backwards,
+        // the first ones by position arrive last
+        ErrorReporter limited;
+        limited.setErrorLimit(limit);
+        pool.parallelFor(count, [&](size_t i) { reportOne(limited, count - 1 - i, count); });
+        std::ostringstream limitedOut;
+        limited.printErrors(limitedOut);
+        if (threads == 1) {
+            ErrorReporter inOrder;
+            inOrder.setErrorLimit(limit);
+            for (size_t i = 0; i < count; ++i) {
+                reportOne(inOrder, i, count);
+            }
+            std::ostringstream inOrderOut;
+            inOrder.printErrors(inOrderOut);
+            expectedLimited = inOrderOut.str();
+        }
+        if (limitedOut.str() != expectedLimited) {
+            std::fprintf(stderr, "with an error limit and %u threads, the printed errors are not the first by position\n",
+                         threads);
+            return EXIT_FAILURE;
+        }
+
+        std::printf("%-8u %12.2f %12.1f %12.2f %10.1f\n", pool.size(), reportMs, reportMs * 1e6 / static_cast<double>(count),
+                    printMs, static_cast<double>(text.size()) / 1e3 / printMs);
+    }
+
+    // One unexpected character per line, all reported
+    std::string source;
+    for (size_t line = 0; line < count / 4; ++line) {
+        source += "let x = 1 @\n";
+    }
+    ErrorReporter lexErrors;
+    auto start = std::chrono::steady_clock::now();
+    Lexer lexer(source, "errors.lh", &lexErrors);
+    lexer.tokenize();
+    double lexMs = millisSince(start);
+    std::ostringstream out;
+    lexErrors.printErrors(out);
+    double totalMs = millisSince(start);
+    std::printf("lexing %zu lines with an error each: %.2f ms, %.2f ms with printing\n", count / 4, lexMs, totalMs);
+    return EXIT_SUCCESS;
+}
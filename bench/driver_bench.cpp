@@ -0,0 +1,127 @@
+// Driver benchmark: writes a project of many small source files and builds
+// it twice with the `lithium` executable, once starting one process per
+// file (up to `jobs` at a time, as a build system would) and once passing
+// every file to a single process with -j. Reports the median wall time of
+// each over several builds.
+//
+// Usage: lithium_driver_bench [files] [jobs] [target] [builds]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "process.hpp"
+
+namespace {
+    using namespace bench;
+
+    constexpr int FUNCTIONS_PER_FILE = 20;
+
+    void writeSource(const std::filesystem::path& path, int file) {
+        std::ofstream out(path);
+        out << "// module " << file << "\n";
+        for (int i = 0; i < FUNCTIONS_PER_FILE; ++i) {
+            out << "fn f" << file << "_" << i << "(x: int, y: int) -> int {\n";
+            out << "    let z = x * " << i + 1 << " + y\n";
+            out << "    z - " << file << " * y\n";
+            out << "}\n\n";
+        }
+        out << "fn main() -> int {\n    f" << file << "_0(1, 2)\n}\n";
+    }
+
+    bool reap(int& failures) {
+        int status;
+        if (wait(&status) < 0) {
+            return false;
+        }
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            ++failures;
+        }
+        return true;
+    }
+
+    // One compiler process per file, at most `jobs` running at once
+    bool processPerFile(const std::string& compiler, const std::vector<std::string>& files, unsigned jobs,
+                        const std::string& target) {
+        int failures = 0;
+        unsigned running = 0;
+        for (const auto& file : files) {
+            if (running == jobs) {
+                if (!reap(failures)) return false;
+                --running;
+            }
+            if (spawn({compiler, "-t", target, file}) < 0) return false;
+            ++running;
+        }
+        while (running > 0) {
+            if (!reap(failures)) return false;
+            --running;
+        }
+        return failures == 0;
+    }
+
+    bool singleProcess(const std::string& compiler, const std::vector<std::string>& files, unsigned jobs,
+                       const std::string& target) {
+        std::vector<std::string> arguments = {compiler, "-t", target, "-j", std::to_string(jobs)};
+        arguments.insert(arguments.end(), files.begin(), files.end());
+        if (spawn(arguments) < 0) return false;
+        int failures = 0;
+        return reap(failures) && failures == 0;
+    }
+
+    template <typename Build>
+    double medianMillis(int builds, Build build) {
+        std::vector<double> samples;
+        for (int i = 0; i < builds; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            if (!build()) {
+                return -1;
+            }
+            samples.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        std::sort(samples.begin(), samples.end());
+        return samples[samples.size() / 2];
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int count = argc > 1 ? std::atoi(argv[1]) : 500;
+    unsigned jobs = argc > 2 ? static_cast<unsigned>(std::atoi(argv[2])) : std::max(1u, std::thread::hardware_concurrency());
+    std::string target = argc > 3 ? argv[3] : "obj";
+    int builds = argc > 4 ? std::atoi(argv[4]) : 5;
+    std::string compiler = std::filesystem::absolute(LITHIUM_EXECUTABLE).string();
+
+    // Outputs are named after their inputs in the working directory
+    auto directory = std::filesystem::temp_directory_path() / ("lithium_driver_" + std::to_string(getpid()));
+    std::filesystem::create_directories(directory);
+    std::filesystem::current_path(directory);
+    std::vector<std::string> files;
+    for (int i = 0; i < count; ++i) {
+        files.push_back("module" + std::to_string(i) + ".lh");
+        writeSource(directory / files.back(), i);
+    }
+
+    double separate = medianMillis(builds, [&] { return processPerFile(compiler, files, jobs, target); });
+    double together = medianMillis(builds, [&] { return singleProcess(compiler, files, jobs, target); });
+    std::filesystem::current_path(std::filesystem::temp_directory_path());
+    std::filesystem::remove_all(directory);
+    if (separate < 0 || together < 0) {
+        std::fprintf(stderr, "build failed; is %s built?\n", compiler.c_str());
+        return EXIT_FAILURE;
+    }
+
+    std::printf("%d files, -t %s, %u jobs, median of %d builds\n", count, target.c_str(), jobs, builds);
+    std::printf("%-20s %12s %12s\n", "driver", "total ms", "ms/file");
+    std::printf("%-20s %12.1f %12.3f\n", "process per file", separate, separate / count);
+    std::printf("%-20s %12.1f %12.3f %8.2fx\n", "one process, -j", together, together / count, separate / together);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,145 @@
+// Code emission benchmark: compiles one large generated program to every
+// output target with 1, 2, 4 ... max-threads code generation threads and
+// reports output size, throughput and the peak memory added by code
+// generation. Every run happens in its own child process so peak RSS
+// figures do not bleed into each other, and every output is checked to be
+// byte-identical to the single-threaded one.
+//
+// Usage: lithium_emit_bench [functions] [max-threads] [output-directory]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "ast_builder.hpp"
+#include "codegen.hpp"
+#include "threadpool.hpp"
+
+namespace {
+    using namespace bench;
+
+    struct Run {
+        const char* name;
+        TargetType type;
+        const char* extension;
+    };
+
+    // Each function is a 255-operator tree over its parameter, literals and
+    // calls to the previous function
+    std::unique_ptr<ProgramNode> largeProgram(int functions) {
+        auto program = std::make_unique<ProgramNode>();
+        for (int f = 0; f < functions; ++f) {
+            int counter = 0;
+            std::string previous = "f" + std::to_string(f - 1);
+            auto leaf = [&](int i) -> std::unique_ptr<Expression> {
+                if (f > 0 && i % 16 == 5) {
+                    return call(previous, identifier("x"));
+                }
+                return i % 2 ? identifier("x") : intLiteral(i * 31 + f);
+            };
+            addFunction(*program, "f" + std::to_string(f), {Parameter("x", "int")}, "int",
+                        expressionTree(8, {"+", "-", "*", "+"}, leaf, counter));
+        }
+        addFunction(*program, "main", {}, "int", call("f" + std::to_string(functions - 1), intLiteral(1)));
+        return program;
+    }
+
+    long peakRssKb() {
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+
+    std::string outputPath(const std::string& directory, const Run& run, unsigned threads) {
+        return directory + "/lithium_emit_bench." + std::to_string(threads) + run.extension;
+    }
+
+    std::string readAll(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    int runTarget(const Run& run, int functions, unsigned threads, const std::string& output) {
+        auto program = largeProgram(functions);
+        long baseline = peakRssKb();
+
+        ErrorReporter errorReporter;
+        CodeGenerator codeGenerator(Target(run.type, output), errorReporter);
+        codeGenerator.setThreadCount(threads);
+        auto start = std::chrono::steady_clock::now();
+        bool ok = codeGenerator.generate(program.get(), output);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (!ok) {
+            errorReporter.printErrors();
+            return EXIT_FAILURE;
+        }
+
+        double megabytes = static_cast<double>(std::filesystem::file_size(output)) / (1024.0 * 1024.0);
+        std::printf("%-8s %8u %10.2f %10.1f %10.1f %12ld\n", run.name, threads, megabytes, seconds * 1000.0,
+                    megabytes / seconds, peakRssKb() - baseline);
+        return EXIT_SUCCESS;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int functions = argc > 1 ? std::atoi(argv[1]) : 4000;
+    unsigned maxThreads = argc > 2 ? static_cast<unsigned>(std::atoi(argv[2])) : ThreadPool::defaultThreadCount();
+    std::string directory = argc > 3 ? argv[3] : std::filesystem::temp_directory_path().string();
+
+    std::vector<unsigned> threadCounts;
+    for (unsigned threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(std::max(maxThreads, 1u));
+
+    const std::vector<Run> runs = {
+        {"ir", TargetType::INTERMEDIATE, ".ir"},
+        {"asm", TargetType::ASSEMBLY, ".s"},
+        {"exe", TargetType::EXECUTABLE, ""},
+        {"obj", TargetType::OBJECT, ".o"},
+        {"bc", TargetType::BYTECODE, ".lbc"},
+    };
+
+    std::printf("%d functions\n", functions);
+    std::printf("%-8s %8s %10s %10s %10s %12s\n", "target", "threads", "MB", "ms", "MB/s", "peak-KB");
+    std::fflush(stdout);
+    for (const auto& run : runs) {
+        std::string reference = outputPath(directory, run, threadCounts.front());
+        for (unsigned threads : threadCounts) {
+            std::string output = outputPath(directory, run, threads);
+            pid_t child = fork();
+            if (child == 0) {
+                int status = runTarget(run, functions, threads, output);
+                std::fflush(stdout);
+                std::_Exit(status);
+            }
+            int status = 0;
+            if (child < 0 || waitpid(child, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                std::fprintf(stderr, "%s: benchmark failed\n", run.name);
+                return EXIT_FAILURE;
+            }
+            if (output != reference) {
+                bool identical = readAll(output) == readAll(reference);
+                std::filesystem::remove(output);
+                if (!identical) {
+                    std::fprintf(stderr, "%s: output with %u threads differs from single-threaded output\n",
+                                 run.name, threads);
+                    return EXIT_FAILURE;
+                }
+            }
+        }
+        std::filesystem::remove(reference);
+    }
+    return EXIT_SUCCESS;
+}
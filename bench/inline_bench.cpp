@@ -0,0 +1,154 @@
+// Inlining benchmark: call-heavy programs are compiled with and without
+// the inliner, then run on the bytecode interpreter and as native code.
+// Reports calls executed per run and time per run for each configuration.
+//
+// Usage: lithium_inline_bench [min-milliseconds-per-measurement]
+
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ast_builder.hpp"
+#include "timing.hpp"
+#include "codegen.hpp"
+#include "bytecode.hpp"
+#include "jit.hpp"
+#include "x86.hpp"
+#include "vm.hpp"
+
+namespace {
+    using namespace bench;
+
+    struct Benchmark {
+        std::string name;
+        std::function<std::unique_ptr<ProgramNode>()> build;
+    };
+
+    struct Result {
+        bool ok = false;
+        int exitCode = 0;
+        unsigned long long calls = 0;
+        double vmNanos = 0;
+        double jitNanos = 0;
+    };
+
+    // main sums 64 expressions built from one-line helpers
+    std::unique_ptr<ProgramNode> tinyHelpers() {
+        auto program = std::make_unique<ProgramNode>();
+        addFunction(*program, "square", {Parameter("x", "int")}, "int", binary(identifier("x"), "*", identifier("x")));
+        addFunction(*program, "add", {Parameter("a", "int"), Parameter("b", "int")}, "int",
+                    binary(identifier("a"), "+", identifier("b")));
+        addFunction(*program, "scale", {Parameter("x", "int")}, "int", binary(identifier("x"), "*", intLiteral(3)));
+        std::unique_ptr<Expression> sum = intLiteral(0);
+        for (int i = 0; i < 64; ++i) {
+            std::vector<std::unique_ptr<Expression>> args;
+            args.push_back(call("square", intLiteral(i % 5)));
+            args.push_back(intLiteral(1));
+            sum = binary(std::move(sum), "+", call("scale", call("add", std::move(args))));
+        }
+        addFunction(*program, "main", {}, "int", binary(std::move(sum), "/", intLiteral(100)));
+        return program;
+    }
+
+    // f0 -> f1 -> ... -> f15, each adding one on the way back, called 16 times
+    std::unique_ptr<ProgramNode> callChain() {
+        const int depth = 16;
+        auto program = std::make_unique<ProgramNode>();
+        for (int i = 0; i < depth; ++i) {
+            std::string next = "f" + std::to_string(i + 1);
+            auto body = i + 1 < depth ? binary(call(next, identifier("x")), "+", intLiteral(1)) : identifier("x");
+            addFunction(*program, "f" + std::to_string(i), {Parameter("x", "int")}, "int", std::move(body));
+        }
+        std::unique_ptr<Expression> sum = intLiteral(0);
+        for (int i = 0; i < 16; ++i) {
+            sum = binary(std::move(sum), "+", call("f0", intLiteral(i)));
+        }
+        addFunction(*program, "main", {}, "int", binary(std::move(sum), "/", intLiteral(10)));
+        return program;
+    }
+
+    // A callee well over the threshold stays a call
+    std::unique_ptr<ProgramNode> largeCallee() {
+        auto program = std::make_unique<ProgramNode>();
+        int counter = 0;
+        auto leaf = [](int i) { return i % 2 ? identifier("x") : intLiteral(i % 7 + 1); };
+        addFunction(*program, "compute", {Parameter("x", "int")}, "int",
+                    expressionTree(6, {"+", "-", "*", "+"}, leaf, counter));
+        std::unique_ptr<Expression> sum = intLiteral(0);
+        for (int i = 0; i < 8; ++i) {
+            sum = binary(std::move(sum), "+", call("compute", intLiteral(i)));
+        }
+        addFunction(*program, "main", {}, "int", binary(std::move(sum), "/", intLiteral(1000)));
+        return program;
+    }
+
+    Result measure(const Benchmark& benchmark, bool inlining, double minMillis) {
+        Result result;
+
+        ErrorReporter bytecodeErrors;
+        auto bytecodeProgram = benchmark.build();
+        CodeGenerator bytecodeGenerator(Target(TargetType::BYTECODE, ""), bytecodeErrors);
+        bytecodeGenerator.setInlining(inlining);
+        BytecodeModule bytecode;
+        if (!bytecodeGenerator.generateBytecodeInMemory(bytecodeProgram.get(), bytecode)) {
+            bytecodeErrors.printErrors();
+            return result;
+        }
+
+        VirtualMachine counter(bytecode);
+        result.exitCode = counter.runMain();
+        result.calls = counter.getCallCount();
+        VirtualMachine vm(bytecode);
+        result.vmNanos = nanosPerRun(minMillis, [&] { vm.runMain(); });
+
+        ErrorReporter machineErrors;
+        auto machineProgram = benchmark.build();
+        CodeGenerator machineGenerator(Target(TargetType::EXECUTABLE, ""), machineErrors);
+        machineGenerator.setInlining(inlining);
+        MachineModule machine;
+        JitModule jit(machineErrors);
+        if (!machineGenerator.generateInMemory(machineProgram.get(), machine) || !jit.load(machine)) {
+            machineErrors.printErrors();
+            return result;
+        }
+        if (jit.runMain() != result.exitCode) {
+            std::fprintf(stderr, "%s: native and bytecode results differ\n", benchmark.name.c_str());
+            return result;
+        }
+        result.jitNanos = nanosPerRun(minMillis, [&] { jit.runMain(); });
+
+        result.ok = true;
+        return result;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    double minMillis = argc > 1 ? std::atof(argv[1]) : 200.0;
+
+    std::vector<Benchmark> benchmarks = {
+        {"tiny_helpers", tinyHelpers},
+        {"call_chain", callChain},
+        {"large_callee", largeCallee},
+    };
+
+    std::printf("%-14s %-8s %10s %12s %12s\n", "benchmark", "inline", "calls/run", "vm ns/run", "jit ns/run");
+    for (const auto& benchmark : benchmarks) {
+        Result without = measure(benchmark, false, minMillis);
+        Result with = measure(benchmark, true, minMillis);
+        if (!without.ok || !with.ok) {
+            return EXIT_FAILURE;
+        }
+        if (without.exitCode != with.exitCode) {
+            std::fprintf(stderr, "%s: inlining changed the result\n", benchmark.name.c_str());
+            return EXIT_FAILURE;
+        }
+        for (const Result* result : {&without, &with}) {
+            std::printf("%-14s %-8s %10llu %12.1f %12.1f\n", benchmark.name.c_str(), result == &with ? "on" : "off",
+                        result->calls, result->vmNanos, result->jitNanos);
+        }
+    }
+    return EXIT_SUCCESS;
+}
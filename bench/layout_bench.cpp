@@ -0,0 +1,212 @@
+// Function layout benchmark: a large generated program whose hot functions
+// are spread through the source between big functions that run once, built
+// in source order (--no-layout) and with the chosen layout. Reports how many
+// 4 KiB pages and 64-byte lines the hot code spans, time per run through the
+// JIT and, when `perf` is installed, front-end stall, iTLB and i-cache miss
+// counts of the executables measured with `perf stat`.
+//
+// Usage: lithium_layout_bench [functions] [min-milliseconds-per-measurement]
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "ast_builder.hpp"
+#include "timing.hpp"
+#include "codegen.hpp"
+#include "jit.hpp"
+#include "x86.hpp"
+
+namespace {
+    using namespace bench;
+
+    constexpr int FAN_DEPTH = 10;
+    constexpr uint64_t PAGE_SIZE = 4096;
+    constexpr uint64_t LINE_SIZE = 64;
+    const char* const PERF_EVENTS = "stalled-cycles-frontend,iTLB-load-misses,L1-icache-load-misses";
+
+    std::unique_ptr<Expression> tree(int depth, const std::string& name, int seed) {
+        int counter = seed;
+        auto leaf = [&](int i) { return i % 3 == 2 ? intLiteral(i % 7 + 1) : identifier(name); };
+        return expressionTree(depth, {"+", "-", "*", "+"}, leaf, counter);
+    }
+
+    // once<i> runs once from main and is large; work<i> is entered 2^depth
+    // times through fan<depth>..fan0. Both call work<i>, so it has two
+    // callers and is too large to inline.
+    std::unique_ptr<ProgramNode> spreadProgram(int functions) {
+        auto program = std::make_unique<ProgramNode>();
+        std::unique_ptr<Expression> leafBody = intLiteral(0);
+        std::unique_ptr<Expression> mainBody = call("fan" + std::to_string(FAN_DEPTH), intLiteral(1));
+        for (int i = 0; i < functions; ++i) {
+            std::string work = "work" + std::to_string(i);
+            std::string once = "once" + std::to_string(i);
+            addFunction(*program, once, {Parameter("x", "int")}, "int",
+                        binary(tree(8, "x", i), "+", call(work, identifier("x"))));
+            addFunction(*program, work, {Parameter("x", "int")}, "int", tree(5, "x", i));
+            leafBody = binary(std::move(leafBody), "+", call(work, identifier("x")));
+            mainBody = binary(std::move(mainBody), "+", call(once, intLiteral(i)));
+        }
+        addFunction(*program, "fan0", {Parameter("x", "int")}, "int", std::move(leafBody));
+        for (int i = 1; i <= FAN_DEPTH; ++i) {
+            std::string below = "fan" + std::to_string(i - 1);
+            addFunction(*program, "fan" + std::to_string(i), {Parameter("x", "int")}, "int",
+                        binary(call(below, identifier("x")), "+",
+                               call(below, binary(identifier("x"), "+", intLiteral(1)))));
+        }
+        addFunction(*program, "main", {}, "int", binary(std::move(mainBody), "/", intLiteral(1000000)));
+        return program;
+    }
+
+    struct Build {
+        MachineModule machine;
+        std::set<std::string> hot;
+        size_t coldFunctions = 0;
+    };
+
+    bool build(int functions, bool layout, const std::string& executable, Build& result) {
+        ErrorReporter errors;
+        auto program = spreadProgram(functions);
+        CodeGenerator generator(Target(TargetType::EXECUTABLE, ""), errors);
+        generator.setFunctionLayout(layout);
+        if (!generator.generateInMemory(program.get(), result.machine)) {
+            errors.printErrors();
+            return false;
+        }
+        for (const auto& placement : generator.getLayout().getOrder()) {
+            if (placement.entries > 1) {
+                result.hot.insert(placement.function->name);
+            }
+            result.coldFunctions += placement.cold ? 1 : 0;
+        }
+
+        ErrorReporter fileErrors;
+        auto fileProgram = spreadProgram(functions);
+        CodeGenerator fileGenerator(Target(TargetType::EXECUTABLE, executable), fileErrors);
+        fileGenerator.setFunctionLayout(layout);
+        if (!fileGenerator.generate(fileProgram.get(), executable)) {
+            fileErrors.printErrors();
+            return false;
+        }
+        return true;
+    }
+
+    // Pages and cache lines holding at least one byte of a hot function
+    void footprint(const MachineModule& machine, const std::set<std::string>& hot, size_t& pages, size_t& lines) {
+        std::set<uint64_t> pageSet;
+        std::set<uint64_t> lineSet;
+        for (const auto& symbol : machine.symbols) {
+            if (symbol.section != SectionKind::TEXT || !hot.count(symbol.name) || symbol.size == 0) continue;
+            for (uint64_t at = symbol.offset; at < symbol.offset + symbol.size; at += LINE_SIZE) {
+                lineSet.insert(at / LINE_SIZE);
+                pageSet.insert(at / PAGE_SIZE);
+            }
+            lineSet.insert((symbol.offset + symbol.size - 1) / LINE_SIZE);
+            pageSet.insert((symbol.offset + symbol.size - 1) / PAGE_SIZE);
+        }
+        pages = pageSet.size();
+        lines = lineSet.size();
+    }
+
+    bool havePerf() {
+        return std::system("perf --version >/dev/null 2>&1") == 0;
+    }
+
+    // Runs `perf stat` in CSV mode and prints each event's count
+    void perfStat(const std::string& executable, const std::string& label) {
+        std::string report = executable + ".perf";
+        std::string command = "perf stat -x, -r 20 -e " + std::string(PERF_EVENTS) + " -o " + report + " " +
+                              executable + " >/dev/null 2>&1";
+        std::system(command.c_str());
+        std::ifstream file(report);
+        std::string line;
+        bool any = false;
+        while (std::getline(file, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            std::stringstream fields(line);
+            std::string value;
+            std::string unit;
+            std::string event;
+            std::getline(fields, value, ',');
+            std::getline(fields, unit, ',');
+            std::getline(fields, event, ',');
+            std::printf("  %-10s %-28s %16s\n", label.c_str(), event.c_str(), value.c_str());
+            any = true;
+        }
+        if (!any) {
+            std::printf("  %-10s perf stat reported nothing (counters unavailable?)\n", label.c_str());
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int functions = argc > 1 ? std::atoi(argv[1]) : 64;
+    double minMillis = argc > 2 ? std::atof(argv[2]) : 500.0;
+
+    auto directory = std::filesystem::temp_directory_path() / ("lithium_layout_" + std::to_string(getpid()));
+    std::filesystem::create_directories(directory);
+    std::string sourceOrder = (directory / "source_order").string();
+    std::string laidOut = (directory / "laid_out").string();
+
+    Build plain;
+    Build ordered;
+    if (!build(functions, false, sourceOrder, plain) || !build(functions, true, laidOut, ordered)) {
+        std::filesystem::remove_all(directory);
+        return EXIT_FAILURE;
+    }
+
+    ErrorReporter errors;
+    JitModule plainJit(errors);
+    JitModule orderedJit(errors);
+    size_t textBytes[2] = {plain.machine.text.size(), ordered.machine.text.size()};
+    uint64_t coldBytes = ordered.machine.coldBytes;
+    size_t pages[2];
+    size_t lines[2];
+    footprint(plain.machine, ordered.hot, pages[0], lines[0]);
+    footprint(ordered.machine, ordered.hot, pages[1], lines[1]);
+    if (!plainJit.load(plain.machine) || !orderedJit.load(ordered.machine)) {
+        errors.printErrors();
+        std::filesystem::remove_all(directory);
+        return EXIT_FAILURE;
+    }
+    int plainExit = plainJit.runMain();
+    if (plainExit != orderedJit.runMain()) {
+        std::fprintf(stderr, "results differ between layouts\n");
+        std::filesystem::remove_all(directory);
+        return EXIT_FAILURE;
+    }
+    double nanos[2] = {nanosPerRun(minMillis, [&] { plainJit.runMain(); }, 10),
+                       nanosPerRun(minMillis, [&] { orderedJit.runMain(); }, 10)};
+
+    std::printf("%d hot and %d run-once functions, %zu hot after layout, %zu cold (%ju bytes of .text.cold)\n",
+                functions + FAN_DEPTH + 1, functions + 1, ordered.hot.size(), ordered.coldFunctions,
+                static_cast<uintmax_t>(coldBytes));
+    std::printf("%-12s %10s %10s %10s %12s %9s\n", "layout", "text bytes", "hot pages", "hot lines", "ns/run",
+                "speedup");
+    const char* names[2] = {"source", "chosen"};
+    for (int i = 0; i < 2; ++i) {
+        std::printf("%-12s %10zu %10zu %10zu %12.0f", names[i], textBytes[i], pages[i], lines[i], nanos[i]);
+        if (i == 1) {
+            std::printf(" %8.2fx", nanos[0] / nanos[1]);
+        }
+        std::printf("\n");
+    }
+
+    if (havePerf()) {
+        std::printf("perf stat, 20 runs each:\n");
+        perfStat(sourceOrder, names[0]);
+        perfStat(laidOut, names[1]);
+    } else {
+        std::printf("perf not found; front-end stall counters skipped\n");
+    }
+    std::filesystem::remove_all(directory);
+    return EXIT_SUCCESS;
+}
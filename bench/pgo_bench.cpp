@@ -0,0 +1,164 @@
+// Profile-guided optimization benchmark: each program is compiled plainly,
+// then instrumented and run once to collect a profile, then recompiled with
+// that profile. Reports time per run of the plain and the profile-guided
+// native code and the size of each.
+//
+// Usage: lithium_pgo_bench [min-milliseconds-per-measurement]
+
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ast_builder.hpp"
+#include "timing.hpp"
+#include "codegen.hpp"
+#include "jit.hpp"
+#include "profile.hpp"
+#include "x86.hpp"
+
+namespace {
+    using namespace bench;
+
+    struct Benchmark {
+        std::string name;
+        std::function<std::unique_ptr<ProgramNode>()> build;
+    };
+
+    struct Result {
+        bool ok = false;
+        int exitCode = 0;
+        size_t textBytes = 0;
+        double nanos = 0;
+    };
+
+    // fan0 is entered 2^depth times through fan1..fan<depth>, each calling
+    // the one below twice; main calls the same callees a few times itself
+    void addFan(ProgramNode& program, int depth, std::unique_ptr<Expression> leafBody) {
+        addFunction(program, "fan0", {Parameter("x", "int")}, "int", std::move(leafBody));
+        for (int i = 1; i <= depth; ++i) {
+            std::string below = "fan" + std::to_string(i - 1);
+            addFunction(program, "fan" + std::to_string(i), {Parameter("x", "int")}, "int",
+                        binary(call(below, identifier("x")), "+",
+                               call(below, binary(identifier("x"), "+", intLiteral(1)))));
+        }
+    }
+
+    std::unique_ptr<Expression> tree(const std::vector<std::string>& names) {
+        int counter = 0;
+        auto leaf = [&](int i) { return i % 3 == 2 ? intLiteral(i % 5 + 1) : identifier(names[i % names.size()]); };
+        return expressionTree(4, {"+", "-", "*", "+"}, leaf, counter);
+    }
+
+    // A callee over the inlining threshold with many callers, one of them hot
+    std::unique_ptr<ProgramNode> hotCallee() {
+        auto program = std::make_unique<ProgramNode>();
+        std::unique_ptr<Expression> sum = call("fan10", intLiteral(1));
+        for (int i = 0; i < 8; ++i) {
+            sum = binary(std::move(sum), "+", call("work", intLiteral(i)));
+        }
+        addFunction(*program, "main", {}, "int", binary(std::move(sum), "/", intLiteral(1000000)));
+        addFunction(*program, "work", {Parameter("x", "int")}, "int", tree({"x"}));
+        addFan(*program, 10, call("work", identifier("x")));
+        return program;
+    }
+
+    // A function with `any` parameters called with more signatures than get
+    // copies; the cold calls come first in source order
+    std::unique_ptr<ProgramNode> hotSignature() {
+        auto program = std::make_unique<ProgramNode>();
+        auto mixCall = [](std::unique_ptr<Expression> a, std::unique_ptr<Expression> b, std::unique_ptr<Expression> c) {
+            std::vector<std::unique_ptr<Expression>> args;
+            args.push_back(std::move(a));
+            args.push_back(std::move(b));
+            args.push_back(std::move(c));
+            return call("mix", std::move(args));
+        };
+        std::unique_ptr<Expression> sum = call("fan10", intLiteral(1));
+        for (int i = 0; i < 4; ++i) {
+            auto arg = [&](int position) {
+                return (i == 3 ? position < 2 : position == i) ? floatLiteral(position + 0.5) : intLiteral(position);
+            };
+            sum = binary(std::move(sum), "+", call("drop", mixCall(arg(0), arg(1), arg(2))));
+        }
+        addFunction(*program, "main", {}, "int", binary(std::move(sum), "/", intLiteral(1000000)));
+        addFunction(*program, "drop", {Parameter("value", "any")}, "int", intLiteral(0));
+        addFunction(*program, "mix", {Parameter("a", "any"), Parameter("b", "any"), Parameter("c", "any")}, "any",
+                    tree({"a", "b", "c"}));
+        addFan(*program, 10, mixCall(identifier("x"), intLiteral(1), intLiteral(2)));
+        return program;
+    }
+
+    bool load(const Benchmark& benchmark, bool instrument, const Profile* profile, JitModule& jit, size_t& textBytes) {
+        ErrorReporter errors;
+        auto program = benchmark.build();
+        CodeGenerator generator(Target(TargetType::EXECUTABLE, ""), errors);
+        if (instrument) {
+            generator.setProfileGenerate("unused");
+        }
+        generator.setProfileUse(profile);
+        MachineModule machine;
+        if (!generator.generateInMemory(program.get(), machine) || !jit.load(machine)) {
+            errors.printErrors();
+            return false;
+        }
+        textBytes = machine.text.size();
+        return true;
+    }
+
+    Result measure(const Benchmark& benchmark, const Profile* profile, double minMillis) {
+        Result result;
+        ErrorReporter errors;
+        JitModule jit(errors);
+        if (!load(benchmark, false, profile, jit, result.textBytes)) {
+            return result;
+        }
+        result.exitCode = jit.runMain();
+        result.nanos = nanosPerRun(minMillis, [&] { jit.runMain(); });
+        result.ok = true;
+        return result;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    double minMillis = argc > 1 ? std::atof(argv[1]) : 200.0;
+
+    std::vector<Benchmark> benchmarks = {
+        {"hot_callee", hotCallee},
+        {"hot_signature", hotSignature},
+    };
+
+    std::printf("%-14s %8s %10s %12s %12s %10s\n", "benchmark", "profile", "entries", "text bytes", "ns/run",
+                "speedup");
+    for (const auto& benchmark : benchmarks) {
+        ErrorReporter errors;
+        JitModule instrumented(errors);
+        size_t instrumentedBytes = 0;
+        Profile profile;
+        if (!load(benchmark, true, nullptr, instrumented, instrumentedBytes)) {
+            return EXIT_FAILURE;
+        }
+        int instrumentedExit = instrumented.runMain();
+        if (!instrumented.readProfile(profile)) {
+            std::fprintf(stderr, "%s: no counters in the instrumented build\n", benchmark.name.c_str());
+            return EXIT_FAILURE;
+        }
+
+        Result plain = measure(benchmark, nullptr, minMillis);
+        Result guided = measure(benchmark, &profile, minMillis);
+        if (!plain.ok || !guided.ok) {
+            return EXIT_FAILURE;
+        }
+        if (plain.exitCode != guided.exitCode || plain.exitCode != instrumentedExit) {
+            std::fprintf(stderr, "%s: results differ between builds\n", benchmark.name.c_str());
+            return EXIT_FAILURE;
+        }
+        std::printf("%-14s %8s %10s %12zu %12.1f %10s\n", benchmark.name.c_str(), "none", "-", plain.textBytes,
+                    plain.nanos, "");
+        std::printf("%-14s %8s %10zu %12zu %12.1f %9.2fx\n", benchmark.name.c_str(), "used", profile.size(),
+                    guided.textBytes, guided.nanos, plain.nanos / guided.nanos);
+    }
+    return EXIT_SUCCESS;
+}
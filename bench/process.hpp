@@ -0,0 +1,28 @@
+#pragma once
+
+// Process helpers shared by the benchmarks that run the `lithium` executable
+
+#include <string>
+#include <vector>
+
+#include <spawn.h>
+#include <sys/types.h>
+
+extern char** environ;
+
+namespace bench {
+    // Starts arguments[0] (an absolute path) with the given arguments;
+    // returns its pid, or -1 if it could not be started
+    inline pid_t spawn(const std::vector<std::string>& arguments) {
+        std::vector<char*> argv;
+        for (const auto& argument : arguments) {
+            argv.push_back(const_cast<char*>(argument.c_str()));
+        }
+        argv.push_back(nullptr);
+        pid_t pid;
+        if (posix_spawn(&pid, argv[0], nullptr, nullptr, argv.data(), environ) != 0) {
+            return -1;
+        }
+        return pid;
+    }
+}
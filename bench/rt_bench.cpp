@@ -0,0 +1,252 @@
+// Runtime library benchmark: times the liblithium_rt string and number
+// kernels against naive byte-at-a-time and digit-at-a-time versions, with
+// libc and std::to_chars for reference, and checks that every float it
+// formats reads back as the same value and is no longer than std::to_chars
+// makes it.
+//
+// Usage: lithium_rt_bench [repetitions]
+
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "lithium_rt.h"
+
+namespace {
+    struct Row {
+        const char* name;
+        std::function<size_t()> naive;
+        std::function<size_t()> library;
+        std::function<size_t()> runtime;
+    };
+
+    volatile size_t sink;
+
+    // Best of `repetitions`, in nanoseconds per operation
+    double nanosPerOp(const std::function<size_t()>& run, size_t operations, int repetitions) {
+        double best = 1e30;
+        for (int i = 0; i < repetitions; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            sink = run();
+            double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            best = std::min(best, elapsed / static_cast<double>(operations));
+        }
+        return best;
+    }
+
+    __attribute__((noinline)) size_t naiveStrlen(const char* s) {
+        size_t n = 0;
+        while (s[n]) ++n;
+        return n;
+    }
+
+    __attribute__((noinline)) const void* naiveMemchr(const void* bytes, int value, size_t size) {
+        const auto* p = static_cast<const unsigned char*>(bytes);
+        for (size_t i = 0; i < size; ++i) {
+            if (p[i] == static_cast<unsigned char>(value)) return p + i;
+        }
+        return nullptr;
+    }
+
+    __attribute__((noinline)) int naiveMemcmp(const void* lhs, const void* rhs, size_t size) {
+        const auto* a = static_cast<const unsigned char*>(lhs);
+        const auto* b = static_cast<const unsigned char*>(rhs);
+        for (size_t i = 0; i < size; ++i) {
+            if (a[i] != b[i]) return a[i] - b[i];
+        }
+        return 0;
+    }
+
+    __attribute__((noinline)) const char* naiveConcat(const char* lhs, const char* rhs) {
+        size_t lhsSize = naiveStrlen(lhs);
+        size_t rhsSize = naiveStrlen(rhs);
+        char* result = static_cast<char*>(std::malloc(lhsSize + rhsSize + 1));
+        for (size_t i = 0; i < lhsSize; ++i) result[i] = lhs[i];
+        for (size_t i = 0; i < rhsSize; ++i) result[lhsSize + i] = rhs[i];
+        result[lhsSize + rhsSize] = '\0';
+        return result;
+    }
+
+    __attribute__((noinline)) size_t naiveFormatInt(int64_t value, char* out) {
+        char reversed[20];
+        size_t n = 0;
+        uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+        do {
+            reversed[n++] = static_cast<char>('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude);
+        size_t size = 0;
+        if (value < 0) out[size++] = '-';
+        while (n) out[size++] = reversed[--n];
+        return size;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int repetitions = argc > 1 ? std::atoi(argv[1]) : 5;
+    std::mt19937_64 random(42);
+
+    // 1000 strings of 16 to 1024 bytes; the compared copies are equal
+    std::vector<std::string> strings;
+    std::vector<std::string> copies;
+    size_t totalBytes = 0;
+    for (int i = 0; i < 1000; ++i) {
+        std::string s(16 + random() % 1009, ' ');
+        for (auto& c : s) c = static_cast<char>('a' + random() % 26);
+        totalBytes += s.size();
+        strings.push_back(s);
+        copies.push_back(s);
+    }
+    // Concatenation works on short strings, like most program strings, and
+    // every variant keeps its results alive as the runtime does
+    std::vector<std::string> words;
+    for (int i = 0; i < 64; ++i) {
+        words.push_back(strings[i].substr(0, 8 + random() % 57));
+    }
+    // The runtime reads each operand's length from in front of its bytes
+    std::vector<const char*> runtimeWords;
+    for (const auto& word : words) {
+        char* copy = lithium_rt_string_alloc(word.size());
+        std::memcpy(copy, word.data(), word.size());
+        runtimeWords.push_back(copy);
+    }
+    const int concats = 100000;
+    std::vector<const char*> kept(concats);
+    std::vector<std::string> keptStrings(concats);
+    std::vector<int64_t> ints(1000000);
+    for (auto& value : ints) value = static_cast<int64_t>(random()) >> (random() % 64);
+    std::vector<double> floats(1000000);
+    for (auto& value : floats) {
+        uint64_t bits = random();
+        std::memcpy(&value, &bits, sizeof(value));
+        if (value != value || value - value != 0) value = static_cast<double>(bits % 1000003) / 7.0;
+    }
+
+    auto overStrings = [&](auto op) {
+        return [&, op] {
+            size_t total = 0;
+            for (size_t i = 0; i < strings.size(); ++i) total += op(i);
+            return total;
+        };
+    };
+    char buffer[LITHIUM_RT_NUMBER_CHARS];
+    auto overInts = [&](auto format) {
+        return [&, format] {
+            size_t total = 0;
+            for (int64_t value : ints) total += format(value);
+            return total;
+        };
+    };
+    auto overFloats = [&](auto format) {
+        return [&, format] {
+            size_t total = 0;
+            for (double value : floats) total += format(value);
+            return total;
+        };
+    };
+
+    std::vector<Row> rows = {
+        {"strlen",
+         overStrings([&](size_t i) { return naiveStrlen(strings[i].c_str()); }),
+         overStrings([&](size_t i) { return std::strlen(strings[i].c_str()); }),
+         overStrings([&](size_t i) { return lithium_rt_strlen(strings[i].c_str()); })},
+        {"memchr",
+         overStrings([&](size_t i) { return naiveMemchr(strings[i].data(), '!', strings[i].size()) != nullptr; }),
+         overStrings([&](size_t i) { return std::memchr(strings[i].data(), '!', strings[i].size()) != nullptr; }),
+         overStrings([&](size_t i) { return lithium_rt_memchr(strings[i].data(), '!', strings[i].size()) != nullptr; })},
+        {"memcmp",
+         overStrings([&](size_t i) { return static_cast<size_t>(naiveMemcmp(strings[i].data(), copies[i].data(), strings[i].size())); }),
+         overStrings([&](size_t i) { return static_cast<size_t>(std::memcmp(strings[i].data(), copies[i].data(), strings[i].size())); }),
+         overStrings([&](size_t i) { return static_cast<size_t>(lithium_rt_memcmp(strings[i].data(), copies[i].data(), strings[i].size())); })},
+        {"string_equals",
+         overStrings([&](size_t i) { return naiveStrlen(strings[i].c_str()) == naiveStrlen(copies[i].c_str()) &&
+                                            naiveMemcmp(strings[i].c_str(), copies[i].c_str(), strings[i].size()) == 0; }),
+         overStrings([&](size_t i) { return std::strcmp(strings[i].c_str(), copies[i].c_str()) == 0; }),
+         overStrings([&](size_t i) { return static_cast<size_t>(lithium_rt_string_equals(strings[i].c_str(), copies[i].c_str())); })},
+        {"concat",
+         [&] {
+             size_t total = 0;
+             for (int i = 0; i < concats; ++i) {
+                 std::free(const_cast<char*>(kept[i]));
+                 kept[i] = naiveConcat(words[i % 64].c_str(), words[i % 61].c_str());
+                 total += static_cast<unsigned char>(kept[i][0]);
+             }
+             return total;
+         },
+         [&] {
+             size_t total = 0;
+             for (int i = 0; i < concats; ++i) {
+                 keptStrings[i] = words[i % 64] + words[i % 61];
+                 total += keptStrings[i].size();
+             }
+             return total;
+         },
+         [&] {
+             size_t total = 0;
+             for (int i = 0; i < concats; ++i) {
+                 total += static_cast<unsigned char>(lithium_rt_concat(runtimeWords[i % 64], runtimeWords[i % 61])[0]);
+             }
+             return total;
+         }},
+        {"format_int",
+         overInts([&](int64_t value) { return naiveFormatInt(value, buffer); }),
+         overInts([&](int64_t value) { return static_cast<size_t>(std::to_chars(buffer, buffer + sizeof(buffer), value).ptr - buffer); }),
+         overInts([&](int64_t value) { return lithium_rt_format_int(value, buffer); })},
+        {"format_float",
+         overFloats([&](double value) { return static_cast<size_t>(std::snprintf(buffer, sizeof(buffer), "%.17g", value)); }),
+         overFloats([&](double value) { return static_cast<size_t>(std::to_chars(buffer, buffer + sizeof(buffer), value).ptr - buffer); }),
+         overFloats([&](double value) { return lithium_rt_format_float(value, buffer); })},
+    };
+    size_t operations[] = {strings.size(), strings.size(), strings.size(), strings.size(), concats, ints.size(), floats.size()};
+
+    std::printf("%zu strings, %zu bytes; naive is byte or digit at a time, reference is libc, std::string or std::to_chars\n",
+                strings.size(), totalBytes);
+    std::printf("%-14s %12s %12s %12s %10s\n", "kernel", "naive ns", "reference ns", "runtime ns", "vs naive");
+    for (size_t i = 0; i < rows.size(); ++i) {
+        double naive = nanosPerOp(rows[i].naive, operations[i], repetitions);
+        double library = nanosPerOp(rows[i].library, operations[i], repetitions);
+        double runtime = nanosPerOp(rows[i].runtime, operations[i], repetitions);
+        std::printf("%-14s %12.1f %12.1f %12.1f %9.1fx\n", rows[i].name, naive, library, runtime, naive / runtime);
+    }
+
+    // Results must agree with the references
+    size_t mismatches = 0;
+    size_t longer = 0;
+    for (double value : floats) {
+        char expected[LITHIUM_RT_NUMBER_CHARS];
+        size_t expectedSize = static_cast<size_t>(std::to_chars(expected, expected + sizeof(expected), value).ptr - expected);
+        size_t size = lithium_rt_format_float(value, buffer);
+        if (std::strtod(std::string(buffer, size).c_str(), nullptr) != value) {
+            ++mismatches;
+        } else if (size > expectedSize) {
+            ++longer;
+        }
+    }
+    for (int64_t value : ints) {
+        char expected[LITHIUM_RT_NUMBER_CHARS];
+        auto end = std::to_chars(expected, expected + sizeof(expected), value).ptr;
+        size_t size = lithium_rt_format_int(value, buffer);
+        mismatches += std::string(buffer, size) != std::string(expected, end);
+    }
+    for (int i = 0; i < 64; ++i) {
+        const char* joined = lithium_rt_concat(runtimeWords[i], runtimeWords[(i + 1) % 64]);
+        mismatches += joined != words[i] + words[(i + 1) % 64];
+        mismatches += lithium_rt_string_size(joined) != words[i].size() + words[(i + 1) % 64].size();
+    }
+    for (size_t i = 0; i < strings.size(); ++i) {
+        mismatches += lithium_rt_strlen(strings[i].c_str()) != strings[i].size();
+        mismatches += !lithium_rt_string_equals(strings[i].c_str(), copies[i].c_str());
+        int order = lithium_rt_string_compare(strings[i].c_str(), strings[(i + 1) % strings.size()].c_str());
+        int expected = std::strcmp(strings[i].c_str(), strings[(i + 1) % strings.size()].c_str());
+        mismatches += order != (expected > 0) - (expected < 0);
+    }
+    std::printf("floats not reading back: %zu, longer than shortest: %zu of %zu; other mismatches included above\n",
+                mismatches, longer, floats.size());
+    return mismatches == 0 && longer == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,123 @@
+// Compile server benchmark: an edit-compile loop over a generated project.
+// Each round rewrites one file and rebuilds the whole project, either by
+// starting a fresh `lithium` process or through `lithium --connect` to a
+// server started for the benchmark, which parses only the edited file
+// again. Reports the median rebuild time of each.
+//
+// Usage: lithium_server_bench [files] [rounds] [target]
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "process.hpp"
+#include "server.hpp"
+
+namespace {
+    using namespace bench;
+
+    constexpr int FUNCTIONS_PER_FILE = 20;
+
+    void writeSource(const std::filesystem::path& path, int file, int edit) {
+        std::ofstream out(path);
+        out << "// module " << file << ", edit " << edit << "\n";
+        for (int i = 0; i < FUNCTIONS_PER_FILE; ++i) {
+            out << "fn f" << file << "_" << i << "(x: int, y: int) -> int {\n";
+            out << "    let z = x * " << i + edit + 1 << " + y\n";
+            out << "    z - " << file << " * y\n";
+            out << "}\n\n";
+        }
+    }
+
+    bool runToCompletion(const std::vector<std::string>& arguments) {
+        pid_t pid = spawn(arguments);
+        int status;
+        return pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+
+    bool waitForServer(const std::string& socket) {
+        for (int attempt = 0; attempt < 500; ++attempt) {
+            int exitCode;
+            std::string out;
+            std::string err;
+            if (CompileClient::request(socket, "/", {"--help"}, exitCode, out, err)) {
+                return true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return false;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int count = argc > 1 ? std::atoi(argv[1]) : 200;
+    int rounds = argc > 2 ? std::atoi(argv[2]) : 20;
+    std::string target = argc > 3 ? argv[3] : "obj";
+    std::string compiler = std::filesystem::absolute(LITHIUM_EXECUTABLE).string();
+
+    auto directory = std::filesystem::temp_directory_path() / ("lithium_server_" + std::to_string(getpid()));
+    std::filesystem::create_directories(directory);
+    std::filesystem::current_path(directory);
+    std::string socket = (directory / "server.sock").string();
+
+    std::vector<std::string> build = {"-t", target, "-o", "project"};
+    for (int i = 0; i < count; ++i) {
+        std::string file = "module" + std::to_string(i) + ".lh";
+        writeSource(directory / file, i, 0);
+        build.push_back(file);
+    }
+    std::vector<std::string> fresh = {compiler};
+    fresh.insert(fresh.end(), build.begin(), build.end());
+    std::vector<std::string> client = {compiler, "--connect=" + socket};
+    client.insert(client.end(), build.begin(), build.end());
+
+    pid_t server = spawn({compiler, "--server=" + socket});
+    bool ok = server > 0 && waitForServer(socket) && runToCompletion(client);
+
+    std::vector<double> samples[2];
+    for (int round = 1; ok && round <= rounds; ++round) {
+        for (int mode = 0; mode < 2 && ok; ++mode) {
+            int file = (round * 7 + mode) % count;
+            writeSource(directory / ("module" + std::to_string(file) + ".lh"), file, round * 2 + mode);
+            auto start = std::chrono::steady_clock::now();
+            ok = runToCompletion(mode == 0 ? fresh : client);
+            samples[mode].push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+    }
+
+    if (server > 0) {
+        kill(server, SIGTERM);
+        waitpid(server, nullptr, 0);
+    }
+    std::filesystem::current_path(std::filesystem::temp_directory_path());
+    std::filesystem::remove_all(directory);
+    if (!ok) {
+        std::fprintf(stderr, "build failed; is %s built?\n", compiler.c_str());
+        return EXIT_FAILURE;
+    }
+
+    std::printf("%d files, -t %s, one file edited per build, median of %d builds\n", count, target.c_str(), rounds);
+    std::printf("%-20s %12s\n", "build", "ms");
+    const char* names[2] = {"fresh process", "--connect"};
+    double medians[2];
+    for (int mode = 0; mode < 2; ++mode) {
+        std::sort(samples[mode].begin(), samples[mode].end());
+        medians[mode] = samples[mode][samples[mode].size() / 2];
+        std::printf("%-20s %12.2f", names[mode], medians[mode]);
+        if (mode == 1) {
+            std::printf(" %8.2fx", medians[0] / medians[1]);
+        }
+        std::printf("\n");
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,236 @@
+// Specialization benchmark: a large function with untyped parameters is
+// called with concrete arguments, compiled once with only the generic
+// version and once with a copy per argument signature. Reports the growth
+// of the native code and the time per call on both backends.
+//
+// Usage: lithium_specialize_bench [min-milliseconds-per-measurement]
+
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ast_builder.hpp"
+#include "timing.hpp"
+#include "codegen.hpp"
+#include "bytecode.hpp"
+#include "jit.hpp"
+#include "x86.hpp"
+#include "vm.hpp"
+
+namespace {
+    using namespace bench;
+
+    struct Benchmark {
+        std::string name;
+        long callsPerRun;
+        std::function<std::unique_ptr<ProgramNode>()> build;
+    };
+
+    struct Measurement {
+        size_t textBytes = 0;
+        double vmNanos = 0;
+        double jitNanos = 0;
+        int result = 0;
+    };
+
+    // 255 operations over two untyped parameters; far too large to inline
+    void addKernel(ProgramNode& program, const std::vector<std::string>& ops, bool floats) {
+        int counter = 0;
+        auto leaf = [floats](int i) -> std::unique_ptr<Expression> {
+            if (i % 3 == 0) return identifier("x");
+            if (i % 3 == 1) return identifier("y");
+            return floats ? floatLiteral(i % 5 + 0.5) : intLiteral(i % 5 + 1);
+        };
+        addFunction(program, "kernel", {Parameter("x", ""), Parameter("y", "")}, "",
+                    expressionTree(8, ops, leaf, counter));
+    }
+
+    std::unique_ptr<Expression> kernelCall(std::unique_ptr<Expression> x, std::unique_ptr<Expression> y) {
+        std::vector<std::unique_ptr<Expression>> args;
+        args.push_back(std::move(x));
+        args.push_back(std::move(y));
+        return call("kernel", std::move(args));
+    }
+
+    // Sum of `calls` kernel calls whose arguments come from `argument`
+    std::unique_ptr<Expression> sumOfCalls(int calls,
+                                           const std::function<std::unique_ptr<Expression>(int)>& argument) {
+        std::unique_ptr<Expression> sum = kernelCall(argument(0), argument(1));
+        for (int i = 1; i < calls; ++i) {
+            sum = binary(std::move(sum), "+", kernelCall(argument(2 * i), argument(2 * i + 1)));
+        }
+        return sum;
+    }
+
+    // Integer additions and subtractions; every caller passes ints
+    std::unique_ptr<ProgramNode> intArgs() {
+        auto program = std::make_unique<ProgramNode>();
+        addKernel(*program, {"+", "-", "+", "-"}, false);
+        addFunction(*program, "main", {}, "int", sumOfCalls(16, [](int i) { return intLiteral(i % 9); }));
+        return program;
+    }
+
+    // All four operators; every caller passes floats
+    std::unique_ptr<ProgramNode> floatArgs() {
+        auto program = std::make_unique<ProgramNode>();
+        addKernel(*program, {"+", "-", "*", "/"}, true);
+        addFunction(*program, "main", {}, "void", sumOfCalls(16, [](int i) { return floatLiteral(i % 9 + 0.25); }));
+        return program;
+    }
+
+    // Half the callers pass ints and half floats, so two copies are made
+    std::unique_ptr<ProgramNode> mixedArgs() {
+        auto program = std::make_unique<ProgramNode>();
+        addKernel(*program, {"+", "-", "+", "*"}, false);
+        addFunction(*program, "main", {}, "void", sumOfCalls(16, [](int i) -> std::unique_ptr<Expression> {
+            if (i < 16) return intLiteral(i % 3);
+            return floatLiteral(i % 3 + 0.5);
+        }));
+        return program;
+    }
+
+    // Every caller passes ints too wide for the NaN-box payload, which the
+    // generic version boxes in cells; the result must not change
+    std::unique_ptr<ProgramNode> wideIntArgs() {
+        auto program = std::make_unique<ProgramNode>();
+        addKernel(*program, {"+", "-", "+", "-"}, false);
+        const int64_t wide = int64_t(1) << 50;
+        std::unique_ptr<Expression> sum;
+        for (int i = 0; i < 8; ++i) {
+            int64_t x = wide + i;
+            int64_t y = wide + 7 * i + 1;
+            auto difference = binary(kernelCall(intLiteral(x), intLiteral(y)), "-",
+                                     kernelCall(intLiteral(y), intLiteral(x)));
+            sum = sum ? binary(std::move(sum), "+", std::move(difference)) : std::move(difference);
+        }
+        addFunction(*program, "main", {}, "int", std::move(sum));
+        return program;
+    }
+
+    // f(a: any) -> int = a; main returns f(2^53 + 1) - 2^53. Specialization
+    // and the peephole box/unbox rule skip the box, so the generic version
+    // must not round the int either.
+    std::unique_ptr<ProgramNode> wideIntRoundTrip() {
+        auto program = std::make_unique<ProgramNode>();
+        addFunction(*program, "f", {Parameter("a", "")}, "int", identifier("a"));
+        const int64_t big = int64_t(1) << 53;
+        std::vector<std::unique_ptr<Expression>> args;
+        args.push_back(intLiteral(big + 1));
+        addFunction(*program, "main", {}, "int", binary(call("f", std::move(args)), "-", intLiteral(big)));
+        return program;
+    }
+
+    bool checkWideIntRoundTrip() {
+        for (bool specialize : {false, true}) {
+            for (bool peephole : {false, true}) {
+                ErrorReporter bytecodeErrors;
+                auto bytecodeProgram = wideIntRoundTrip();
+                CodeGenerator bytecodeGenerator(Target(TargetType::BYTECODE, ""), bytecodeErrors);
+                bytecodeGenerator.setSpecialization(specialize);
+                bytecodeGenerator.setPeephole(peephole);
+                BytecodeModule bytecode;
+                if (!bytecodeGenerator.generateBytecodeInMemory(bytecodeProgram.get(), bytecode)) {
+                    bytecodeErrors.printErrors();
+                    return false;
+                }
+
+                ErrorReporter machineErrors;
+                auto machineProgram = wideIntRoundTrip();
+                CodeGenerator machineGenerator(Target(TargetType::EXECUTABLE, ""), machineErrors);
+                machineGenerator.setSpecialization(specialize);
+                machineGenerator.setPeephole(peephole);
+                MachineModule machine;
+                JitModule jit(machineErrors);
+                if (!machineGenerator.generateInMemory(machineProgram.get(), machine) || !jit.load(machine)) {
+                    machineErrors.printErrors();
+                    return false;
+                }
+
+                int vmResult = VirtualMachine(bytecode).runMain();
+                int jitResult = jit.runMain();
+                if (vmResult != 1 || jitResult != 1) {
+                    std::fprintf(stderr, "wide int round trip: vm %d, jit %d with specialization %s and peephole %s\n",
+                                 vmResult, jitResult, specialize ? "on" : "off", peephole ? "on" : "off");
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    bool measure(const Benchmark& benchmark, bool specialize, double minMillis, Measurement& out) {
+        ErrorReporter bytecodeErrors;
+        auto bytecodeProgram = benchmark.build();
+        CodeGenerator bytecodeGenerator(Target(TargetType::BYTECODE, ""), bytecodeErrors);
+        bytecodeGenerator.setSpecialization(specialize);
+        BytecodeModule bytecode;
+        if (!bytecodeGenerator.generateBytecodeInMemory(bytecodeProgram.get(), bytecode)) {
+            bytecodeErrors.printErrors();
+            return false;
+        }
+        VirtualMachine vm(bytecode);
+        out.vmNanos = nanosPerRun(minMillis, [&] { vm.runMain(); }) / static_cast<double>(benchmark.callsPerRun);
+
+        ErrorReporter machineErrors;
+        auto machineProgram = benchmark.build();
+        CodeGenerator machineGenerator(Target(TargetType::EXECUTABLE, ""), machineErrors);
+        machineGenerator.setSpecialization(specialize);
+        MachineModule machine;
+        JitModule jit(machineErrors);
+        if (!machineGenerator.generateInMemory(machineProgram.get(), machine)) {
+            machineErrors.printErrors();
+            return false;
+        }
+        out.textBytes = machine.text.size();
+        if (!jit.load(machine)) {
+            machineErrors.printErrors();
+            return false;
+        }
+        out.result = jit.runMain();
+        if (out.result != VirtualMachine(bytecode).runMain()) {
+            std::fprintf(stderr, "%s: native and bytecode results differ\n", benchmark.name.c_str());
+            return false;
+        }
+        out.jitNanos = nanosPerRun(minMillis, [&] { jit.runMain(); }) / static_cast<double>(benchmark.callsPerRun);
+        return true;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    double minMillis = argc > 1 ? std::atof(argv[1]) : 200.0;
+
+    std::vector<Benchmark> benchmarks = {
+        {"int_args", 16, intArgs},
+        {"float_args", 16, floatArgs},
+        {"mixed_args", 16, mixedArgs},
+        {"wide_int_args", 16, wideIntArgs},
+    };
+
+    if (!checkWideIntRoundTrip()) {
+        return EXIT_FAILURE;
+    }
+
+    std::printf("%-14s %-12s %10s %12s %12s\n", "benchmark", "version", "text bytes", "vm ns/call", "jit ns/call");
+    for (const auto& benchmark : benchmarks) {
+        Measurement generic;
+        Measurement specialized;
+        if (!measure(benchmark, false, minMillis, generic) || !measure(benchmark, true, minMillis, specialized)) {
+            return EXIT_FAILURE;
+        }
+        if (generic.result != specialized.result) {
+            std::fprintf(stderr, "%s: specialization changed the result\n", benchmark.name.c_str());
+            return EXIT_FAILURE;
+        }
+        std::printf("%-14s %-12s %10zu %12.1f %12.1f\n", benchmark.name.c_str(), "generic", generic.textBytes,
+                    generic.vmNanos, generic.jitNanos);
+        std::printf("%-14s %-12s %10zu %12.1f %12.1f\n", "", "specialized", specialized.textBytes,
+                    specialized.vmNanos, specialized.jitNanos);
+        std::printf("%-14s %-12s %+9.0f%% %11.2fx %11.2fx\n", "", "change",
+                    100.0 * (static_cast<double>(specialized.textBytes) / static_cast<double>(generic.textBytes) - 1),
+                    generic.vmNanos / specialized.vmNanos, generic.jitNanos / specialized.jitNanos);
+    }
+    return EXIT_SUCCESS;
+}
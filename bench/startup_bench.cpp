@@ -0,0 +1,151 @@
+// Startup benchmark: builds executables for a trivial program, one with
+// many constant globals and one linked with the runtime library, then
+// times spawning each until it exits. Fails when the trivial program's
+// median exceeds the budget, so startup cost cannot creep up unnoticed.
+//
+// Usage: lithium_startup_bench [budget-microseconds] [runs]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "ast_builder.hpp"
+#include "codegen.hpp"
+
+extern char** environ;
+
+namespace {
+    using namespace bench;
+
+    struct Benchmark {
+        std::string name;
+        std::function<std::unique_ptr<ProgramNode>()> build;
+    };
+
+    std::unique_ptr<ProgramNode> trivial() {
+        auto program = std::make_unique<ProgramNode>();
+        addFunction(*program, "main", {}, "int", intLiteral(0));
+        return program;
+    }
+
+    // Every initializer is a constant, so nothing runs before main
+    std::unique_ptr<ProgramNode> constantGlobals() {
+        auto program = std::make_unique<ProgramNode>();
+        for (int i = 0; i < 1000; ++i) {
+            auto global = std::make_unique<VarDecl>("g" + std::to_string(i));
+            if (i % 3 == 0) {
+                global->initializer = intLiteral(i);
+            } else if (i % 3 == 1) {
+                global->initializer = floatLiteral(i + 0.5);
+            } else {
+                global->initializer = std::make_unique<StringLiteral>("global " + std::to_string(i));
+            }
+            program->declarations.push_back(std::move(global));
+        }
+        addFunction(*program, "main", {}, "int", binary(identifier("g0"), "+", identifier("g999")));
+        return program;
+    }
+
+    // Links the runtime and exits through it
+    std::unique_ptr<ProgramNode> runtimeConcat() {
+        auto program = std::make_unique<ProgramNode>();
+        addFunction(*program, "greet", {Parameter("name", "string")}, "string",
+                    binary(std::make_unique<StringLiteral>("hello, "), "+", identifier("name")));
+        addFunction(*program, "main", {}, "void", call("greet", std::make_unique<StringLiteral>("world")));
+        return program;
+    }
+
+    bool compile(const Benchmark& benchmark, const std::string& path) {
+        ErrorReporter errors;
+        auto program = benchmark.build();
+        CodeGenerator generator(Target(TargetType::EXECUTABLE, path), errors);
+        if (!generator.generate(program.get(), path)) {
+            errors.printErrors();
+            return false;
+        }
+        return true;
+    }
+
+    // Median spawn-to-exit time in microseconds, or a negative value if the
+    // program could not be run
+    double medianMicros(const std::string& path, int runs) {
+        std::vector<double> samples;
+        char* argv[] = {const_cast<char*>(path.c_str()), nullptr};
+        for (int i = 0; i < runs; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            pid_t pid;
+            if (posix_spawn(&pid, path.c_str(), nullptr, nullptr, argv, environ) != 0) {
+                return -1;
+            }
+            int status;
+            if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status)) {
+                return -1;
+            }
+            samples.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+        }
+        std::sort(samples.begin(), samples.end());
+        return samples[samples.size() / 2];
+    }
+}
+
+int main(int argc, char* argv[]) {
+    double budget = argc > 1 ? std::atof(argv[1]) : 500.0;
+    int runs = argc > 2 ? std::atoi(argv[2]) : 200;
+
+    std::vector<Benchmark> benchmarks = {
+        {"trivial", trivial},
+        {"const_globals", constantGlobals},
+        {"runtime_concat", runtimeConcat},
+    };
+
+    auto directory = std::filesystem::temp_directory_path() / ("lithium_startup_" + std::to_string(getpid()));
+    std::filesystem::create_directories(directory);
+
+    std::printf("%-14s %10s %12s\n", "program", "bytes", "median us");
+    double trivialMicros = 0;
+    bool ok = true;
+    for (const auto& benchmark : benchmarks) {
+        std::string path = (directory / benchmark.name).string();
+        if (!compile(benchmark, path)) {
+            ok = false;
+            break;
+        }
+        double micros = medianMicros(path, runs);
+        if (micros < 0) {
+            std::fprintf(stderr, "%s: could not run %s\n", benchmark.name.c_str(), path.c_str());
+            ok = false;
+            break;
+        }
+        if (benchmark.name == "trivial") {
+            trivialMicros = micros;
+        }
+        std::printf("%-14s %10ju %12.1f\n", benchmark.name.c_str(),
+                    static_cast<uintmax_t>(std::filesystem::file_size(path)), micros);
+    }
+    double reference = ok && access("/bin/true", X_OK) == 0 ? medianMicros("/bin/true", runs) : -1;
+    if (reference >= 0) {
+        std::printf("%-14s %10ju %12.1f\n", "/bin/true", static_cast<uintmax_t>(std::filesystem::file_size("/bin/true")),
+                    reference);
+    }
+    std::filesystem::remove_all(directory);
+    if (!ok) {
+        return EXIT_FAILURE;
+    }
+
+    if (trivialMicros > budget) {
+        std::printf("trivial program takes %.1f us to start and exit, over the %.1f us budget\n", trivialMicros, budget);
+        return EXIT_FAILURE;
+    }
+    std::printf("trivial program within the %.1f us budget\n", budget);
+    return EXIT_SUCCESS;
+}
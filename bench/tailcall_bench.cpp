@@ -0,0 +1,156 @@
+// Tail call benchmark: self- and mutually recursive functions are run to a
+// fixed depth with and without tail calls, on the bytecode interpreter and
+// as native code, and the time and peak memory of each run is reported.
+//
+// The language has no conditionals yet, so the recursion ends with a
+// deliberate division by zero once the counter reaches zero: the
+// interpreter throws and native code takes SIGFPE. Running out of stack
+// first shows up as "overflow". Every run happens in its own child process.
+//
+// Usage: lithium_tailcall_bench [depth]
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "ast_builder.hpp"
+#include "codegen.hpp"
+#include "bytecode.hpp"
+#include "jit.hpp"
+#include "x86.hpp"
+#include "vm.hpp"
+
+namespace {
+    using namespace bench;
+
+    enum Outcome { REACHED_DEPTH = 0, OVERFLOW = 1, FAILED = 2 };
+
+    struct Benchmark {
+        std::string name;
+        std::function<std::unique_ptr<ProgramNode>(int)> build;
+    };
+
+    // n - 1, trapping once n is zero
+    std::unique_ptr<Expression> countDown() {
+        auto trap = binary(intLiteral(0), "*", binary(intLiteral(1), "/", identifier("n")));
+        return binary(binary(identifier("n"), "-", intLiteral(1)), "+", std::move(trap));
+    }
+
+    // loop(n) = loop(n - 1)
+    std::unique_ptr<ProgramNode> selfRecursion(int depth) {
+        auto program = std::make_unique<ProgramNode>();
+        addFunction(*program, "loop", {Parameter("n", "int")}, "int", call("loop", countDown()));
+        addFunction(*program, "main", {}, "int", call("loop", intLiteral(depth)));
+        return program;
+    }
+
+    // even(n) = odd(n - 1), odd(n) = even(n - 1)
+    std::unique_ptr<ProgramNode> mutualRecursion(int depth) {
+        auto program = std::make_unique<ProgramNode>();
+        addFunction(*program, "even", {Parameter("n", "int")}, "int", call("odd", countDown()));
+        addFunction(*program, "odd", {Parameter("n", "int")}, "int", call("even", countDown()));
+        addFunction(*program, "main", {}, "int", call("even", intLiteral(depth)));
+        return program;
+    }
+
+    // Runs in the child; the exit status or signal tells how it ended
+    int runBytecode(ProgramNode& program, bool tailCalls) {
+        ErrorReporter errorReporter;
+        CodeGenerator codeGenerator(Target(TargetType::BYTECODE, ""), errorReporter);
+        codeGenerator.setTailCalls(tailCalls);
+        BytecodeModule module;
+        if (!codeGenerator.generateBytecodeInMemory(&program, module)) {
+            errorReporter.printErrors();
+            return FAILED;
+        }
+        VirtualMachine vm(module);
+        try {
+            vm.runMain();
+        } catch (const std::runtime_error& e) {
+            std::string message = e.what();
+            if (message.rfind("Division by zero", 0) == 0) return REACHED_DEPTH;
+            if (message.rfind("Stack overflow", 0) == 0) return OVERFLOW;
+        }
+        return FAILED;
+    }
+
+    int runNative(ProgramNode& program, bool tailCalls) {
+        ErrorReporter errorReporter;
+        CodeGenerator codeGenerator(Target(TargetType::EXECUTABLE, ""), errorReporter);
+        codeGenerator.setTailCalls(tailCalls);
+        MachineModule module;
+        JitModule jit(errorReporter);
+        if (!codeGenerator.generateInMemory(&program, module) || !jit.load(module)) {
+            errorReporter.printErrors();
+            return FAILED;
+        }
+        jit.runMain();
+        return FAILED;
+    }
+
+    const char* describe(int status) {
+        if (WIFEXITED(status)) {
+            switch (WEXITSTATUS(status)) {
+                case REACHED_DEPTH: return "reached";
+                case OVERFLOW: return "overflow";
+                default: return "failed";
+            }
+        }
+        if (WIFSIGNALED(status)) {
+            switch (WTERMSIG(status)) {
+                case SIGFPE: return "reached";
+                case SIGSEGV: return "overflow";
+                default: return "failed";
+            }
+        }
+        return "failed";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int depth = argc > 1 ? std::atoi(argv[1]) : 10000000;
+
+    std::vector<Benchmark> benchmarks = {
+        {"self", selfRecursion},
+        {"mutual", mutualRecursion},
+    };
+
+    std::printf("depth %d\n", depth);
+    std::printf("%-8s %-8s %-6s %-10s %10s %12s\n", "program", "backend", "tail", "outcome", "ms", "peak-KB");
+    std::fflush(stdout);
+    for (const auto& benchmark : benchmarks) {
+        for (bool native : {false, true}) {
+            for (bool tailCalls : {true, false}) {
+                auto start = std::chrono::steady_clock::now();
+                pid_t child = fork();
+                if (child == 0) {
+                    auto program = benchmark.build(depth);
+                    int outcome = native ? runNative(*program, tailCalls) : runBytecode(*program, tailCalls);
+                    std::fflush(stdout);
+                    std::_Exit(outcome);
+                }
+                int status = 0;
+                rusage usage{};
+                if (child < 0 || wait4(child, &status, 0, &usage) < 0) {
+                    std::perror("fork");
+                    return EXIT_FAILURE;
+                }
+                double millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                std::printf("%-8s %-8s %-6s %-10s %10.1f %12ld\n", benchmark.name.c_str(), native ? "native" : "vm",
+                            tailCalls ? "on" : "off", describe(status), millis, usage.ru_maxrss);
+                std::fflush(stdout);
+            }
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+// Timing loop shared by the benchmarks
+
+#include <chrono>
+
+namespace bench {
+    // Calls `run` in batches of `batch` until at least `minMillis` have
+    // passed and returns the mean time per call in nanoseconds
+    template <typename Run>
+    double nanosPerRun(double minMillis, Run run, int batch = 100) {
+        long runs = 0;
+        auto start = std::chrono::steady_clock::now();
+        double elapsed = 0;
+        do {
+            for (int i = 0; i < batch; ++i) {
+                run();
+            }
+            runs += batch;
+            elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        } while (elapsed < minMillis * 1e6);
+        return elapsed / static_cast<double>(runs);
+    }
+}
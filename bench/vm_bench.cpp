@@ -0,0 +1,128 @@
+// Bytecode interpreter micro-benchmarks: call-heavy and arithmetic-heavy
+// programs are built as ASTs, compiled to bytecode and run repeatedly.
+//
+// Usage: lithium_vm_bench [min-milliseconds-per-benchmark]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ast_builder.hpp"
+#include "codegen.hpp"
+#include "bytecode.hpp"
+#include "vm.hpp"
+
+namespace {
+    using namespace bench;
+
+    struct Benchmark {
+        std::string name;
+        long opsPerRun;
+        std::function<std::unique_ptr<ProgramNode>()> build;
+    };
+
+    // f0 -> f1 -> ... -> f63, each adding one on the way back
+    std::unique_ptr<ProgramNode> callChain() {
+        const int depth = 64;
+        auto program = std::make_unique<ProgramNode>();
+        for (int i = 0; i < depth; ++i) {
+            std::string next = "f" + std::to_string(i + 1);
+            auto body = i + 1 < depth ? binary(call(next, identifier("x")), "+", intLiteral(1)) : identifier("x");
+            addFunction(*program, "f" + std::to_string(i), {Parameter("x", "int")}, "int", std::move(body));
+        }
+        addFunction(*program, "main", {}, "int", call("f0", intLiteral(0)));
+        return program;
+    }
+
+    // main sums 64 calls to a two-argument leaf
+    std::unique_ptr<ProgramNode> callFanout() {
+        auto program = std::make_unique<ProgramNode>();
+        addFunction(*program, "mul", {Parameter("a", "int"), Parameter("b", "int")}, "int",
+                    binary(identifier("a"), "*", identifier("b")));
+        std::unique_ptr<Expression> sum = intLiteral(0);
+        for (int i = 0; i < 64; ++i) {
+            std::vector<std::unique_ptr<Expression>> args;
+            args.push_back(intLiteral(i));
+            args.push_back(intLiteral(3));
+            sum = binary(std::move(sum), "+", call("mul", std::move(args)));
+        }
+        addFunction(*program, "main", {}, "int", std::move(sum));
+        return program;
+    }
+
+    // 1023 integer operations over a parameter so nothing folds away
+    std::unique_ptr<ProgramNode> intArithmetic() {
+        auto program = std::make_unique<ProgramNode>();
+        int counter = 0;
+        auto leaf = [](int i) { return i % 2 ? identifier("x") : intLiteral(i % 7 + 1); };
+        addFunction(*program, "compute", {Parameter("x", "int")}, "int",
+                    expressionTree(10, {"+", "-", "*", "+"}, leaf, counter));
+        addFunction(*program, "main", {}, "int", call("compute", intLiteral(3)));
+        return program;
+    }
+
+    std::unique_ptr<ProgramNode> floatArithmetic() {
+        auto program = std::make_unique<ProgramNode>();
+        int counter = 0;
+        auto leaf = [](int i) { return i % 2 ? identifier("x") : floatLiteral(i % 7 + 0.5); };
+        addFunction(*program, "compute", {Parameter("x", "float")}, "float",
+                    expressionTree(10, {"+", "-", "*", "/"}, leaf, counter));
+        addFunction(*program, "main", {}, "void", call("compute", floatLiteral(1.25)));
+        return program;
+    }
+
+    // 63 concatenations of short literals
+    std::unique_ptr<ProgramNode> stringConcat() {
+        auto program = std::make_unique<ProgramNode>();
+        int counter = 0;
+        auto leaf = [](int i) { return std::make_unique<StringLiteral>("s" + std::to_string(i)); };
+        addFunction(*program, "build", {}, "string", expressionTree(6, {"+"}, leaf, counter));
+        addFunction(*program, "main", {}, "void", call("build"));
+        return program;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    double minMillis = argc > 1 ? std::atof(argv[1]) : 200.0;
+
+    std::vector<Benchmark> benchmarks = {
+        {"call_chain", 64, callChain},
+        {"call_fanout", 64, callFanout},
+        {"int_arith", 1023, intArithmetic},
+        {"float_arith", 1023, floatArithmetic},
+        {"string_concat", 63, stringConcat},
+    };
+
+    std::printf("%-16s %10s %12s %10s\n", "benchmark", "ops/run", "runs", "ns/op");
+    for (const auto& benchmark : benchmarks) {
+        ErrorReporter errorReporter;
+        auto program = benchmark.build();
+        CodeGenerator codeGenerator(Target(TargetType::BYTECODE, ""), errorReporter);
+        BytecodeModule module;
+        if (!codeGenerator.generateBytecodeInMemory(program.get(), module)) {
+            errorReporter.printErrors();
+            return EXIT_FAILURE;
+        }
+
+        long runs = 0;
+        auto start = std::chrono::steady_clock::now();
+        double elapsed = 0;
+        do {
+            // A fresh VM per batch keeps concatenation results from piling up
+            VirtualMachine vm(module);
+            for (int i = 0; i < 100; ++i) {
+                vm.runMain();
+            }
+            runs += 100;
+            elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        } while (elapsed < minMillis * 1e6);
+
+        std::printf("%-16s %10ld %12ld %10.2f\n", benchmark.name.c_str(), benchmark.opsPerRun, runs,
+                    elapsed / (static_cast<double>(runs) * benchmark.opsPerRun));
+    }
+    return EXIT_SUCCESS;
+}
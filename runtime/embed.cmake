@@ -0,0 +1,20 @@
+# Writes the runtime archive into a C++ source file so the compiler can link
+# it into executables without looking for it on disk.
+#   cmake -DINPUT=liblithium_rt.a -DOUTPUT=lithium_rt_archive.cpp -P embed.cmake
+file(READ ${INPUT} bytes HEX)
+file(SIZE ${INPUT} size)
+string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," bytes "${bytes}")
+string(REGEX REPLACE "(0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,)" "\\1\n        " bytes "${bytes}")
+file(WRITE ${OUTPUT} "// Generated from liblithium_rt.a by runtime/embed.cmake; do not edit
+#include \"linker.hpp\"
+
+namespace {
+    const unsigned char archive[] = {
+        ${bytes}
+    };
+}
+
+std::string_view StaticLinker::runtimeArchive() {
+    return std::string_view(reinterpret_cast<const char*>(archive), ${size});
+}
+")
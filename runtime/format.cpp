@@ -0,0 +1,571 @@
+#include "lithium_rt.h"
+#include "simd.hpp"
+
+// Integers are written two digits at a time. Floats use Grisu3 (Loitsch,
+// "Printing floating-point numbers quickly and accurately with integers",
+// PLDI 2010), which finds the shortest digits that read back as the same
+// double with 64-bit integers alone and knows when it could not be sure.
+// For those few values, a fraction of a percent, Grisu2's digits, which
+// always read back, are shortened with exact big integer comparisons.
+namespace {
+    const char DIGIT_PAIRS[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+    unsigned decimalDigits(uint64_t value) {
+        unsigned digits = 1;
+        for (;;) {
+            if (value < 10) return digits;
+            if (value < 100) return digits + 1;
+            if (value < 1000) return digits + 2;
+            if (value < 10000) return digits + 3;
+            value /= 10000;
+            digits += 4;
+        }
+    }
+
+    // Writes exactly `digits` digits of value, least significant last
+    void writeDigits(uint64_t value, char* out, unsigned digits) {
+        char* end = out + digits;
+        while (value >= 100) {
+            unsigned pair = static_cast<unsigned>(value % 100) * 2;
+            value /= 100;
+            end -= 2;
+            end[0] = DIGIT_PAIRS[pair];
+            end[1] = DIGIT_PAIRS[pair + 1];
+        }
+        if (value >= 10) {
+            unsigned pair = static_cast<unsigned>(value) * 2;
+            end -= 2;
+            end[0] = DIGIT_PAIRS[pair];
+            end[1] = DIGIT_PAIRS[pair + 1];
+        } else if (end > out) {
+            *--end = static_cast<char>('0' + value);
+        }
+    }
+
+    // Floating point number f * 2^e with a 64-bit significand
+    struct DiyFp {
+        uint64_t f;
+        int e;
+    };
+
+    DiyFp multiply(DiyFp x, DiyFp y) {
+        unsigned __int128 product = static_cast<unsigned __int128>(x.f) * y.f;
+        uint64_t high = static_cast<uint64_t>(product >> 64);
+        uint64_t low = static_cast<uint64_t>(product);
+        return {high + (low >> 63), x.e + y.e + 64};
+    }
+
+    DiyFp normalize(DiyFp x) {
+        int shift = __builtin_clzll(x.f);
+        return {x.f << shift, x.e - shift};
+    }
+
+    struct CachedPower {
+        uint64_t f;
+        int e;
+        int k;
+    };
+
+    // 10^k for k = -300, -292, ..., 340, rounded to 64 bits
+    const CachedPower CACHED_POWERS[] = {
+        {0xAB70FE17C79AC6CAULL, -1060, -300},
+        {0xFF77B1FCBEBCDC4FULL, -1034, -292},
+        {0xBE5691EF416BD60CULL, -1007, -284},
+        {0x8DD01FAD907FFC3CULL, -980, -276},
+        {0xD3515C2831559A83ULL, -954, -268},
+        {0x9D71AC8FADA6C9B5ULL, -927, -260},
+        {0xEA9C227723EE8BCBULL, -901, -252},
+        {0xAECC49914078536DULL, -874, -244},
+        {0x823C12795DB6CE57ULL, -847, -236},
+        {0xC21094364DFB5637ULL, -821, -228},
+        {0x9096EA6F3848984FULL, -794, -220},
+        {0xD77485CB25823AC7ULL, -768, -212},
+        {0xA086CFCD97BF97F4ULL, -741, -204},
+        {0xEF340A98172AACE5ULL, -715, -196},
+        {0xB23867FB2A35B28EULL, -688, -188},
+        {0x84C8D4DFD2C63F3BULL, -661, -180},
+        {0xC5DD44271AD3CDBAULL, -635, -172},
+        {0x936B9FCEBB25C996ULL, -608, -164},
+        {0xDBAC6C247D62A584ULL, -582, -156},
+        {0xA3AB66580D5FDAF6ULL, -555, -148},
+        {0xF3E2F893DEC3F126ULL, -529, -140},
+        {0xB5B5ADA8AAFF80B8ULL, -502, -132},
+        {0x87625F056C7C4A8BULL, -475, -124},
+        {0xC9BCFF6034C13053ULL, -449, -116},
+        {0x964E858C91BA2655ULL, -422, -108},
+        {0xDFF9772470297EBDULL, -396, -100},
+        {0xA6DFBD9FB8E5B88FULL, -369, -92},
+        {0xF8A95FCF88747D94ULL, -343, -84},
+        {0xB94470938FA89BCFULL, -316, -76},
+        {0x8A08F0F8BF0F156BULL, -289, -68},
+        {0xCDB02555653131B6ULL, -263, -60},
+        {0x993FE2C6D07B7FACULL, -236, -52},
+        {0xE45C10C42A2B3B06ULL, -210, -44},
+        {0xAA242499697392D3ULL, -183, -36},
+        {0xFD87B5F28300CA0EULL, -157, -28},
+        {0xBCE5086492111AEBULL, -130, -20},
+        {0x8CBCCC096F5088CCULL, -103, -12},
+        {0xD1B71758E219652CULL, -77, -4},
+        {0x9C40000000000000ULL, -50, 4},
+        {0xE8D4A51000000000ULL, -24, 12},
+        {0xAD78EBC5AC620000ULL, 3, 20},
+        {0x813F3978F8940984ULL, 30, 28},
+        {0xC097CE7BC90715B3ULL, 56, 36},
+        {0x8F7E32CE7BEA5C70ULL, 83, 44},
+        {0xD5D238A4ABE98068ULL, 109, 52},
+        {0x9F4F2726179A2245ULL, 136, 60},
+        {0xED63A231D4C4FB27ULL, 162, 68},
+        {0xB0DE65388CC8ADA8ULL, 189, 76},
+        {0x83C7088E1AAB65DBULL, 216, 84},
+        {0xC45D1DF942711D9AULL, 242, 92},
+        {0x924D692CA61BE758ULL, 269, 100},
+        {0xDA01EE641A708DEAULL, 295, 108},
+        {0xA26DA3999AEF774AULL, 322, 116},
+        {0xF209787BB47D6B85ULL, 348, 124},
+        {0xB454E4A179DD1877ULL, 375, 132},
+        {0x865B86925B9BC5C2ULL, 402, 140},
+        {0xC83553C5C8965D3DULL, 428, 148},
+        {0x952AB45CFA97A0B3ULL, 455, 156},
+        {0xDE469FBD99A05FE3ULL, 481, 164},
+        {0xA59BC234DB398C25ULL, 508, 172},
+        {0xF6C69A72A3989F5CULL, 534, 180},
+        {0xB7DCBF5354E9BECEULL, 561, 188},
+        {0x88FCF317F22241E2ULL, 588, 196},
+        {0xCC20CE9BD35C78A5ULL, 614, 204},
+        {0x98165AF37B2153DFULL, 641, 212},
+        {0xE2A0B5DC971F303AULL, 667, 220},
+        {0xA8D9D1535CE3B396ULL, 694, 228},
+        {0xFB9B7CD9A4A7443CULL, 720, 236},
+        {0xBB764C4CA7A44410ULL, 747, 244},
+        {0x8BAB8EEFB6409C1AULL, 774, 252},
+        {0xD01FEF10A657842CULL, 800, 260},
+        {0x9B10A4E5E9913129ULL, 827, 268},
+        {0xE7109BFBA19C0C9DULL, 853, 276},
+        {0xAC2820D9623BF429ULL, 880, 284},
+        {0x80444B5E7AA7CF85ULL, 907, 292},
+        {0xBF21E44003ACDD2DULL, 933, 300},
+        {0x8E679C2F5E44FF8FULL, 960, 308},
+        {0xD433179D9C8CB841ULL, 986, 316},
+        {0x9E19DB92B4E31BA9ULL, 1013, 324},
+        {0xEB96BF6EBADF77D9ULL, 1039, 332},
+        {0xAF87023B9BF0EE6BULL, 1066, 340},
+    };
+    constexpr int CACHED_POWERS_MIN_EXPONENT = -300;
+    constexpr int CACHED_POWERS_STEP = 8;
+
+    // Scaled values keep their binary exponent in [ALPHA, GAMMA], so the
+    // integer part of a digit fits in 32 bits
+    constexpr int ALPHA = -60;
+    constexpr int GAMMA = -32;
+
+    const CachedPower& cachedPowerFor(int e) {
+        // Smallest k with 10^k * 2^e >= 2^ALPHA; 78913 / 2^18 is log10(2)
+        int f = ALPHA - e - 1;
+        int k = (f * 78913) / (1 << 18) + (f > 0);
+        int index = (-CACHED_POWERS_MIN_EXPONENT + k + (CACHED_POWERS_STEP - 1)) / CACHED_POWERS_STEP;
+        return CACHED_POWERS[index];
+    }
+
+    // Moves the last digit towards the exact value while it stays within
+    // the rounding interval
+    void roundWeedApproximate(char* digits, int length, uint64_t distance, uint64_t delta, uint64_t rest, uint64_t tenK) {
+        while (rest < distance && delta - rest >= tenK &&
+               (rest + tenK < distance || distance - rest > rest + tenK - distance)) {
+            --digits[length - 1];
+            rest += tenK;
+        }
+    }
+
+    // Digits of a value in (low, high) that is closest to `value`; they may
+    // be one longer than needed
+    void generateDigitsApproximate(char* digits, int& length, int& exponent, DiyFp low, DiyFp value, DiyFp high) {
+        uint64_t delta = high.f - low.f;
+        uint64_t distance = high.f - value.f;
+        const DiyFp one = {uint64_t(1) << -high.e, high.e};
+
+        auto integral = static_cast<uint32_t>(high.f >> -one.e);
+        uint64_t fractional = high.f & (one.f - 1);
+
+        unsigned remaining = decimalDigits(integral);
+        uint32_t divisor = 1;
+        for (unsigned i = 1; i < remaining; ++i) {
+            divisor *= 10;
+        }
+        while (remaining > 0) {
+            uint32_t digit = integral / divisor;
+            integral %= divisor;
+            digits[length++] = static_cast<char>('0' + digit);
+            --remaining;
+            uint64_t rest = (static_cast<uint64_t>(integral) << -one.e) + fractional;
+            if (rest <= delta) {
+                exponent += static_cast<int>(remaining);
+                roundWeedApproximate(digits, length, distance, delta, rest, static_cast<uint64_t>(divisor) << -one.e);
+                return;
+            }
+            divisor /= 10;
+        }
+
+        int fractionalDigits = 0;
+        for (;;) {
+            fractional *= 10;
+            delta *= 10;
+            distance *= 10;
+            digits[length++] = static_cast<char>('0' + (fractional >> -one.e));
+            fractional &= one.f - 1;
+            ++fractionalDigits;
+            if (fractional <= delta) {
+                break;
+            }
+        }
+        exponent -= fractionalDigits;
+        roundWeedApproximate(digits, length, distance, delta, fractional, one.f);
+    }
+
+    // Like roundWeedApproximate, where every scaled value may be off by
+    // `unit`. Fails unless the result is certainly the closest digits inside
+    // the rounding interval.
+    bool roundWeed(char* digits, int length, uint64_t distance, uint64_t unsafeInterval, uint64_t rest, uint64_t tenK,
+                   uint64_t unit) {
+        uint64_t smallDistance = distance - unit;
+        uint64_t bigDistance = distance + unit;
+        while (rest < smallDistance && unsafeInterval - rest >= tenK &&
+               (rest + tenK < smallDistance || smallDistance - rest >= rest + tenK - smallDistance)) {
+            --digits[length - 1];
+            rest += tenK;
+        }
+        // Another digit might be closer to the exact value
+        if (rest < bigDistance && unsafeInterval - rest >= tenK &&
+            (rest + tenK < bigDistance || bigDistance - rest > rest + tenK - bigDistance)) {
+            return false;
+        }
+        return 2 * unit <= rest && rest <= unsafeInterval - 4 * unit;
+    }
+
+    // The shortest digits in the widened interval (low - 1, high + 1); fails
+    // unless they are certainly inside (low, high) as well
+    bool generateDigits(char* digits, int& length, int& exponent, DiyFp low, DiyFp value, DiyFp high) {
+        uint64_t unit = 1;
+        DiyFp tooLow = {low.f - unit, low.e};
+        DiyFp tooHigh = {high.f + unit, high.e};
+        uint64_t unsafeInterval = tooHigh.f - tooLow.f;
+        uint64_t distance = tooHigh.f - value.f;
+        const DiyFp one = {uint64_t(1) << -high.e, high.e};
+
+        auto integral = static_cast<uint32_t>(tooHigh.f >> -one.e);
+        uint64_t fractional = tooHigh.f & (one.f - 1);
+
+        unsigned remaining = decimalDigits(integral);
+        uint32_t divisor = 1;
+        for (unsigned i = 1; i < remaining; ++i) {
+            divisor *= 10;
+        }
+        while (remaining > 0) {
+            uint32_t digit = integral / divisor;
+            integral %= divisor;
+            digits[length++] = static_cast<char>('0' + digit);
+            --remaining;
+            uint64_t rest = (static_cast<uint64_t>(integral) << -one.e) + fractional;
+            if (rest < unsafeInterval) {
+                exponent += static_cast<int>(remaining);
+                return roundWeed(digits, length, distance, unsafeInterval, rest, static_cast<uint64_t>(divisor) << -one.e,
+                                 unit);
+            }
+            divisor /= 10;
+        }
+
+        int fractionalDigits = 0;
+        for (;;) {
+            fractional *= 10;
+            unit *= 10;
+            unsafeInterval *= 10;
+            digits[length++] = static_cast<char>('0' + (fractional >> -one.e));
+            fractional &= one.f - 1;
+            ++fractionalDigits;
+            if (fractional < unsafeInterval) {
+                exponent -= fractionalDigits;
+                return roundWeed(digits, length, distance * unit, unsafeInterval, fractional, one.f, unit);
+            }
+        }
+    }
+
+    // Unsigned integer big enough for any double's rounding interval scaled
+    // to a power of ten, about 1200 bits
+    struct BigInt {
+        uint32_t limbs[40];
+        int size;
+    };
+
+    BigInt bigInt(uint64_t value) {
+        BigInt x;
+        x.size = 0;
+        for (; value; value >>= 32) {
+            x.limbs[x.size++] = static_cast<uint32_t>(value);
+        }
+        return x;
+    }
+
+    void multiply(BigInt& x, uint32_t factor) {
+        uint64_t carry = 0;
+        for (int i = 0; i < x.size; ++i) {
+            uint64_t product = static_cast<uint64_t>(x.limbs[i]) * factor + carry;
+            x.limbs[i] = static_cast<uint32_t>(product);
+            carry = product >> 32;
+        }
+        if (carry) {
+            x.limbs[x.size++] = static_cast<uint32_t>(carry);
+        }
+    }
+
+    void multiplyByPowerOfTen(BigInt& x, int power) {
+        for (; power >= 9; power -= 9) {
+            multiply(x, 1000000000);
+        }
+        uint32_t factor = 1;
+        for (; power > 0; --power) {
+            factor *= 10;
+        }
+        multiply(x, factor);
+    }
+
+    void shiftLeft(BigInt& x, int bits) {
+        if (x.size == 0) return;
+        int words = bits / 32;
+        bits %= 32;
+        x.limbs[x.size] = 0;
+        for (int i = x.size; i >= 0; --i) {
+            uint32_t carried = i > 0 && bits ? x.limbs[i - 1] >> (32 - bits) : 0;
+            x.limbs[i + words] = (x.limbs[i] << bits) | carried;
+        }
+        for (int i = 0; i < words; ++i) {
+            x.limbs[i] = 0;
+        }
+        x.size += words + 1;
+        while (x.size > 0 && x.limbs[x.size - 1] == 0) {
+            --x.size;
+        }
+    }
+
+    // Sign of digits * 10^exponent - value * 2^binaryExponent
+    int compareExact(uint64_t digits, int exponent, uint64_t value, int binaryExponent) {
+        BigInt lhs = bigInt(digits);
+        BigInt rhs = bigInt(value);
+        if (exponent > 0) {
+            multiplyByPowerOfTen(lhs, exponent);
+        } else {
+            multiplyByPowerOfTen(rhs, -exponent);
+        }
+        if (binaryExponent > 0) {
+            shiftLeft(rhs, binaryExponent);
+        } else {
+            shiftLeft(lhs, -binaryExponent);
+        }
+        if (lhs.size != rhs.size) {
+            return lhs.size < rhs.size ? -1 : 1;
+        }
+        for (int i = lhs.size - 1; i >= 0; --i) {
+            if (lhs.limbs[i] != rhs.limbs[i]) {
+                return lhs.limbs[i] < rhs.limbs[i] ? -1 : 1;
+            }
+        }
+        return 0;
+    }
+
+    // Drops trailing digits of `digits` while a number that short still
+    // reads back as m * 2^e, comparing against the exact rounding interval.
+    // A shorter number in the interval is always next to the longer one, and
+    // if none of some length is, none shorter is either.
+    void shortenExactly(char* digits, int& length, int& exponent, uint64_t m, int e, bool closerBelow) {
+        // Everything in units of 2^(e - 2), where the boundaries are integers
+        uint64_t low = closerBelow ? 4 * m - 1 : 4 * m - 2;
+        uint64_t high = 4 * m + 2;
+        // Reading rounds halfway cases to even, so an even m keeps its
+        // boundaries
+        bool inclusive = m % 2 == 0;
+        auto inside = [&](uint64_t candidate, int candidateExponent) {
+            int belowHigh = compareExact(candidate, candidateExponent, high, e - 2);
+            int aboveLow = compareExact(candidate, candidateExponent, low, e - 2);
+            return inclusive ? aboveLow >= 0 && belowHigh <= 0 : aboveLow > 0 && belowHigh < 0;
+        };
+
+        uint64_t value = 0;
+        for (int i = 0; i < length; ++i) {
+            value = value * 10 + static_cast<uint64_t>(digits[i] - '0');
+        }
+        uint64_t best = value;
+        int bestExponent = exponent;
+        uint64_t power = 1;
+        for (int dropped = 1; dropped < length; ++dropped) {
+            power *= 10;
+            uint64_t below = value / power;
+            int candidateExponent = exponent + dropped;
+            bool belowInside = inside(below, candidateExponent);
+            bool aboveInside = inside(below + 1, candidateExponent);
+            if (!belowInside && !aboveInside) {
+                break;
+            }
+            if (belowInside && aboveInside) {
+                // The closer of the two, or the even one from halfway
+                int side = compareExact(2 * below + 1, candidateExponent, 8 * m, e - 2);
+                belowInside = side > 0 || (side == 0 && below % 2 == 0);
+            }
+            best = belowInside ? below : below + 1;
+            bestExponent = candidateExponent;
+        }
+        for (; best % 10 == 0; best /= 10) {
+            ++bestExponent;
+        }
+        length = static_cast<int>(decimalDigits(best));
+        writeDigits(best, digits, static_cast<unsigned>(length));
+        exponent = bestExponent;
+    }
+
+    // Shortest digits d1..dn and exponent such that d1..dn * 10^exponent
+    // reads back as `value`, which must be finite and positive
+    void shortestDigits(double value, char* digits, int& length, int& exponent) {
+        uint64_t bits;
+        __builtin_memcpy(&bits, &value, sizeof(bits));
+        uint64_t fraction = bits & ((uint64_t(1) << 52) - 1);
+        int biased = static_cast<int>(bits >> 52);
+
+        DiyFp v = biased == 0 ? DiyFp{fraction, 1 - 1075} : DiyFp{fraction | (uint64_t(1) << 52), biased - 1075};
+
+        // Halfway points to the neighbouring doubles; the gap below a power
+        // of two is half as wide
+        bool closerBelow = fraction == 0 && biased > 1;
+        DiyFp high = normalize({2 * v.f + 1, v.e - 1});
+        DiyFp low = closerBelow ? DiyFp{4 * v.f - 1, v.e - 2} : DiyFp{2 * v.f - 1, v.e - 1};
+        low = {low.f << (low.e - high.e), high.e};
+        DiyFp w = normalize(v);
+
+        const CachedPower& power = cachedPowerFor(high.e);
+        DiyFp scale = {power.f, power.e};
+        DiyFp scaledW = multiply(w, scale);
+        DiyFp scaledLow = multiply(low, scale);
+        DiyFp scaledHigh = multiply(high, scale);
+
+        length = 0;
+        exponent = -power.k;
+        if (generateDigits(digits, length, exponent, scaledLow, scaledW, scaledHigh)) {
+            return;
+        }
+
+        // Shrinking the interval by one unit stays clear of rounding errors,
+        // at the cost of sometimes one digit too many
+        ++scaledLow.f;
+        --scaledHigh.f;
+        length = 0;
+        exponent = -power.k;
+        generateDigitsApproximate(digits, length, exponent, scaledLow, scaledW, scaledHigh);
+        shortenExactly(digits, length, exponent, v.f, v.e, closerBelow);
+    }
+
+    size_t writeExponent(int exponent, char* out) {
+        char* p = out;
+        *p++ = 'e';
+        *p++ = exponent < 0 ? '-' : '+';
+        unsigned magnitude = static_cast<unsigned>(exponent < 0 ? -exponent : exponent);
+        if (magnitude < 10) {
+            *p++ = '0';
+        }
+        unsigned digits = decimalDigits(magnitude);
+        writeDigits(magnitude, p, digits);
+        return static_cast<size_t>(p + digits - out);
+    }
+}
+
+size_t lithium_rt_format_int(int64_t value, char* out) {
+    char* p = out;
+    uint64_t magnitude = static_cast<uint64_t>(value);
+    if (value < 0) {
+        *p++ = '-';
+        magnitude = 0 - magnitude;
+    }
+    unsigned digits = decimalDigits(magnitude);
+    writeDigits(magnitude, p, digits);
+    return static_cast<size_t>(p + digits - out);
+}
+
+// Plain or scientific notation, whichever is shorter, preferring plain
+size_t lithium_rt_format_float(double value, char* out) {
+    char* p = out;
+    uint64_t bits;
+    __builtin_memcpy(&bits, &value, sizeof(bits));
+    if (bits >> 63) {
+        *p++ = '-';
+        value = -value;
+    }
+    if (value != value) {
+        p = out;
+        *p++ = 'n'; *p++ = 'a'; *p++ = 'n';
+        return static_cast<size_t>(p - out);
+    }
+    if (value == __builtin_inf()) {
+        *p++ = 'i'; *p++ = 'n'; *p++ = 'f';
+        return static_cast<size_t>(p - out);
+    }
+    if (value == 0) {
+        *p++ = '0';
+        return static_cast<size_t>(p - out);
+    }
+
+    char digits[20];
+    int length = 0;
+    int exponent = 0;
+    shortestDigits(value, digits, length, exponent);
+
+    // The decimal point goes after `point` digits
+    int point = length + exponent;
+    int plainSize = point <= 0 ? 2 - point + length : point >= length ? point : length + 1;
+    int scientificExponent = point - 1;
+    int magnitude = scientificExponent < 0 ? -scientificExponent : scientificExponent;
+    int scientificSize = length + (length > 1) + 2 + (magnitude < 100 ? 2 : 3);
+
+    if (plainSize <= scientificSize) {
+        if (point <= 0) {
+            *p++ = '0';
+            *p++ = '.';
+            for (int i = 0; i < -point; ++i) *p++ = '0';
+            lithium_rt::copyBytes(p, digits, static_cast<size_t>(length));
+            p += length;
+        } else if (point >= length) {
+            lithium_rt::copyBytes(p, digits, static_cast<size_t>(length));
+            p += length;
+            for (int i = length; i < point; ++i) *p++ = '0';
+        } else {
+            lithium_rt::copyBytes(p, digits, static_cast<size_t>(point));
+            p += point;
+            *p++ = '.';
+            lithium_rt::copyBytes(p, digits + point, static_cast<size_t>(length - point));
+            p += length - point;
+        }
+        return static_cast<size_t>(p - out);
+    }
+
+    *p++ = digits[0];
+    if (length > 1) {
+        *p++ = '.';
+        lithium_rt::copyBytes(p, digits + 1, static_cast<size_t>(length - 1));
+        p += length - 1;
+    }
+    p += writeExponent(scientificExponent, p);
+    return static_cast<size_t>(p - out);
+}
+
+const char* lithium_rt_int_to_string(int64_t value) {
+    char buffer[LITHIUM_RT_NUMBER_CHARS];
+    size_t size = lithium_rt_format_int(value, buffer);
+    char* result = lithium_rt_string_alloc(size);
+    lithium_rt::copyBytes(result, buffer, size);
+    return result;
+}
+
+const char* lithium_rt_float_to_string(double value) {
+    char buffer[LITHIUM_RT_NUMBER_CHARS];
+    size_t size = lithium_rt_format_float(value, buffer);
+    char* result = lithium_rt_string_alloc(size);
+    lithium_rt::copyBytes(result, buffer, size);
+    return result;
+}
@@ -0,0 +1,52 @@
+#include "lithium_rt.h"
+#include "simd.hpp"
+#include "syscall.hpp"
+
+// Standard output goes through one buffer, written when it fills up and at
+// exit, so printing in a loop costs a system call per 64 KB
+namespace {
+    constexpr size_t BUFFER_SIZE = size_t(1) << 16;
+
+    char buffer[BUFFER_SIZE];
+    size_t used;
+}
+
+void lithium_rt_flush(void) {
+    lithium_rt::writeAll(1, buffer, used);
+    used = 0;
+}
+
+void lithium_rt_write(const char* bytes, size_t size) {
+    if (size > BUFFER_SIZE - used) {
+        lithium_rt_flush();
+        if (size >= BUFFER_SIZE) {
+            lithium_rt::writeAll(1, bytes, size);
+            return;
+        }
+    }
+    lithium_rt::copyBytes(buffer + used, bytes, size);
+    used += size;
+}
+
+void lithium_rt_print_string(const char* string) {
+    lithium_rt_write(string, lithium_rt::stringLength(string));
+}
+
+void lithium_rt_print_int(int64_t value) {
+    if (BUFFER_SIZE - used < LITHIUM_RT_NUMBER_CHARS) {
+        lithium_rt_flush();
+    }
+    used += lithium_rt_format_int(value, buffer + used);
+}
+
+void lithium_rt_print_float(double value) {
+    if (BUFFER_SIZE - used < LITHIUM_RT_NUMBER_CHARS) {
+        lithium_rt_flush();
+    }
+    used += lithium_rt_format_float(value, buffer + used);
+}
+
+void lithium_rt_exit(int status) {
+    lithium_rt_flush();
+    lithium_rt::exitGroup(status);
+}
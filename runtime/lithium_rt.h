@@ -0,0 +1,68 @@
+#pragma once
+
+// Runtime library linked into executables produced by the native backend.
+// It is freestanding: no libc, no C++ runtime and no static constructors.
+// Strings are NUL-terminated byte arrays, as in generated code. Strings
+// from generated code and from this library also have their length, as a
+// uint64_t, in the 8 bytes before their first byte; concatenation relies
+// on it, while the other functions take any NUL-terminated string. The
+// strings returned here are allocated from an arena released at exit.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#pragma GCC visibility push(hidden)
+
+// Memory
+void* lithium_rt_alloc(size_t size);
+
+// A string of `size` bytes with its length and NUL already written; the
+// caller fills in the bytes
+char* lithium_rt_string_alloc(size_t size);
+
+static inline size_t lithium_rt_string_size(const char* string) {
+    uint64_t size;
+    __builtin_memcpy(&size, string - sizeof(size), sizeof(size));
+    return (size_t)size;
+}
+
+// Byte and string kernels, vectorized with SSE2
+size_t lithium_rt_strlen(const char* string);
+const void* lithium_rt_memchr(const void* bytes, int value, size_t size);
+int lithium_rt_memcmp(const void* lhs, const void* rhs, size_t size);
+void lithium_rt_memcpy(void* dst, const void* src, size_t size);
+int lithium_rt_string_equals(const char* lhs, const char* rhs);
+int lithium_rt_string_compare(const char* lhs, const char* rhs);
+const char* lithium_rt_concat(const char* lhs, const char* rhs);
+const char* lithium_rt_concat_n(const char* const* parts, size_t count);
+
+// Number formatting. `out` needs LITHIUM_RT_NUMBER_CHARS bytes; the length
+// is returned and no NUL is written. Floats get the shortest digits that
+// read back as the same value.
+#define LITHIUM_RT_NUMBER_CHARS 32
+size_t lithium_rt_format_int(int64_t value, char* out);
+size_t lithium_rt_format_float(double value, char* out);
+const char* lithium_rt_int_to_string(int64_t value);
+const char* lithium_rt_float_to_string(double value);
+
+// Standard output, buffered until the buffer fills, a flush or exit
+void lithium_rt_write(const char* bytes, size_t size);
+void lithium_rt_print_string(const char* string);
+void lithium_rt_print_int(int64_t value);
+void lithium_rt_print_float(double value);
+void lithium_rt_flush(void);
+__attribute__((noreturn)) void lithium_rt_exit(int status);
+
+// Profile of an instrumented program: writes `count` key/counter pairs to
+// `path`, replacing the file
+void lithium_rt_profile_write(const char* path, const uint64_t* keys, const uint64_t* counters, size_t count);
+
+#pragma GCC visibility pop
+
+#ifdef __cplusplus
+}
+#endif
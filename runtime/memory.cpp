@@ -0,0 +1,43 @@
+#include "lithium_rt.h"
+#include "syscall.hpp"
+
+// Bump allocator over anonymous mappings. Programs are short-lived, so
+// nothing is freed before exit.
+namespace {
+    constexpr size_t CHUNK_SIZE = size_t(1) << 20;
+    constexpr long PROT_READ_WRITE = 0x3;
+    constexpr long MAP_PRIVATE_ANONYMOUS = 0x22;
+    // Faulting a chunk in with the mapping costs one kernel entry instead
+    // of one per page. The first chunk is left to fault page by page, so
+    // programs that allocate little do not pay to zero a whole chunk.
+    constexpr long MAP_POPULATE = 0x8000;
+
+    char* next;
+    char* limit;
+
+    char* map(size_t size, long flags) {
+        long address = lithium_rt::syscall6(lithium_rt::SYS_MMAP, 0, static_cast<long>(size), PROT_READ_WRITE,
+                                            MAP_PRIVATE_ANONYMOUS | flags, -1, 0);
+        if (address < 0 && address > -4096) {
+            static const char message[] = "lithium: out of memory\n";
+            lithium_rt::writeAll(2, message, sizeof(message) - 1);
+            lithium_rt::exitGroup(1);
+        }
+        return reinterpret_cast<char*>(address);
+    }
+}
+
+void* lithium_rt_alloc(size_t size) {
+    size = (size + 15) & ~size_t(15);
+    if (size > static_cast<size_t>(limit - next)) {
+        // Large blocks get a mapping of their own and leave the chunk alone
+        if (size > CHUNK_SIZE / 4) {
+            return map((size + 4095) & ~size_t(4095), 0);
+        }
+        next = map(CHUNK_SIZE, limit ? MAP_POPULATE : 0);
+        limit = next + CHUNK_SIZE;
+    }
+    char* block = next;
+    next += size;
+    return block;
+}
@@ -0,0 +1,39 @@
+#include "lithium_rt.h"
+#include "syscall.hpp"
+
+// Counts of an instrumented program, written in the layout Profile reads in
+// the compiler (src/profile.hpp)
+namespace {
+    constexpr uint32_t MAGIC = 0x46504c48;
+    constexpr uint32_t VERSION = 1;
+    constexpr long OPEN_FLAGS = 01 | 0100 | 01000 | 02000000; // O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC
+
+    void report(const char* message, size_t size) {
+        lithium_rt::writeAll(2, message, size);
+    }
+}
+
+void lithium_rt_profile_write(const char* path, const uint64_t* keys, const uint64_t* counters, size_t count) {
+    long fd = lithium_rt::syscall3(lithium_rt::SYS_OPEN, reinterpret_cast<long>(path), OPEN_FLAGS, 0644);
+    if (fd < 0) {
+        static const char message[] = "lithium: could not write profile\n";
+        report(message, sizeof(message) - 1);
+        return;
+    }
+
+    // Pairs go out a buffer at a time
+    uint64_t buffer[512];
+    buffer[0] = MAGIC | static_cast<uint64_t>(VERSION) << 32;
+    buffer[1] = count;
+    size_t used = 2;
+    for (size_t i = 0; i < count; ++i) {
+        if (used == sizeof(buffer) / sizeof(buffer[0])) {
+            lithium_rt::writeAll(static_cast<int>(fd), reinterpret_cast<const char*>(buffer), sizeof(buffer));
+            used = 0;
+        }
+        buffer[used++] = keys[i];
+        buffer[used++] = counters[i];
+    }
+    lithium_rt::writeAll(static_cast<int>(fd), reinterpret_cast<const char*>(buffer), used * sizeof(buffer[0]));
+    lithium_rt::syscall3(lithium_rt::SYS_CLOSE, fd, 0, 0);
+}
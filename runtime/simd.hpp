@@ -0,0 +1,108 @@
+#pragma once
+
+// SSE2 kernels shared by the runtime's translation units
+
+#include <emmintrin.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace lithium_rt {
+    inline unsigned firstSet(unsigned mask) {
+        return static_cast<unsigned>(__builtin_ctz(mask));
+    }
+
+    // Aligned loads never cross into an unmapped page, so the scan may read
+    // past the terminator as long as it stays within the same 16 bytes
+    inline size_t stringLength(const char* string) {
+        const __m128i zero = _mm_setzero_si128();
+        uintptr_t misalignment = reinterpret_cast<uintptr_t>(string) & 15;
+        const char* block = string - misalignment;
+        unsigned mask = static_cast<unsigned>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(block)), zero)));
+        mask >>= misalignment;
+        if (mask) {
+            return firstSet(mask);
+        }
+        // Reach a 64-byte boundary, then test four blocks at once: the
+        // minimum of their bytes is zero only if one of them holds the NUL
+        block += 16;
+        while (reinterpret_cast<uintptr_t>(block) & 63) {
+            mask = static_cast<unsigned>(
+                _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(block)), zero)));
+            if (mask) {
+                return static_cast<size_t>(block - string) + firstSet(mask);
+            }
+            block += 16;
+        }
+        for (;; block += 64) {
+            const auto* blocks = reinterpret_cast<const __m128i*>(block);
+            __m128i a = _mm_load_si128(blocks);
+            __m128i b = _mm_load_si128(blocks + 1);
+            __m128i c = _mm_load_si128(blocks + 2);
+            __m128i d = _mm_load_si128(blocks + 3);
+            __m128i least = _mm_min_epu8(_mm_min_epu8(a, b), _mm_min_epu8(c, d));
+            if (!_mm_movemask_epi8(_mm_cmpeq_epi8(least, zero))) {
+                continue;
+            }
+            uint64_t masks = static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(a, zero))) |
+                             static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(b, zero))) << 16 |
+                             static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(c, zero))) << 32 |
+                             static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(d, zero))) << 48;
+            return static_cast<size_t>(block - string) + static_cast<size_t>(__builtin_ctzll(masks));
+        }
+    }
+
+    // Index of the first byte where the strings differ or both end. Blocks
+    // are read unaligned, except near the end of a page, where the rest of
+    // either string might not be mapped.
+    inline size_t mismatch(const char* lhs, const char* rhs) {
+        constexpr uintptr_t PAGE_SIZE = 4096;
+        const __m128i zero = _mm_setzero_si128();
+        size_t i = 0;
+        for (;;) {
+            if (((reinterpret_cast<uintptr_t>(lhs + i) | reinterpret_cast<uintptr_t>(rhs + i)) & (PAGE_SIZE - 1)) >
+                PAGE_SIZE - 16) {
+                for (size_t end = i + 16; i < end; ++i) {
+                    if (lhs[i] != rhs[i] || lhs[i] == '\0') {
+                        return i;
+                    }
+                }
+                continue;
+            }
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lhs + i));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rhs + i));
+            unsigned stop = static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(
+                _mm_xor_si128(_mm_cmpeq_epi8(a, b), _mm_set1_epi8(-1)), _mm_cmpeq_epi8(a, zero))));
+            if (stop) {
+                return i + firstSet(stop);
+            }
+            i += 16;
+        }
+    }
+
+    inline void copyBytes(char* dst, const char* src, size_t size) {
+        if (size >= 16) {
+            size_t i = 0;
+            for (; i + 16 <= size; i += 16) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                                 _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+            }
+            // One overlapping block covers the tail
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + size - 16),
+                             _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + size - 16)));
+            return;
+        }
+        if (size >= 8) {
+            uint64_t head;
+            uint64_t tail;
+            __builtin_memcpy(&head, src, 8);
+            __builtin_memcpy(&tail, src + size - 8, 8);
+            __builtin_memcpy(dst, &head, 8);
+            __builtin_memcpy(dst + size - 8, &tail, 8);
+            return;
+        }
+        for (size_t i = 0; i < size; ++i) {
+            dst[i] = src[i];
+        }
+    }
+}
@@ -0,0 +1,121 @@
+#include "lithium_rt.h"
+#include "simd.hpp"
+
+using lithium_rt::firstSet;
+
+size_t lithium_rt_strlen(const char* string) {
+    return lithium_rt::stringLength(string);
+}
+
+const void* lithium_rt_memchr(const void* bytes, int value, size_t size) {
+    const auto* p = static_cast<const unsigned char*>(bytes);
+    const __m128i needle = _mm_set1_epi8(static_cast<char>(value));
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i)), needle)));
+        if (mask) {
+            return p + i + firstSet(mask);
+        }
+    }
+    if (size >= 16 && i < size) {
+        // Overlapping last block; bytes already checked are masked off
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + size - 16)), needle)));
+        mask >>= 16 - (size - i);
+        return mask ? p + i + firstSet(mask) : nullptr;
+    }
+    for (; i < size; ++i) {
+        if (p[i] == static_cast<unsigned char>(value)) {
+            return p + i;
+        }
+    }
+    return nullptr;
+}
+
+int lithium_rt_memcmp(const void* lhs, const void* rhs, size_t size) {
+    const auto* a = static_cast<const unsigned char*>(lhs);
+    const auto* b = static_cast<const unsigned char*>(rhs);
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+                           _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i))))) ^ 0xFFFFu;
+        if (mask) {
+            unsigned at = firstSet(mask);
+            return a[i + at] - b[i + at];
+        }
+    }
+    if (size >= 16 && i < size) {
+        size_t from = size - 16;
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + from)),
+                           _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + from))))) ^ 0xFFFFu;
+        if (mask) {
+            unsigned at = firstSet(mask);
+            return a[from + at] - b[from + at];
+        }
+        return 0;
+    }
+    for (; i < size; ++i) {
+        if (a[i] != b[i]) {
+            return a[i] - b[i];
+        }
+    }
+    return 0;
+}
+
+void lithium_rt_memcpy(void* dst, const void* src, size_t size) {
+    lithium_rt::copyBytes(static_cast<char*>(dst), static_cast<const char*>(src), size);
+}
+
+int lithium_rt_string_equals(const char* lhs, const char* rhs) {
+    if (lhs == rhs) {
+        return 1;
+    }
+    size_t at = lithium_rt::mismatch(lhs, rhs);
+    return lhs[at] == rhs[at];
+}
+
+// A string orders before any longer string it is a prefix of, since its
+// NUL is the first byte that differs
+int lithium_rt_string_compare(const char* lhs, const char* rhs) {
+    size_t at = lithium_rt::mismatch(lhs, rhs);
+    auto a = static_cast<unsigned char>(lhs[at]);
+    auto b = static_cast<unsigned char>(rhs[at]);
+    return (a > b) - (a < b);
+}
+
+char* lithium_rt_string_alloc(size_t size) {
+    auto* block = static_cast<char*>(lithium_rt_alloc(sizeof(uint64_t) + size + 1));
+    uint64_t length = size;
+    __builtin_memcpy(block, &length, sizeof(length));
+    char* string = block + sizeof(length);
+    string[size] = '\0';
+    return string;
+}
+
+const char* lithium_rt_concat(const char* lhs, const char* rhs) {
+    size_t lhsSize = lithium_rt_string_size(lhs);
+    size_t rhsSize = lithium_rt_string_size(rhs);
+    char* result = lithium_rt_string_alloc(lhsSize + rhsSize);
+    lithium_rt::copyBytes(result, lhs, lhsSize);
+    lithium_rt::copyBytes(result + lhsSize, rhs, rhsSize);
+    return result;
+}
+
+// Sums the lengths first so the result is allocated once
+const char* lithium_rt_concat_n(const char* const* parts, size_t count) {
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        total += lithium_rt_string_size(parts[i]);
+    }
+    char* result = lithium_rt_string_alloc(total);
+    char* out = result;
+    for (size_t i = 0; i < count; ++i) {
+        size_t size = lithium_rt_string_size(parts[i]);
+        lithium_rt::copyBytes(out, parts[i], size);
+        out += size;
+    }
+    return result;
+}
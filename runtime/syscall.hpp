@@ -0,0 +1,48 @@
+#pragma once
+
+// Raw Linux x86-64 system calls; the runtime has no libc to go through
+
+#include <stddef.h>
+
+namespace lithium_rt {
+    enum : long {
+        SYS_WRITE = 1,
+        SYS_OPEN = 2,
+        SYS_CLOSE = 3,
+        SYS_MMAP = 9,
+        SYS_EXIT_GROUP = 231
+    };
+
+    inline long syscall3(long number, long a, long b, long c) {
+        long result;
+        asm volatile("syscall" : "=a"(result) : "a"(number), "D"(a), "S"(b), "d"(c) : "rcx", "r11", "memory");
+        return result;
+    }
+
+    inline long syscall6(long number, long a, long b, long c, long d, long e, long f) {
+        long result;
+        register long r10 asm("r10") = d;
+        register long r8 asm("r8") = e;
+        register long r9 asm("r9") = f;
+        asm volatile("syscall" : "=a"(result) : "a"(number), "D"(a), "S"(b), "d"(c), "r"(r10), "r"(r8), "r"(r9)
+                     : "rcx", "r11", "memory");
+        return result;
+    }
+
+    [[noreturn]] inline void exitGroup(int status) {
+        for (;;) {
+            syscall3(SYS_EXIT_GROUP, status, 0, 0);
+        }
+    }
+
+    // Writes everything, retrying after partial writes and interruptions
+    inline void writeAll(int fd, const char* bytes, size_t size) {
+        while (size > 0) {
+            long written = syscall3(SYS_WRITE, fd, reinterpret_cast<long>(bytes), static_cast<long>(size));
+            if (written == -4) continue; // EINTR
+            if (written <= 0) return;
+            bytes += written;
+            size -= static_cast<size_t>(written);
+        }
+    }
+}
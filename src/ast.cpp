@@ -1,4 +1,20 @@
 #include "ast.hpp"
+#include "memtrack.hpp"
+
+#ifdef LITHIUM_MEM_TRACKING
+Position::Position(const Position& other) : line(other.line), column(other.column) {
+    MemoryScope scope(MemoryCategory::POSITIONS);
+    filename = other.filename;
+}
+
+Position& Position::operator=(const Position& other) {
+    MemoryScope scope(MemoryCategory::POSITIONS);
+    filename = other.filename;
+    line = other.line;
+    column = other.column;
+    return *this;
+}
+#endif
 
 // todo: non work
 void ProgramNode::accept(ASTVisitor& visitor) {
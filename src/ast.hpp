@@ -13,6 +13,14 @@ struct Position {
     
     Position(std::string file = "", int l = 1, int c = 1) 
         : filename(std::move(file)), line(l), column(c) {}
+    
+#ifdef LITHIUM_MEM_TRACKING
+    // Copies are charged to their own category in --mem-report
+    Position(const Position& other);
+    Position& operator=(const Position& other);
+    Position(Position&& other) = default;
+    Position& operator=(Position&& other) = default;
+#endif
 };
 
 class ASTNode {
@@ -20,7 +28,7 @@ public:
     virtual ~ASTNode() = default;
     virtual void accept(ASTVisitor& visitor) = 0;
     
-    Position getPosition() const { return position; }
+    const Position& getPosition() const { return position; }
     void setPosition(const Position& pos) { position = pos; }
     
 protected:
@@ -90,6 +98,7 @@ class FunctionCall : public Expression {
 public:
     std::string functionName;
     std::vector<std::unique_ptr<Expression>> arguments;
+    bool requireTailCall = false; // written `tail f(...)`; an error if it cannot reuse the frame
     
     void accept(ASTVisitor& visitor) override;
 };
@@ -0,0 +1,444 @@
+#include "bytecode.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    template <typename T>
+    void put(std::string& out, T value) {
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        out.append(bytes, sizeof(T));
+    }
+
+    void putString(std::string& out, const std::string& value) {
+        put<uint32_t>(out, static_cast<uint32_t>(value.size()));
+        out += value;
+    }
+
+    class Reader {
+    private:
+        const std::string& bytes;
+        size_t position = 0;
+
+    public:
+        bool ok = true;
+
+        explicit Reader(const std::string& input) : bytes(input) {}
+
+        template <typename T>
+        T get() {
+            T value{};
+            if (position + sizeof(T) > bytes.size()) {
+                ok = false;
+                return value;
+            }
+            std::memcpy(&value, bytes.data() + position, sizeof(T));
+            position += sizeof(T);
+            return value;
+        }
+
+        std::string getString() {
+            uint32_t length = get<uint32_t>();
+            if (!ok || position + length > bytes.size()) {
+                ok = false;
+                return "";
+            }
+            std::string value = bytes.substr(position, length);
+            position += length;
+            return value;
+        }
+    };
+
+    bool isTemp(const std::string& operand) {
+        return operand.size() > 1 && operand[0] == 't';
+    }
+
+    std::string symbolName(const std::string& operand) {
+        return (!operand.empty() && operand[0] == '@') ? operand.substr(1) : operand;
+    }
+}
+
+std::string BytecodeModule::serialize() const {
+    std::string out;
+    put<uint32_t>(out, MAGIC);
+    put<uint32_t>(out, VERSION);
+
+    put<uint32_t>(out, static_cast<uint32_t>(constants.size()));
+    for (const auto& constant : constants) {
+        put<uint8_t>(out, static_cast<uint8_t>(constant.kind));
+        switch (constant.kind) {
+            case BytecodeConstant::Kind::INT: put<int64_t>(out, constant.intValue); break;
+            case BytecodeConstant::Kind::FLOAT: put<double>(out, constant.floatValue); break;
+            case BytecodeConstant::Kind::STRING: putString(out, constant.stringValue); break;
+        }
+    }
+
+    put<uint32_t>(out, numGlobals);
+    for (int32_t constant : globalInitializers) {
+        put<int32_t>(out, constant);
+    }
+    put<int32_t>(out, mainFunction);
+    put<int32_t>(out, initFunction);
+
+    put<uint32_t>(out, static_cast<uint32_t>(functions.size()));
+    for (const auto& function : functions) {
+        putString(out, function.name);
+        put<uint16_t>(out, function.numParams);
+        put<uint32_t>(out, function.numRegisters);
+        put<uint32_t>(out, static_cast<uint32_t>(function.code.size()));
+        for (const auto& inst : function.code) {
+            put<uint16_t>(out, static_cast<uint16_t>(inst.op));
+            put<uint16_t>(out, inst.a);
+            put<uint16_t>(out, inst.b);
+            put<uint16_t>(out, inst.c);
+        }
+    }
+    return out;
+}
+
+bool BytecodeModule::deserialize(const std::string& bytes, std::string& error) {
+    Reader reader(bytes);
+    if (reader.get<uint32_t>() != MAGIC || reader.get<uint32_t>() != VERSION) {
+        error = "not a Lithium bytecode file";
+        return false;
+    }
+
+    uint32_t numConstants = reader.get<uint32_t>();
+    for (uint32_t i = 0; i < numConstants && reader.ok; ++i) {
+        BytecodeConstant constant;
+        constant.kind = static_cast<BytecodeConstant::Kind>(reader.get<uint8_t>());
+        switch (constant.kind) {
+            case BytecodeConstant::Kind::INT: constant.intValue = reader.get<int64_t>(); break;
+            case BytecodeConstant::Kind::FLOAT: constant.floatValue = reader.get<double>(); break;
+            case BytecodeConstant::Kind::STRING: constant.stringValue = reader.getString(); break;
+            default: reader.ok = false; break;
+        }
+        constants.push_back(std::move(constant));
+    }
+
+    numGlobals = reader.get<uint32_t>();
+    for (uint32_t i = 0; i < numGlobals && reader.ok; ++i) {
+        globalInitializers.push_back(reader.get<int32_t>());
+    }
+    mainFunction = reader.get<int32_t>();
+    initFunction = reader.get<int32_t>();
+
+    uint32_t numFunctions = reader.get<uint32_t>();
+    for (uint32_t i = 0; i < numFunctions && reader.ok; ++i) {
+        BytecodeFunction function;
+        function.name = reader.getString();
+        function.numParams = reader.get<uint16_t>();
+        function.numRegisters = reader.get<uint32_t>();
+        uint32_t codeSize = reader.get<uint32_t>();
+        for (uint32_t j = 0; j < codeSize && reader.ok; ++j) {
+            BytecodeInstruction inst;
+            inst.op = static_cast<Opcode>(reader.get<uint16_t>());
+            inst.a = reader.get<uint16_t>();
+            inst.b = reader.get<uint16_t>();
+            inst.c = reader.get<uint16_t>();
+            function.code.push_back(inst);
+        }
+        functions.push_back(std::move(function));
+    }
+
+    if (!reader.ok) {
+        error = "truncated or corrupt bytecode file";
+        return false;
+    }
+
+    // Reject anything the interpreter would trust blindly
+    auto validFunction = [&](int32_t index) {
+        return index == NO_FUNCTION || (index >= 0 && static_cast<size_t>(index) < functions.size());
+    };
+    if (!validFunction(mainFunction) || !validFunction(initFunction)) {
+        error = "bad entry point";
+        return false;
+    }
+    for (int32_t constant : globalInitializers) {
+        if (constant != NO_CONSTANT && (constant < 0 || static_cast<size_t>(constant) >= constants.size())) {
+            error = "bad global initializer";
+            return false;
+        }
+    }
+    for (const auto& function : functions) {
+        if (function.code.empty() || function.numRegisters < function.numParams) {
+            error = "bad function '" + function.name + "'";
+            return false;
+        }
+        auto isRegister = [&](uint16_t r) { return r < function.numRegisters; };
+        for (const auto& inst : function.code) {
+            bool valid = false;
+            switch (inst.op) {
+                case Opcode::LOADK: valid = isRegister(inst.a) && inst.b < constants.size(); break;
+                case Opcode::GETGLOBAL: valid = isRegister(inst.a) && inst.b < numGlobals; break;
+                case Opcode::SETGLOBAL: valid = inst.a < numGlobals && isRegister(inst.b); break;
+                case Opcode::MOV:
+                case Opcode::ITOF:
+                case Opcode::BOX_I: case Opcode::BOX_F: case Opcode::BOX_S: case Opcode::BOX_B:
+                case Opcode::UNBOX_I: case Opcode::UNBOX_F: case Opcode::UNBOX_S: case Opcode::UNBOX_B: valid = isRegister(inst.a) && isRegister(inst.b); break;
+                case Opcode::ADD_II: case Opcode::SUB_II: case Opcode::MUL_II: case Opcode::DIV_II:
+                case Opcode::ADD_FF: case Opcode::SUB_FF: case Opcode::MUL_FF: case Opcode::DIV_FF:
+                case Opcode::CONCAT_SS:
+                case Opcode::ADD_AA: case Opcode::SUB_AA: case Opcode::MUL_AA: case Opcode::DIV_AA:
+                    valid = isRegister(inst.a) && isRegister(inst.b) && isRegister(inst.c);
+                    break;
+                case Opcode::CONCAT_N:
+                    valid = isRegister(inst.a) && inst.c > 0 && inst.b + inst.c <= function.numRegisters;
+                    break;
+                case Opcode::CALL:
+                    valid = isRegister(inst.a) && inst.b < functions.size() &&
+                            inst.c + functions[inst.b].numParams <= function.numRegisters;
+                    break;
+                case Opcode::TAILCALL:
+                    valid = inst.b < functions.size() && inst.c + functions[inst.b].numParams <= function.numRegisters;
+                    break;
+                case Opcode::RET: valid = isRegister(inst.a); break;
+                case Opcode::RET_VOID: valid = true; break;
+                default: break;
+            }
+            if (!valid) {
+                error = "bad instruction in function '" + function.name + "'";
+                return false;
+            }
+        }
+        Opcode last = function.code.back().op;
+        if (last != Opcode::RET && last != Opcode::RET_VOID && last != Opcode::TAILCALL) {
+            error = "function '" + function.name + "' does not end in a return";
+            return false;
+        }
+    }
+    return true;
+}
+
+// BytecodeCompiler implementation
+bool BytecodeCompiler::compile(const std::vector<Instruction>& instructions) {
+    // Number every function up front so calls can refer forward
+    for (const auto& inst : instructions) {
+        if (inst.opcode == "func") {
+            declareFunction(symbolName(inst.operands[0]));
+        }
+    }
+    return append(instructions) && finish();
+}
+
+void BytecodeCompiler::declareFunction(const std::string& name) {
+    if (functionIndex.emplace(name, static_cast<uint16_t>(module.functions.size())).second) {
+        module.functions.push_back({name, 0, 0, {}});
+    }
+}
+
+bool BytecodeCompiler::append(const std::vector<Instruction>& instructions) {
+    for (size_t i = 0; i < instructions.size(); ++i) {
+        const Instruction& inst = instructions[i];
+        if (inst.opcode == "global") {
+            globalIndex.emplace(symbolName(inst.operands[0]), static_cast<uint16_t>(module.numGlobals++));
+            module.globalInitializers.push_back(inst.operands.size() == 3
+                                                    ? addConstant(inst.operands[1], inst.operands[2])
+                                                    : BytecodeModule::NO_CONSTANT);
+            continue;
+        }
+        if (inst.opcode != "func") continue;
+        declareFunction(symbolName(inst.operands[0]));
+        size_t end = i;
+        while (end < instructions.size() && instructions[end].opcode != "endfunc") {
+            ++end;
+        }
+        if (!compileFunction(instructions, i, end)) {
+            return false;
+        }
+        i = end;
+    }
+    return true;
+}
+
+bool BytecodeCompiler::finish() {
+    // Indices past the limit have wrapped, so nothing compiled is usable
+    if (!checkLimit(module.functions.size(), "functions") || !checkLimit(module.numGlobals, "globals")) {
+        return false;
+    }
+    for (const auto& function : module.functions) {
+        // Compiled functions always end in a return
+        if (function.code.empty()) {
+            errorReporter.reportError(ErrorSeverity::FATAL, ErrorCategory::SEMANTIC, Position(),
+                                      "Internal error: function '" + function.name + "' was never compiled");
+            return false;
+        }
+    }
+
+    auto main = functionIndex.find("main");
+    module.mainFunction = main != functionIndex.end() ? main->second : BytecodeModule::NO_FUNCTION;
+    auto init = functionIndex.find(CodeGenerator::INIT_FUNCTION);
+    module.initFunction = init != functionIndex.end() ? init->second : BytecodeModule::NO_FUNCTION;
+    return true;
+}
+
+bool BytecodeCompiler::compileFunction(const std::vector<Instruction>& instructions, size_t begin, size_t end) {
+    BytecodeFunction& function = module.functions[functionIndex[symbolName(instructions[begin].operands[0])]];
+
+    // Parameters occupy the first registers, every other temporary gets its
+    // own register, and the outgoing argument area sits on top
+    std::unordered_map<std::string, uint16_t> registers;
+    size_t maxArgs = 0;
+    for (size_t i = begin; i < end; ++i) {
+        if (instructions[i].opcode == "param") {
+            size_t index = std::stoul(instructions[i].operands[1]);
+            registers[instructions[i].operands[0]] = static_cast<uint16_t>(index);
+            function.numParams = static_cast<uint16_t>(std::max<size_t>(function.numParams, index + 1));
+        } else if (instructions[i].opcode == "call") {
+            maxArgs = std::max<size_t>(maxArgs, std::stoul(instructions[i].operands[2]));
+        } else if (instructions[i].opcode == "tailcall") {
+            maxArgs = std::max<size_t>(maxArgs, std::stoul(instructions[i].operands[1]));
+        } else if (instructions[i].opcode == "concat.n") {
+            maxArgs = std::max<size_t>(maxArgs, instructions[i].operands.size() - 1);
+        }
+    }
+    size_t nextRegister = function.numParams;
+    for (size_t i = begin; i < end; ++i) {
+        for (const auto& operand : instructions[i].operands) {
+            if (isTemp(operand) && registers.find(operand) == registers.end()) {
+                registers[operand] = static_cast<uint16_t>(nextRegister++);
+            }
+        }
+    }
+    size_t argBase = nextRegister;
+    if (!checkLimit(argBase + maxArgs, "registers in function '" + function.name + "'")) {
+        return false;
+    }
+    function.numRegisters = static_cast<uint32_t>(std::max<size_t>(argBase + maxArgs, 1));
+
+    auto reg = [&](const std::string& temp) { return registers[temp]; };
+    auto emit = [&](Opcode op, uint16_t a = 0, uint16_t b = 0, uint16_t c = 0) {
+        function.code.push_back({op, a, b, c});
+    };
+    std::vector<std::string> args;
+
+    for (size_t i = begin + 1; i < end; ++i) {
+        const std::string& op = instructions[i].opcode;
+        const auto& operands = instructions[i].operands;
+
+        if (op.empty() || op == "param" || op == "global") {
+            continue;
+        } else if (op == "const.i" || op == "const.f" || op == "const.s") {
+            emit(Opcode::LOADK, reg(operands[0]), addConstant(op, operands[1]));
+        } else if (op == "load") {
+            emit(Opcode::GETGLOBAL, reg(operands[0]), globalIndex[symbolName(operands[1])]);
+        } else if (op == "store") {
+            emit(Opcode::SETGLOBAL, globalIndex[symbolName(operands[0])], reg(operands[1]));
+        } else if (op == "mov") {
+            emit(Opcode::MOV, reg(operands[0]), reg(operands[1]));
+        } else if (op == "itof") {
+            emit(Opcode::ITOF, reg(operands[0]), reg(operands[1]));
+        } else if (op.compare(0, 4, "box.") == 0 || op.compare(0, 6, "unbox.") == 0) {
+            static const std::unordered_map<std::string, Opcode> conversions = {
+                {"box.i", Opcode::BOX_I}, {"box.f", Opcode::BOX_F}, {"box.s", Opcode::BOX_S},
+                {"box.b", Opcode::BOX_B}, {"unbox.i", Opcode::UNBOX_I}, {"unbox.f", Opcode::UNBOX_F},
+                {"unbox.s", Opcode::UNBOX_S}, {"unbox.b", Opcode::UNBOX_B}
+            };
+            emit(conversions.at(op), reg(operands[0]), reg(operands[1]));
+        } else if (op == "add.i" || op == "sub.i" || op == "mul.i" || op == "div.i" ||
+                   op == "add.f" || op == "sub.f" || op == "mul.f" || op == "div.f" || op == "concat" ||
+                   op == "add.a" || op == "sub.a" || op == "mul.a" || op == "div.a") {
+            static const std::unordered_map<std::string, Opcode> arithmetic = {
+                {"add.i", Opcode::ADD_II}, {"sub.i", Opcode::SUB_II}, {"mul.i", Opcode::MUL_II},
+                {"div.i", Opcode::DIV_II}, {"add.f", Opcode::ADD_FF}, {"sub.f", Opcode::SUB_FF},
+                {"mul.f", Opcode::MUL_FF}, {"div.f", Opcode::DIV_FF}, {"concat", Opcode::CONCAT_SS},
+                {"add.a", Opcode::ADD_AA}, {"sub.a", Opcode::SUB_AA}, {"mul.a", Opcode::MUL_AA},
+                {"div.a", Opcode::DIV_AA}
+            };
+            emit(arithmetic.at(op), reg(operands[0]), reg(operands[1]), reg(operands[2]));
+        } else if (op == "concat.n") {
+            // The parts are gathered in the argument area like call arguments
+            for (size_t j = 1; j < operands.size(); ++j) {
+                emit(Opcode::MOV, static_cast<uint16_t>(argBase + j - 1), reg(operands[j]));
+            }
+            emit(Opcode::CONCAT_N, reg(operands[0]), static_cast<uint16_t>(argBase),
+                 static_cast<uint16_t>(operands.size() - 1));
+        } else if (op == "arg") {
+            size_t index = std::stoul(operands[0]);
+            if (args.size() <= index) {
+                args.resize(index + 1);
+            }
+            args[index] = operands[1];
+        } else if (op == "call") {
+            auto callee = functionIndex.find(symbolName(operands[1]));
+            if (callee == functionIndex.end()) {
+                errorReporter.reportSemanticError(Position(), "Undefined reference to '" + symbolName(operands[1]) + "'");
+                return false;
+            }
+            for (size_t j = 0; j < args.size(); ++j) {
+                emit(Opcode::MOV, static_cast<uint16_t>(argBase + j), reg(args[j]));
+            }
+            emit(Opcode::CALL, reg(operands[0]), callee->second, static_cast<uint16_t>(argBase));
+            args.clear();
+        } else if (op == "tailcall") {
+            auto callee = functionIndex.find(symbolName(operands[0]));
+            if (callee == functionIndex.end()) {
+                errorReporter.reportSemanticError(Position(), "Undefined reference to '" + symbolName(operands[0]) + "'");
+                return false;
+            }
+            for (size_t j = 0; j < args.size(); ++j) {
+                emit(Opcode::MOV, static_cast<uint16_t>(argBase + j), reg(args[j]));
+            }
+            emit(Opcode::TAILCALL, 0, callee->second, static_cast<uint16_t>(argBase));
+            args.clear();
+        } else if (op == "ret") {
+            if (operands.empty()) {
+                emit(Opcode::RET_VOID);
+            } else {
+                emit(Opcode::RET, reg(operands[0]));
+            }
+        } else {
+            errorReporter.reportError(ErrorSeverity::ERROR, ErrorCategory::SEMANTIC, Position(),
+                                      "Bytecode compiler does not support IR instruction '" + op + "'",
+                                      "in function " + function.name);
+            return false;
+        }
+    }
+
+    if (function.code.empty() || (function.code.back().op != Opcode::RET && function.code.back().op != Opcode::RET_VOID &&
+                                  function.code.back().op != Opcode::TAILCALL)) {
+        emit(Opcode::RET_VOID);
+    }
+    return checkLimit(module.constants.size(), "constants");
+}
+
+// `op` is the const instruction that spells the value, e.g. const.i
+uint16_t BytecodeCompiler::addConstant(const std::string& op, const std::string& literal) {
+    if (op == "const.i") {
+        BytecodeConstant constant;
+        constant.kind = BytecodeConstant::Kind::INT;
+        constant.intValue = std::stoll(literal);
+        return addConstant(constant, "i" + literal);
+    }
+    if (op == "const.f") {
+        BytecodeConstant constant;
+        constant.kind = BytecodeConstant::Kind::FLOAT;
+        constant.floatValue = std::stod(literal);
+        return addConstant(constant, "f" + literal);
+    }
+    BytecodeConstant constant;
+    constant.kind = BytecodeConstant::Kind::STRING;
+    constant.stringValue = CompilerUtils::unescapeString(literal.substr(1, literal.size() - 2));
+    std::string key = "s" + constant.stringValue;
+    return addConstant(std::move(constant), key);
+}
+
+uint16_t BytecodeCompiler::addConstant(BytecodeConstant constant, const std::string& key) {
+    auto it = constantIndex.find(key);
+    if (it != constantIndex.end()) {
+        return it->second;
+    }
+    auto index = static_cast<uint16_t>(module.constants.size());
+    module.constants.push_back(std::move(constant));
+    constantIndex.emplace(key, index);
+    return index;
+}
+
+bool BytecodeCompiler::checkLimit(size_t value, const std::string& what) {
+    if (value > UINT16_MAX) {
+        errorReporter.reportSemanticError(Position(), "Too many " + what + " for bytecode (limit is 65535)");
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "codegen.hpp"
+#include "error.hpp"
+
+// Register-based bytecode. Every instruction is four 16-bit fields; operand
+// meaning depends on the opcode (a is normally the destination register).
+enum class Opcode : uint16_t {
+    LOADK,      // a = constants[b]
+    MOV,        // a = b
+    GETGLOBAL,  // a = globals[b]
+    SETGLOBAL,  // globals[a] = b
+    ADD_II,     // a = b + c (int)
+    SUB_II,
+    MUL_II,
+    DIV_II,
+    ADD_FF,     // a = b + c (float)
+    SUB_FF,
+    MUL_FF,
+    DIV_FF,
+    CONCAT_SS,  // a = b + c (string)
+    CONCAT_N,   // a = registers b .. b + c - 1 joined (string)
+    ITOF,       // a = float(b)
+    BOX_I,      // a = any(b), from int
+    BOX_F,
+    BOX_S,
+    BOX_B,
+    UNBOX_I,    // a = int(b); a type error unless b holds an int
+    UNBOX_F,    // also accepts an int
+    UNBOX_S,
+    UNBOX_B,
+    ADD_AA,     // a = b + c (any); ints stay ints unless a product overflows
+    SUB_AA,
+    MUL_AA,
+    DIV_AA,
+    CALL,       // a = functions[b](registers c ..)
+    TAILCALL,   // return functions[b](registers c ..), reusing this frame
+    RET,        // return a
+    RET_VOID,   // return 0
+    COUNT
+};
+
+struct BytecodeInstruction {
+    Opcode op;
+    uint16_t a;
+    uint16_t b;
+    uint16_t c;
+};
+
+struct BytecodeConstant {
+    enum class Kind : uint8_t { INT, FLOAT, STRING };
+
+    Kind kind;
+    int64_t intValue = 0;
+    double floatValue = 0.0;
+    std::string stringValue;
+};
+
+// Arguments for a call live in the caller's top registers starting at
+// CALL's c operand and become registers 0..numParams-1 of the callee frame.
+struct BytecodeFunction {
+    std::string name;
+    uint16_t numParams = 0;
+    uint32_t numRegisters = 0;
+    std::vector<BytecodeInstruction> code;
+};
+
+class BytecodeModule {
+public:
+    static constexpr uint32_t MAGIC = 0x4342484C; // "LHBC"
+    static constexpr uint32_t VERSION = 5;
+    static constexpr int32_t NO_FUNCTION = -1;
+    static constexpr int32_t NO_CONSTANT = -1;
+
+    std::vector<BytecodeConstant> constants;
+    std::vector<BytecodeFunction> functions;
+    uint32_t numGlobals = 0;
+    // Constant each global starts out holding; the rest start at zero
+    std::vector<int32_t> globalInitializers;
+    int32_t mainFunction = NO_FUNCTION;
+    int32_t initFunction = NO_FUNCTION;
+
+    std::string serialize() const;
+    bool deserialize(const std::string& bytes, std::string& error);
+};
+
+// Translates IR into a BytecodeModule a piece at a time, so the IR of a
+// function can be dropped as soon as it is compiled. Functions are numbered
+// as they are declared; a call may refer to one declared but not compiled
+// yet.
+class BytecodeCompiler {
+private:
+    ErrorReporter& errorReporter;
+    BytecodeModule module;
+    std::unordered_map<std::string, uint16_t> functionIndex;
+    std::unordered_map<std::string, uint16_t> globalIndex;
+    std::unordered_map<std::string, uint16_t> constantIndex;
+
+public:
+    explicit BytecodeCompiler(ErrorReporter& reporter) : errorReporter(reporter) {}
+
+    void declareFunction(const std::string& name);
+    // Takes `global` declarations and whole functions, declaring any
+    // function that was not declared before
+    bool append(const std::vector<Instruction>& instructions);
+    // Checks that every declared function was compiled and finds main and
+    // the initializer
+    bool finish();
+    // A whole program at once
+    bool compile(const std::vector<Instruction>& instructions);
+    BytecodeModule& getModule() { return module; }
+
+private:
+    bool compileFunction(const std::vector<Instruction>& instructions, size_t begin, size_t end);
+    uint16_t addConstant(const std::string& op, const std::string& literal);
+    uint16_t addConstant(BytecodeConstant constant, const std::string& key);
+    bool checkLimit(size_t value, const std::string& what);
+};
@@ -0,0 +1,140 @@
+#include "callgraph.hpp"
+#include <algorithm>
+#include <cstdint>
+
+void CallGraph::collectCalls(Expression& expr, std::vector<FunctionCall*>& calls) {
+    if (auto* binary = dynamic_cast<BinaryOp*>(&expr)) {
+        if (binary->left) collectCalls(*binary->left, calls);
+        if (binary->right) collectCalls(*binary->right, calls);
+    } else if (auto* call = dynamic_cast<FunctionCall*>(&expr)) {
+        // Arguments are evaluated before the call itself
+        for (auto& argument : call->arguments) {
+            collectCalls(*argument, calls);
+        }
+        calls.push_back(call);
+    }
+}
+
+void CallGraph::build(ProgramNode& program, const std::unordered_map<std::string, FunctionDecl*>& resolve) {
+    functions.clear();
+    indices.clear();
+    callSites.clear();
+    initializerCalls.clear();
+
+    for (auto& decl : program.declarations) {
+        if (auto* function = dynamic_cast<FunctionDecl*>(decl.get())) {
+            indices.emplace(function, functions.size());
+            functions.push_back(function);
+        }
+    }
+    callSites.resize(functions.size());
+    callerCounts.assign(functions.size(), 0);
+
+    auto record = [&](Expression& expr, std::vector<CallSite>& sites) {
+        std::vector<FunctionCall*> calls;
+        collectCalls(expr, calls);
+        for (auto* call : calls) {
+            auto target = resolve.find(call->functionName);
+            FunctionDecl* callee = target != resolve.end() ? target->second : nullptr;
+            sites.push_back({call, callee});
+            auto index = callee ? indices.find(callee) : indices.end();
+            if (index != indices.end()) {
+                ++callerCounts[index->second];
+            }
+        }
+    };
+
+    for (size_t i = 0; i < functions.size(); ++i) {
+        if (functions[i]->body) {
+            record(*functions[i]->body, callSites[i]);
+        }
+    }
+    for (auto& decl : program.declarations) {
+        if (auto* var = dynamic_cast<VarDecl*>(decl.get())) {
+            if (var->initializer) {
+                record(*var->initializer, initializerCalls);
+            }
+        }
+    }
+}
+
+const std::vector<CallSite>& CallGraph::getCallSites(const FunctionDecl* function) const {
+    static const std::vector<CallSite> none;
+    auto index = indices.find(function);
+    return index != indices.end() ? callSites[index->second] : none;
+}
+
+size_t CallGraph::getCallerCount(const FunctionDecl* function) const {
+    auto index = indices.find(function);
+    return index != indices.end() ? callerCounts[index->second] : 0;
+}
+
+// Tarjan's algorithm with an explicit stack, so deep call chains cannot
+// overflow the native one. Components are completed callees first.
+std::vector<std::vector<FunctionDecl*>> CallGraph::bottomUpComponents() const {
+    const size_t unvisited = SIZE_MAX;
+    std::vector<size_t> order(functions.size(), unvisited);
+    std::vector<size_t> lowLink(functions.size(), 0);
+    std::vector<bool> onStack(functions.size(), false);
+    std::vector<size_t> stack;
+    std::vector<std::vector<FunctionDecl*>> components;
+    size_t counter = 0;
+
+    struct Frame {
+        size_t function;
+        size_t nextSite;
+    };
+    std::vector<Frame> work;
+
+    for (size_t root = 0; root < functions.size(); ++root) {
+        if (order[root] != unvisited) continue;
+        work.push_back({root, 0});
+
+        while (!work.empty()) {
+            Frame& frame = work.back();
+            size_t v = frame.function;
+            if (frame.nextSite == 0 && order[v] == unvisited) {
+                order[v] = lowLink[v] = counter++;
+                stack.push_back(v);
+                onStack[v] = true;
+            }
+
+            const auto& sites = callSites[v];
+            bool descended = false;
+            while (frame.nextSite < sites.size()) {
+                const CallSite& site = sites[frame.nextSite++];
+                auto target = site.callee ? indices.find(site.callee) : indices.end();
+                if (target == indices.end()) continue;
+                size_t w = target->second;
+                if (order[w] == unvisited) {
+                    work.push_back({w, 0});
+                    descended = true;
+                    break;
+                }
+                if (onStack[w]) {
+                    lowLink[v] = std::min(lowLink[v], order[w]);
+                }
+            }
+            if (descended) continue;
+
+            if (lowLink[v] == order[v]) {
+                std::vector<FunctionDecl*> component;
+                size_t w;
+                do {
+                    w = stack.back();
+                    stack.pop_back();
+                    onStack[w] = false;
+                    component.push_back(functions[w]);
+                } while (w != v);
+                std::reverse(component.begin(), component.end());
+                components.push_back(std::move(component));
+            }
+            work.pop_back();
+            if (!work.empty()) {
+                size_t parent = work.back().function;
+                lowLink[parent] = std::min(lowLink[parent], lowLink[v]);
+            }
+        }
+    }
+    return components;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ast.hpp"
+
+struct CallSite {
+    FunctionCall* call;
+    FunctionDecl* callee; // null when the name does not resolve
+};
+
+// Direct calls between the functions of a program. Call sites are kept in
+// source order; calls made by global initializers are tracked separately
+// because they do not belong to any function.
+class CallGraph {
+private:
+    std::vector<FunctionDecl*> functions;
+    std::unordered_map<const FunctionDecl*, size_t> indices;
+    std::vector<std::vector<CallSite>> callSites;
+    std::vector<CallSite> initializerCalls;
+    std::vector<size_t> callerCounts;
+
+public:
+    void build(ProgramNode& program, const std::unordered_map<std::string, FunctionDecl*>& resolve);
+
+    // Every function in source order
+    const std::vector<FunctionDecl*>& getFunctions() const { return functions; }
+    const std::vector<CallSite>& getCallSites(const FunctionDecl* function) const;
+    const std::vector<CallSite>& getInitializerCalls() const { return initializerCalls; }
+
+    // Number of call sites anywhere in the program that target the function
+    size_t getCallerCount(const FunctionDecl* function) const;
+
+    // Strongly connected components ordered so that callees come before
+    // their callers; a component with several functions is a recursive cycle
+    std::vector<std::vector<FunctionDecl*>> bottomUpComponents() const;
+
+    // Appends every call in the expression, in evaluation order
+    static void collectCalls(Expression& expr, std::vector<FunctionCall*>& calls);
+};
@@ -1,15 +1,102 @@
 #include "codegen.hpp"
-#include <fstream>
+#include "x86.hpp"
+#include "elf.hpp"
+#include "linker.hpp"
+#include "memtrack.hpp"
+#include "bytecode.hpp"
+#include "emitter.hpp"
+#include "threadpool.hpp"
+#include "callgraph.hpp"
+#include "inliner.hpp"
+#include "peephole.hpp"
+#include "trace.hpp"
+#include "value.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <filesystem>
+
+namespace {
+    void appendIntermediate(const std::vector<Instruction>& instructions, std::string& out) {
+        for (const auto& inst : instructions) {
+            bool header = inst.opcode == "func" || inst.opcode == "endfunc" || inst.opcode == "global" ||
+                          (!inst.opcode.empty() && inst.opcode.back() == ':');
+            if (!header) {
+                out += "    ";
+            }
+            inst.appendTo(out);
+            out += '\n';
+        }
+    }
+
+    // Folding can leave an initializer as a single constant stored to its
+    // global, as in `let k: int = 40 + 2`. That constant becomes the
+    // global's initial value, like a literal initializer does in lowering,
+    // and an initializer function left with nothing to do is dropped.
+    void hoistConstantStores(std::vector<Instruction>& instructions) {
+        std::unordered_map<std::string, Instruction*> declarations;
+        std::unordered_map<std::string, size_t> mentions;
+        for (auto& inst : instructions) {
+            if (inst.opcode == "global" && inst.operands.size() == 1) {
+                declarations[inst.operands[0]] = &inst;
+            }
+            for (const auto& operand : inst.operands) {
+                ++mentions[operand];
+            }
+        }
+        
+        std::vector<bool> removed(instructions.size(), false);
+        for (size_t i = 1; i < instructions.size(); ++i) {
+            const Instruction& store = instructions[i];
+            const Instruction& constant = instructions[i - 1];
+            if (store.opcode != "store" || constant.opcode.compare(0, 6, "const.") != 0 ||
+                constant.operands[0] != store.operands[1] || mentions[constant.operands[0]] != 2) {
+                continue;
+            }
+            auto declaration = declarations.find(store.operands[0]);
+            if (declaration == declarations.end()) {
+                continue;
+            }
+            declaration->second->operands.push_back(constant.opcode);
+            declaration->second->operands.push_back(constant.operands[1]);
+            declarations.erase(declaration);
+            removed[i - 1] = removed[i] = true;
+        }
+        
+        size_t kept = 0;
+        for (size_t i = 0; i < instructions.size(); ++i) {
+            if (removed[i]) continue;
+            if (kept != i) {
+                instructions[kept] = std::move(instructions[i]);
+            }
+            ++kept;
+        }
+        instructions.erase(instructions.begin() + static_cast<std::ptrdiff_t>(kept), instructions.end());
+        
+        // func, ret and endfunc are all that is left
+        auto body = std::find_if(instructions.begin(), instructions.end(),
+                                 [](const Instruction& inst) { return inst.opcode == "func"; });
+        if (instructions.end() - body == 3 && body[1].opcode == "ret") {
+            instructions.erase(body, instructions.end());
+        }
+    }
+}
 
 std::string Instruction::toString() const {
-    std::string result = opcode;
+    std::string result;
+    appendTo(result);
+    return result;
+}
+
+void Instruction::appendTo(std::string& out) const {
+    out += opcode;
     for (const auto& operand : operands) {
-        result += " " + operand;
+        out += ' ';
+        out += operand;
     }
     if (!comment.empty()) {
-        result += " ; " + comment;
+        out += " ; ";
+        out += comment;
     }
-    return result;
 }
 
 std::string CodeGenContext::generateLabel(const std::string& prefix) {
@@ -24,6 +111,7 @@ void CodeGenContext::emitInstruction(const std::string& opcode,
                                    const std::vector<std::string>& operands,
                                    const std::string& comment) {
     instructions.emplace_back(opcode, operands, comment);
+    instructions.back().position = position;
 }
 
 void CodeGenContext::emitLabel(const std::string& label) {
@@ -34,71 +122,1040 @@ void CodeGenContext::emitComment(const std::string& comment) {
     instructions.emplace_back("", std::vector<std::string>(), comment);
 }
 
+// FunctionLowering implementation
+FunctionLowering::FunctionLowering(ModuleSymbols& moduleSymbols, ErrorReporter& reporter)
+    : symbols(moduleSymbols), errorReporter(&reporter), parameterCount(0), tailCalls(true), tailExpression(nullptr),
+      functionReturnType(PrimitiveType::VOID), endedInTailCall(false), currentType(PrimitiveType::VOID) {}
+
+std::string FunctionLowering::stringOperand(const std::string& value) {
+    return "\"" + CompilerUtils::escapeString(value) + "\"";
+}
+
+bool FunctionLowering::constantString(Expression& expr, std::string& value) {
+    if (auto* literal = dynamic_cast<StringLiteral*>(&expr)) {
+        value = literal->value;
+        return true;
+    }
+    auto* binary = dynamic_cast<BinaryOp*>(&expr);
+    std::string right;
+    if (!binary || binary->operator_ != "+" || !binary->left || !binary->right ||
+        !constantString(*binary->left, value) || !constantString(*binary->right, right)) {
+        return false;
+    }
+    value += right;
+    return true;
+}
+
+// Globals with a constant initializer start out holding their value, so the
+// initializer function only exists when some global needs code to run
+void FunctionLowering::lowerGlobals(const std::vector<VarDecl*>& variables) {
+    currentFunction = CodeGenerator::INIT_FUNCTION;
+    generateFunctionPrologue(CodeGenerator::INIT_FUNCTION);
+    size_t bodyStart = context.instructions.size();
+    for (auto* var : variables) {
+        var->accept(*this);
+    }
+    bool needed = context.instructions.size() > bodyStart;
+    context.emitInstruction("ret");
+    generateFunctionEpilogue(CodeGenerator::INIT_FUNCTION);
+    currentFunction.clear();
+    
+    if (!needed) {
+        context.instructions.clear();
+    }
+    context.instructions.insert(context.instructions.begin(), std::make_move_iterator(globalDeclarations.begin()),
+                                std::make_move_iterator(globalDeclarations.end()));
+    globalDeclarations.clear();
+}
+
+void FunctionLowering::visit(ProgramNode& node) {
+    // Programs are split into functions by CodeGenerator
+}
+
+void FunctionLowering::visit(FunctionDecl& node) {
+    std::vector<PrimitiveType> parameterTypes;
+    for (const auto& param : node.parameters) {
+        parameterTypes.push_back(TypeUtils::stringToPrimitiveType(param.type));
+    }
+    lowerBody(node, node.name, parameterTypes);
+}
+
+void FunctionLowering::lowerSpecialization(FunctionDecl& node, const Specialization& specialization) {
+    lowerBody(node, specialization.name, specialization.parameterTypes);
+}
+
+void FunctionLowering::lowerBody(FunctionDecl& node, const std::string& name,
+                                 const std::vector<PrimitiveType>& parameterTypes) {
+    currentFunction = name;
+    parameterCount = node.parameters.size();
+    locals.clear();
+    context.position = &node.getPosition();
+    
+    generateFunctionPrologue(name);
+    
+    for (size_t i = 0; i < node.parameters.size(); ++i) {
+        const auto& param = node.parameters[i];
+        std::string temp = context.generateTemp();
+        context.emitInstruction("param", {temp, std::to_string(i)});
+        if (!locals.emplace(param.name, std::make_pair(temp, parameterTypes[i])).second) {
+            errorReporter->reportSemanticError(param.position, "Duplicate parameter '" + param.name + "'");
+        }
+    }
+    emitCounter(&node, nullptr);
+    
+    PrimitiveType returnType = TypeUtils::stringToPrimitiveType(node.returnType);
+    functionReturnType = returnType;
+    tailExpression = node.body.get();
+    endedInTailCall = false;
+    if (node.body) {
+        lowerExpression(*node.body);
+        if (endedInTailCall) {
+            // tailcall does not come back here
+        } else if (returnType == PrimitiveType::VOID) {
+            context.emitInstruction("ret");
+        } else {
+            context.emitInstruction("ret", {convertValue(currentValue, currentType, returnType, node.body->getPosition())});
+        }
+    } else {
+        context.emitInstruction("ret");
+    }
+    
+    tailExpression = nullptr;
+    generateFunctionEpilogue(name);
+    currentFunction.clear();
+}
+
+void FunctionLowering::visit(VarDecl& node) {
+    if (symbols.functions.count(node.name) || symbols.globals.count(node.name)) {
+        errorReporter->reportSemanticError(node.getPosition(), "Redefinition of '" + node.name + "'");
+        return;
+    }
+    
+    context.position = &node.getPosition();
+    PrimitiveType type = TypeUtils::stringToPrimitiveType(node.declaredType);
+    if (!node.initializer) {
+        if (node.declaredType.empty()) {
+            errorReporter->reportSemanticError(node.getPosition(), "Variable '" + node.name + "' needs a type or an initializer");
+            return;
+        }
+        symbols.globals[node.name] = type;
+        globalDeclarations.emplace_back("global", std::vector<std::string>{"@" + node.name});
+        return;
+    }
+    
+    size_t initializerStart = context.instructions.size();
+    lowerExpression(*node.initializer);
+    if (node.declaredType.empty()) {
+        type = currentType;
+    }
+    std::string value = convertValue(currentValue, currentType, type, node.getPosition());
+    symbols.globals[node.name] = type;
+    
+    // An initializer that lowered to nothing but constants becomes the
+    // global's initial value: `global @name const.k value`
+    Instruction declaration("global", {"@" + node.name});
+    auto& instructions = context.instructions;
+    bool constant = instructions.size() > initializerStart && instructions.back().operands.size() == 2 &&
+                    instructions.back().operands[0] == value;
+    for (size_t i = initializerStart; constant && i < instructions.size(); ++i) {
+        constant = instructions[i].opcode.compare(0, 6, "const.") == 0;
+    }
+    if (constant) {
+        declaration.operands.push_back(instructions.back().opcode);
+        declaration.operands.push_back(instructions.back().operands[1]);
+        instructions.erase(instructions.begin() + static_cast<std::ptrdiff_t>(initializerStart), instructions.end());
+    } else {
+        context.emitInstruction("store", {"@" + node.name, value});
+    }
+    globalDeclarations.push_back(std::move(declaration));
+}
+
+void FunctionLowering::visit(BinaryOp& node) {
+    tailExpression = nullptr;
+    std::string folded;
+    if (constantString(node, folded)) {
+        currentValue = context.generateTemp();
+        context.emitInstruction("const.s", {currentValue, stringOperand(folded)});
+        currentType = PrimitiveType::STRING;
+        return;
+    }
+    
+    // All operands of a `+` chain are lowered before any operator, so a chain
+    // that turns out to join strings can build its result in one allocation
+    std::vector<Expression*> operands;
+    if (node.operator_ == "+") {
+        collectOperands(node, operands);
+    } else {
+        operands = {node.left.get(), node.right.get()};
+    }
+    std::vector<std::pair<std::string, PrimitiveType>> values;
+    for (auto* operand : operands) {
+        lowerExpression(*operand);
+        values.emplace_back(currentValue, currentType);
+    }
+    
+    bool allStrings = values.size() > 2;
+    for (const auto& value : values) {
+        allStrings = allStrings && value.second == PrimitiveType::STRING;
+    }
+    if (allStrings) {
+        std::vector<std::string> concatOperands{context.generateTemp()};
+        for (const auto& value : values) {
+            concatOperands.push_back(value.first);
+        }
+        context.emitInstruction("concat.n", concatOperands);
+        currentValue = concatOperands[0];
+        currentType = PrimitiveType::STRING;
+        return;
+    }
+    
+    size_t next = 0;
+    combineOperands(node, operands, values, next);
+}
+
+void FunctionLowering::collectOperands(BinaryOp& node, std::vector<Expression*>& operands) {
+    for (auto* child : {node.left.get(), node.right.get()}) {
+        auto* binary = dynamic_cast<BinaryOp*>(child);
+        if (!binary || binary->operator_ != "+") {
+            operands.push_back(child);
+            continue;
+        }
+        // A `+` of literals stays whole so it is still folded; it is the only
+        // kind of `+` collected as an operand
+        size_t first = operands.size();
+        collectOperands(*binary, operands);
+        bool literals = std::all_of(operands.begin() + static_cast<std::ptrdiff_t>(first), operands.end(),
+                                    [](Expression* operand) {
+            auto* inner = dynamic_cast<BinaryOp*>(operand);
+            return dynamic_cast<StringLiteral*>(operand) || (inner && inner->operator_ == "+");
+        });
+        if (literals) {
+            operands.resize(first);
+            operands.push_back(child);
+        }
+    }
+}
+
+void FunctionLowering::combineOperands(BinaryOp& node, const std::vector<Expression*>& operands,
+                                       const std::vector<std::pair<std::string, PrimitiveType>>& values, size_t& next) {
+    std::pair<std::string, PrimitiveType> sides[2];
+    Expression* children[2] = {node.left.get(), node.right.get()};
+    for (int i = 0; i < 2; ++i) {
+        if (operands[next] == children[i]) {
+            sides[i] = values[next++];
+        } else {
+            combineOperands(static_cast<BinaryOp&>(*children[i]), operands, values, next);
+            sides[i] = {currentValue, currentType};
+        }
+    }
+    lowerOperator(node, sides[0].first, sides[0].second, sides[1].first, sides[1].second);
+}
+
+void FunctionLowering::lowerOperator(BinaryOp& node, std::string lhs, PrimitiveType lhsType, std::string rhs,
+                                     PrimitiveType rhsType) {
+    std::string opcode;
+    if (node.operator_ == "+") opcode = "add";
+    else if (node.operator_ == "-") opcode = "sub";
+    else if (node.operator_ == "*") opcode = "mul";
+    else if (node.operator_ == "/") opcode = "div";
+    
+    std::string result = context.generateTemp();
+    if (lhsType == PrimitiveType::INT && rhsType == PrimitiveType::INT && !opcode.empty()) {
+        context.emitInstruction(opcode + ".i", {result, lhs, rhs});
+        currentType = PrimitiveType::INT;
+    } else if (TypeUtils::isNumericType(lhsType) && TypeUtils::isNumericType(rhsType) && !opcode.empty()) {
+        lhs = convertValue(lhs, lhsType, PrimitiveType::FLOAT, node.getPosition());
+        rhs = convertValue(rhs, rhsType, PrimitiveType::FLOAT, node.getPosition());
+        context.emitInstruction(opcode + ".f", {result, lhs, rhs});
+        currentType = PrimitiveType::FLOAT;
+    } else if (opcode == "add" && lhsType == PrimitiveType::STRING && rhsType == PrimitiveType::STRING) {
+        context.emitInstruction("concat", {result, lhs, rhs});
+        currentType = PrimitiveType::STRING;
+    } else if ((lhsType == PrimitiveType::ANY || rhsType == PrimitiveType::ANY) && !opcode.empty() &&
+               lhsType != PrimitiveType::VOID && rhsType != PrimitiveType::VOID) {
+        // Only an operand that is not statically known pays for a type check
+        lhs = convertValue(lhs, lhsType, PrimitiveType::ANY, node.getPosition());
+        rhs = convertValue(rhs, rhsType, PrimitiveType::ANY, node.getPosition());
+        context.emitInstruction(opcode + ".a", {result, lhs, rhs});
+        currentType = PrimitiveType::ANY;
+    } else {
+        errorReporter->reportTypeError(node.getPosition(), "Operator '" + node.operator_ + "' cannot be applied to '" +
+                                      TypeUtils::primitiveTypeToString(lhsType) + "' and '" +
+                                      TypeUtils::primitiveTypeToString(rhsType) + "'");
+        currentType = lhsType;
+    }
+    currentValue = result;
+}
+
+void FunctionLowering::visit(FunctionCall& node) {
+    bool tailPosition = &node == tailExpression;
+    tailExpression = nullptr;
+    
+    auto callee = symbols.functions.find(node.functionName);
+    if (callee == symbols.functions.end()) {
+        errorReporter->reportSemanticError(node.getPosition(), "Call to undefined function '" + node.functionName + "'");
+        currentValue = context.generateTemp();
+        currentType = PrimitiveType::ANY;
+        return;
+    }
+    
+    const auto& params = callee->second->parameters;
+    if (params.size() != node.arguments.size()) {
+        errorReporter->reportSemanticError(node.getPosition(), "Function '" + node.functionName + "' expects " +
+                                          std::to_string(params.size()) + " arguments, got " +
+                                          std::to_string(node.arguments.size()));
+    }
+    
+    // Arguments for `any` parameters are converted once the callee version
+    // is known; a specialization takes them as they are
+    std::vector<std::string> args;
+    std::vector<PrimitiveType> argTypes;
+    for (size_t i = 0; i < node.arguments.size(); ++i) {
+        lowerExpression(*node.arguments[i]);
+        PrimitiveType paramType = i < params.size() ? TypeUtils::stringToPrimitiveType(params[i].type) : currentType;
+        argTypes.push_back(currentType);
+        if (paramType == PrimitiveType::ANY) {
+            args.push_back(currentValue);
+        } else {
+            args.push_back(convertValue(currentValue, currentType, paramType, node.arguments[i]->getPosition()));
+            argTypes.back() = paramType;
+        }
+    }
+    
+    bool inlined = symbols.inlineSites.count(&node) && callee->second->body && args.size() == params.size() &&
+                   std::find(inlineStack.begin(), inlineStack.end(), callee->second) == inlineStack.end();
+    std::string target = node.functionName;
+    std::vector<PrimitiveType> paramTypes;
+    std::string name = Specializer::specializedName(*callee->second, argTypes, paramTypes);
+    auto specialization = symbols.specializations.find(name);
+    if (specialization != symbols.specializations.end() && (inlined || !specialization->second.inlinedOnly) &&
+        args.size() == params.size()) {
+        target = name;
+    } else {
+        paramTypes.clear();
+        for (const auto& param : params) {
+            paramTypes.push_back(TypeUtils::stringToPrimitiveType(param.type));
+        }
+    }
+    for (size_t i = 0; i < args.size() && i < params.size(); ++i) {
+        args[i] = convertValue(args[i], argTypes[i], paramTypes[i], node.arguments[i]->getPosition());
+    }
+    
+    emitCounter(nullptr, &node);
+    if (inlined) {
+        lowerInlined(*callee->second, args, paramTypes, tailPosition);
+        return;
+    }
+    for (size_t i = 0; i < args.size(); ++i) {
+        context.emitInstruction("arg", {std::to_string(i), args[i]});
+    }
+    
+    if ((tailCalls || node.requireTailCall) && canTailCall(node, *callee->second, tailPosition)) {
+        context.emitInstruction("tailcall", {"@" + target, std::to_string(args.size())});
+        endedInTailCall = true;
+        return;
+    }
+    
+    currentValue = context.generateTemp();
+    currentType = TypeUtils::stringToPrimitiveType(callee->second->returnType);
+    context.emitInstruction("call", {currentValue, "@" + target, std::to_string(args.size())});
+}
+
+// Expands the callee's body in place with its parameters bound to the
+// already converted arguments, so each argument is still evaluated once
+void FunctionLowering::lowerInlined(FunctionDecl& callee, const std::vector<std::string>& args,
+                                    const std::vector<PrimitiveType>& parameterTypes, bool tailPosition) {
+    auto savedLocals = std::move(locals);
+    locals.clear();
+    for (size_t i = 0; i < callee.parameters.size(); ++i) {
+        locals.emplace(callee.parameters[i].name, std::make_pair(args[i], parameterTypes[i]));
+    }
+    
+    // The callee reports its own errors when it is lowered on its own
+    ErrorReporter scratch;
+    ErrorReporter* savedReporter = errorReporter;
+    errorReporter = &scratch;
+    inlineStack.push_back(&callee);
+    emitCounter(&callee, nullptr);
+    
+    // The expansion stays in tail position only if its result is returned
+    // without conversion
+    PrimitiveType returnType = TypeUtils::stringToPrimitiveType(callee.returnType);
+    tailExpression = tailPosition && returnType == functionReturnType ? callee.body.get() : nullptr;
+    lowerExpression(*callee.body);
+    tailExpression = nullptr;
+    if (endedInTailCall) {
+        // Nothing follows a tailcall
+    } else if (returnType == PrimitiveType::VOID) {
+        currentValue = context.generateTemp();
+        context.emitInstruction("const.i", {currentValue, "0"});
+    } else {
+        currentValue = convertValue(currentValue, currentType, returnType, callee.body->getPosition());
+    }
+    currentType = returnType;
+    
+    inlineStack.pop_back();
+    errorReporter = savedReporter;
+    locals = std::move(savedLocals);
+}
+
+// A call is a tail call when the caller returns its result unchanged and
+// the callee's stack arguments fit where the caller's own arguments were
+bool FunctionLowering::canTailCall(const FunctionCall& node, const FunctionDecl& callee, bool tailPosition) {
+    std::string reason;
+    PrimitiveType calleeType = TypeUtils::stringToPrimitiveType(callee.returnType);
+    if (!tailPosition) {
+        reason = "it is not in tail position";
+    } else if (calleeType != functionReturnType) {
+        reason = "'" + callee.name + "' returns '" + TypeUtils::primitiveTypeToString(calleeType) + "' but '" +
+                 currentFunction + "' returns '" + TypeUtils::primitiveTypeToString(functionReturnType) + "'";
+    } else if (node.arguments.size() > std::max(REGISTER_ARGS, parameterCount)) {
+        reason = "it passes more stack arguments than '" + currentFunction + "' receives";
+    }
+    
+    if (reason.empty()) {
+        return true;
+    }
+    if (node.requireTailCall) {
+        errorReporter->reportSemanticError(node.getPosition(), "Call to '" + node.functionName +
+                                           "' cannot be a tail call: " + reason);
+    }
+    return false;
+}
+
+void FunctionLowering::visit(Identifier& node) {
+    auto local = locals.find(node.name);
+    if (local != locals.end()) {
+        currentValue = local->second.first;
+        currentType = local->second.second;
+        return;
+    }
+    
+    auto global = symbols.globals.find(node.name);
+    currentValue = context.generateTemp();
+    if (global == symbols.globals.end()) {
+        errorReporter->reportSemanticError(node.getPosition(), "Undefined identifier '" + node.name + "'");
+        currentType = PrimitiveType::ANY;
+        return;
+    }
+    context.emitInstruction("load", {currentValue, "@" + node.name});
+    currentType = global->second;
+}
+
+void FunctionLowering::visit(NumberLiteral& node) {
+    currentValue = context.generateTemp();
+    if (node.isFloat) {
+        try {
+            std::stod(node.value);
+            literalTemps.emplace(currentValue, &node);
+        } catch (const std::out_of_range&) {
+            errorReporter->reportSemanticError(node.getPosition(), "Float literal '" + node.value + "' is out of range");
+        }
+        context.emitInstruction("const.f", {currentValue, node.value});
+        currentType = PrimitiveType::FLOAT;
+        return;
+    }
+    
+    try {
+        std::stoll(node.value);
+        literalTemps.emplace(currentValue, &node);
+    } catch (const std::out_of_range&) {
+        errorReporter->reportSemanticError(node.getPosition(), "Integer literal '" + node.value + "' is out of range");
+    }
+    context.emitInstruction("const.i", {currentValue, node.value});
+    currentType = PrimitiveType::INT;
+}
+
+void FunctionLowering::visit(StringLiteral& node) {
+    currentValue = context.generateTemp();
+    context.emitInstruction("const.s", {currentValue, stringOperand(node.value)});
+    currentType = PrimitiveType::STRING;
+}
+
+void FunctionLowering::visit(IncludeDirective& node) {
+    // Included files are resolved before code generation
+}
+
+void FunctionLowering::visit(ImportStatement& node) {
+    // Imports only affect name resolution
+}
+
+void FunctionLowering::visit(SelectiveImport& node) {
+    // Imports only affect name resolution
+}
+
+void FunctionLowering::generateFunctionPrologue(const std::string& functionName) {
+    context.emitInstruction("func", {"@" + functionName});
+}
+
+void FunctionLowering::generateFunctionEpilogue(const std::string& functionName) {
+    context.emitInstruction("endfunc", {"@" + functionName});
+}
+
+// Instructions belong to the innermost expression being lowered, so an
+// operator applied after its operands is attributed to the operator
+void FunctionLowering::lowerExpression(Expression& expr) {
+    const Position* outer = context.position;
+    context.position = &expr.getPosition();
+    expr.accept(*this);
+    context.position = outer;
+}
+
+// Counts the entry to a function or the execution of a call in an
+// instrumented build; an inlined body still counts as an entry
+void FunctionLowering::emitCounter(const FunctionDecl* function, const FunctionCall* call) {
+    const auto& counters = symbols.profileCounters;
+    auto entry = counters.entries.find(function);
+    auto site = counters.calls.find(call);
+    if (entry != counters.entries.end()) {
+        context.emitInstruction("count", {std::to_string(entry->second)});
+    } else if (site != counters.calls.end()) {
+        context.emitInstruction("count", {std::to_string(site->second)});
+    }
+}
+
+std::string FunctionLowering::convertValue(const std::string& value, PrimitiveType from, PrimitiveType to,
+                                        const Position& position) {
+    if (from == to) {
+        return value;
+    }
+    if (from == PrimitiveType::INT && to == PrimitiveType::FLOAT) {
+        std::string result = context.generateTemp();
+        context.emitInstruction("itof", {result, value});
+        return result;
+    }
+    
+    // Boxing always succeeds; unboxing is checked when the program runs
+    static const char* const suffixes[] = {"i", "f", "s", "b"}; // by PrimitiveType
+    auto literal = literalTemps.find(value);
+    if (to == PrimitiveType::ANY && literal != literalTemps.end()) {
+        if (literal->second->isFloat) {
+            // A float literal is never NaN, so it is its own box
+            return value;
+        }
+        // An int too wide for the payload is boxed when the program runs
+        int64_t integer = std::stoll(literal->second->value);
+        if (NanBox::fitsInt(integer)) {
+            std::string result = context.generateTemp();
+            context.emitInstruction("const.i", {result, std::to_string(static_cast<int64_t>(NanBox::boxInt(integer)))});
+            return result;
+        }
+    }
+    if (to == PrimitiveType::ANY && from != PrimitiveType::VOID) {
+        std::string result = context.generateTemp();
+        context.emitInstruction(std::string("box.") + suffixes[static_cast<int>(from)], {result, value});
+        return result;
+    }
+    if (from == PrimitiveType::ANY && to != PrimitiveType::VOID) {
+        std::string result = context.generateTemp();
+        context.emitInstruction(std::string("unbox.") + suffixes[static_cast<int>(to)], {result, value});
+        return result;
+    }
+    
+    errorReporter->reportTypeError(position, "Cannot convert '" + TypeUtils::primitiveTypeToString(from) +
+                                  "' to '" + TypeUtils::primitiveTypeToString(to) + "'");
+    return value;
+}
+
 // CodeGenerator implementation
 CodeGenerator::CodeGenerator(Target tgt, ErrorReporter& reporter) 
-    : target(std::move(tgt)), errorReporter(reporter) {}
+    : target(std::move(tgt)), errorReporter(reporter), threadCount(0), inlining(true), tailCalls(true),
+      specializing(true), collectRemarks(false), debugInfo(false), peephole(true),
+      peepholeHits(Peephole::rules().size(), 0), instructionCount(0), ordering(true), profile(nullptr) {}
+
+CodeGenerator::~CodeGenerator() = default;
 
 bool CodeGenerator::generate(ProgramNode* program, const std::string& outputFile) {
-    // TODO: Implement actual code generation
+    MemoryScope memory(MemoryCategory::CODE);
+    if (!beginOutput(outputFile)) {
+        return false;
+    }
+    
     if (program) {
-        program->accept(*this);
+        lowerProgram(*program);
     }
     
-    return writeOutputFile(outputFile);
+    return finishOutput(outputFile);
 }
 
-void CodeGenerator::visit(ProgramNode& node) {
-    // TODO: Implement 
+bool CodeGenerator::generateInMemory(ProgramNode* program, MachineModule& module) {
+    MemoryScope memory(MemoryCategory::CODE);
+    backend = std::make_unique<X86Backend>(errorReporter, stringPool);
+    if (program) {
+        lowerProgram(*program);
+    }
+    
+    if (errorReporter.hasAnyErrors() || !checkEntryPoint() || !linkRuntime(backend->getModule())) {
+        return false;
+    }
+    
+    backend->placeColdCode();
+    module = std::move(backend->getModule());
+    return true;
 }
 
-void CodeGenerator::visit(FunctionDecl& node) {
-    // TODO: Implement 
+bool CodeGenerator::linkRuntime(MachineModule& module) {
+    StaticLinker linker(errorReporter);
+    return linker.addArchive(StaticLinker::runtimeArchive(), "liblithium_rt.a") &&
+           linker.link(module, &backend->getColdModule());
 }
 
-void CodeGenerator::visit(VarDecl& node) {
-    // TODO: Implement 
+bool CodeGenerator::generateBytecodeInMemory(ProgramNode* program, BytecodeModule& module) {
+    MemoryScope memory(MemoryCategory::CODE);
+    bytecode = std::make_unique<BytecodeCompiler>(errorReporter);
+    if (program) {
+        lowerProgram(*program);
+    }
+    
+    if (errorReporter.hasAnyErrors() || !checkEntryPoint() || !bytecode->finish()) {
+        return false;
+    }
+    module = std::move(bytecode->getModule());
+    return true;
 }
 
-void CodeGenerator::visit(BinaryOp& node) {
-    // TODO: Implement 
+// Global initializers are lowered first on this thread because they define
+// the global types. Function bodies are then lowered in parallel, a window
+// at a time, and merged in source order, or in layout order for native code,
+// so the output never depends on scheduling.
+void CodeGenerator::lowerProgram(ProgramNode& program) {
+    // A program built without the parser may only have positions on its
+    // declarations
+    programPosition = program.getPosition();
+    for (const auto& decl : program.declarations) {
+        if (!programPosition.filename.empty()) break;
+        if (decl) programPosition = Position(decl->getPosition().filename);
+    }
+    
+    // Collect signatures first so calls may refer to functions declared later
+    std::vector<VarDecl*> variables;
+    std::vector<FunctionDecl*> bodies;
+    for (auto& decl : program.declarations) {
+        if (auto* func = dynamic_cast<FunctionDecl*>(decl.get())) {
+            if (!symbols.functions.emplace(func->name, func).second) {
+                errorReporter.reportSemanticError(func->getPosition(), "Redefinition of function '" + func->name + "'");
+            }
+            bodies.push_back(func);
+        } else if (auto* var = dynamic_cast<VarDecl*>(decl.get())) {
+            variables.push_back(var);
+        }
+    }
+    
+    // Each copy is lowered right after the function it was made from
+    struct Work {
+        FunctionDecl* function;
+        const Specialization* specialization;
+        bool cold;
+    };
+    std::vector<Work> work;
+    bool profiling = profile || !profileOutput.empty();
+    bool laidOut = backend && ordering;
+    if ((inlining || specializing || profiling || laidOut) && !errorReporter.hasAnyErrors()) {
+        MemoryScope memory(MemoryCategory::PASSES);
+        CallGraph graph;
+        {
+            TraceScope trace("pass", "call graph");
+            graph.build(program, symbols.functions);
+        }
+        if (profiling) {
+            ProfileSites sites;
+            sites.build(graph);
+            if (profile) {
+                profileCounts.build(sites, *profile);
+            }
+            if (!profileOutput.empty()) {
+                symbols.profileCounters = std::move(sites);
+            }
+        }
+        Inliner inliner(collectRemarks ? &remarks : nullptr);
+        if (inlining) {
+            TraceScope trace("pass", "inline");
+            inliner.setProfile(profile ? &profileCounts : nullptr);
+            inliner.run(graph, symbols.inlineSites);
+        }
+        
+        std::vector<Specialization> specializations;
+        if (specializing) {
+            TraceScope trace("pass", "specialize");
+            Specializer specializer(collectRemarks ? &remarks : nullptr);
+            specializer.setProfile(profile ? &profileCounts : nullptr);
+            specializer.run(graph, variables, symbols.inlineSites, specializations);
+        }
+        std::unordered_map<const FunctionDecl*, std::vector<const Specialization*>> copies;
+        for (auto& specialization : specializations) {
+            auto& copy = symbols.specializations.emplace(specialization.name, specialization).first->second;
+            if (!copy.inlinedOnly) {
+                copies[copy.function].push_back(&copy);
+            }
+        }
+        
+        // Native code follows the chosen layout; copies share the placement
+        // of their function
+        std::vector<std::pair<FunctionDecl*, bool>> placed;
+        if (laidOut) {
+            TraceScope trace("pass", "layout");
+            layout.setProfile(profile ? &profileCounts : nullptr);
+            layout.run(graph, symbols.inlineSites, inlining ? &inliner : nullptr, target.type == TargetType::OBJECT);
+            for (const auto& placement : layout.getOrder()) {
+                placed.emplace_back(placement.function, placement.cold);
+            }
+        } else {
+            for (auto* function : bodies) {
+                placed.emplace_back(function, false);
+            }
+        }
+        for (const auto& [function, cold] : placed) {
+            work.push_back({function, nullptr, cold});
+            for (const auto* copy : copies[function]) {
+                work.push_back({function, copy, cold});
+            }
+        }
+    } else {
+        for (auto* function : bodies) {
+            work.push_back({function, nullptr, false});
+        }
+    }
+    
+    if (bytecode) {
+        for (const auto& item : work) {
+            bytecode->declareFunction(item.specialization ? item.specialization->name : item.function->name);
+        }
+    }
+    
+    {
+        TraceScope trace("pass", "strings");
+        for (auto* var : variables) {
+            if (var->initializer) {
+                internStrings(*var->initializer);
+            }
+        }
+        for (auto* function : bodies) {
+            if (function->body) {
+                internStrings(*function->body);
+            }
+        }
+        if (backend) {
+            stringPool.layout();
+            backend->emitStrings();
+        }
+    }
+    if (backend && debugInfo) {
+        numberSourceFiles(program);
+    }
+    if (backend && !symbols.profileCounters.keys.empty()) {
+        backend->defineProfile(symbols.profileCounters.keys, profileOutput);
+    }
+    
+    if (!variables.empty()) {
+        TraceScope trace("codegen", "globals");
+        MemoryScope memory(MemoryCategory::IR);
+        FunctionLowering lowering(symbols, errorReporter);
+        lowering.lowerGlobals(variables);
+        emitInitializers(lowering.getInstructions());
+    }
+    if (output && target.type == TargetType::ASSEMBLY && !errorReporter.hasAnyErrors()) {
+        writeListing();
+    }
+    
+    ThreadPool pool(threadCount);
+    size_t window = static_cast<size_t>(pool.size()) * 16;
+    std::vector<LoweredFunction> results;
+    for (size_t begin = 0; begin < work.size() && !errorReporter.limitReached(); begin += window) {
+        size_t count = std::min(window, work.size() - begin);
+        results.clear();
+        results.resize(count);
+        pool.parallelFor(count, [&](size_t i) {
+            results[i].cold = work[begin + i].cold;
+            results[i].errors.setErrorLimit(errorReporter.getErrorLimit());
+            lowerFunction(*work[begin + i].function, work[begin + i].specialization, results[i]);
+        });
+        for (auto& result : results) {
+            mergeFunction(result);
+        }
+    }
 }
 
-void CodeGenerator::visit(FunctionCall& node) {
-    // TODO: Implement 
+// Runs on a worker thread: only reads shared state and writes to `result`
+void CodeGenerator::lowerFunction(FunctionDecl& function, const Specialization* specialization,
+                                  LoweredFunction& result) {
+    TraceScope trace("codegen", specialization ? specialization->name : function.name);
+    MemoryScope memory(MemoryCategory::IR);
+    FunctionLowering lowering(symbols, result.errors);
+    lowering.setTailCalls(tailCalls);
+    if (specialization) {
+        lowering.lowerSpecialization(function, *specialization);
+    } else {
+        function.accept(lowering);
+    }
+    if (result.errors.hasAnyErrors()) {
+        return;
+    }
+    
+    auto& instructions = lowering.getInstructions();
+    optimize(instructions, result.peepholeHits);
+    result.instructionCount = instructions.size();
+    MemoryScope code(MemoryCategory::CODE);
+    if (backend) {
+        bool listing = output && target.type == TargetType::ASSEMBLY;
+        result.machine = std::make_unique<X86Backend>(result.errors, stringPool, listing);
+        if (debugInfo) {
+            result.machine->setLineInfo(&symbols.sourceFileIndex);
+        }
+        result.machine->lower(instructions);
+        if (listing) {
+            std::vector<std::string> text;
+            std::vector<std::string> data;
+            result.machine->drainListing(text, data);
+            for (const auto& line : text) {
+                result.text += line;
+                result.text += '\n';
+            }
+            result.machine.reset();
+        }
+    } else if (output && target.type == TargetType::INTERMEDIATE) {
+        appendIntermediate(instructions, result.text);
+    } else {
+        result.instructions = std::move(instructions);
+    }
 }
 
-void CodeGenerator::visit(Identifier& node) {
-    // TODO: Implement 
+// Runs on the calling thread, in the order functions are placed
+void CodeGenerator::mergeFunction(LoweredFunction& result) {
+    errorReporter.merge(result.errors);
+    for (size_t i = 0; i < result.peepholeHits.size(); ++i) {
+        peepholeHits[i] += result.peepholeHits[i];
+    }
+    instructionCount += result.instructionCount;
+    if (errorReporter.hasAnyErrors()) {
+        // Nothing more will be written
+        return;
+    }
+    
+    if (result.machine) {
+        backend->append(*result.machine, result.cold);
+    } else if (result.cold) {
+        coldAssembly += result.text;
+    } else if (!result.text.empty()) {
+        output->write(result.text);
+    } else if (bytecode) {
+        bytecode->append(result.instructions);
+    }
 }
 
-void CodeGenerator::visit(NumberLiteral& node) {
-    // TODO: Implement 
+// The initializer function defines globals, so it goes through the main
+// backend instead of a worker
+void CodeGenerator::emitInitializers(std::vector<Instruction>& instructions) {
+    if (errorReporter.hasAnyErrors()) {
+        return;
+    }
+    
+    std::vector<size_t> hits;
+    optimize(instructions, hits);
+    for (size_t i = 0; i < hits.size(); ++i) {
+        peepholeHits[i] += hits[i];
+    }
+    hoistConstantStores(instructions);
+    instructionCount += instructions.size();
+    
+    MemoryScope memory(MemoryCategory::CODE);
+    if (backend) {
+        backend->lower(instructions);
+    } else if (output && target.type == TargetType::INTERMEDIATE) {
+        std::string text;
+        appendIntermediate(instructions, text);
+        output->write(text);
+    } else if (bytecode) {
+        bytecode->append(instructions);
+    }
 }
 
-void CodeGenerator::visit(StringLiteral& node) {
-    // TODO: Implement 
+void CodeGenerator::optimize(std::vector<Instruction>& instructions, std::vector<size_t>& hits) const {
+    if (!peephole) {
+        return;
+    }
+    TraceScope trace("pass", "peephole");
+    Peephole pass;
+    pass.run(instructions);
+    hits = pass.getHits();
 }
 
-void CodeGenerator::visit(IncludeDirective& node) {
-    // TODO: Implement 
+// String constants are pooled before anything is lowered, in source order,
+// so workers only read the pool and labels do not depend on timing
+void CodeGenerator::internStrings(Expression& expr) {
+    std::string folded;
+    if (dynamic_cast<BinaryOp*>(&expr) && FunctionLowering::constantString(expr, folded)) {
+        stringPool.intern(folded);
+        stringPool.noteFolded();
+    } else if (auto* literal = dynamic_cast<StringLiteral*>(&expr)) {
+        stringPool.intern(literal->value);
+    } else if (auto* binary = dynamic_cast<BinaryOp*>(&expr)) {
+        if (binary->left) internStrings(*binary->left);
+        if (binary->right) internStrings(*binary->right);
+    } else if (auto* call = dynamic_cast<FunctionCall*>(&expr)) {
+        for (auto& argument : call->arguments) {
+            internStrings(*argument);
+        }
+    }
 }
 
-void CodeGenerator::visit(ImportStatement& node) {
-    // TODO: Implement 
+// Line entries name files by number, so the numbering is fixed before any
+// function is lowered
+void CodeGenerator::numberSourceFiles(ProgramNode& program) {
+    for (const auto& decl : program.declarations) {
+        const std::string& file = decl->getPosition().filename;
+        if (!file.empty() && symbols.sourceFileIndex.emplace(file, symbols.sourceFiles.size()).second) {
+            symbols.sourceFiles.push_back(file);
+        }
+    }
+    backend->setLineInfo(&symbols.sourceFileIndex);
+    backend->getModule().sourceFiles = symbols.sourceFiles;
+    
+    if (output && target.type == TargetType::ASSEMBLY) {
+        for (size_t i = 0; i < symbols.sourceFiles.size(); ++i) {
+            output->write("    .file " + std::to_string(i + 1) + " \"" +
+                          CompilerUtils::escapeString(symbols.sourceFiles[i]) + "\"\n");
+        }
+    }
 }
 
-void CodeGenerator::visit(SelectiveImport& node) {
-    // TODO: Implement 
+// Text targets write each function as soon as it is finished, machine
+// targets lower it straight into the backend and bytecode compiles it, so
+// the IR never accumulates
+bool CodeGenerator::beginOutput(const std::string& outputFile) {
+    output = std::make_unique<OutputBuffer>();
+    if (!output->open(outputFile)) {
+        errorReporter.reportFileError(Position(), "Could not open output file: " + output->errorMessage());
+        return false;
+    }
+    
+    switch (target.type) {
+        case TargetType::EXECUTABLE:
+        case TargetType::OBJECT:
+            backend = std::make_unique<X86Backend>(errorReporter, stringPool);
+            break;
+        case TargetType::ASSEMBLY:
+            backend = std::make_unique<X86Backend>(errorReporter, stringPool, true);
+            output->write("    .intel_syntax noprefix\n    .text\n");
+            break;
+        case TargetType::BYTECODE:
+            bytecode = std::make_unique<BytecodeCompiler>(errorReporter);
+            break;
+        case TargetType::INTERMEDIATE:
+            break;
+    }
+    return true;
 }
 
-bool CodeGenerator::writeOutputFile(const std::string& outputFile) {
-    std::ofstream file(outputFile);
-    if (!file.is_open()) {
-        errorReporter.reportFileError(Position(), "Could not open output file: " + outputFile);
+bool CodeGenerator::finishOutput(const std::string& outputFile) {
+    if (!errorReporter.hasAnyErrors()) {
+        switch (target.type) {
+            case TargetType::EXECUTABLE: generateExecutable(); break;
+            case TargetType::OBJECT: generateObject(); break;
+            case TargetType::BYTECODE: generateBytecode(); break;
+            case TargetType::ASSEMBLY: generateAssembly(); break;
+            case TargetType::INTERMEDIATE: break;
+        }
+    }
+    
+    // Never leave a partial file behind
+    if (errorReporter.hasAnyErrors()) {
+        output->discard();
         return false;
     }
+    if (!output->close()) {
+        errorReporter.reportFileError(Position(), "Could not write output file: " + output->errorMessage());
+        output->discard();
+        return false;
+    }
+    
+    if (target.type == TargetType::EXECUTABLE) {
+        std::filesystem::permissions(outputFile,
+                                     std::filesystem::perms::owner_exec | std::filesystem::perms::group_exec |
+                                     std::filesystem::perms::others_exec,
+                                     std::filesystem::perm_options::add);
+    }
     
-    file << "# TODO: Implement actual code generation\n";
+    return true;
+}
+
+void CodeGenerator::writeListing() {
+    std::vector<std::string> text;
+    std::vector<std::string> data;
+    backend->drainListing(text, data);
     
+    if (!data.empty()) {
+        output->write("    .section .rodata\n");
+        for (const auto& line : data) {
+            output->write(line);
+            output->put('\n');
+        }
+        output->write("    .text\n");
+    }
+    for (const auto& line : text) {
+        output->write(line);
+        output->put('\n');
+    }
+}
+
+bool CodeGenerator::checkEntryPoint() {
+    auto main = symbols.functions.find("main");
+    if (main == symbols.functions.end()) {
+        errorReporter.reportSemanticError(programPosition, "No 'main' function defined");
+        return false;
+    }
+    PrimitiveType mainType = TypeUtils::stringToPrimitiveType(main->second->returnType);
+    if (mainType != PrimitiveType::INT && mainType != PrimitiveType::VOID) {
+        errorReporter.reportTypeError(main->second->getPosition(), "'main' must return int or void");
+        return false;
+    }
     return true;
-}
\ No newline at end of file
+}
+
+void CodeGenerator::generateExecutable() {
+    if (!checkEntryPoint()) {
+        return;
+    }
+    
+    MachineModule& module = backend->getModule();
+    bool usesRuntime = StaticLinker::usesRuntime(module) || StaticLinker::usesRuntime(backend->getColdModule());
+    backend->emitStart(module.findSymbol(INIT_FUNCTION) != nullptr, usesRuntime);
+    if (!linkRuntime(module)) {
+        return;
+    }
+    backend->placeColdCode();
+    ElfWriter writer(errorReporter);
+    writer.setCompilationDirectory(compilationDirectory);
+    writer.writeExecutable(module, *output);
+}
+
+// Objects keep a single .text: the cold code goes at its end
+void CodeGenerator::generateObject() {
+    backend->placeColdCode();
+    if (backend->getModule().findSymbol(INIT_FUNCTION)) {
+        backend->getModule().initFunctions.push_back(INIT_FUNCTION);
+    }
+    
+    ElfWriter writer(errorReporter);
+    writer.setCompilationDirectory(compilationDirectory);
+    writer.writeObject(backend->getModule(), *output);
+}
+
+void CodeGenerator::generateBytecode() {
+    if (bytecode->finish()) {
+        output->write(bytecode->getModule().serialize());
+    }
+}
+
+void CodeGenerator::generateAssembly() {
+    if (symbols.functions.count("main")) {
+        MachineModule& module = backend->getModule();
+        backend->emitStart(module.findSymbol(INIT_FUNCTION) != nullptr, StaticLinker::usesRuntime(module));
+        writeListing();
+    }
+    if (!coldAssembly.empty()) {
+        output->write("    .section .text.cold,\"ax\",@progbits\n");
+        output->write(coldAssembly);
+        output->write("    .text\n");
+    }
+    output->write("\n    .section .note.GNU-stack,\"\",@progbits\n");
+}
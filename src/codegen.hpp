@@ -3,13 +3,22 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <unordered_map>
+#include <unordered_set>
 #include "ast.hpp"
+#include "types.hpp"
 #include "error.hpp"
+#include "layout.hpp"
+#include "profile.hpp"
+#include "specializer.hpp"
+#include "stringpool.hpp"
 
 // donno if im doing iR
 enum class TargetType {
     EXECUTABLE,
+    OBJECT,
     INTERMEDIATE,
+    BYTECODE,
     ASSEMBLY
 };
 
@@ -21,25 +30,35 @@ public:
     Target(TargetType t, std::string path) : type(t), outputPath(std::move(path)) {}
 };
 
+class OutputBuffer;
+class MachineModule;
+class BytecodeModule;
+class BytecodeCompiler;
+class X86Backend;
+
 class Instruction {
 public:
     std::string opcode;
     std::vector<std::string> operands;
     std::string comment;
+    // Source the instruction was lowered from, for line tables; points into
+    // the AST, which outlives the instruction
+    const Position* position = nullptr;
     
     Instruction(std::string op, std::vector<std::string> ops = {}, std::string cmt = "")
         : opcode(std::move(op)), operands(std::move(ops)), comment(std::move(cmt)) {}
     
     std::string toString() const;
+    void appendTo(std::string& out) const;
 };
 
 class CodeGenContext {
 public:
     std::vector<Instruction> instructions;
-    std::vector<std::string> dataSection;
-    std::vector<std::string> textSection;
     int labelCounter;
     int tempCounter;
+    // Stamped on every instruction emitted
+    const Position* position = nullptr;
     
     CodeGenContext() : labelCounter(0), tempCounter(0) {}
     
@@ -54,17 +73,85 @@ public:
     void emitComment(const std::string& comment);
 };
 
-class CodeGenerator : public ASTVisitor {
+// Program-wide tables. Filled before function bodies are lowered and only
+// read while they are, so workers can share them without locking.
+struct ModuleSymbols {
+    std::unordered_map<std::string, FunctionDecl*> functions;
+    std::unordered_map<std::string, PrimitiveType> globals;
+    
+    // Files the declarations come from, numbered in source order, when line
+    // tables are wanted; every backend numbers files the same way
+    std::vector<std::string> sourceFiles;
+    std::unordered_map<std::string, uint32_t> sourceFileIndex;
+    
+    // Calls chosen by the Inliner; their callee bodies are lowered in place
+    std::unordered_set<const FunctionCall*> inlineSites;
+    
+    // Copies chosen by the Specializer, by name; a call whose argument types
+    // match one calls it instead of the generic function
+    std::unordered_map<std::string, Specialization> specializations;
+    
+    // Counters of an instrumented build, bumped by `count` instructions;
+    // empty otherwise
+    ProfileSites profileCounters;
+};
+
+// Lowers a single function, or the global initializers, to IR. Every
+// instance has its own context and temp namespace, so separate functions
+// can be lowered on separate threads.
+class FunctionLowering : public ASTVisitor {
 private:
-    Target target;
+    ModuleSymbols& symbols;
+    ErrorReporter* errorReporter;
     CodeGenContext context;
-    ErrorReporter& errorReporter;
     std::string currentFunction;
+    size_t parameterCount;
+    std::unordered_map<std::string, std::pair<std::string, PrimitiveType>> locals;
+    std::vector<const FunctionDecl*> inlineStack;
+    bool tailCalls;
+    
+    // `global` instructions, placed ahead of the initializer function once
+    // every initializer has been seen
+    std::vector<Instruction> globalDeclarations;
+    
+    // Temps holding number literals, so boxing one can happen at compile time
+    std::unordered_map<std::string, const NumberLiteral*> literalTemps;
+    
+    // The expression whose value the current function returns unchanged;
+    // a call here becomes `tailcall`, which also ends the function
+    const Expression* tailExpression;
+    PrimitiveType functionReturnType;
+    bool endedInTailCall;
+    
+    // Result of the most recently lowered expression
+    std::string currentValue;
+    PrimitiveType currentType;
     
 public:
-    CodeGenerator(Target tgt, ErrorReporter& reporter);
+    // Arguments the native calling convention passes in registers; a tail
+    // call may need no more stack arguments than its caller received
+    static constexpr size_t REGISTER_ARGS = 6;
     
-    bool generate(ProgramNode* program, const std::string& outputFile);
+    FunctionLowering(ModuleSymbols& moduleSymbols, ErrorReporter& reporter);
+    
+    // Calls marked `tail` are turned into tail calls even when this is off
+    void setTailCalls(bool enabled) { tailCalls = enabled; }
+    
+    // Declares every global and defines the function that initializes those
+    // whose initial value is not a constant
+    void lowerGlobals(const std::vector<VarDecl*>& variables);
+    
+    // Lowers the body under the name and parameter types of a copy
+    void lowerSpecialization(FunctionDecl& node, const Specialization& specialization);
+    
+    std::vector<Instruction>& getInstructions() { return context.instructions; }
+    
+    // IR operand spelling of a string constant
+    static std::string stringOperand(const std::string& value);
+    
+    // Value of a string literal or of a `+` chain of them, which is folded
+    // into a single constant
+    static bool constantString(Expression& expr, std::string& value);
     
     void visit(ProgramNode& node) override;
     void visit(FunctionDecl& node) override;
@@ -79,13 +166,151 @@ public:
     void visit(SelectiveImport& node) override;
     
 private:
-    void generatePrologue();
-    void generateEpilogue();
     void generateFunctionPrologue(const std::string& functionName);
     void generateFunctionEpilogue(const std::string& functionName);
     
-    bool writeOutputFile(const std::string& outputFile);
-    std::string generateExecutable();
-    std::string generateIntermediate();
-    std::string generateAssembly();
-};
\ No newline at end of file
+    void lowerBody(FunctionDecl& node, const std::string& name, const std::vector<PrimitiveType>& parameterTypes);
+    void lowerExpression(Expression& expr);
+    void emitCounter(const FunctionDecl* function, const FunctionCall* call);
+    void lowerInlined(FunctionDecl& callee, const std::vector<std::string>& args,
+                      const std::vector<PrimitiveType>& parameterTypes, bool tailPosition);
+    
+    // Operands of a `+` chain in evaluation order, and the operators applied
+    // to their lowered values in the shape of the tree
+    void collectOperands(BinaryOp& node, std::vector<Expression*>& operands);
+    void combineOperands(BinaryOp& node, const std::vector<Expression*>& operands,
+                         const std::vector<std::pair<std::string, PrimitiveType>>& values, size_t& next);
+    void lowerOperator(BinaryOp& node, std::string lhs, PrimitiveType lhsType, std::string rhs, PrimitiveType rhsType);
+    bool canTailCall(const FunctionCall& node, const FunctionDecl& callee, bool tailPosition);
+    std::string convertValue(const std::string& value, PrimitiveType from, PrimitiveType to, const Position& position);
+};
+
+class CodeGenerator {
+private:
+    // Output of one function lowered on a worker thread
+    struct LoweredFunction {
+        ErrorReporter errors;
+        std::vector<Instruction> instructions;
+        std::string text;
+        std::unique_ptr<X86Backend> machine;
+        bool cold = false;
+        std::vector<size_t> peepholeHits;
+        size_t instructionCount = 0;
+    };
+    
+    Target target;
+    ErrorReporter& errorReporter;
+    ModuleSymbols symbols;
+    // Where diagnostics about the whole program, like a missing main, point
+    Position programPosition;
+    unsigned threadCount;
+    bool inlining;
+    bool tailCalls;
+    bool specializing;
+    bool collectRemarks;
+    bool debugInfo;
+    std::string compilationDirectory;
+    bool peephole;
+    std::vector<size_t> peepholeHits;
+    size_t instructionCount;
+    bool ordering;
+    FunctionLayout layout;
+    std::string profileOutput;
+    const Profile* profile;
+    ProfileCounts profileCounts;
+    std::vector<Remark> remarks;
+    StringPool stringPool;
+    
+    // Finished functions are streamed here instead of being kept as IR
+    std::unique_ptr<OutputBuffer> output;
+    std::unique_ptr<X86Backend> backend;
+    
+    // Assembly of cold functions, written after everything else
+    std::string coldAssembly;
+    
+    // Bytecode is compiled a function at a time as functions are merged;
+    // every function is declared to it before any is lowered
+    std::unique_ptr<BytecodeCompiler> bytecode;
+    
+public:
+    // Runs the global initializers that are not constants before main
+    static constexpr const char* INIT_FUNCTION = "__lithium_init";
+    
+    CodeGenerator(Target tgt, ErrorReporter& reporter);
+    ~CodeGenerator();
+    
+    // Worker threads used to lower functions; 0 means one per core. The
+    // output is byte-identical for every thread count.
+    void setThreadCount(unsigned count) { threadCount = count; }
+    
+    // Inlining is on by default; remarks explain each decision it makes
+    void setInlining(bool enabled) { inlining = enabled; }
+    void setRemarks(bool enabled) { collectRemarks = enabled; }
+    
+    // Functions with `any` parameters are copied per argument type signature
+    // unless this is turned off
+    void setSpecialization(bool enabled) { specializing = enabled; }
+    
+    // Calls in tail position reuse the caller's frame; only benchmarks turn
+    // this off
+    void setTailCalls(bool enabled) { tailCalls = enabled; }
+    const std::vector<Remark>& getRemarks() const { return remarks; }
+    
+    // Native outputs get a DWARF line table mapping code to source lines
+    void setDebugInfo(bool enabled) { debugInfo = enabled; }
+    // What relative source names in it are relative to; the working
+    // directory when empty
+    void setCompilationDirectory(std::string directory) { compilationDirectory = std::move(directory); }
+    
+    // Every target gets IR rewritten by the Peephole rules unless this is
+    // turned off; hits are counted per rule, in Peephole::rules() order
+    void setPeephole(bool enabled) { peephole = enabled; }
+    const std::vector<size_t>& getPeepholeHits() const { return peepholeHits; }
+    // IR instructions handed to the target, after peephole rewrites
+    size_t getInstructionCount() const { return instructionCount; }
+    
+    // Native code counts every function entry and call and writes the counts
+    // to `path` once main returns
+    void setProfileGenerate(const std::string& path) { profileOutput = path; }
+    
+    // Counts from an instrumented run steer inlining, specialization and the
+    // order functions are placed in; `counts` must outlive generation
+    void setProfileUse(const Profile* counts) { profile = counts; }
+    
+    // Native code is ordered by FunctionLayout unless this is turned off,
+    // which keeps source order and puts nothing in .text.cold
+    void setFunctionLayout(bool enabled) { ordering = enabled; }
+    const FunctionLayout& getLayout() const { return layout; }
+    
+    // Every string constant of the program, filled while it is lowered
+    const StringPool& getStringPool() const { return stringPool; }
+    
+    bool generate(ProgramNode* program, const std::string& outputFile);
+    
+    // Lowers to machine code without writing anything, for the JIT
+    bool generateInMemory(ProgramNode* program, MachineModule& module);
+    bool generateBytecodeInMemory(ProgramNode* program, BytecodeModule& module);
+    
+private:
+    void lowerProgram(ProgramNode& program);
+    void lowerFunction(FunctionDecl& function, const Specialization* specialization, LoweredFunction& result);
+    void mergeFunction(LoweredFunction& result);
+    void emitInitializers(std::vector<Instruction>& instructions);
+    void optimize(std::vector<Instruction>& instructions, std::vector<size_t>& hits) const;
+    void internStrings(Expression& expr);
+    void numberSourceFiles(ProgramNode& program);
+    
+    bool checkEntryPoint();
+    
+    // Adds the liblithium_rt members the generated code needs, including
+    // those of the cold code placed after them
+    bool linkRuntime(MachineModule& module);
+    
+    bool beginOutput(const std::string& outputFile);
+    bool finishOutput(const std::string& outputFile);
+    void writeListing();
+    void generateExecutable();
+    void generateObject();
+    void generateBytecode();
+    void generateAssembly();
+};
@@ -0,0 +1,204 @@
+#include "dwarf.hpp"
+
+namespace {
+    // DWARF constants used here, from the DWARF 4 specification
+    constexpr uint8_t DW_TAG_compile_unit = 0x11;
+    constexpr uint8_t DW_TAG_subprogram = 0x2e;
+    constexpr uint8_t DW_CHILDREN_no = 0;
+    constexpr uint8_t DW_CHILDREN_yes = 1;
+    constexpr uint8_t DW_AT_name = 0x03;
+    constexpr uint8_t DW_AT_stmt_list = 0x10;
+    constexpr uint8_t DW_AT_low_pc = 0x11;
+    constexpr uint8_t DW_AT_high_pc = 0x12;
+    constexpr uint8_t DW_AT_language = 0x13;
+    constexpr uint8_t DW_AT_comp_dir = 0x1b;
+    constexpr uint8_t DW_AT_producer = 0x25;
+    constexpr uint8_t DW_AT_external = 0x3f;
+    constexpr uint8_t DW_FORM_addr = 0x01;
+    constexpr uint8_t DW_FORM_data2 = 0x05;
+    constexpr uint8_t DW_FORM_data8 = 0x07;
+    constexpr uint8_t DW_FORM_string = 0x08;
+    constexpr uint8_t DW_FORM_sec_offset = 0x17;
+    constexpr uint8_t DW_FORM_flag_present = 0x19;
+    constexpr uint16_t DW_LANG_lo_user = 0x8000; // Lithium has no assigned code
+
+    constexpr uint8_t DW_LNS_copy = 1;
+    constexpr uint8_t DW_LNS_advance_pc = 2;
+    constexpr uint8_t DW_LNS_advance_line = 3;
+    constexpr uint8_t DW_LNS_set_file = 4;
+    constexpr uint8_t DW_LNS_set_column = 5;
+    constexpr uint8_t DW_LNE_end_sequence = 1;
+    constexpr uint8_t DW_LNE_set_address = 2;
+
+    // Special opcodes cover a line step of LINE_BASE..LINE_BASE+LINE_RANGE-1
+    // together with a small address step in one byte
+    constexpr int LINE_BASE = -5;
+    constexpr int LINE_RANGE = 14;
+    constexpr uint8_t OPCODE_BASE = 13;
+    constexpr uint8_t STANDARD_OPCODE_LENGTHS[OPCODE_BASE - 1] = {0, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 1};
+
+    template <typename T>
+    void put(std::string& out, T value) {
+        for (size_t i = 0; i < sizeof(T); ++i) {
+            out.push_back(static_cast<char>(static_cast<uint64_t>(value) >> (8 * i)));
+        }
+    }
+
+    void putString(std::string& out, const std::string& value) {
+        out += value;
+        out.push_back('\0');
+    }
+
+    void putUleb(std::string& out, uint64_t value) {
+        do {
+            uint8_t byte = value & 0x7f;
+            value >>= 7;
+            out.push_back(static_cast<char>(value ? byte | 0x80 : byte));
+        } while (value);
+    }
+
+    void putSleb(std::string& out, int64_t value) {
+        for (;;) {
+            uint8_t byte = value & 0x7f;
+            value >>= 7;
+            bool done = (value == 0 && !(byte & 0x40)) || (value == -1 && (byte & 0x40));
+            out.push_back(static_cast<char>(done ? byte : byte | 0x80));
+            if (done) return;
+        }
+    }
+
+    // Length fields are written once what they cover is known
+    void patchLength(std::string& out, size_t at) {
+        auto length = static_cast<uint32_t>(out.size() - at - 4);
+        for (size_t i = 0; i < 4; ++i) {
+            out[at + i] = static_cast<char>(length >> (8 * i));
+        }
+    }
+}
+
+DebugSections DwarfWriter::build(const MachineModule& module, uint64_t textAddress, const std::string& directory) {
+    DebugSections sections;
+
+    auto& abbrev = sections.abbrev;
+    abbrev.push_back(1);
+    putUleb(abbrev, DW_TAG_compile_unit);
+    abbrev.push_back(DW_CHILDREN_yes);
+    for (uint8_t attribute : {DW_AT_producer, DW_FORM_string, DW_AT_language, DW_FORM_data2,
+                              DW_AT_name, DW_FORM_string, DW_AT_comp_dir, DW_FORM_string,
+                              DW_AT_stmt_list, DW_FORM_sec_offset, DW_AT_low_pc, DW_FORM_addr,
+                              DW_AT_high_pc, DW_FORM_data8, uint8_t(0), uint8_t(0)}) {
+        abbrev.push_back(static_cast<char>(attribute));
+    }
+    abbrev.push_back(2);
+    putUleb(abbrev, DW_TAG_subprogram);
+    abbrev.push_back(DW_CHILDREN_no);
+    for (uint8_t attribute : {DW_AT_name, DW_FORM_string, DW_AT_external, DW_FORM_flag_present,
+                              DW_AT_low_pc, DW_FORM_addr, DW_AT_high_pc, DW_FORM_data8, uint8_t(0), uint8_t(0)}) {
+        abbrev.push_back(static_cast<char>(attribute));
+    }
+    abbrev.push_back(0);
+
+    auto address = [&](std::string& out, std::vector<std::pair<uint64_t, uint64_t>>& places, uint64_t offset) {
+        places.emplace_back(out.size(), offset);
+        put<uint64_t>(out, textAddress + offset);
+    };
+
+    auto& info = sections.info;
+    put<uint32_t>(info, 0);
+    put<uint16_t>(info, 4);
+    sections.abbrevReference = info.size();
+    put<uint32_t>(info, 0);
+    info.push_back(8);
+    info.push_back(1);
+    putString(info, "lithium");
+    put<uint16_t>(info, DW_LANG_lo_user);
+    putString(info, module.sourceFiles.empty() ? std::string() : module.sourceFiles.front());
+    putString(info, directory);
+    sections.lineReference = info.size();
+    put<uint32_t>(info, 0);
+    address(info, sections.infoAddresses, 0);
+    put<uint64_t>(info, module.text.size());
+    for (const auto& symbol : module.symbols) {
+        if (symbol.section != SectionKind::TEXT || !symbol.isFunction) continue;
+        info.push_back(2);
+        putString(info, symbol.name);
+        address(info, sections.infoAddresses, symbol.offset);
+        put<uint64_t>(info, symbol.size);
+    }
+    info.push_back(0);
+    patchLength(info, 0);
+
+    auto& line = sections.line;
+    put<uint32_t>(line, 0);
+    put<uint16_t>(line, 4);
+    size_t headerLengthAt = line.size();
+    put<uint32_t>(line, 0);
+    line.push_back(1);  // minimum_instruction_length
+    line.push_back(1);  // maximum_operations_per_instruction
+    line.push_back(1);  // default_is_stmt
+    line.push_back(static_cast<char>(LINE_BASE));
+    line.push_back(LINE_RANGE);
+    line.push_back(OPCODE_BASE);
+    line.append(reinterpret_cast<const char*>(STANDARD_OPCODE_LENGTHS), sizeof(STANDARD_OPCODE_LENGTHS));
+    line.push_back(0);  // no include directories beyond the compilation directory
+    for (const auto& file : module.sourceFiles) {
+        putString(line, file);
+        putUleb(line, 0);
+        putUleb(line, 0);
+        putUleb(line, 0);
+    }
+    line.push_back(0);
+    patchLength(line, headerLengthAt);
+
+    // One sequence over all of .text; rows start at file 1, line 1, column 0
+    line.push_back(0);
+    putUleb(line, 9);
+    line.push_back(DW_LNE_set_address);
+    address(line, sections.lineAddresses, 0);
+    uint64_t offset = 0;
+    uint32_t file = 0;
+    int64_t lineNumber = 1;
+    uint32_t column = 0;
+    for (const auto& entry : module.lines) {
+        if (entry.file != file) {
+            line.push_back(DW_LNS_set_file);
+            putUleb(line, entry.file + 1);
+            file = entry.file;
+        }
+        if (entry.column != column) {
+            line.push_back(DW_LNS_set_column);
+            putUleb(line, entry.column);
+            column = entry.column;
+        }
+        uint64_t addressStep = entry.offset - offset;
+        int64_t lineStep = static_cast<int64_t>(entry.line) - lineNumber;
+        offset = entry.offset;
+        lineNumber = entry.line;
+        if (lineStep >= LINE_BASE && lineStep < LINE_BASE + LINE_RANGE) {
+            uint64_t special = static_cast<uint64_t>(lineStep - LINE_BASE) + LINE_RANGE * addressStep + OPCODE_BASE;
+            if (special <= 255) {
+                line.push_back(static_cast<char>(special));
+                continue;
+            }
+        }
+        if (addressStep) {
+            line.push_back(DW_LNS_advance_pc);
+            putUleb(line, addressStep);
+        }
+        if (lineStep) {
+            line.push_back(DW_LNS_advance_line);
+            putSleb(line, lineStep);
+        }
+        line.push_back(DW_LNS_copy);
+    }
+    if (module.text.size() > offset) {
+        line.push_back(DW_LNS_advance_pc);
+        putUleb(line, module.text.size() - offset);
+    }
+    line.push_back(0);
+    putUleb(line, 1);
+    line.push_back(DW_LNE_end_sequence);
+    patchLength(line, 0);
+
+    return sections;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "x86.hpp"
+
+// Contents of the DWARF 4 sections describing a module: one compile unit
+// with a subprogram per function, and the line table. Enough for
+// addr2line, perf report/annotate and gdb to map code back to .lh lines.
+struct DebugSections {
+    std::string abbrev;
+    std::string info;
+    std::string line;
+
+    // Places holding a .text address, with its offset from the start of
+    // .text; objects relocate them
+    std::vector<std::pair<uint64_t, uint64_t>> infoAddresses;
+    std::vector<std::pair<uint64_t, uint64_t>> lineAddresses;
+
+    // Places in .debug_info holding 32-bit offsets into other sections
+    uint64_t abbrevReference = 0;
+    uint64_t lineReference = 0;
+};
+
+class DwarfWriter {
+public:
+    // Addresses are written as `textAddress` plus the offset in .text, so an
+    // executable passes its load address and an object passes 0. Relative
+    // file names are resolved against `directory`.
+    static DebugSections build(const MachineModule& module, uint64_t textAddress, const std::string& directory);
+};
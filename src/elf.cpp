@@ -0,0 +1,518 @@
+#include "elf.hpp"
+#include "dwarf.hpp"
+#include <elf.h>
+#include <cstring>
+#include <filesystem>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+    uint64_t alignUp(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    template <typename T>
+    void append(std::string& out, const T& value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    // Offsets are relative to where the image started in the output
+    void padTo(OutputBuffer& out, uint64_t origin, uint64_t offset) {
+        if (out.size() - origin < offset) {
+            out.writeZeros(offset - (out.size() - origin));
+        }
+    }
+
+    class StringTable {
+    public:
+        std::string data = std::string(1, '\0');
+
+        uint32_t add(const std::string& name) {
+            if (name.empty()) return 0;
+            uint32_t offset = static_cast<uint32_t>(data.size());
+            data += name;
+            data.push_back('\0');
+            return offset;
+        }
+    };
+
+    // Section header indices shared by both output kinds
+    enum : uint16_t {
+        SEC_NULL,
+        SEC_TEXT,
+        SEC_RODATA,
+        SEC_DATA,
+        SEC_BSS,
+        SEC_FIRST_EXTRA
+    };
+
+    uint16_t sectionIndex(SectionKind kind) {
+        switch (kind) {
+            case SectionKind::TEXT: return SEC_TEXT;
+            case SectionKind::RODATA: return SEC_RODATA;
+            case SectionKind::DATA: return SEC_DATA;
+            case SectionKind::BSS: return SEC_BSS;
+        }
+        return SEC_NULL;
+    }
+
+    Elf64_Shdr sectionHeader(uint32_t name, uint32_t type, uint64_t flags, uint64_t addr,
+                             uint64_t offset, uint64_t size, uint64_t align,
+                             uint32_t link = 0, uint32_t info = 0, uint64_t entsize = 0) {
+        Elf64_Shdr header{};
+        header.sh_name = name;
+        header.sh_type = type;
+        header.sh_flags = flags;
+        header.sh_addr = addr;
+        header.sh_offset = offset;
+        header.sh_size = size;
+        header.sh_link = link;
+        header.sh_info = info;
+        header.sh_addralign = align;
+        header.sh_entsize = entsize;
+        return header;
+    }
+
+    Elf64_Ehdr fileHeader(uint16_t type, uint64_t entry, uint64_t phoff, uint16_t phnum,
+                          uint64_t shoff, uint16_t shnum, uint16_t shstrndx) {
+        Elf64_Ehdr header{};
+        std::memcpy(header.e_ident, ELFMAG, SELFMAG);
+        header.e_ident[EI_CLASS] = ELFCLASS64;
+        header.e_ident[EI_DATA] = ELFDATA2LSB;
+        header.e_ident[EI_VERSION] = EV_CURRENT;
+        header.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+        header.e_type = type;
+        header.e_machine = EM_X86_64;
+        header.e_version = EV_CURRENT;
+        header.e_entry = entry;
+        header.e_phoff = phoff;
+        header.e_shoff = shoff;
+        header.e_ehsize = sizeof(Elf64_Ehdr);
+        header.e_phentsize = phnum ? sizeof(Elf64_Phdr) : 0;
+        header.e_phnum = phnum;
+        header.e_shentsize = sizeof(Elf64_Shdr);
+        header.e_shnum = shnum;
+        header.e_shstrndx = shstrndx;
+        return header;
+    }
+
+    // The compilation directory recorded in debug info
+    std::string directoryOrCurrent(const std::string& directory) {
+        if (!directory.empty()) {
+            return directory;
+        }
+        std::error_code error;
+        auto current = std::filesystem::current_path(error);
+        return error ? std::string() : current.string();
+    }
+
+    // Names of the debug sections, in the order both writers place them
+    const char* const DEBUG_SECTION_NAMES[] = {".debug_abbrev", ".debug_info", ".debug_line"};
+}
+
+bool ElfWriter::writeExecutable(const MachineModule& module, OutputBuffer& out) {
+    const MachineSymbol* entry = module.findSymbol("_start");
+    if (!entry) {
+        errorReporter.reportFileError(Position(), "Executable has no _start entry point");
+        return false;
+    }
+
+    // Three PT_LOAD segments: headers + .text (r-x), .rodata (r--), .data + .bss (rw-).
+    // File offsets stay packed; each segment gets its own pages in memory by
+    // keeping vaddr congruent to the file offset modulo the page size.
+    const uint16_t phnum = 3;
+    uint64_t textOffset = alignUp(sizeof(Elf64_Ehdr) + phnum * sizeof(Elf64_Phdr), 16);
+    uint64_t textAddr = BASE_ADDRESS + textOffset;
+    uint64_t rodataOffset = alignUp(textOffset + module.text.size(), 16);
+    uint64_t rodataAddr = alignUp(textAddr + module.text.size(), PAGE_SIZE) + rodataOffset % PAGE_SIZE;
+    uint64_t dataOffset = alignUp(rodataOffset + module.rodata.size(), 16);
+    uint64_t dataAddr = alignUp(rodataAddr + module.rodata.size(), PAGE_SIZE) + dataOffset % PAGE_SIZE;
+    uint64_t bssAddr = alignUp(dataAddr + module.data.size(), 16);
+
+    auto sectionAddress = [&](SectionKind kind) {
+        switch (kind) {
+            case SectionKind::TEXT: return textAddr;
+            case SectionKind::RODATA: return rodataAddr;
+            case SectionKind::DATA: return dataAddr;
+            case SectionKind::BSS: return bssAddr;
+        }
+        return uint64_t(0);
+    };
+
+    std::unordered_map<std::string, uint64_t> addresses;
+    for (const auto& symbol : module.symbols) {
+        addresses.emplace(symbol.name, sectionAddress(symbol.section) + symbol.offset);
+    }
+
+    // Cold code is the tail of the same segment, under a section of its own
+    uint64_t coldStart = module.text.size() - module.coldBytes;
+
+    // Resolve every relocation in place; linked runtime code also has
+    // them in its data
+    std::string text = module.text;
+    std::string rodata = module.rodata;
+    std::string data = module.data;
+    for (const auto& reloc : module.relocations) {
+        auto target = addresses.find(reloc.symbol);
+        if (target == addresses.end()) {
+            errorReporter.reportSemanticError(Position(), "Undefined reference to '" + reloc.symbol + "'");
+            continue;
+        }
+        std::string& contents = reloc.section == SectionKind::RODATA ? rodata
+                              : reloc.section == SectionKind::DATA ? data : text;
+        uint64_t place = sectionAddress(reloc.section) + reloc.offset;
+        if (reloc.kind == RelocKind::ABS64) {
+            uint64_t value = target->second + reloc.addend;
+            std::memcpy(&contents[reloc.offset], &value, 8);
+        } else {
+            int64_t value = static_cast<int64_t>(target->second + reloc.addend - place);
+            int32_t value32 = static_cast<int32_t>(value);
+            std::memcpy(&contents[reloc.offset], &value32, 4);
+        }
+    }
+    if (errorReporter.hasAnyErrors()) {
+        return false;
+    }
+
+    // Symbol table: locals first, as the format requires
+    bool debugInfo = !module.lines.empty();
+    const uint16_t coldIndex = SEC_FIRST_EXTRA + 3 + (debugInfo ? 3 : 0);
+    StringTable strtab;
+    std::string symtab;
+    append(symtab, Elf64_Sym{});
+    uint32_t firstGlobal = 1;
+    for (int pass = 0; pass < 2; ++pass) {
+        for (const auto& symbol : module.symbols) {
+            if (symbol.isGlobal != (pass == 1)) continue;
+            Elf64_Sym sym{};
+            sym.st_name = strtab.add(symbol.name);
+            sym.st_info = ELF64_ST_INFO(symbol.isGlobal ? STB_GLOBAL : STB_LOCAL,
+                                        symbol.isFunction ? STT_FUNC : STT_OBJECT);
+            sym.st_shndx = sectionIndex(symbol.section);
+            if (symbol.section == SectionKind::TEXT && symbol.offset >= coldStart && module.coldBytes) {
+                sym.st_shndx = coldIndex;
+            }
+            sym.st_value = sectionAddress(symbol.section) + symbol.offset;
+            sym.st_size = symbol.size;
+            append(symtab, sym);
+            if (pass == 0) ++firstGlobal;
+        }
+    }
+
+    StringTable shstrtab;
+    uint32_t textName = shstrtab.add(".text");
+    uint32_t rodataName = shstrtab.add(".rodata");
+    uint32_t dataName = shstrtab.add(".data");
+    uint32_t bssName = shstrtab.add(".bss");
+    uint32_t symtabName = shstrtab.add(".symtab");
+    uint32_t strtabName = shstrtab.add(".strtab");
+    uint32_t shstrtabName = shstrtab.add(".shstrtab");
+
+    uint32_t coldName = module.coldBytes ? shstrtab.add(".text.cold") : 0;
+
+    // Line tables are not loaded, so they go after everything that is, with
+    // their headers after the string tables
+    DebugSections debug;
+    uint32_t debugNames[3] = {};
+    if (debugInfo) {
+        debug = DwarfWriter::build(module, textAddr, directoryOrCurrent(compilationDirectory));
+        for (int i = 0; i < 3; ++i) {
+            debugNames[i] = shstrtab.add(DEBUG_SECTION_NAMES[i]);
+        }
+    }
+    const std::string* debugContents[] = {&debug.abbrev, &debug.info, &debug.line};
+
+    uint64_t symtabOffset = alignUp(dataOffset + module.data.size(), 8);
+    uint64_t strtabOffset = symtabOffset + symtab.size();
+    uint64_t shstrtabOffset = strtabOffset + strtab.data.size();
+    uint64_t debugOffset = shstrtabOffset + shstrtab.data.size();
+    uint64_t shOffset = alignUp(debugOffset + debug.abbrev.size() + debug.info.size() + debug.line.size(), 8);
+    const uint16_t shnum = coldIndex + (module.coldBytes ? 1 : 0);
+
+    uint64_t origin = out.size();
+
+    out.writeRaw(fileHeader(ET_EXEC, addresses["_start"], sizeof(Elf64_Ehdr), phnum,
+                             shOffset, shnum, SEC_FIRST_EXTRA + 2));
+
+    Elf64_Phdr textSegment{PT_LOAD, PF_R | PF_X, 0, BASE_ADDRESS, BASE_ADDRESS,
+                           textOffset + module.text.size(), textOffset + module.text.size(), PAGE_SIZE};
+    Elf64_Phdr rodataSegment{PT_LOAD, PF_R, rodataOffset, rodataAddr, rodataAddr,
+                             module.rodata.size(), module.rodata.size(), PAGE_SIZE};
+    Elf64_Phdr dataSegment{PT_LOAD, PF_R | PF_W, dataOffset, dataAddr, dataAddr,
+                           module.data.size(), bssAddr + module.bssSize - dataAddr, PAGE_SIZE};
+    out.writeRaw(textSegment);
+    out.writeRaw(rodataSegment);
+    out.writeRaw(dataSegment);
+
+    padTo(out, origin, textOffset);
+    out.write(text);
+    padTo(out, origin, rodataOffset);
+    out.write(rodata);
+    padTo(out, origin, dataOffset);
+    out.write(data);
+    padTo(out, origin, symtabOffset);
+    out.write(symtab);
+    out.write(strtab.data);
+    out.write(shstrtab.data);
+    for (const std::string* contents : debugContents) {
+        out.write(*contents);
+    }
+    padTo(out, origin, shOffset);
+
+    out.writeRaw(Elf64_Shdr{});
+    out.writeRaw(sectionHeader(textName, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, textAddr,
+                                textOffset, coldStart, 16));
+    out.writeRaw(sectionHeader(rodataName, SHT_PROGBITS, SHF_ALLOC, rodataAddr,
+                                rodataOffset, module.rodata.size(), 16));
+    out.writeRaw(sectionHeader(dataName, SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, dataAddr,
+                                dataOffset, module.data.size(), 16));
+    out.writeRaw(sectionHeader(bssName, SHT_NOBITS, SHF_ALLOC | SHF_WRITE, bssAddr,
+                                dataOffset + (bssAddr - dataAddr), module.bssSize, 16));
+    out.writeRaw(sectionHeader(symtabName, SHT_SYMTAB, 0, 0, symtabOffset, symtab.size(), 8,
+                                SEC_FIRST_EXTRA + 1, firstGlobal, sizeof(Elf64_Sym)));
+    out.writeRaw(sectionHeader(strtabName, SHT_STRTAB, 0, 0, strtabOffset, strtab.data.size(), 1));
+    out.writeRaw(sectionHeader(shstrtabName, SHT_STRTAB, 0, 0, shstrtabOffset, shstrtab.data.size(), 1));
+    if (debugInfo) {
+        for (int i = 0; i < 3; ++i) {
+            out.writeRaw(sectionHeader(debugNames[i], SHT_PROGBITS, 0, 0, debugOffset, debugContents[i]->size(), 1));
+            debugOffset += debugContents[i]->size();
+        }
+    }
+    if (module.coldBytes) {
+        out.writeRaw(sectionHeader(coldName, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, textAddr + coldStart,
+                                    textOffset + coldStart, module.coldBytes, 1));
+    }
+
+    return true;
+}
+
+bool ElfWriter::writeObject(const MachineModule& module, OutputBuffer& out) {
+    enum : uint16_t {
+        SEC_RELA_TEXT = SEC_FIRST_EXTRA,
+        SEC_RELA_DATA,
+        SEC_INIT_ARRAY,
+        SEC_RELA_INIT,
+        SEC_NOTE_STACK,
+        SEC_SYMTAB,
+        SEC_STRTAB,
+        SEC_SHSTRTAB,
+        // Line tables, when present, follow the string tables
+        SEC_DEBUG_ABBREV,
+        SEC_DEBUG_INFO,
+        SEC_DEBUG_LINE,
+        SEC_RELA_DEBUG_INFO,
+        SEC_RELA_DEBUG_LINE,
+        SEC_DEBUG_END
+    };
+    bool debugInfo = !module.lines.empty();
+
+    StringTable strtab;
+    std::string symtab;
+    std::unordered_map<std::string, uint32_t> symbolIndex;
+    std::unordered_map<std::string, const MachineSymbol*> defined;
+    for (const auto& symbol : module.symbols) {
+        defined.emplace(symbol.name, &symbol);
+    }
+
+    auto addSymbol = [&](uint32_t name, unsigned char bind, unsigned char type,
+                         uint16_t shndx, uint64_t value, uint64_t size) {
+        Elf64_Sym sym{};
+        sym.st_name = name;
+        sym.st_info = ELF64_ST_INFO(bind, type);
+        sym.st_shndx = shndx;
+        sym.st_value = value;
+        sym.st_size = size;
+        append(symtab, sym);
+        return static_cast<uint32_t>(symtab.size() / sizeof(Elf64_Sym) - 1);
+    };
+
+    // Null symbol, then one section symbol per allocated section so local
+    // references can be expressed as section + offset
+    addSymbol(0, STB_LOCAL, STT_NOTYPE, SHN_UNDEF, 0, 0);
+    uint32_t sectionSymbols[SEC_FIRST_EXTRA] = {};
+    for (uint16_t sec = SEC_TEXT; sec < SEC_FIRST_EXTRA; ++sec) {
+        sectionSymbols[sec] = addSymbol(0, STB_LOCAL, STT_SECTION, sec, 0, 0);
+    }
+    uint32_t abbrevSymbol = debugInfo ? addSymbol(0, STB_LOCAL, STT_SECTION, SEC_DEBUG_ABBREV, 0, 0) : 0;
+    uint32_t lineSymbol = debugInfo ? addSymbol(0, STB_LOCAL, STT_SECTION, SEC_DEBUG_LINE, 0, 0) : 0;
+    for (const auto& symbol : module.symbols) {
+        if (symbol.isGlobal || symbol.name.rfind(".L", 0) == 0) continue;
+        symbolIndex[symbol.name] = addSymbol(strtab.add(symbol.name), STB_LOCAL,
+                                             symbol.isFunction ? STT_FUNC : STT_OBJECT,
+                                             sectionIndex(symbol.section), symbol.offset, symbol.size);
+    }
+    uint32_t firstGlobal = static_cast<uint32_t>(symtab.size() / sizeof(Elf64_Sym));
+    for (const auto& symbol : module.symbols) {
+        if (!symbol.isGlobal) continue;
+        symbolIndex[symbol.name] = addSymbol(strtab.add(symbol.name), STB_GLOBAL,
+                                             symbol.isFunction ? STT_FUNC : STT_OBJECT,
+                                             sectionIndex(symbol.section), symbol.offset, symbol.size);
+    }
+
+    auto encodeRelocations = [&](const std::vector<Relocation>& relocations) {
+        std::string rela;
+        for (const auto& reloc : relocations) {
+            Elf64_Rela entry{};
+            entry.r_offset = reloc.offset;
+            entry.r_addend = reloc.addend;
+            uint32_t sym;
+            auto local = defined.find(reloc.symbol);
+            if (local != defined.end() && !local->second->isGlobal) {
+                sym = sectionSymbols[sectionIndex(local->second->section)];
+                entry.r_addend += static_cast<int64_t>(local->second->offset);
+            } else {
+                auto it = symbolIndex.find(reloc.symbol);
+                if (it == symbolIndex.end()) {
+                    it = symbolIndex.emplace(reloc.symbol, addSymbol(strtab.add(reloc.symbol), STB_GLOBAL,
+                                                                     STT_NOTYPE, SHN_UNDEF, 0, 0)).first;
+                }
+                sym = it->second;
+            }
+            uint32_t type = reloc.kind == RelocKind::PC32 ? R_X86_64_PC32
+                          : reloc.kind == RelocKind::PLT32 ? R_X86_64_PLT32 : R_X86_64_64;
+            entry.r_info = ELF64_R_INFO(sym, type);
+            append(rela, entry);
+        }
+        return rela;
+    };
+
+    std::vector<Relocation> textRelocations;
+    std::vector<Relocation> dataRelocations;
+    for (const auto& reloc : module.relocations) {
+        (reloc.section == SectionKind::DATA ? dataRelocations : textRelocations).push_back(reloc);
+    }
+    std::string relaText = encodeRelocations(textRelocations);
+    std::string relaData = encodeRelocations(dataRelocations);
+
+    // Global initializers run through .init_array when linked with a C runtime
+    std::string initArray(module.initFunctions.size() * 8, '\0');
+    std::vector<Relocation> initRelocations;
+    for (size_t i = 0; i < module.initFunctions.size(); ++i) {
+        initRelocations.push_back({SectionKind::DATA, i * 8, RelocKind::ABS64, module.initFunctions[i], 0});
+    }
+    std::string relaInit = encodeRelocations(initRelocations);
+
+    // Debug sections refer to .text and to each other; the linker fixes
+    // both up as it merges them with those of other objects
+    DebugSections debug;
+    std::string relaDebugInfo;
+    std::string relaDebugLine;
+    if (debugInfo) {
+        debug = DwarfWriter::build(module, 0, directoryOrCurrent(compilationDirectory));
+        auto relocate = [](std::string& rela, uint64_t offset, uint32_t sym, uint32_t type, uint64_t addend) {
+            Elf64_Rela entry{};
+            entry.r_offset = offset;
+            entry.r_info = ELF64_R_INFO(sym, type);
+            entry.r_addend = static_cast<int64_t>(addend);
+            append(rela, entry);
+        };
+        relocate(relaDebugInfo, debug.abbrevReference, abbrevSymbol, R_X86_64_32, 0);
+        relocate(relaDebugInfo, debug.lineReference, lineSymbol, R_X86_64_32, 0);
+        for (const auto& [place, offset] : debug.infoAddresses) {
+            relocate(relaDebugInfo, place, sectionSymbols[SEC_TEXT], R_X86_64_64, offset);
+        }
+        for (const auto& [place, offset] : debug.lineAddresses) {
+            relocate(relaDebugLine, place, sectionSymbols[SEC_TEXT], R_X86_64_64, offset);
+        }
+    }
+
+    StringTable shstrtab;
+    uint32_t textName = shstrtab.add(".text");
+    uint32_t rodataName = shstrtab.add(".rodata");
+    uint32_t dataName = shstrtab.add(".data");
+    uint32_t bssName = shstrtab.add(".bss");
+    uint32_t relaTextName = shstrtab.add(".rela.text");
+    uint32_t relaDataName = shstrtab.add(".rela.data");
+    uint32_t initArrayName = shstrtab.add(".init_array");
+    uint32_t relaInitName = shstrtab.add(".rela.init_array");
+    uint32_t noteStackName = shstrtab.add(".note.GNU-stack");
+    uint32_t symtabName = shstrtab.add(".symtab");
+    uint32_t strtabName = shstrtab.add(".strtab");
+    uint32_t shstrtabName = shstrtab.add(".shstrtab");
+    uint32_t debugNames[3] = {};
+    uint32_t relaDebugInfoName = 0;
+    uint32_t relaDebugLineName = 0;
+    if (debugInfo) {
+        for (int i = 0; i < 3; ++i) {
+            debugNames[i] = shstrtab.add(DEBUG_SECTION_NAMES[i]);
+        }
+        relaDebugInfoName = shstrtab.add(".rela.debug_info");
+        relaDebugLineName = shstrtab.add(".rela.debug_line");
+    }
+
+    uint64_t textOffset = sizeof(Elf64_Ehdr);
+    uint64_t rodataOffset = alignUp(textOffset + module.text.size(), 16);
+    uint64_t dataOffset = alignUp(rodataOffset + module.rodata.size(), 16);
+    uint64_t relaTextOffset = alignUp(dataOffset + module.data.size(), 8);
+    uint64_t relaDataOffset = relaTextOffset + relaText.size();
+    uint64_t initArrayOffset = relaDataOffset + relaData.size();
+    uint64_t relaInitOffset = initArrayOffset + initArray.size();
+    uint64_t symtabOffset = relaInitOffset + relaInit.size();
+    uint64_t strtabOffset = symtabOffset + symtab.size();
+    uint64_t shstrtabOffset = strtabOffset + strtab.data.size();
+    uint64_t debugAbbrevOffset = shstrtabOffset + shstrtab.data.size();
+    uint64_t debugInfoOffset = debugAbbrevOffset + debug.abbrev.size();
+    uint64_t debugLineOffset = debugInfoOffset + debug.info.size();
+    uint64_t relaDebugInfoOffset = alignUp(debugLineOffset + debug.line.size(), 8);
+    uint64_t relaDebugLineOffset = relaDebugInfoOffset + relaDebugInfo.size();
+    uint64_t shOffset = alignUp(relaDebugLineOffset + relaDebugLine.size(), 8);
+
+    uint64_t origin = out.size();
+    out.writeRaw(fileHeader(ET_REL, 0, 0, 0, shOffset, debugInfo ? SEC_DEBUG_END : SEC_DEBUG_ABBREV, SEC_SHSTRTAB));
+
+    out.write(module.text);
+    padTo(out, origin, rodataOffset);
+    out.write(module.rodata);
+    padTo(out, origin, dataOffset);
+    out.write(module.data);
+    padTo(out, origin, relaTextOffset);
+    out.write(relaText);
+    out.write(relaData);
+    out.write(initArray);
+    out.write(relaInit);
+    out.write(symtab);
+    out.write(strtab.data);
+    out.write(shstrtab.data);
+    out.write(debug.abbrev);
+    out.write(debug.info);
+    out.write(debug.line);
+    padTo(out, origin, relaDebugInfoOffset);
+    out.write(relaDebugInfo);
+    out.write(relaDebugLine);
+    padTo(out, origin, shOffset);
+
+    out.writeRaw(Elf64_Shdr{});
+    out.writeRaw(sectionHeader(textName, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 0,
+                                textOffset, module.text.size(), 16));
+    out.writeRaw(sectionHeader(rodataName, SHT_PROGBITS, SHF_ALLOC, 0,
+                                rodataOffset, module.rodata.size(), 16));
+    out.writeRaw(sectionHeader(dataName, SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, 0,
+                                dataOffset, module.data.size(), 16));
+    out.writeRaw(sectionHeader(bssName, SHT_NOBITS, SHF_ALLOC | SHF_WRITE, 0,
+                                relaTextOffset, module.bssSize, 8));
+    out.writeRaw(sectionHeader(relaTextName, SHT_RELA, SHF_INFO_LINK, 0, relaTextOffset,
+                                relaText.size(), 8, SEC_SYMTAB, SEC_TEXT, sizeof(Elf64_Rela)));
+    out.writeRaw(sectionHeader(relaDataName, SHT_RELA, SHF_INFO_LINK, 0, relaDataOffset,
+                                relaData.size(), 8, SEC_SYMTAB, SEC_DATA, sizeof(Elf64_Rela)));
+    out.writeRaw(sectionHeader(initArrayName, SHT_INIT_ARRAY, SHF_ALLOC | SHF_WRITE, 0,
+                                initArrayOffset, initArray.size(), 8, 0, 0, 8));
+    out.writeRaw(sectionHeader(relaInitName, SHT_RELA, SHF_INFO_LINK, 0, relaInitOffset,
+                                relaInit.size(), 8, SEC_SYMTAB, SEC_INIT_ARRAY, sizeof(Elf64_Rela)));
+    // Empty marker so linkers do not assume an executable stack
+    out.writeRaw(sectionHeader(noteStackName, SHT_PROGBITS, 0, 0, symtabOffset, 0, 1));
+    out.writeRaw(sectionHeader(symtabName, SHT_SYMTAB, 0, 0, symtabOffset, symtab.size(), 8,
+                                SEC_STRTAB, firstGlobal, sizeof(Elf64_Sym)));
+    out.writeRaw(sectionHeader(strtabName, SHT_STRTAB, 0, 0, strtabOffset, strtab.data.size(), 1));
+    out.writeRaw(sectionHeader(shstrtabName, SHT_STRTAB, 0, 0, shstrtabOffset, shstrtab.data.size(), 1));
+    if (debugInfo) {
+        out.writeRaw(sectionHeader(debugNames[0], SHT_PROGBITS, 0, 0, debugAbbrevOffset, debug.abbrev.size(), 1));
+        out.writeRaw(sectionHeader(debugNames[1], SHT_PROGBITS, 0, 0, debugInfoOffset, debug.info.size(), 1));
+        out.writeRaw(sectionHeader(debugNames[2], SHT_PROGBITS, 0, 0, debugLineOffset, debug.line.size(), 1));
+        out.writeRaw(sectionHeader(relaDebugInfoName, SHT_RELA, SHF_INFO_LINK, 0, relaDebugInfoOffset,
+                                    relaDebugInfo.size(), 8, SEC_SYMTAB, SEC_DEBUG_INFO, sizeof(Elf64_Rela)));
+        out.writeRaw(sectionHeader(relaDebugLineName, SHT_RELA, SHF_INFO_LINK, 0, relaDebugLineOffset,
+                                    relaDebugLine.size(), 8, SEC_SYMTAB, SEC_DEBUG_LINE, sizeof(Elf64_Rela)));
+    }
+
+    return true;
+}
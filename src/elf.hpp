@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "x86.hpp"
+#include "emitter.hpp"
+#include "error.hpp"
+
+// Serializes a MachineModule as an ELF64 x86-64 image. Section contents are
+// streamed into the output buffer; only headers and tables are built here.
+class ElfWriter {
+private:
+    ErrorReporter& errorReporter;
+    std::string compilationDirectory;
+
+public:
+    static constexpr uint64_t BASE_ADDRESS = 0x400000;
+    static constexpr uint64_t PAGE_SIZE = 0x1000;
+
+    explicit ElfWriter(ErrorReporter& reporter) : errorReporter(reporter) {}
+
+    // Relative source names in the line table are resolved against this;
+    // the working directory when empty
+    void setCompilationDirectory(std::string directory) { compilationDirectory = std::move(directory); }
+
+    // Static executable with every relocation resolved; entry is _start
+    bool writeExecutable(const MachineModule& module, OutputBuffer& out);
+
+    // Relocatable object for linking with an external toolchain
+    bool writeObject(const MachineModule& module, OutputBuffer& out);
+};
@@ -0,0 +1,112 @@
+#include "emitter.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+OutputBuffer::OutputBuffer() : buffer(new char[CAPACITY]), used(0), flushed(0), fd(-1), errorNumber(0) {}
+
+OutputBuffer::~OutputBuffer() {
+    close();
+}
+
+bool OutputBuffer::open(const std::string& outputPath) {
+    close();
+    path = outputPath;
+    used = 0;
+    flushed = 0;
+    errorNumber = 0;
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        errorNumber = errno;
+        return false;
+    }
+    return true;
+}
+
+bool OutputBuffer::close() {
+    if (fd < 0) {
+        return !failed();
+    }
+    flush();
+    if (::close(fd) != 0 && !failed()) {
+        errorNumber = errno;
+    }
+    fd = -1;
+    return !failed();
+}
+
+void OutputBuffer::discard() {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    used = 0;
+    if (!path.empty()) {
+        ::unlink(path.c_str());
+    }
+}
+
+void OutputBuffer::write(const char* data, size_t length) {
+    if (length > CAPACITY - used) {
+        flush();
+        // Large blocks bypass the buffer
+        if (length >= CAPACITY) {
+            writeAll(data, length);
+            return;
+        }
+    }
+    std::memcpy(buffer.get() + used, data, length);
+    used += length;
+}
+
+void OutputBuffer::writeInt(int64_t value) {
+    if (CAPACITY - used < 24) {
+        flush();
+    }
+    auto result = std::to_chars(buffer.get() + used, buffer.get() + CAPACITY, value);
+    used = static_cast<size_t>(result.ptr - buffer.get());
+}
+
+void OutputBuffer::writeZeros(size_t count) {
+    while (count > 0) {
+        if (used == CAPACITY) {
+            flush();
+        }
+        size_t chunk = std::min(count, CAPACITY - used);
+        std::memset(buffer.get() + used, 0, chunk);
+        used += chunk;
+        count -= chunk;
+    }
+}
+
+bool OutputBuffer::flush() {
+    writeAll(buffer.get(), used);
+    used = 0;
+    return !failed();
+}
+
+// After a failure further output is dropped; callers check failed() once at the end
+void OutputBuffer::writeAll(const char* data, size_t length) {
+    while (length > 0 && !failed()) {
+        if (fd < 0) {
+            errorNumber = EBADF;
+            break;
+        }
+        ssize_t written = ::write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            errorNumber = errno;
+            break;
+        }
+        data += written;
+        length -= static_cast<size_t>(written);
+        flushed += static_cast<uint64_t>(written);
+    }
+}
+
+std::string OutputBuffer::errorMessage() const {
+    return path + ": " + std::strerror(errorNumber);
+}
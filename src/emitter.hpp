@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Buffered writer for compiler output. Text and binary data are formatted
+// straight into one fixed buffer that is handed to write(2) whenever it
+// fills, so memory use does not grow with the size of the output.
+class OutputBuffer {
+private:
+    static constexpr size_t CAPACITY = 1 << 20;
+
+    std::unique_ptr<char[]> buffer;
+    size_t used;
+    uint64_t flushed;
+    int fd;
+    int errorNumber;
+    std::string path;
+
+public:
+    OutputBuffer();
+    ~OutputBuffer();
+
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    bool open(const std::string& outputPath);
+    bool close();
+
+    // Closes and deletes a partially written file
+    void discard();
+
+    void write(const char* data, size_t length);
+    void write(std::string_view text) { write(text.data(), text.size()); }
+    void writeInt(int64_t value);
+    void writeZeros(size_t count);
+
+    void put(char c) {
+        if (used == CAPACITY) {
+            flush();
+        }
+        buffer[used++] = c;
+    }
+
+    template <typename T>
+    void writeRaw(const T& value) {
+        write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    bool flush();
+
+    // Bytes accepted so far, flushed or not
+    uint64_t size() const { return flushed + used; }
+    bool failed() const { return errorNumber != 0; }
+    std::string errorMessage() const;
+
+private:
+    void writeAll(const char* data, size_t length);
+};
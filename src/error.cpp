@@ -1,9 +1,70 @@
 #include "error.hpp"
+#include <algorithm>
+#include <charconv>
 #include <iostream>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+
+namespace {
+    std::atomic<uint64_t> nextReporterId{1};
+
+    // The buffer this thread last reported into, and whose it is
+    struct CachedBuffer {
+        uint64_t reporter = 0;
+        void* buffer = nullptr;
+    };
+    thread_local CachedBuffer cachedBuffer;
+
+    void appendNumber(std::string& out, int value) {
+        char digits[16];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        out.append(digits, result.ptr);
+    }
+
+    bool isError(ErrorSeverity severity) {
+        return severity != ErrorSeverity::WARNING;
+    }
+
+    // Position first, then everything else, so equal positions still come
+    // out in the same order however the threads ran
+    bool positionLess(const Error& a, const Error& b) {
+        bool aUnplaced = a.position.filename.empty();
+        bool bUnplaced = b.position.filename.empty();
+        return std::tie(aUnplaced, a.position.filename, a.position.line, a.position.column, a.severity, a.category,
+                        a.message, a.context) <
+               std::tie(bUnplaced, b.position.filename, b.position.line, b.position.column, b.severity, b.category,
+                        b.message, b.context);
+    }
+}
 
 std::string Error::toString() const {
-    return position.filename + ":" + std::to_string(position.line) + ":" + 
-           std::to_string(position.column) + ": " + getSeverityString() + ": " + message;
+    std::string text;
+    appendTo(text);
+    text.resize(text.find('\n'));
+    return text;
+}
+
+void Error::appendTo(std::string& out) const {
+    out += position.filename;
+    out += ':';
+    appendNumber(out, position.line);
+    out += ':';
+    appendNumber(out, position.column);
+    out += severity == ErrorSeverity::WARNING ? ": warning: " : severity == ErrorSeverity::ERROR ? ": error: "
+                                                                                              : ": fatal error: ";
+    out += message;
+    out += '\n';
+    if (!context.empty()) {
+        out += "  ";
+        out += context;
+        out += '\n';
+    }
+}
+
+std::string Remark::toString() const {
+    return position.filename + ":" + std::to_string(position.line) + ":" +
+           std::to_string(position.column) + ": remark: " + message + " [" + pass + "]";
 }
 
 std::string Error::getSeverityString() const {
@@ -26,51 +87,254 @@ std::string Error::getCategoryString() const {
     }
 }
 
-void ErrorReporter::reportError(ErrorSeverity severity, ErrorCategory category, 
-                               const Position& position, const std::string& message,
-                               const std::string& context) {
-    errors.emplace_back(severity, category, position, message, context);
-    hasErrors = true;
-    if (severity == ErrorSeverity::FATAL) {
-        hasFatalErrors = true;
+ErrorReporter::ErrorReporter()
+    : buffers(nullptr), diagnosticCount(0), errorCount(0), hasFatalErrors(false), errorLimit(0),
+      id(nextReporterId.fetch_add(1, std::memory_order_relaxed)) {}
+
+ErrorReporter::~ErrorReporter() {
+    releaseBuffers();
+}
+
+// Threads that cached the old reporter's id find their buffers again by
+// walking the list
+ErrorReporter::ErrorReporter(ErrorReporter&& other) noexcept
+    : buffers(other.buffers.exchange(nullptr)), diagnosticCount(other.diagnosticCount.exchange(0)),
+      errorCount(other.errorCount.exchange(0)), hasFatalErrors(other.hasFatalErrors.exchange(false)), errorLimit(other.errorLimit),
+      id(nextReporterId.fetch_add(1, std::memory_order_relaxed)), merged(std::move(other.merged)) {
+    other.id = nextReporterId.fetch_add(1, std::memory_order_relaxed);
+}
+
+ErrorReporter::Buffer& ErrorReporter::localBuffer() {
+    if (cachedBuffer.reporter == id) {
+        return *static_cast<Buffer*>(cachedBuffer.buffer);
+    }
+    auto thread = std::this_thread::get_id();
+    Buffer* head = buffers.load(std::memory_order_acquire);
+    Buffer* found = nullptr;
+    for (Buffer* buffer = head; buffer && !found; buffer = buffer->next) {
+        if (buffer->thread == thread) {
+            found = buffer;
+        }
+    }
+    if (!found) {
+        found = new Buffer{thread, {}, 0, head};
+        while (!buffers.compare_exchange_weak(found->next, found, std::memory_order_release,
+                                              std::memory_order_acquire)) {
+        }
+    }
+    cachedBuffer.reporter = id;
+    cachedBuffer.buffer = found;
+    return *found;
+}
+
+// Errors past the limit are kept until printing, since one reported later
+// may still come earlier in the file; trimming each buffer now and then
+// bounds how many that is
+void ErrorReporter::append(Error error) {
+    Buffer& buffer = localBuffer();
+    bool counted = isError(error.severity);
+    if (counted) {
+        errorCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (error.severity == ErrorSeverity::FATAL) {
+        hasFatalErrors.store(true, std::memory_order_relaxed);
+    }
+    buffer.errors.push_back(std::move(error));
+    diagnosticCount.fetch_add(1, std::memory_order_release);
+    if (counted && ++buffer.errorCount >= 2 * errorLimit && errorLimit != 0) {
+        trim(buffer);
+    }
+}
+
+// Keeps the first `errorLimit` errors in the buffer by position, and every
+// warning. The rest are past the limit however the buffers merge, because
+// this buffer alone has that many before them.
+void ErrorReporter::trim(Buffer& buffer) const {
+    std::sort(buffer.errors.begin(), buffer.errors.end(), positionLess);
+    size_t kept = 0;
+    size_t errors = 0;
+    for (size_t i = 0; i < buffer.errors.size(); ++i) {
+        bool counted = isError(buffer.errors[i].severity);
+        if (counted && errors == errorLimit) {
+            continue;
+        }
+        errors += counted;
+        if (kept != i) {
+            buffer.errors[kept] = std::move(buffer.errors[i]);
+        }
+        ++kept;
     }
+    buffer.errors.erase(buffer.errors.begin() + static_cast<std::ptrdiff_t>(kept), buffer.errors.end());
+    buffer.errorCount = errors;
 }
 
-void ErrorReporter::reportLexicalError(const Position& position, const std::string& message) {
-    reportError(ErrorSeverity::ERROR, ErrorCategory::LEXICAL, position, message);
+void ErrorReporter::reportError(ErrorSeverity severity, ErrorCategory category,
+                               const Position& position, std::string message,
+                               std::string context) {
+    append(Error(severity, category, position, std::move(message), std::move(context)));
 }
 
-void ErrorReporter::reportSyntaxError(const Position& position, const std::string& message) {
-    reportError(ErrorSeverity::ERROR, ErrorCategory::SYNTAX, position, message);
+void ErrorReporter::reportLexicalError(const Position& position, std::string message) {
+    reportError(ErrorSeverity::ERROR, ErrorCategory::LEXICAL, position, std::move(message));
 }
 
-void ErrorReporter::reportSemanticError(const Position& position, const std::string& message) {
-    reportError(ErrorSeverity::ERROR, ErrorCategory::SEMANTIC, position, message);
+void ErrorReporter::reportSyntaxError(const Position& position, std::string message) {
+    reportError(ErrorSeverity::ERROR, ErrorCategory::SYNTAX, position, std::move(message));
 }
 
-void ErrorReporter::reportTypeError(const Position& position, const std::string& message) {
-    reportError(ErrorSeverity::ERROR, ErrorCategory::TYPE, position, message);
+void ErrorReporter::reportSemanticError(const Position& position, std::string message) {
+    reportError(ErrorSeverity::ERROR, ErrorCategory::SEMANTIC, position, std::move(message));
 }
 
-void ErrorReporter::reportFileError(const Position& position, const std::string& message) {
-    reportError(ErrorSeverity::ERROR, ErrorCategory::FILE_IO, position, message);
+void ErrorReporter::reportTypeError(const Position& position, std::string message) {
+    reportError(ErrorSeverity::ERROR, ErrorCategory::TYPE, position, std::move(message));
+}
+
+void ErrorReporter::reportFileError(const Position& position, std::string message) {
+    reportError(ErrorSeverity::ERROR, ErrorCategory::FILE_IO, position, std::move(message));
+}
+
+// Sorts small keys rather than the errors themselves: files are ranked once,
+// so most comparisons never touch an Error
+std::vector<const Error*> ErrorReporter::sortedErrors() const {
+    struct Key {
+        uint32_t file;
+        int line;
+        int column;
+        const Error* error;
+    };
+    std::vector<Key> keys;
+    keys.reserve(diagnosticCount.load(std::memory_order_acquire));
+    std::unordered_map<std::string_view, uint32_t> files;
+    for (Buffer* buffer = buffers.load(std::memory_order_acquire); buffer; buffer = buffer->next) {
+        const std::string* previous = nullptr;
+        for (const auto& error : buffer->errors) {
+            // Runs of errors in one file are the usual case
+            if (!previous || *previous != error.position.filename) {
+                files.emplace(error.position.filename, 0);
+                previous = &error.position.filename;
+            }
+            keys.push_back({0, error.position.line, error.position.column, &error});
+        }
+    }
+    std::vector<std::string_view> names;
+    for (const auto& entry : files) {
+        names.push_back(entry.first);
+    }
+    // Diagnostics without a file go last
+    std::sort(names.begin(), names.end(), [](std::string_view a, std::string_view b) {
+        return std::make_pair(a.empty(), a) < std::make_pair(b.empty(), b);
+    });
+    for (size_t i = 0; i < names.size(); ++i) {
+        files[names[i]] = static_cast<uint32_t>(i);
+    }
+    const std::string* previous = nullptr;
+    uint32_t rank = 0;
+    for (auto& key : keys) {
+        if (!previous || *previous != key.error->position.filename) {
+            previous = &key.error->position.filename;
+            rank = files[*previous];
+        }
+        key.file = rank;
+    }
+    auto less = [](const Key& a, const Key& b) {
+        if (a.file != b.file || a.line != b.line || a.column != b.column) {
+            return std::tie(a.file, a.line, a.column) < std::tie(b.file, b.line, b.column);
+        }
+        return positionLess(*a.error, *b.error);
+    };
+    // Errors from one thread usually arrive in order already
+    if (!std::is_sorted(keys.begin(), keys.end(), less)) {
+        std::sort(keys.begin(), keys.end(), less);
+    }
+    std::vector<const Error*> sorted;
+    sorted.reserve(keys.size());
+    size_t errors = 0;
+    for (const auto& key : keys) {
+        if (errorLimit != 0 && isError(key.error->severity) && errors++ >= errorLimit) {
+            continue;
+        }
+        sorted.push_back(key.error);
+    }
+    return sorted;
+}
+
+const std::vector<Error>& ErrorReporter::getErrors() const {
+    merged.clear();
+    for (const Error* error : sortedErrors()) {
+        merged.push_back(*error);
+    }
+    return merged;
+}
+
+void ErrorReporter::merge(const ErrorReporter& other) {
+    size_t appended = 0;
+    for (Buffer* buffer = other.buffers.load(std::memory_order_acquire); buffer; buffer = buffer->next) {
+        for (const auto& error : buffer->errors) {
+            appended += isError(error.severity);
+            append(error);
+        }
+    }
+    // Errors the other reporter trimmed still count against the limit
+    size_t reported = other.errorCount.load(std::memory_order_relaxed);
+    if (reported > appended) {
+        errorCount.fetch_add(reported - appended, std::memory_order_relaxed);
+    }
+    if (other.hasFatalError()) {
+        hasFatalErrors.store(true, std::memory_order_relaxed);
+    }
+}
+
+void ErrorReporter::releaseBuffers() {
+    Buffer* buffer = buffers.exchange(nullptr);
+    while (buffer) {
+        Buffer* next = buffer->next;
+        delete buffer;
+        buffer = next;
+    }
 }
 
 void ErrorReporter::clearErrors() {
-    errors.clear();
-    hasErrors = false;
+    releaseBuffers();
+    merged.clear();
+    diagnosticCount = 0;
+    errorCount = 0;
     hasFatalErrors = false;
+    // Caches pointing at the freed buffers must miss
+    id = nextReporterId.fetch_add(1, std::memory_order_relaxed);
 }
 
 void ErrorReporter::printErrors() const {
-    for (const auto& error : errors) {
-        printError(error);
-    }
+    printErrors(std::cerr);
 }
 
 void ErrorReporter::printError(const Error& error) const {
-    std::cerr << error.toString() << std::endl;
-    if (!error.context.empty()) {
-        std::cerr << "  " << error.context << std::endl;
+    printError(error, std::cerr);
+}
+
+void ErrorReporter::printErrors(std::ostream& out) const {
+    auto errors = sortedErrors();
+    std::string text;
+    size_t estimate = 0;
+    for (const Error* error : errors) {
+        estimate += error->position.filename.size() + error->message.size() + error->context.size() + 40;
+    }
+    text.reserve(estimate);
+    for (const Error* error : errors) {
+        error->appendTo(text);
+    }
+    if (limitReached()) {
+        text += "fatal error: too many errors, stopped after ";
+        appendNumber(text, static_cast<int>(errorLimit));
+        text += "\n";
     }
-}
\ No newline at end of file
+    out.write(text.data(), static_cast<std::streamsize>(text.size()));
+    out.flush();
+}
+
+void ErrorReporter::printError(const Error& error, std::ostream& out) const {
+    std::string text;
+    error.appendTo(text);
+    out.write(text.data(), static_cast<std::streamsize>(text.size()));
+    out.flush();
+}
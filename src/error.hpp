@@ -1,6 +1,10 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
 #include <string>
+#include <thread>
 #include <vector>
 #include "ast.hpp"
 
@@ -28,39 +32,113 @@ public:
     
     Error(ErrorSeverity sev, ErrorCategory cat, Position pos, 
           std::string msg, std::string ctx = "")
-        : severity(sev), category(cat), position(pos), 
+        : severity(sev), category(cat), position(std::move(pos)), 
           message(std::move(msg)), context(std::move(ctx)) {}
     
     std::string toString() const;
+    // Appends toString() and the context line, each ending in a newline
+    void appendTo(std::string& out) const;
     std::string getSeverityString() const;
     std::string getCategoryString() const;
 };
 
+// Explains an optimization decision; never affects whether compilation
+// succeeds
+class Remark {
+public:
+    Position position;
+    std::string pass;
+    std::string message;
+    
+    Remark(Position pos, std::string passName, std::string msg)
+        : position(std::move(pos)), pass(std::move(passName)), message(std::move(msg)) {}
+    
+    std::string toString() const;
+};
+
+// Collects diagnostics from any number of threads without locking: each
+// thread appends to a buffer of its own, found through a list that threads
+// only ever prepend to. The buffers are merged and sorted by source
+// position when the diagnostics are read, so the output does not depend on
+// which thread reported first. Reading, clearing and destroying must not
+// overlap with reporting.
+//
+// With an error limit of N, only the first N errors by position are kept,
+// whichever thread reported them, and limitReached() tells long-running work
+// to stop early. Message text is built by the caller when reporting; only
+// the location and severity are formatted when printing.
 class ErrorReporter {
 private:
-    std::vector<Error> errors;
-    bool hasErrors;
-    bool hasFatalErrors;
+    struct Buffer {
+        std::thread::id thread;
+        std::vector<Error> errors;
+        size_t errorCount; // entries in `errors` that are not warnings
+        Buffer* next;
+    };
+    
+    std::atomic<Buffer*> buffers;
+    std::atomic<size_t> diagnosticCount;
+    // Errors and fatal errors reported, not warnings, including those past
+    // the limit
+    std::atomic<size_t> errorCount;
+    std::atomic<bool> hasFatalErrors;
+    size_t errorLimit;
+    // Tells reporters apart in each thread's buffer cache, even when one
+    // reuses the address of another
+    uint64_t id;
+    mutable std::vector<Error> merged;
+    
+    Buffer& localBuffer();
+    std::vector<const Error*> sortedErrors() const;
+    void append(Error error);
+    void trim(Buffer& buffer) const;
+    void releaseBuffers();
     
 public:
-    ErrorReporter() : hasErrors(false), hasFatalErrors(false) {}
+    ErrorReporter();
+    ~ErrorReporter();
+    ErrorReporter(ErrorReporter&& other) noexcept;
+    ErrorReporter& operator=(ErrorReporter&&) = delete;
+    ErrorReporter(const ErrorReporter&) = delete;
+    ErrorReporter& operator=(const ErrorReporter&) = delete;
     
     void reportError(ErrorSeverity severity, ErrorCategory category, 
-                    const Position& position, const std::string& message,
-                    const std::string& context = "");
+                    const Position& position, std::string message,
+                    std::string context = "");
     
-    void reportLexicalError(const Position& position, const std::string& message);
-    void reportSyntaxError(const Position& position, const std::string& message);
-    void reportSemanticError(const Position& position, const std::string& message);
-    void reportTypeError(const Position& position, const std::string& message);
-    void reportFileError(const Position& position, const std::string& message);
+    void reportLexicalError(const Position& position, std::string message);
+    void reportSyntaxError(const Position& position, std::string message);
+    void reportSemanticError(const Position& position, std::string message);
+    void reportTypeError(const Position& position, std::string message);
+    void reportFileError(const Position& position, std::string message);
     
-    bool hasAnyErrors() const { return hasErrors; }
-    bool hasFatalError() const { return hasFatalErrors; }
+    bool hasAnyErrors() const { return diagnosticCount.load(std::memory_order_relaxed) != 0; }
+    bool hasFatalError() const { return hasFatalErrors.load(std::memory_order_relaxed); }
     
-    const std::vector<Error>& getErrors() const { return errors; }
+    // Errors past the first `limit` by position are dropped; 0 keeps them
+    // all
+    void setErrorLimit(size_t limit) { errorLimit = limit; }
+    size_t getErrorLimit() const { return errorLimit; }
+    bool limitReached() const {
+        return errorLimit != 0 && errorCount.load(std::memory_order_relaxed) >= errorLimit;
+    }
+    size_t getDroppedCount() const {
+        size_t count = errorCount.load(std::memory_order_relaxed);
+        return errorLimit != 0 && count > errorLimit ? count - errorLimit : 0;
+    }
+    
+    // Every thread's diagnostics, sorted by position; diagnostics without a
+    // file come last
+    const std::vector<Error>& getErrors() const;
     void clearErrors();
     
+    // Adds another reporter's diagnostics, counting them against the limit
+    void merge(const ErrorReporter& other);
+    
+    // Formats everything into one buffer and writes it at once
     void printErrors() const;
     void printError(const Error& error) const;
-};
\ No newline at end of file
+    // Same, to `out` instead of stderr
+    void printErrors(std::ostream& out) const;
+    void printError(const Error& error, std::ostream& out) const;
+};
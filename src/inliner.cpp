@@ -0,0 +1,118 @@
+#include "inliner.hpp"
+#include <algorithm>
+#include <tuple>
+
+void Inliner::run(const CallGraph& graph, std::unordered_set<const FunctionCall*>& inlineSites) {
+    const auto& functions = graph.getFunctions();
+    std::unordered_map<const FunctionDecl*, size_t> sourceIndex;
+    for (size_t i = 0; i < functions.size(); ++i) {
+        sourceIndex.emplace(functions[i], i);
+    }
+
+    auto components = graph.bottomUpComponents();
+    std::unordered_map<const FunctionDecl*, size_t> componentOf;
+    for (size_t i = 0; i < components.size(); ++i) {
+        for (auto* function : components[i]) {
+            componentOf.emplace(function, i);
+        }
+    }
+
+    // Expanding a recursive function only peels one level off the cycle
+    std::unordered_set<const FunctionDecl*> recursive;
+    for (const auto& component : components) {
+        for (auto* function : component) {
+            for (const auto& site : graph.getCallSites(function)) {
+                if (site.callee && componentOf[site.callee] == componentOf[function]) {
+                    recursive.insert(component.begin(), component.end());
+                }
+            }
+        }
+    }
+
+    // Remarks are produced bottom-up but reported in source order
+    std::vector<std::tuple<size_t, size_t, Remark>> pending;
+
+    for (const auto& component : components) {
+        for (auto* function : component) {
+            if (!function->body) {
+                costs[function] = 0;
+                continue;
+            }
+
+            int cost = expressionCost(*function->body, inlineSites);
+            const auto& sites = graph.getCallSites(function);
+            for (size_t i = 0; i < sites.size(); ++i) {
+                FunctionCall* call = sites[i].call;
+                FunctionDecl* callee = sites[i].callee;
+                std::string reason;
+
+                if (!callee || !callee->body || callee->parameters.size() != call->arguments.size()) {
+                    // Reported as an error by code generation
+                    continue;
+                }
+
+                int calleeCost = costs[callee];
+                bool hot = profile && profile->isHot(call);
+                int threshold = hot ? HOT_THRESHOLD
+                                    : graph.getCallerCount(callee) == 1 ? SINGLE_CALLER_THRESHOLD : INLINE_THRESHOLD;
+                int growth = calleeCost - CALL_COST - static_cast<int>(call->arguments.size());
+                if (componentOf[callee] == componentOf[function]) {
+                    reason = "'" + callee->name + "' not inlined into '" + function->name + "': recursive call";
+                } else if (call->requireTailCall) {
+                    reason = "'" + callee->name + "' not inlined into '" + function->name + "': marked as a tail call";
+                } else if (recursive.count(callee)) {
+                    reason = "'" + callee->name + "' not inlined into '" + function->name + "': callee is recursive";
+                } else if (growth > 0 && profile && profile->isCold(call)) {
+                    reason = "'" + callee->name + "' not inlined into '" + function->name +
+                             "': call never ran in the profile";
+                } else if (calleeCost > threshold) {
+                    reason = "'" + callee->name + "' not inlined into '" + function->name + "': too large (cost " +
+                             std::to_string(calleeCost) + " > threshold " + std::to_string(threshold) + ")";
+                } else if (growth > 0 && cost + growth > MAX_FUNCTION_COST) {
+                    reason = "'" + callee->name + "' not inlined into '" + function->name + "': caller would grow past " +
+                             std::to_string(MAX_FUNCTION_COST);
+                } else {
+                    inlineSites.insert(call);
+                    cost += growth;
+                    reason = "inlined '" + callee->name + "' into '" + function->name + "' (" +
+                             (hot ? "hot call site, " : "") + "cost " + std::to_string(calleeCost) + " <= threshold " +
+                             std::to_string(threshold) + ")";
+                }
+
+                if (remarks) {
+                    pending.emplace_back(sourceIndex[function], i, Remark(call->getPosition(), "inline", reason));
+                }
+            }
+            costs[function] = cost;
+        }
+    }
+
+    if (remarks) {
+        std::stable_sort(pending.begin(), pending.end(), [](const auto& a, const auto& b) {
+            return std::tie(std::get<0>(a), std::get<1>(a)) < std::tie(std::get<0>(b), std::get<1>(b));
+        });
+        for (auto& entry : pending) {
+            remarks->push_back(std::move(std::get<2>(entry)));
+        }
+    }
+}
+
+int Inliner::getCost(const FunctionDecl* function) const {
+    auto it = costs.find(function);
+    return it != costs.end() ? it->second : 0;
+}
+
+int Inliner::expressionCost(Expression& expr, const std::unordered_set<const FunctionCall*>& inlineSites) const {
+    if (auto* binary = dynamic_cast<BinaryOp*>(&expr)) {
+        return 1 + (binary->left ? expressionCost(*binary->left, inlineSites) : 0) +
+               (binary->right ? expressionCost(*binary->right, inlineSites) : 0);
+    }
+    if (auto* call = dynamic_cast<FunctionCall*>(&expr)) {
+        int cost = CALL_COST + static_cast<int>(call->arguments.size());
+        for (auto& argument : call->arguments) {
+            cost += expressionCost(*argument, inlineSites);
+        }
+        return cost;
+    }
+    return 1;
+}
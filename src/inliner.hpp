@@ -0,0 +1,44 @@
+#pragma once
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "ast.hpp"
+#include "callgraph.hpp"
+#include "error.hpp"
+#include "profile.hpp"
+
+// Chooses the call sites that are expanded in place of a call. Functions
+// are visited bottom-up over the call graph, so a callee's cost already
+// includes everything inlined into it. Calls within a recursive cycle are
+// never inlined. With a profile, hot call sites get a larger threshold and
+// sites that never ran are not grown. The pass only records decisions; code
+// generation lowers the callee body at each chosen site.
+class Inliner {
+public:
+    // Rough IR instruction counts
+    static constexpr int CALL_COST = 5;
+    static constexpr int INLINE_THRESHOLD = 16;
+    static constexpr int SINGLE_CALLER_THRESHOLD = 64;
+    static constexpr int HOT_THRESHOLD = 128;
+    static constexpr int MAX_FUNCTION_COST = 1000;
+
+private:
+    std::vector<Remark>* remarks;
+    const ProfileCounts* profile = nullptr;
+    std::unordered_map<const FunctionDecl*, int> costs;
+
+public:
+    // Every decision is explained in `remarkSink` when it is given
+    explicit Inliner(std::vector<Remark>* remarkSink = nullptr) : remarks(remarkSink) {}
+
+    void setProfile(const ProfileCounts* counts) { profile = counts; }
+
+    void run(const CallGraph& graph, std::unordered_set<const FunctionCall*>& inlineSites);
+
+    // Size of a function after inlining, in the units above
+    int getCost(const FunctionDecl* function) const;
+
+private:
+    int expressionCost(Expression& expr, const std::unordered_set<const FunctionCall*>& inlineSites) const;
+};
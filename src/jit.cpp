@@ -0,0 +1,143 @@
+#include "jit.hpp"
+#include "codegen.hpp"
+#include "linker.hpp"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+JitModule::~JitModule() {
+    if (memory) {
+        munmap(memory, memorySize);
+    }
+}
+
+bool JitModule::load(const MachineModule& module) {
+    size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    auto pageAlign = [pageSize](size_t size) { return (size + pageSize - 1) & ~(pageSize - 1); };
+
+    // One mapping keeps every rel32 displacement in range
+    size_t textSize = pageAlign(module.text.size());
+    size_t rodataSize = pageAlign(module.rodata.size());
+    size_t dataSize = pageAlign(((module.data.size() + 15) & ~size_t(15)) + module.bssSize);
+    memorySize = textSize + rodataSize + dataSize;
+    if (memorySize == 0) {
+        memorySize = pageSize;
+    }
+
+    memory = mmap(nullptr, memorySize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        memory = nullptr;
+        errorReporter.reportError(ErrorSeverity::FATAL, ErrorCategory::FILE_IO, Position(),
+                                  "Could not map memory for JIT code");
+        return false;
+    }
+
+    auto* base = static_cast<uint8_t*>(memory);
+    uint8_t* text = base;
+    uint8_t* rodata = base + textSize;
+    uint8_t* data = rodata + rodataSize;
+    uint8_t* bss = data + ((module.data.size() + 15) & ~size_t(15));
+    std::memcpy(text, module.text.data(), module.text.size());
+    std::memcpy(rodata, module.rodata.data(), module.rodata.size());
+    std::memcpy(data, module.data.data(), module.data.size());
+
+    auto sectionBase = [&](SectionKind kind) {
+        switch (kind) {
+            case SectionKind::TEXT: return text;
+            case SectionKind::RODATA: return rodata;
+            case SectionKind::DATA: return data;
+            case SectionKind::BSS: return bss;
+        }
+        return base;
+    };
+
+    for (const auto& symbol : module.symbols) {
+        addresses.emplace(symbol.name, sectionBase(symbol.section) + symbol.offset);
+        if (symbol.section == SectionKind::TEXT && symbol.isFunction) {
+            functions.push_back({symbol.name, {text + symbol.offset, symbol.size}});
+        }
+        if (symbol.name == X86Backend::PROFILE_KEYS) {
+            profileSize = symbol.size / 8;
+        }
+    }
+
+    for (const auto& reloc : module.relocations) {
+        auto target = addresses.find(reloc.symbol);
+        if (target == addresses.end()) {
+            errorReporter.reportSemanticError(Position(), "Undefined reference to '" + reloc.symbol + "'");
+            continue;
+        }
+        uint8_t* place = sectionBase(reloc.section) + reloc.offset;
+        auto value = reinterpret_cast<intptr_t>(target->second) + reloc.addend;
+        if (reloc.kind == RelocKind::ABS64) {
+            std::memcpy(place, &value, 8);
+        } else {
+            auto value32 = static_cast<int32_t>(value - reinterpret_cast<intptr_t>(place));
+            std::memcpy(place, &value32, 4);
+        }
+    }
+    if (errorReporter.hasAnyErrors()) {
+        return false;
+    }
+
+    if ((textSize && mprotect(text, textSize, PROT_READ | PROT_EXEC) != 0) ||
+        (rodataSize && mprotect(rodata, rodataSize, PROT_READ) != 0)) {
+        errorReporter.reportError(ErrorSeverity::FATAL, ErrorCategory::FILE_IO, Position(),
+                                  "Could not make JIT code executable");
+        return false;
+    }
+    return true;
+}
+
+bool JitModule::writePerfMap() const {
+    std::string path = "/tmp/perf-" + std::to_string(getpid()) + ".map";
+    FILE* map = std::fopen(path.c_str(), "a");
+    if (!map) {
+        return false;
+    }
+    for (const auto& [name, range] : functions) {
+        std::fprintf(map, "%" PRIxPTR " %zx %s\n", reinterpret_cast<uintptr_t>(range.first), range.second, name.c_str());
+    }
+    return std::fclose(map) == 0;
+}
+
+void* JitModule::lookup(const std::string& name) const {
+    auto it = addresses.find(name);
+    return it != addresses.end() ? it->second : nullptr;
+}
+
+int JitModule::runMain() {
+    using EntryPoint = int64_t (*)();
+
+    if (void* init = lookup(CodeGenerator::INIT_FUNCTION)) {
+        reinterpret_cast<EntryPoint>(init)();
+    }
+    void* main = lookup("main");
+    if (!main) {
+        errorReporter.reportSemanticError(Position(), "No 'main' function defined");
+        return EXIT_FAILURE;
+    }
+    int result = static_cast<int>(reinterpret_cast<EntryPoint>(main)());
+
+    // Output the runtime buffered would otherwise be written at process exit
+    if (void* flush = lookup(std::string(StaticLinker::RUNTIME_PREFIX) + "flush")) {
+        reinterpret_cast<void (*)()>(flush)();
+    }
+    return result;
+}
+
+bool JitModule::readProfile(Profile& profile) const {
+    auto* keys = static_cast<const uint64_t*>(lookup(X86Backend::PROFILE_KEYS));
+    auto* counters = static_cast<const uint64_t*>(lookup(X86Backend::PROFILE_COUNTERS));
+    if (!keys || !counters) {
+        return false;
+    }
+    for (size_t i = 0; i < profileSize; ++i) {
+        profile.add(keys[i], counters[i]);
+    }
+    return true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "x86.hpp"
+#include "error.hpp"
+#include "profile.hpp"
+
+// Places a MachineModule in anonymous memory of this process and runs it.
+// Pages are writable only while relocations are applied; code ends up
+// read+execute, string data read-only and globals read+write (W^X).
+class JitModule {
+private:
+    ErrorReporter& errorReporter;
+    void* memory;
+    size_t memorySize;
+    std::unordered_map<std::string, void*> addresses;
+    // Address and size of every function, for profilers
+    std::vector<std::pair<std::string, std::pair<void*, size_t>>> functions;
+    // Counters of an instrumented module
+    size_t profileSize;
+
+public:
+    explicit JitModule(ErrorReporter& reporter)
+        : errorReporter(reporter), memory(nullptr), memorySize(0), profileSize(0) {}
+    ~JitModule();
+
+    JitModule(const JitModule&) = delete;
+    JitModule& operator=(const JitModule&) = delete;
+
+    bool load(const MachineModule& module);
+    void* lookup(const std::string& name) const;
+
+    // Appends the loaded functions to /tmp/perf-<pid>.map, where perf looks
+    // up names for code that belongs to no file
+    bool writePerfMap() const;
+
+    // Runs global initializers and main; main's result is the exit code
+    int runMain();
+
+    // Adds the counts an instrumented module gathered over every run so far;
+    // false if it was not instrumented
+    bool readProfile(Profile& profile) const;
+};
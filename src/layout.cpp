@@ -0,0 +1,210 @@
+#include "layout.hpp"
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+
+namespace {
+    constexpr uint64_t SATURATED = std::numeric_limits<uint64_t>::max();
+
+    // Frequencies of deep call trees grow exponentially, so they saturate
+    uint64_t addCounts(uint64_t a, uint64_t b) {
+        return a > SATURATED - b ? SATURATED : a + b;
+    }
+
+    uint64_t multiplyCounts(uint64_t a, uint64_t b) {
+        return b != 0 && a > SATURATED / b ? SATURATED : a * b;
+    }
+
+    // Size of a body without inlining, in Inliner cost units
+    int expressionSize(const Expression& expr) {
+        if (auto* binary = dynamic_cast<const BinaryOp*>(&expr)) {
+            return 1 + (binary->left ? expressionSize(*binary->left) : 0) +
+                   (binary->right ? expressionSize(*binary->right) : 0);
+        }
+        if (auto* call = dynamic_cast<const FunctionCall*>(&expr)) {
+            int size = Inliner::CALL_COST + static_cast<int>(call->arguments.size());
+            for (const auto& argument : call->arguments) {
+                size += expressionSize(*argument);
+            }
+            return size;
+        }
+        return 1;
+    }
+}
+
+void FunctionLayout::run(const CallGraph& graph, const std::unordered_set<const FunctionCall*>& inlineSites,
+                         const Inliner* inliner, bool exported) {
+    const auto& functions = graph.getFunctions();
+    std::unordered_map<const FunctionDecl*, size_t> sourceIndex;
+    for (size_t i = 0; i < functions.size(); ++i) {
+        sourceIndex.emplace(functions[i], i);
+    }
+
+    // Counts from the profile replace the estimates where it has them
+    auto measuredCall = [&](const FunctionCall* call, uint64_t& count) {
+        if (!profile) return;
+        auto it = profile->calls.find(call);
+        if (it != profile->calls.end()) count = it->second;
+    };
+    auto measuredEntries = [&](const FunctionDecl* function, uint64_t& count) {
+        if (!profile) return false;
+        auto it = profile->entries.find(function);
+        if (it == profile->entries.end()) return false;
+        count = it->second;
+        return true;
+    };
+
+    // Entry points are entered once per run
+    std::vector<uint64_t> runs(functions.size(), 0);
+    std::vector<uint64_t> entries(functions.size(), 0);
+    for (size_t i = 0; i < functions.size(); ++i) {
+        if (exported || functions[i]->name == "main") {
+            runs[i] = entries[i] = 1;
+        }
+    }
+    for (const auto& site : graph.getInitializerCalls()) {
+        auto callee = site.callee ? sourceIndex.find(site.callee) : sourceIndex.end();
+        if (callee == sourceIndex.end()) continue;
+        uint64_t count = 1;
+        measuredCall(site.call, count);
+        runs[callee->second] = addCounts(runs[callee->second], count);
+        if (!inlineSites.count(site.call)) {
+            entries[callee->second] = addCounts(entries[callee->second], count);
+        }
+    }
+
+    // Callers before callees, so a function's runs are known before its
+    // calls are counted
+    auto components = graph.bottomUpComponents();
+    std::reverse(components.begin(), components.end());
+    std::unordered_map<const FunctionDecl*, size_t> componentOf;
+    for (size_t i = 0; i < components.size(); ++i) {
+        for (auto* function : components[i]) {
+            componentOf.emplace(function, i);
+        }
+    }
+
+    // Calls between two functions, weighted by how often they run. Calls in
+    // the body of a function that was inlined everywhere are made from the
+    // function it was inlined into most.
+    std::vector<std::unordered_map<size_t, uint64_t>> callers(functions.size());
+    std::vector<size_t> host(functions.size());
+    std::vector<std::pair<size_t, uint64_t>> inlinedInto(functions.size(), {functions.size(), 0});
+    for (size_t i = 0; i < functions.size(); ++i) {
+        host[i] = i;
+    }
+    for (size_t c = 0; c < components.size(); ++c) {
+        const auto& component = components[c];
+        bool recursive = component.size() > 1;
+        uint64_t inflow = 0;
+        for (auto* function : component) {
+            inflow = addCounts(inflow, runs[sourceIndex[function]]);
+            for (const auto& site : graph.getCallSites(function)) {
+                recursive = recursive || site.callee == function;
+            }
+        }
+        for (auto* function : component) {
+            size_t i = sourceIndex[function];
+            if (!measuredEntries(function, runs[i]) && recursive) {
+                runs[i] = multiplyCounts(inflow, RECURSION_FACTOR);
+            }
+        }
+        for (auto* function : component) {
+            size_t i = sourceIndex[function];
+            if (entries[i] == 0 && inlinedInto[i].first != functions.size()) {
+                host[i] = inlinedInto[i].first;
+            }
+        }
+        for (auto* function : component) {
+            size_t caller = sourceIndex[function];
+            for (const auto& site : graph.getCallSites(function)) {
+                auto callee = site.callee ? sourceIndex.find(site.callee) : sourceIndex.end();
+                if (callee == sourceIndex.end()) continue;
+                uint64_t count = runs[caller];
+                measuredCall(site.call, count);
+                if (componentOf[site.callee] != c) {
+                    runs[callee->second] = addCounts(runs[callee->second], count);
+                }
+                if (inlineSites.count(site.call)) {
+                    auto& into = inlinedInto[callee->second];
+                    if (into.first == functions.size() || count > into.second) {
+                        into = {host[caller], count};
+                    }
+                } else {
+                    entries[callee->second] = addCounts(entries[callee->second], count);
+                    if (callee->second != host[caller]) {
+                        uint64_t& weight = callers[callee->second][host[caller]];
+                        weight = addCounts(weight, count);
+                    }
+                }
+            }
+        }
+    }
+
+    // Each hot function starts in a cluster of its own
+    std::vector<int> sizes(functions.size());
+    std::vector<size_t> clusterOf(functions.size());
+    std::vector<std::vector<size_t>> clusters(functions.size());
+    std::vector<int> clusterSizes(functions.size());
+    std::vector<uint64_t> clusterEntries(functions.size());
+    std::vector<size_t> hot;
+    for (size_t i = 0; i < functions.size(); ++i) {
+        int size = inliner ? inliner->getCost(functions[i]) : functions[i]->body ? expressionSize(*functions[i]->body) : 0;
+        sizes[i] = std::max(size, 1);
+        clusterOf[i] = i;
+        clusters[i] = {i};
+        clusterSizes[i] = sizes[i];
+        clusterEntries[i] = entries[i];
+        if (entries[i] > 0) {
+            hot.push_back(i);
+        }
+    }
+    std::stable_sort(hot.begin(), hot.end(), [&](size_t a, size_t b) { return entries[a] > entries[b]; });
+
+    for (size_t function : hot) {
+        size_t best = functions.size();
+        uint64_t bestWeight = 0;
+        for (const auto& [caller, weight] : callers[function]) {
+            if (entries[caller] == 0) continue;
+            if (weight > bestWeight || (weight == bestWeight && caller < best)) {
+                best = caller;
+                bestWeight = weight;
+            }
+        }
+        if (best == functions.size()) continue;
+        size_t into = clusterOf[best];
+        size_t from = clusterOf[function];
+        if (into == from || clusterSizes[into] + clusterSizes[from] > CLUSTER_LIMIT) continue;
+        for (size_t member : clusters[from]) {
+            clusterOf[member] = into;
+        }
+        clusters[into].insert(clusters[into].end(), clusters[from].begin(), clusters[from].end());
+        clusters[from].clear();
+        clusterSizes[into] += clusterSizes[from];
+        clusterEntries[into] = addCounts(clusterEntries[into], clusterEntries[from]);
+    }
+
+    // Densest clusters first; ties keep the order of the first member
+    std::vector<size_t> clusterOrder;
+    for (size_t function : hot) {
+        if (clusterOf[function] == function && !clusters[function].empty()) {
+            clusterOrder.push_back(function);
+        }
+    }
+    std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&](size_t a, size_t b) {
+        return static_cast<double>(clusterEntries[a]) / clusterSizes[a] >
+               static_cast<double>(clusterEntries[b]) / clusterSizes[b];
+    });
+
+    order.clear();
+    for (size_t c = 0; c < clusterOrder.size(); ++c) {
+        for (size_t member : clusters[clusterOrder[c]]) {
+            order.push_back({functions[member], entries[member], sizes[member], c, false});
+        }
+    }
+    for (size_t i = 0; i < functions.size(); ++i) {
+        if (entries[i] == 0) {
+            order.push_back({functions[i], 0, sizes[i], clusterOrder.size(), true});
+        }
+    }
+}
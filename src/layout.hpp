@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+#include "ast.hpp"
+#include "callgraph.hpp"
+#include "inliner.hpp"
+#include "profile.hpp"
+
+// Chooses the order of functions in .text. Every call site is given a
+// frequency: its count in the profile when there is one, otherwise the
+// number of times its caller runs, found top-down from the entry points
+// (exact without recursion, since Lithium has no branches). Functions are
+// then clustered the way call-chain clustering does it: taken from the most
+// entered down, each joins the cluster of the caller that calls it most, as
+// long as the cluster stays within about a page of code. Clusters are laid
+// out densest first. Functions whose out-of-line body never runs, because
+// every call to them was inlined or the profile never saw one, are cold and
+// go last, in source order.
+class FunctionLayout {
+public:
+    // Cluster size limit, in Inliner cost units (roughly IR instructions)
+    static constexpr int CLUSTER_LIMIT = 256;
+    // Times a recursive cycle is assumed to repeat without a profile
+    static constexpr uint64_t RECURSION_FACTOR = 10;
+
+    struct Placement {
+        FunctionDecl* function;
+        uint64_t entries; // calls into the out-of-line body
+        int size;
+        size_t cluster;
+        bool cold;
+    };
+
+private:
+    const ProfileCounts* profile = nullptr;
+    std::vector<Placement> order;
+
+public:
+    void setProfile(const ProfileCounts* counts) { profile = counts; }
+
+    // `inliner` gives function sizes after inlining when it ran. With
+    // `exported` every function is an entry point, as in an object file;
+    // otherwise only main and the calls of global initializers are.
+    void run(const CallGraph& graph, const std::unordered_set<const FunctionCall*>& inlineSites,
+             const Inliner* inliner, bool exported);
+
+    // Hot functions first, in layout order, then the cold ones
+    const std::vector<Placement>& getOrder() const { return order; }
+    bool usesProfile() const { return profile != nullptr; }
+};
@@ -8,6 +8,7 @@
 #include <vector>
 #include <unordered_map>
 #include "ast.hpp"
+#include "error.hpp"
 
 enum class TokenType {
     // Literals
@@ -21,6 +22,7 @@ enum class TokenType {
     CONST,
     INCLUDE,
     FROM,
+    TAIL,
     
     // Types
     INT_TYPE,
@@ -92,8 +94,9 @@ bool isDelimiterToken(TokenType type);
 
 class Lexer {
 public:
-    Lexer(std::string source, std::string filename = "") 
-        : m_src(std::move(source)), m_filename(std::move(filename)), m_line(1), m_column(1) {}
+    // Without `errors`, problems are printed to stderr as they are found
+    Lexer(std::string source, std::string filename = "", ErrorReporter* errors = nullptr) 
+        : m_src(std::move(source)), m_filename(std::move(filename)), m_line(1), m_column(1), m_errors(errors) {}
 
     std::vector<Token> tokenize();
 
@@ -121,10 +124,12 @@ private:
     bool isAlpha(char c) const;
     bool isAlphaNumeric(char c) const;
     bool isDigit(char c) const;
+    void reportError(const Position& position, const std::string& message);
     
     const std::string m_src;
     std::string m_filename;
     size_t m_idx = 0;
     int m_line;
     int m_column;
+    ErrorReporter* m_errors;
 };
@@ -1,4 +1,5 @@
 #include "lexar.hpp"
+#include "memtrack.hpp"
 #include <unordered_map>
 
 // Static keyword mapping for efficient lookup
@@ -8,6 +9,7 @@ static const std::unordered_map<std::string, TokenType> keywords = {
     {"const", TokenType::CONST},
     {"include", TokenType::INCLUDE},
     {"from", TokenType::FROM},
+    {"tail", TokenType::TAIL},
     {"int", TokenType::INT_TYPE},
     {"float", TokenType::FLOAT_TYPE},
     {"string", TokenType::STRING_TYPE},
@@ -110,6 +112,7 @@ std::string tokenTypeToString(TokenType type) {
         case TokenType::CONST: return "CONST";
         case TokenType::INCLUDE: return "INCLUDE";
         case TokenType::FROM: return "FROM";
+        case TokenType::TAIL: return "TAIL";
         case TokenType::INT_TYPE: return "INT_TYPE";
         case TokenType::FLOAT_TYPE: return "FLOAT_TYPE";
         case TokenType::STRING_TYPE: return "STRING_TYPE";
@@ -137,7 +140,7 @@ std::string tokenTypeToString(TokenType type) {
 
 bool isKeywordToken(TokenType type) {
     return type == TokenType::FN || type == TokenType::LET || type == TokenType::CONST ||
-           type == TokenType::INCLUDE || type == TokenType::FROM ||
+           type == TokenType::INCLUDE || type == TokenType::FROM || type == TokenType::TAIL ||
            type == TokenType::INT_TYPE || type == TokenType::FLOAT_TYPE ||
            type == TokenType::STRING_TYPE || type == TokenType::BOOL_TYPE ||
            type == TokenType::ANY_TYPE || type == TokenType::VOID_TYPE;
@@ -161,9 +164,11 @@ bool isDelimiterToken(TokenType type) {
 
 // Lexer implementation
 std::vector<Token> Lexer::tokenize() {
+    MemoryScope memory(MemoryCategory::TOKENS);
     std::vector<Token> tokens;
     
-    while (!isAtEnd()) {
+    // Past the error limit nothing more would be shown
+    while (!isAtEnd() && !(m_errors && m_errors->limitReached())) {
         // Skip whitespace but preserve newlines
         if (std::isspace(peek().value()) && peek().value() != '\n') {
             skipWhitespace();
@@ -218,8 +223,7 @@ std::vector<Token> Lexer::tokenize() {
         }
         
         // Unknown character
-        std::cerr << "Error: Unexpected character '" << c << "' at " 
-                  << m_filename << ":" << m_line << ":" << m_column << std::endl;
+        reportError(getCurrentPosition(), std::string("Unexpected character '") + c + "'");
         consume(); // Skip unknown character
     }
     
@@ -317,9 +321,11 @@ Token Lexer::scanString() {
     }
     
     if (!peek().has_value()) {
-        std::cerr << "Error: Unterminated string literal at " 
-                  << m_filename << ":" << startPos.line << ":" << startPos.column << std::endl;
-        exit(EXIT_FAILURE);
+        reportError(startPos, "Unterminated string literal");
+        if (!m_errors) {
+            exit(EXIT_FAILURE);
+        }
+        return Token::createString(value, startPos);
     }
     
     consume(); // consume closing quote
@@ -342,8 +348,7 @@ Token Lexer::scanOperator() {
             }
             return Token::createOperator(TokenType::MINUS, "-", startPos);
         default:
-            std::cerr << "Error: Unknown operator '" << c << "' at " 
-                      << m_filename << ":" << m_line << ":" << m_column << std::endl;
+            reportError(startPos, std::string("Unknown operator '") + c + "'");
             return Token::createOperator(TokenType::ASSIGN, std::string(1, c), startPos);
     }
 }
@@ -360,8 +365,7 @@ Token Lexer::scanDelimiter() {
         case ':': return Token::createDelimiter(TokenType::COLON, startPos);
         case ',': return Token::createDelimiter(TokenType::COMMA, startPos);
         default:
-            std::cerr << "Error: Unknown delimiter '" << c << "' at " 
-                      << m_filename << ":" << m_line << ":" << m_column << std::endl;
+            reportError(startPos, std::string("Unknown delimiter '") + c + "'");
             return Token::createDelimiter(TokenType::COMMA, startPos);
     }
 }
@@ -382,6 +386,7 @@ Token Lexer::scanComment() {
 }
 
 Position Lexer::getCurrentPosition() const {
+    MemoryScope memory(MemoryCategory::POSITIONS);
     return Position(m_filename, m_line, m_column);
 }
 
@@ -408,4 +413,12 @@ bool Lexer::isAlphaNumeric(char c) const {
 
 bool Lexer::isDigit(char c) const {
     return std::isdigit(c);
-}
\ No newline at end of file
+}
+void Lexer::reportError(const Position& position, const std::string& message) {
+    if (m_errors) {
+        m_errors->reportLexicalError(position, message);
+        return;
+    }
+    std::cerr << "Error: " << message << " at " << position.filename << ":" << position.line << ":"
+              << position.column << std::endl;
+}
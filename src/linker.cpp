@@ -0,0 +1,318 @@
+#include "linker.hpp"
+#include <elf.h>
+#include <cstring>
+#include <unordered_set>
+
+namespace {
+    constexpr std::string_view ARCHIVE_MAGIC = "!<arch>\n";
+    constexpr size_t MEMBER_HEADER_SIZE = 60;
+
+    template <typename T>
+    bool read(std::string_view image, uint64_t offset, T& value) {
+        if (offset > image.size() || image.size() - offset < sizeof(T)) {
+            return false;
+        }
+        std::memcpy(&value, image.data() + offset, sizeof(T));
+        return true;
+    }
+
+    std::string_view trim(std::string_view field) {
+        size_t end = field.find_last_not_of(' ');
+        return end == std::string_view::npos ? std::string_view() : field.substr(0, end + 1);
+    }
+
+    // A parsed relocatable object; every table is bounds checked once here
+    struct ObjectFile {
+        std::string_view image;
+        std::vector<Elf64_Shdr> sections;
+        std::vector<Elf64_Sym> symbols;
+        std::string_view symbolNames;
+        std::string_view sectionNames;
+
+        bool parse(std::string_view bytes) {
+            image = bytes;
+            Elf64_Ehdr header;
+            if (!read(image, 0, header) || std::memcmp(header.e_ident, ELFMAG, SELFMAG) != 0 ||
+                header.e_ident[EI_CLASS] != ELFCLASS64 || header.e_machine != EM_X86_64 || header.e_type != ET_REL) {
+                return false;
+            }
+            sections.resize(header.e_shnum);
+            for (size_t i = 0; i < sections.size(); ++i) {
+                if (!read(image, header.e_shoff + i * sizeof(Elf64_Shdr), sections[i])) return false;
+            }
+            for (const auto& section : sections) {
+                if (section.sh_type != SHT_NOBITS && section.sh_type != SHT_NULL &&
+                    (section.sh_offset > image.size() || image.size() - section.sh_offset < section.sh_size)) {
+                    return false;
+                }
+            }
+            if (header.e_shstrndx >= sections.size()) return false;
+            sectionNames = contents(header.e_shstrndx);
+            for (const auto& section : sections) {
+                if (section.sh_type != SHT_SYMTAB) continue;
+                if (section.sh_link >= sections.size()) return false;
+                symbolNames = contents(section.sh_link);
+                symbols.resize(section.sh_size / sizeof(Elf64_Sym));
+                for (size_t i = 0; i < symbols.size(); ++i) {
+                    read(image, section.sh_offset + i * sizeof(Elf64_Sym), symbols[i]);
+                }
+            }
+            return true;
+        }
+
+        std::string_view contents(size_t index) const {
+            const auto& section = sections[index];
+            return image.substr(section.sh_offset, section.sh_type == SHT_NOBITS ? 0 : section.sh_size);
+        }
+
+        static std::string name(std::string_view table, uint32_t offset) {
+            if (offset >= table.size()) return std::string();
+            size_t end = table.find('\0', offset);
+            return std::string(table.substr(offset, end == std::string_view::npos ? std::string_view::npos : end - offset));
+        }
+
+        std::string sectionName(size_t index) const { return name(sectionNames, sections[index].sh_name); }
+        std::string symbolName(const Elf64_Sym& symbol) const { return name(symbolNames, symbol.st_name); }
+    };
+
+    bool isGlobalDefinition(const Elf64_Sym& symbol) {
+        unsigned char bind = ELF64_ST_BIND(symbol.st_info);
+        return (bind == STB_GLOBAL || bind == STB_WEAK) && symbol.st_shndx != SHN_UNDEF;
+    }
+}
+
+bool StaticLinker::usesRuntime(const MachineModule& module) {
+    for (const auto& reloc : module.relocations) {
+        if (reloc.symbol.compare(0, std::strlen(RUNTIME_PREFIX), RUNTIME_PREFIX) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool StaticLinker::addArchive(std::string_view archive, const std::string& name) {
+    if (archive.substr(0, ARCHIVE_MAGIC.size()) != ARCHIVE_MAGIC) {
+        errorReporter.reportFileError(Position(), "'" + name + "' is not an archive");
+        return false;
+    }
+
+    std::string_view longNames;
+    size_t offset = ARCHIVE_MAGIC.size();
+    while (offset + MEMBER_HEADER_SIZE <= archive.size()) {
+        std::string_view header = archive.substr(offset, MEMBER_HEADER_SIZE);
+        std::string_view field = trim(header.substr(0, 16));
+        size_t size = std::strtoul(std::string(trim(header.substr(48, 10))).c_str(), nullptr, 10);
+        offset += MEMBER_HEADER_SIZE;
+        if (size > archive.size() - offset) {
+            errorReporter.reportFileError(Position(), "'" + name + "' is truncated");
+            return false;
+        }
+        std::string_view image = archive.substr(offset, size);
+        offset += size + (size & 1);
+
+        // GNU layout: "/" is the symbol index, "//" the long name table
+        // and "/N" an offset into it; short names end in '/'
+        if (field == "/" || field == "/SYM64/") {
+            continue;
+        }
+        if (field == "//") {
+            longNames = image;
+            continue;
+        }
+        std::string memberName;
+        if (field.size() > 1 && field[0] == '/') {
+            size_t at = std::strtoul(std::string(field.substr(1)).c_str(), nullptr, 10);
+            size_t end = at < longNames.size() ? longNames.find('/', at) : std::string_view::npos;
+            memberName = end == std::string_view::npos ? std::string(field) : std::string(longNames.substr(at, end - at));
+        } else {
+            memberName = std::string(field.back() == '/' ? field.substr(0, field.size() - 1) : field);
+        }
+
+        members.push_back({name + "(" + memberName + ")", image, {}, false});
+        if (!scanMember(members.back())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool StaticLinker::scanMember(Member& member) {
+    ObjectFile object;
+    if (!object.parse(member.image)) {
+        return fail(member, "not an x86-64 relocatable object");
+    }
+    for (const auto& symbol : object.symbols) {
+        if (isGlobalDefinition(symbol)) {
+            member.definitions.push_back(object.symbolName(symbol));
+            definedBy.emplace(member.definitions.back(), members.size() - 1);
+        }
+    }
+    return true;
+}
+
+bool StaticLinker::link(MachineModule& module, const MachineModule* later) {
+    std::unordered_set<std::string> defined;
+    for (const auto& symbol : module.symbols) {
+        defined.insert(symbol.name);
+    }
+    if (later) {
+        for (const auto& symbol : later->symbols) {
+            defined.insert(symbol.name);
+        }
+        for (const auto& relocation : later->relocations) {
+            if (!require(relocation.symbol, defined, module)) {
+                return false;
+            }
+        }
+    }
+
+    // New members bring references of their own, so look again after each
+    size_t scanned = 0;
+    while (scanned < module.relocations.size()) {
+        if (!require(module.relocations[scanned++].symbol, defined, module)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool StaticLinker::require(const std::string& symbol, std::unordered_set<std::string>& defined,
+                           MachineModule& module) {
+    if (defined.count(symbol)) {
+        return true;
+    }
+    auto provider = definedBy.find(symbol);
+    if (provider == definedBy.end() || members[provider->second].linked) {
+        return true;
+    }
+    Member& member = members[provider->second];
+    for (const auto& name : member.definitions) {
+        if (!defined.insert(name).second) {
+            return fail(member, "defines '" + name + "', which the program already defines");
+        }
+    }
+    return linkMember(member, module);
+}
+
+bool StaticLinker::linkMember(Member& member, MachineModule& module) {
+    ObjectFile object;
+    object.parse(member.image);
+    member.linked = true;
+    std::string prefix = ".L" + std::to_string(linkedMembers++) + ".";
+
+    // Place every allocated section in the module section of its kind
+    struct Placement {
+        bool placed = false;
+        SectionKind kind = SectionKind::TEXT;
+        uint64_t offset = 0;
+    };
+    std::vector<Placement> placements(object.sections.size());
+    for (size_t i = 1; i < object.sections.size(); ++i) {
+        const auto& section = object.sections[i];
+        if (!(section.sh_flags & SHF_ALLOC) || section.sh_size == 0) {
+            continue;
+        }
+        if (section.sh_type == SHT_NOTE) {
+            continue;
+        }
+        if (section.sh_type != SHT_PROGBITS && section.sh_type != SHT_NOBITS) {
+            return fail(member, "has unsupported section '" + object.sectionName(i) + "'");
+        }
+        if (section.sh_addralign > 16) {
+            return fail(member, "section '" + object.sectionName(i) + "' needs more than 16-byte alignment");
+        }
+        uint64_t alignment = section.sh_addralign ? section.sh_addralign : 1;
+        Placement& placement = placements[i];
+        placement.placed = true;
+        if (section.sh_type == SHT_NOBITS) {
+            placement.kind = SectionKind::BSS;
+            placement.offset = (module.bssSize + alignment - 1) & ~(alignment - 1);
+            module.bssSize = placement.offset + section.sh_size;
+        } else {
+            std::string* target = &module.rodata;
+            placement.kind = SectionKind::RODATA;
+            if (section.sh_flags & SHF_EXECINSTR) {
+                target = &module.text;
+                placement.kind = SectionKind::TEXT;
+            } else if (section.sh_flags & SHF_WRITE) {
+                target = &module.data;
+                placement.kind = SectionKind::DATA;
+            }
+            // Code is padded with int3, data with zeros
+            char fill = placement.kind == SectionKind::TEXT ? '\xCC' : '\0';
+            target->resize((target->size() + alignment - 1) & ~(alignment - 1), fill);
+            placement.offset = target->size();
+            *target += object.contents(i);
+        }
+        module.symbols.push_back({prefix + std::to_string(i), placement.kind, placement.offset,
+                                  section.sh_size, false, false});
+    }
+
+    // Module names of the object's symbols: globals keep theirs, locals
+    // are made unique, section symbols refer to the placed section
+    std::vector<std::string> names(object.symbols.size());
+    for (size_t i = 1; i < object.symbols.size(); ++i) {
+        const auto& symbol = object.symbols[i];
+        unsigned char type = ELF64_ST_TYPE(symbol.st_info);
+        if (symbol.st_shndx == SHN_UNDEF) {
+            names[i] = object.symbolName(symbol);
+            continue;
+        }
+        if (symbol.st_shndx == SHN_COMMON || symbol.st_shndx >= placements.size() ||
+            !placements[symbol.st_shndx].placed) {
+            if (isGlobalDefinition(symbol)) {
+                return fail(member, "defines '" + object.symbolName(symbol) + "' outside a supported section");
+            }
+            continue;
+        }
+        const Placement& placement = placements[symbol.st_shndx];
+        if (type == STT_SECTION) {
+            names[i] = prefix + std::to_string(symbol.st_shndx);
+            continue;
+        }
+        bool global = isGlobalDefinition(symbol);
+        names[i] = global ? object.symbolName(symbol) : prefix + object.symbolName(symbol);
+        module.symbols.push_back({names[i], placement.kind, placement.offset + symbol.st_value, symbol.st_size,
+                                  global, type == STT_FUNC});
+    }
+
+    for (size_t i = 1; i < object.sections.size(); ++i) {
+        const auto& section = object.sections[i];
+        if (section.sh_type == SHT_REL) {
+            return fail(member, "uses REL relocations");
+        }
+        if (section.sh_type != SHT_RELA || section.sh_info >= placements.size() ||
+            !placements[section.sh_info].placed) {
+            continue;
+        }
+        const Placement& target = placements[section.sh_info];
+        std::string_view entries = object.contents(i);
+        for (size_t at = 0; at + sizeof(Elf64_Rela) <= entries.size(); at += sizeof(Elf64_Rela)) {
+            Elf64_Rela entry;
+            std::memcpy(&entry, entries.data() + at, sizeof(entry));
+            uint32_t symbol = ELF64_R_SYM(entry.r_info);
+            uint32_t type = ELF64_R_TYPE(entry.r_info);
+            RelocKind kind;
+            if (type == R_X86_64_PC32) {
+                kind = RelocKind::PC32;
+            } else if (type == R_X86_64_PLT32) {
+                kind = RelocKind::PLT32;
+            } else if (type == R_X86_64_64) {
+                kind = RelocKind::ABS64;
+            } else {
+                return fail(member, "uses unsupported relocation type " + std::to_string(type));
+            }
+            if (symbol >= names.size() || names[symbol].empty()) {
+                return fail(member, "relocates against a symbol in a section that was not linked");
+            }
+            module.relocations.push_back({target.kind, target.offset + entry.r_offset, kind, names[symbol],
+                                          entry.r_addend});
+        }
+    }
+    return true;
+}
+
+bool StaticLinker::fail(const Member& member, const std::string& message) {
+    errorReporter.reportFileError(Position(), member.name + " " + message);
+    return false;
+}
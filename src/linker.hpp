@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "error.hpp"
+#include "x86.hpp"
+
+// Links members of a static library into a MachineModule, the way `ld`
+// treats an archive: a member is added when it defines a symbol the module
+// references but does not define, until nothing more is needed. Members
+// must be ELF64 x86-64 relocatable objects built like liblithium_rt:
+// position independent, without unwind tables, using only PC32, PLT32 and
+// 64-bit relocations.
+class StaticLinker {
+private:
+    struct Member {
+        std::string name;
+        std::string_view image;
+        std::vector<std::string> definitions;
+        bool linked = false;
+    };
+
+    ErrorReporter& errorReporter;
+    std::vector<Member> members;
+    std::unordered_map<std::string, size_t> definedBy;
+    size_t linkedMembers = 0;
+
+public:
+    // Prefix of every symbol liblithium_rt exports
+    static constexpr const char* RUNTIME_PREFIX = "lithium_rt_";
+
+    // liblithium_rt.a as built alongside the compiler; the bytes are
+    // embedded at build time
+    static std::string_view runtimeArchive();
+
+    // Whether generated code calls into liblithium_rt
+    static bool usesRuntime(const MachineModule& module);
+
+    explicit StaticLinker(ErrorReporter& reporter) : errorReporter(reporter) {}
+
+    // `archive` must outlive the linker
+    bool addArchive(std::string_view archive, const std::string& name);
+    // Members that code placed in the module later needs, such as its cold
+    // code, are linked as well
+    bool link(MachineModule& module, const MachineModule* later = nullptr);
+
+    size_t getLinkedMembers() const { return linkedMembers; }
+
+private:
+    bool scanMember(Member& member);
+    bool require(const std::string& symbol, std::unordered_set<std::string>& defined, MachineModule& module);
+    bool linkMember(Member& member, MachineModule& module);
+    bool fail(const Member& member, const std::string& message);
+};
@@ -1,63 +1,272 @@
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <string>
 #include <vector>
 #include <filesystem>
 #include <fstream>
 #include <sstream>
+#include <unordered_map>
 
 #include "lexar.hpp"
 #include "parser.hpp"
 #include "semantic.hpp"
+#include "stats.hpp"
+#include "server.hpp"
 #include "codegen.hpp"
+#include "reachability.hpp"
+#include "jit.hpp"
+#include "layout.hpp"
+#include "memtrack.hpp"
+#include "modulecache.hpp"
+#include "peephole.hpp"
+#include "profile.hpp"
+#include "threadpool.hpp"
+#include "trace.hpp"
+#include "vm.hpp"
 #include "error.hpp"
 #include "utils.hpp"
 
+enum class DriverMode {
+    COMPILE,
+    JIT_RUN,
+    VM_RUN
+};
+
+enum class StatsFormat {
+    NONE,
+    TABLE,
+    JSON
+};
+
 struct CompilerOptions {
+    std::vector<std::string> inputFiles;
+    // The file being compiled
     std::string inputFile;
     std::string outputFile;
     bool verbose = false;
     bool debugLexer = false;
     bool debugParser = false;
     bool debugSemantic = false;
+    DriverMode mode = DriverMode::COMPILE;
     TargetType targetType = TargetType::EXECUTABLE;
+    unsigned threads = 0;
+    bool inlining = true;
+    bool specialization = true;
+    bool deadCodeElimination = true;
+    bool remarks = false;
+    bool debugInfo = false;
+    std::string profileGenerate;
+    std::string profileUse;
+    bool layout = true;
+    bool printLayout = false;
+    bool peephole = true;
+    StatsFormat stats = StatsFormat::NONE;
+    std::string serverSocket;
+    std::string connectSocket;
+    std::string traceFile;
+    bool memoryReport = false;
+    // Errors shown per file before it is given up on; 0 for no limit
+    size_t errorLimit = 100;
+    // Parsed files kept between a server's requests
+    ModuleCache* cache = nullptr;
+    // Relative paths are taken from here instead of the working directory;
+    // set to the client's directory for a server request
+    std::string directory;
 };
 
-void printUsage(const char* programName);
-bool parseArguments(int argc, char* argv[], CompilerOptions& options);
+// Reports how long each compiler phase took when --verbose is on, records
+// the phase in `stats` for --stats and as a trace event for --trace
+class PhaseTimer {
+private:
+    bool enabled;
+    std::ostream& out;
+    CompileStats* stats;
+    std::chrono::steady_clock::time_point start;
+    uint64_t traceStart;
+    
+public:
+    PhaseTimer(bool on, std::ostream& stream, CompileStats* phaseStats)
+        : enabled(on), out(stream), stats(phaseStats), start(std::chrono::steady_clock::now()),
+          traceStart(Trace::enabled() ? Trace::now() : 0) {
+        if (stats) {
+            stats->restart();
+        }
+    }
+    
+    // Whether item counts are wanted; some take a walk over the tree
+    bool counting() const { return stats != nullptr; }
+    
+    void lap(const char* phase, const char* itemName = nullptr, size_t items = 0) {
+        if (stats) {
+            stats->lap(phase, itemName, items);
+        }
+        if (Trace::enabled()) {
+            uint64_t now = Trace::now();
+            Trace::complete("phase", phase, traceStart, now);
+            traceStart = now;
+        }
+        if (!enabled) return;
+        auto now = std::chrono::steady_clock::now();
+        out << "  " << phase << ": "
+                  << std::chrono::duration<double, std::milli>(now - start).count() << " ms\n";
+        start = now;
+    }
+};
+
+void printUsage(const char* programName, std::ostream& out);
+bool parseArguments(const std::vector<std::string>& arguments, CompilerOptions& options, std::ostream& err);
 std::string readSourceFile(const std::string& filename);
-int compileFile(const CompilerOptions& options);
+// `path` as the compile should open it; diagnostics keep the name as given
+std::string resolvePath(const CompilerOptions& options, const std::string& path);
+std::string defaultOutputFile(const std::string& inputFile, TargetType targetType);
+// Reads, lexes and parses one file; null if it has errors, which are left
+// in errorReporter
+std::unique_ptr<ProgramNode> parseSource(const CompilerOptions& options, const std::string& filename,
+                                         ErrorReporter& errorReporter, PhaseTimer& timer, std::ostream& out);
+// With `totals`, phases are recorded there instead of printed at the end
+int compileFile(const CompilerOptions& options, std::ostream& out, std::ostream& err,
+                CompileStats* totals = nullptr);
+// Several inputs: without -o each is compiled to its own output, on up to
+// -j threads at once; with -o they are parsed in parallel and compiled as
+// one program. What each file prints is buffered and written out in the
+// order the files were given.
+int compileFiles(const CompilerOptions& options, std::ostream& out, std::ostream& err);
+int compileProgram(const CompilerOptions& options, ProgramNode& program, ErrorReporter& errorReporter,
+                   PhaseTimer& timer, std::ostream& out, std::ostream& err);
+int runBytecodeFile(const CompilerOptions& options);
+// Compiles or runs what the command line asks for, through the server if told to
+int runDriver(const CompilerOptions& options, const std::vector<std::string>& arguments);
+int runServer(const CompilerOptions& options);
+// One request to the server: a command line, compiled with the cache
+int serveRequest(const std::string& directory, const std::vector<std::string>& arguments, ModuleCache& cache,
+                 std::ostream& out, std::ostream& err);
+void printRemarks(const std::vector<Remark>& remarks, std::ostream& err);
+void printLayout(const FunctionLayout& layout, std::ostream& out);
+void printStringStats(const StringPool& pool, std::ostream& out);
+void printPeepholeStats(const std::vector<size_t>& hits, std::ostream& out);
+void printCompileStats(const CompileStats& stats, StatsFormat format, std::ostream& out);
 
 int main(int argc, char* argv[]) {
     CompilerOptions options;
+    std::vector<std::string> arguments(argv + 1, argv + argc);
     
-    if (!parseArguments(argc, argv, options)) {
-        printUsage(argv[0]);
+    if (!parseArguments(arguments, options, std::cerr)) {
+        printUsage(argv[0], std::cout);
         return EXIT_FAILURE;
     }
     
-    return compileFile(options);
+    if (!options.traceFile.empty()) {
+        Trace::start();
+    }
+    int result = EXIT_FAILURE;
+    if (!options.serverSocket.empty()) {
+        result = runServer(options);
+    } else {
+        result = runDriver(options, arguments);
+    }
+    if (!options.traceFile.empty()) {
+        std::string error;
+        if (!Trace::finish(options.traceFile, error)) {
+            std::cerr << "Warning: Could not write trace " << error << "\n";
+        }
+    }
+    if (options.memoryReport) {
+        MemoryTracker::printReport(std::cout);
+    }
+    return result;
+}
+
+int runDriver(const CompilerOptions& options, const std::vector<std::string>& arguments) {
+    // Programs run, debug dumps and traces are written here, so only plain compiles go to the server
+    if (!options.connectSocket.empty() && options.mode == DriverMode::COMPILE && !options.debugLexer &&
+        !options.debugParser && !options.debugSemantic && options.traceFile.empty()) {
+        std::vector<std::string> forwarded;
+        for (const auto& argument : arguments) {
+            if (argument.compare(0, 9, "--connect") != 0) {
+                forwarded.push_back(argument);
+            }
+        }
+        int exitCode = EXIT_FAILURE;
+        std::string out;
+        std::string err;
+        if (CompileClient::request(options.connectSocket, std::filesystem::current_path().string(), forwarded,
+                                   exitCode, out, err)) {
+            std::cout << out << std::flush;
+            std::cerr << err;
+            return exitCode;
+        }
+        if (options.verbose) {
+            std::cout << "No server on " << options.connectSocket << ", compiling here\n";
+        }
+    }
+    
+    if (options.mode == DriverMode::VM_RUN && FileUtils::getFileExtension(options.inputFile) == ".lbc") {
+        return runBytecodeFile(options);
+    }
+    if (options.inputFiles.size() > 1) {
+        return compileFiles(options, std::cout, std::cerr);
+    }
+    return compileFile(options, std::cout, std::cerr);
 }
 
-void printUsage(const char* programName) {
-    std::cout << "Lithium Compiler v1.0\n";
-    std::cout << "Usage: " << programName << " [options] <input-file>\n\n";
-    std::cout << "Options:\n";
-    std::cout << "  -o <file>     Specify output file\n";
-    std::cout << "  -v, --verbose Enable verbose output\n";
-    std::cout << "  --debug-lexer Enable lexer debugging\n";
-    std::cout << "  --debug-parser Enable parser debugging\n";
-    std::cout << "  --debug-semantic Enable semantic analysis debugging\n";
-    std::cout << "  -t <type>     Target type (exe, asm, ir)\n";
-    std::cout << "  -h, --help    Show this help message\n";
+void printUsage(const char* programName, std::ostream& out) {
+    out << "Lithium Compiler v1.0\n";
+    out << "Usage: " << programName << " [options] <input-file>...\n";
+    out << "       " << programName << " run [options] <input-file>\n";
+    out << "       " << programName << " vm [options] <input-file|bytecode-file>\n\n";
+    out << "Commands:\n";
+    out << "  run           Compile in memory and execute; main's result is the exit code\n";
+    out << "  vm            Execute on the bytecode interpreter (.lh or .lbc input)\n\n";
+    out << "Options:\n";
+    out << "  -o <file>     Specify output file; with several inputs, compile them as one program\n";
+    out << "  -v, --verbose Enable verbose output\n";
+    out << "  --debug-lexer Enable lexer debugging\n";
+    out << "  --debug-parser Enable parser debugging\n";
+    out << "  --debug-semantic Enable semantic analysis debugging\n";
+    out << "  -t <type>     Target type (exe, obj, asm, ir, bc)\n";
+    out << "  -j <n>        Files compiled at once, or code generation threads for a single\n";
+    out << "                program (default: one per core)\n";
+    out << "  --no-inline   Disable function inlining\n";
+    out << "  --keep-unused Lower functions that main never reaches\n";
+    out << "  --no-specialize Disable per-type copies of functions with `any` parameters\n";
+    out << "  --no-peephole Disable IR peephole rewrites\n";
+    out << "  --error-limit=<n> Stop after <n> errors in a file (default: 100, 0 for no limit)\n";
+    out << "  --remarks     Explain optimization decisions\n";
+    out << "  -g            Emit source line tables; with run, write /tmp/perf-<pid>.map for perf\n";
+    out << "  --profile-generate[=<file>] Count function entries and calls, written to <file>\n";
+    out << "                (default: lithium.profile) when main returns\n";
+    out << "  --profile-use=<file> Optimize for the counts in <file>\n";
+    out << "  --no-layout   Keep native functions in source order, with no .text.cold\n";
+    out << "  --print-layout Show the order native functions are placed in\n";
+    out << "  --stats[=table|json] Report time, memory, allocations and items of each phase\n";
+    out << "  --trace=<file> Write what the compiler spent its time on as Chrome trace events\n";
+    out << "                (chrome://tracing, ui.perfetto.dev)\n";
+    out << "  --mem-report  Show heap use by category (tokens, AST, IR ...); needs a build\n";
+    out << "                configured with -DLITHIUM_MEM_TRACKING=ON\n";
+    out << "  --server[=<socket>] Stay running and compile for clients that connect to <socket>\n";
+    out << "                (default: $XDG_RUNTIME_DIR/lithium.sock, else /tmp/lithium-<uid>/server.sock),\n";
+    out << "                reusing unchanged parsed files\n";
+    out << "  --connect[=<socket>] Have the server compile; compile here if none is running\n";
+    out << "  -h, --help    Show this help message\n";
 }
 
-bool parseArguments(int argc, char* argv[], CompilerOptions& options) {
-    if (argc < 2) {
+bool parseArguments(const std::vector<std::string>& arguments, CompilerOptions& options, std::ostream& err) {
+    if (arguments.empty()) {
         return false;
     }
     
-    for (int i = 1; i < argc; ++i) {
-        std::string arg = argv[i];
+    size_t first = 0;
+    if (arguments[0] == "run") {
+        options.mode = DriverMode::JIT_RUN;
+        first = 1;
+    } else if (arguments[0] == "vm") {
+        options.mode = DriverMode::VM_RUN;
+        first = 1;
+    }
+    
+    for (size_t i = first; i < arguments.size(); ++i) {
+        const std::string& arg = arguments[i];
         
         if (arg == "-h" || arg == "--help") {
             return false;
@@ -69,58 +278,154 @@ bool parseArguments(int argc, char* argv[], CompilerOptions& options) {
             options.debugParser = true;
         } else if (arg == "--debug-semantic") {
             options.debugSemantic = true;
-        } else if (arg == "-o" && i + 1 < argc) {
-            options.outputFile = argv[++i];
-        } else if (arg == "-t" && i + 1 < argc) {
-            std::string target = argv[++i];
+        } else if (arg == "--no-inline") {
+            options.inlining = false;
+        } else if (arg == "--keep-unused") {
+            options.deadCodeElimination = false;
+        } else if (arg == "--no-specialize") {
+            options.specialization = false;
+        } else if (arg == "--remarks") {
+            options.remarks = true;
+        } else if (arg == "-g") {
+            options.debugInfo = true;
+        } else if (arg == "--profile-generate") {
+            options.profileGenerate = "lithium.profile";
+        } else if (arg.compare(0, 19, "--profile-generate=") == 0 && arg.size() > 19) {
+            options.profileGenerate = arg.substr(19);
+        } else if (arg.compare(0, 14, "--profile-use=") == 0 && arg.size() > 14) {
+            options.profileUse = arg.substr(14);
+        } else if (arg == "--server" || arg == "--connect") {
+            (arg == "--server" ? options.serverSocket : options.connectSocket) = CompileServer::defaultSocketPath();
+        } else if (arg.compare(0, 9, "--server=") == 0 && arg.size() > 9) {
+            options.serverSocket = arg.substr(9);
+        } else if (arg.compare(0, 10, "--connect=") == 0 && arg.size() > 10) {
+            options.connectSocket = arg.substr(10);
+        } else if (arg == "--stats" || arg == "--stats=table") {
+            options.stats = StatsFormat::TABLE;
+        } else if (arg == "--stats=json") {
+            options.stats = StatsFormat::JSON;
+        } else if (arg.compare(0, 14, "--error-limit=") == 0) {
+            std::string limit = arg.substr(14);
+            if (limit.empty() || limit.find_first_not_of("0123456789") != std::string::npos || limit.size() > 9) {
+                err << "Error: Invalid error limit '" << limit << "'\n";
+                return false;
+            }
+            options.errorLimit = std::stoul(limit);
+        } else if (arg == "--mem-report") {
+            if (!MemoryTracker::compiledIn) {
+                err << "Error: --mem-report needs a compiler built with -DLITHIUM_MEM_TRACKING=ON\n";
+                return false;
+            }
+            options.memoryReport = true;
+        } else if (arg.compare(0, 8, "--trace=") == 0 && arg.size() > 8) {
+            options.traceFile = arg.substr(8);
+        } else if (arg == "--no-peephole") {
+            options.peephole = false;
+        } else if (arg == "--no-layout") {
+            options.layout = false;
+        } else if (arg == "--print-layout") {
+            options.printLayout = true;
+        } else if (arg == "-o" && i + 1 < arguments.size()) {
+            options.outputFile = arguments[++i];
+        } else if (arg == "-j" && i + 1 < arguments.size()) {
+            std::string count = arguments[++i];
+            if (count.empty() || count.find_first_not_of("0123456789") != std::string::npos || count.size() > 4) {
+                err << "Error: Invalid thread count '" << count << "'\n";
+                return false;
+            }
+            options.threads = static_cast<unsigned>(std::stoul(count));
+        } else if (arg == "-t" && i + 1 < arguments.size()) {
+            std::string target = arguments[++i];
             if (target == "exe") {
                 options.targetType = TargetType::EXECUTABLE;
+            } else if (target == "obj") {
+                options.targetType = TargetType::OBJECT;
             } else if (target == "asm") {
                 options.targetType = TargetType::ASSEMBLY;
             } else if (target == "ir") {
                 options.targetType = TargetType::INTERMEDIATE;
+            } else if (target == "bc") {
+                options.targetType = TargetType::BYTECODE;
             } else {
-                std::cerr << "Error: Unknown target type '" << target << "'\n";
+                err << "Error: Unknown target type '" << target << "'\n";
                 return false;
             }
         } else if (arg[0] != '-') {
-            if (options.inputFile.empty()) {
-                options.inputFile = arg;
-            } else {
-                std::cerr << "Error: Multiple input files specified\n";
-                return false;
-            }
+            options.inputFiles.push_back(arg);
         } else {
-            std::cerr << "Error: Unknown option '" << arg << "'\n";
+            err << "Error: Unknown option '" << arg << "'\n";
             return false;
         }
     }
     
-    if (options.inputFile.empty()) {
-        std::cerr << "Error: No input file specified\n";
+    // The server takes its inputs from each request
+    if (!options.serverSocket.empty()) {
+        return true;
+    }
+    
+    if (options.inputFiles.empty()) {
+        err << "Error: No input file specified\n";
+        return false;
+    }
+    if (options.inputFiles.size() > 1 && options.mode != DriverMode::COMPILE) {
+        err << "Error: run and vm take a single input file\n";
+        return false;
+    }
+    options.inputFile = options.inputFiles[0];
+    
+    // The counts are written by the program's _start or by `run`
+    if (!options.profileGenerate.empty() &&
+        (options.mode == DriverMode::VM_RUN ||
+         (options.mode == DriverMode::COMPILE && options.targetType != TargetType::EXECUTABLE &&
+          options.targetType != TargetType::ASSEMBLY && options.targetType != TargetType::INTERMEDIATE))) {
+        err << "Error: --profile-generate needs an exe, asm or ir target, or run\n";
         return false;
     }
     
-    if (options.outputFile.empty()) {
-        std::filesystem::path inputPath(options.inputFile);
-        std::string baseName = inputPath.stem().string();
-        
-        switch (options.targetType) {
-            case TargetType::EXECUTABLE:
-                options.outputFile = baseName;
-                break;
-            case TargetType::ASSEMBLY:
-                options.outputFile = baseName + ".s";
-                break;
-            case TargetType::INTERMEDIATE:
-                options.outputFile = baseName + ".ir";
-                break;
+    if (options.outputFile.empty() && options.mode == DriverMode::COMPILE) {
+        if (options.inputFiles.size() == 1) {
+            options.outputFile = defaultOutputFile(options.inputFile, options.targetType);
+        } else {
+            // Each file gets its own output, so no two may share a name
+            std::unordered_map<std::string, std::string> outputs;
+            for (const auto& input : options.inputFiles) {
+                auto [it, added] = outputs.emplace(defaultOutputFile(input, options.targetType), input);
+                if (!added) {
+                    err << "Error: '" << it->second << "' and '" << input << "' would both be compiled to '"
+                              << it->first << "'\n";
+                    return false;
+                }
+            }
         }
     }
     
     return true;
 }
 
+std::string defaultOutputFile(const std::string& inputFile, TargetType targetType) {
+    std::string baseName = std::filesystem::path(inputFile).stem().string();
+    switch (targetType) {
+        case TargetType::EXECUTABLE:
+            return baseName;
+        case TargetType::OBJECT:
+            return baseName + ".o";
+        case TargetType::ASSEMBLY:
+            return baseName + ".s";
+        case TargetType::INTERMEDIATE:
+            return baseName + ".ir";
+        case TargetType::BYTECODE:
+            return baseName + ".lbc";
+    }
+    return baseName;
+}
+
+std::string resolvePath(const CompilerOptions& options, const std::string& path) {
+    if (options.directory.empty() || path.empty()) {
+        return path;
+    }
+    return (std::filesystem::path(options.directory) / path).string();
+}
+
 std::string readSourceFile(const std::string& filename) {
     std::ifstream file(filename);
     if (!file.is_open()) {
@@ -132,77 +437,448 @@ std::string readSourceFile(const std::string& filename) {
     return buffer.str();
 }
 
-int compileFile(const CompilerOptions& options) {
+std::unique_ptr<ProgramNode> parseSource(const CompilerOptions& options, const std::string& filename,
+                                         ErrorReporter& errorReporter, PhaseTimer& timer, std::ostream& out) {
+    std::string sourceCode;
+    std::string path = resolvePath(options, filename);
+    if (options.cache) {
+        if (auto program = options.cache->find(path, sourceCode)) {
+            if (options.verbose) {
+                out << "Compiling " << filename << " (unchanged, already parsed)...\n";
+            }
+            timer.lap("cache", "AST nodes", timer.counting() ? CompileStats::countNodes(*program) : 0);
+            return program;
+        }
+    }
+    if (sourceCode.empty()) {
+        sourceCode = readSourceFile(path);
+    }
+    
+    if (options.verbose) {
+        out << "Compiling " << filename << "...\n";
+    }
+    
+    Lexer lexer(sourceCode, filename, &errorReporter);
+    std::vector<Token> tokens = lexer.tokenize();
+    timer.lap("lex", "tokens", tokens.size());
+    
+    if (options.debugLexer) {
+        out << "=== TOKENS ===\n";
+        DebugUtils::printTokens(tokens);
+    }
+    
+    if (errorReporter.hasAnyErrors()) {
+        return nullptr;
+    }
+    
+    Parser parser(std::move(tokens), errorReporter);
+    auto program = parser.parseProgram();
+    timer.lap("parse", "AST nodes", timer.counting() ? CompileStats::countNodes(*program) : 0);
+    
+    if (options.debugParser) {
+        out << "=== AST ===\n";
+        DebugUtils::printAST(program.get());
+    }
+    
+    if (errorReporter.hasAnyErrors()) {
+        return nullptr;
+    }
+    if (options.cache) {
+        options.cache->store(path, sourceCode, *program);
+    }
+    return program;
+}
+
+int compileFile(const CompilerOptions& options, std::ostream& out, std::ostream& err, CompileStats* totals) {
+    std::unique_ptr<CompileStats> stats;
+    if (!totals && options.stats != StatsFormat::NONE) {
+        stats = std::make_unique<CompileStats>();
+        totals = stats.get();
+    }
+    
+    int result = EXIT_FAILURE;
     try {
-        std::string sourceCode = readSourceFile(options.inputFile);
+        TraceScope trace("module", options.inputFile);
+        ErrorReporter errorReporter;
+        errorReporter.setErrorLimit(options.errorLimit);
+        PhaseTimer timer(options.verbose, out, totals);
+        auto program = parseSource(options, options.inputFile, errorReporter, timer, out);
+        if (program) {
+            result = compileProgram(options, *program, errorReporter, timer, out, err);
+        } else {
+            errorReporter.printErrors(err);
+        }
         
+    } catch (const std::exception& e) {
+        err << "Error: " << e.what() << std::endl;
+    }
+    if (stats) {
+        printCompileStats(*stats, options.stats, out);
+    }
+    return result;
+}
+
+int compileFiles(const CompilerOptions& options, std::ostream& out, std::ostream& err) {
+    const auto& inputs = options.inputFiles;
+    bool linking = !options.outputFile.empty();
+    unsigned jobs = options.threads ? options.threads : ThreadPool::defaultThreadCount();
+    // Debug dumps go straight to stdout, so they must not interleave, and
+    // phase measurements must not overlap
+    std::unique_ptr<CompileStats> stats;
+    if (options.stats != StatsFormat::NONE) {
+        stats = std::make_unique<CompileStats>();
+    }
+    if (options.debugLexer || options.debugParser || options.debugSemantic || stats) {
+        jobs = 1;
+    }
+    ThreadPool pool(static_cast<unsigned>(std::min<size_t>(jobs, inputs.size())));
+    
+    bool buffered = pool.size() > 1;
+    std::vector<std::ostringstream> outs(inputs.size());
+    std::vector<std::ostringstream> errs(inputs.size());
+    std::vector<int> results(inputs.size(), EXIT_SUCCESS);
+    std::vector<std::unique_ptr<ProgramNode>> programs(inputs.size());
+    
+    pool.parallelFor(inputs.size(), [&](size_t i) {
+        std::ostream& fileOut = buffered ? outs[i] : out;
+        std::ostream& fileErr = buffered ? errs[i] : err;
+        CompilerOptions file = options;
+        file.inputFile = inputs[i];
+        if (!linking) {
+            // Files are the unit of parallelism; each generates code on its own thread
+            file.outputFile = defaultOutputFile(inputs[i], options.targetType);
+            file.threads = 1;
+            results[i] = compileFile(file, fileOut, fileErr, stats.get());
+            return;
+        }
+        try {
+            TraceScope trace("module", inputs[i]);
+            ErrorReporter errorReporter;
+            errorReporter.setErrorLimit(options.errorLimit);
+            PhaseTimer timer(options.verbose, fileOut, stats.get());
+            programs[i] = parseSource(file, inputs[i], errorReporter, timer, fileOut);
+            if (!programs[i]) {
+                errorReporter.printErrors(fileErr);
+                results[i] = EXIT_FAILURE;
+            }
+        } catch (const std::exception& e) {
+            fileErr << "Error: " << e.what() << std::endl;
+            results[i] = EXIT_FAILURE;
+        }
+    });
+    
+    int result = EXIT_SUCCESS;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        out << outs[i].str() << std::flush;
+        err << errs[i].str();
+        if (results[i] != EXIT_SUCCESS) {
+            result = EXIT_FAILURE;
+        }
+    }
+    
+    if (linking && result == EXIT_SUCCESS) {
+        // One program from all the files, in the order they were given
+        auto program = std::make_unique<ProgramNode>();
+        program->setPosition(programs.front()->getPosition());
+        for (auto& part : programs) {
+            for (auto& declaration : part->declarations) {
+                program->declarations.push_back(std::move(declaration));
+            }
+            part.reset();
+        }
         if (options.verbose) {
-            std::cout << "Compiling " << options.inputFile << "...\n";
+            out << "Compiling " << inputs.size() << " files as one program...\n";
         }
-        
-        ErrorReporter errorReporter;
-        
-        Lexer lexer(sourceCode, options.inputFile);
-        std::vector<Token> tokens = lexer.tokenize();
-        
-        if (options.debugLexer) {
-            std::cout << "=== TOKENS ===\n";
-            DebugUtils::printTokens(tokens);
+        try {
+            TraceScope trace("module", "program");
+            ErrorReporter errorReporter;
+            errorReporter.setErrorLimit(options.errorLimit);
+            PhaseTimer timer(options.verbose, out, stats.get());
+            result = compileProgram(options, *program, errorReporter, timer, out, err);
+            
+        } catch (const std::exception& e) {
+            err << "Error: " << e.what() << std::endl;
+            result = EXIT_FAILURE;
         }
-        
-        if (errorReporter.hasAnyErrors()) {
-            errorReporter.printErrors();
-            return EXIT_FAILURE;
+    }
+    if (stats) {
+        printCompileStats(*stats, options.stats, out);
+    }
+    return result;
+}
+
+int compileProgram(const CompilerOptions& options, ProgramNode& program, ErrorReporter& errorReporter,
+                   PhaseTimer& timer, std::ostream& out, std::ostream& err) {
+    // Object files export every function, so only whole programs shrink
+    if (options.deadCodeElimination &&
+        (options.mode != DriverMode::COMPILE || options.targetType != TargetType::OBJECT)) {
+        std::vector<Remark> removals;
+        DeadCodeEliminator eliminator(options.remarks ? &removals : nullptr);
+        eliminator.run(program);
+        printRemarks(removals, err);
+        timer.lap("reachability", "functions removed", eliminator.getRemovedFunctions());
+        if (options.verbose) {
+            out << "  removed " << eliminator.getRemovedFunctions() << " unused functions and "
+                << eliminator.getRemovedIncludes() << " unused includes\n";
         }
-        
-        Parser parser(std::move(tokens), errorReporter);
-        auto program = parser.parseProgram();
-        
-        if (options.debugParser) {
-            std::cout << "=== AST ===\n";
-            DebugUtils::printAST(program.get());
+    }
+    
+    SemanticAnalyzer semanticAnalyzer(errorReporter);
+    bool semanticSuccess = semanticAnalyzer.analyze(&program);
+    timer.lap("semantic", "symbols", semanticAnalyzer.getSymbolCount());
+    
+    if (options.debugSemantic) {
+        out << "=== SEMANTIC ANALYSIS ===\n";
+        out << "Analysis " << (semanticSuccess ? "passed" : "failed") << "\n";
+    }
+    
+    if (errorReporter.hasAnyErrors()) {
+        errorReporter.printErrors(err);
+        return EXIT_FAILURE;
+    }
+    
+    Profile profile;
+    if (!options.profileUse.empty()) {
+        std::string error;
+        if (!profile.read(resolvePath(options, options.profileUse), error)) {
+            err << "Error: " << error << "\n";
+            return EXIT_FAILURE;
         }
-        
-        if (errorReporter.hasAnyErrors()) {
-            errorReporter.printErrors();
+    }
+    
+    std::string outputPath = resolvePath(options, options.outputFile);
+    Target target(options.targetType, outputPath);
+    CodeGenerator codeGenerator(target, errorReporter);
+    codeGenerator.setThreadCount(options.threads);
+    codeGenerator.setInlining(options.inlining);
+    codeGenerator.setSpecialization(options.specialization);
+    codeGenerator.setRemarks(options.remarks);
+    codeGenerator.setDebugInfo(options.debugInfo);
+    codeGenerator.setCompilationDirectory(options.directory);
+    codeGenerator.setProfileGenerate(options.profileGenerate);
+    if (!options.profileUse.empty()) {
+        codeGenerator.setProfileUse(&profile);
+    }
+    codeGenerator.setFunctionLayout(options.layout);
+    codeGenerator.setPeephole(options.peephole);
+    
+    if (options.mode == DriverMode::VM_RUN) {
+        BytecodeModule module;
+        bool bytecodeSuccess = codeGenerator.generateBytecodeInMemory(&program, module);
+        printRemarks(codeGenerator.getRemarks(), err);
+        if (!bytecodeSuccess) {
+            errorReporter.printErrors(err);
             return EXIT_FAILURE;
         }
-        
-        SemanticAnalyzer semanticAnalyzer(errorReporter);
-        bool semanticSuccess = semanticAnalyzer.analyze(program.get());
-        
-        if (options.debugSemantic) {
-            std::cout << "=== SEMANTIC ANALYSIS ===\n";
-            std::cout << "Analysis " << (semanticSuccess ? "passed" : "failed") << "\n";
+        timer.lap("bytecode", "IR instructions", codeGenerator.getInstructionCount());
+        if (options.verbose) {
+            printStringStats(codeGenerator.getStringPool(), out);
+            printPeepholeStats(codeGenerator.getPeepholeHits(), out);
         }
         
-        if (errorReporter.hasAnyErrors()) {
-            errorReporter.printErrors();
-            return EXIT_FAILURE;
+        VirtualMachine vm(module);
+        int exitCode = vm.runMain();
+        timer.lap("run");
+        return exitCode;
+    }
+    
+    if (options.mode == DriverMode::JIT_RUN) {
+        MachineModule module;
+        JitModule jit(errorReporter);
+        bool machineSuccess = codeGenerator.generateInMemory(&program, module);
+        printRemarks(codeGenerator.getRemarks(), err);
+        if (options.printLayout) {
+            printLayout(codeGenerator.getLayout(), out);
         }
-        
-        Target target(options.targetType, options.outputFile);
-        CodeGenerator codeGenerator(target, errorReporter);
-        bool codeGenSuccess = codeGenerator.generate(program.get(), options.outputFile);
-        
-        if (errorReporter.hasAnyErrors()) {
-            errorReporter.printErrors();
+        if (!machineSuccess || !jit.load(module)) {
+            errorReporter.printErrors(err);
             return EXIT_FAILURE;
         }
+        if (options.debugInfo && !jit.writePerfMap()) {
+            err << "Warning: Could not write perf map\n";
+        }
+        timer.lap("jit", "IR instructions", codeGenerator.getInstructionCount());
+        if (options.verbose) {
+            printStringStats(codeGenerator.getStringPool(), out);
+            printPeepholeStats(codeGenerator.getPeepholeHits(), out);
+        }
         
-        if (!codeGenSuccess) {
-            std::cerr << "Error: Code generation failed\n";
-            return EXIT_FAILURE;
+        int exitCode = jit.runMain();
+        timer.lap("run");
+        if (!options.profileGenerate.empty()) {
+            Profile counts;
+            std::string error;
+            if (!jit.readProfile(counts) || !counts.write(options.profileGenerate, error)) {
+                err << "Warning: Could not write profile " << options.profileGenerate << "\n";
+            }
+        }
+        return exitCode;
+    }
+    
+    bool codeGenSuccess = codeGenerator.generate(&program, outputPath);
+    timer.lap("codegen", "IR instructions", codeGenerator.getInstructionCount());
+    printRemarks(codeGenerator.getRemarks(), err);
+    if (options.printLayout) {
+        printLayout(codeGenerator.getLayout(), out);
+    }
+    
+    if (errorReporter.hasAnyErrors()) {
+        errorReporter.printErrors(err);
+        return EXIT_FAILURE;
+    }
+    
+    if (!codeGenSuccess) {
+        err << "Error: Code generation failed\n";
+        return EXIT_FAILURE;
+    }
+    
+    if (options.verbose) {
+        printStringStats(codeGenerator.getStringPool(), out);
+        printPeepholeStats(codeGenerator.getPeepholeHits(), out);
+        out << "Compilation successful. Output: " << options.outputFile << "\n";
+    }
+    
+    return EXIT_SUCCESS;
+}
+
+void printRemarks(const std::vector<Remark>& remarks, std::ostream& err) {
+    for (const auto& remark : remarks) {
+        err << remark.toString() << "\n";
+    }
+}
+
+void printLayout(const FunctionLayout& layout, std::ostream& out) {
+    const auto& order = layout.getOrder();
+    if (order.empty()) {
+        return;
+    }
+    size_t cold = 0;
+    for (const auto& placement : order) {
+        cold += placement.cold ? 1 : 0;
+    }
+    out << "layout (" << (layout.usesProfile() ? "profile" : "static estimate") << "): "
+              << order.size() - cold << " hot, " << cold << " cold\n";
+    for (const auto& placement : order) {
+        out << "  ";
+        if (placement.cold) {
+            out << "cold";
+        } else {
+            out << "[" << placement.cluster << "]";
         }
+        out << " " << placement.function->name << " (" << placement.entries << " entries, size "
+                  << placement.size << ")\n";
+    }
+}
+
+void printStringStats(const StringPool& pool, std::ostream& out) {
+    const auto& stats = pool.getStats();
+    size_t uniqueBytes = 0;
+    for (const auto& entry : pool.getEntries()) {
+        uniqueBytes += entry.bytes.size() + 1;
+    }
+    out << "  strings: " << stats.literals << " literals (" << stats.literalBytes << " bytes), "
+              << pool.getEntries().size() << " unique (" << uniqueBytes << " bytes)";
+    if (!pool.getData().empty()) {
+        out << ", " << pool.getData().size() << " bytes with lengths";
+    }
+    out << ", " << stats.folded << " concatenations folded\n";
+}
+
+void printPeepholeStats(const std::vector<size_t>& hits, std::ostream& out) {
+    const auto& rules = Peephole::rules();
+    size_t total = 0;
+    std::string detail;
+    for (size_t i = 0; i < rules.size() && i < hits.size(); ++i) {
+        total += hits[i];
+        if (hits[i]) {
+            detail += (detail.empty() ? "" : ", ") + std::string(rules[i].name) + " " + std::to_string(hits[i]);
+        }
+    }
+    out << "  peephole: " << total << " rewrites";
+    if (!detail.empty()) {
+        out << " (" << detail << ")";
+    }
+    out << "\n";
+}
+
+void printCompileStats(const CompileStats& stats, StatsFormat format, std::ostream& out) {
+    if (format == StatsFormat::JSON) {
+        stats.printJson(out);
+    } else {
+        stats.printTable(out);
+    }
+}
+
+int runBytecodeFile(const CompilerOptions& options) {
+    try {
+        std::ifstream file(options.inputFile, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Could not open file: " + options.inputFile);
+        }
+        std::stringstream buffer;
+        buffer << file.rdbuf();
         
-        if (options.verbose) {
-            std::cout << "Compilation successful. Output: " << options.outputFile << "\n";
+        BytecodeModule module;
+        std::string error;
+        if (!module.deserialize(buffer.str(), error)) {
+            std::cerr << "Error: " << options.inputFile << ": " << error << std::endl;
+            return EXIT_FAILURE;
         }
         
-        return EXIT_SUCCESS;
+        VirtualMachine vm(module);
+        return vm.runMain();
         
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
         return EXIT_FAILURE;
     }
 }
+
+int runServer(const CompilerOptions& options) {
+    CompileServer server(options.serverSocket);
+    std::string error;
+    if (!server.listen(error)) {
+        std::cerr << "Error: " << error << "\n";
+        return EXIT_FAILURE;
+    }
+    if (options.verbose) {
+        std::cout << "Listening on " << options.serverSocket << "\n";
+    }
+    
+    ModuleCache cache;
+    server.run([&](const std::string& directory, const std::vector<std::string>& arguments, std::ostream& out,
+                   std::ostream& err) {
+        return serveRequest(directory, arguments, cache, out, err);
+    }, options.verbose ? &std::cout : nullptr);
+    
+    if (options.verbose) {
+        auto stats = cache.getStats();
+        std::cout << "Stopped with " << cache.size() << " files cached: " << stats.hits << " hits, "
+                  << stats.rehashed << " touched but unchanged, " << stats.parsed << " parsed\n";
+    }
+    return EXIT_SUCCESS;
+}
+
+int serveRequest(const std::string& directory, const std::vector<std::string>& arguments, ModuleCache& cache,
+                 std::ostream& out, std::ostream& err) {
+    CompilerOptions options;
+    if (!parseArguments(arguments, options, err)) {
+        printUsage("lithium", out);
+        return EXIT_FAILURE;
+    }
+    if (options.mode != DriverMode::COMPILE || !options.serverSocket.empty() || !options.connectSocket.empty()) {
+        err << "Error: The server only compiles files\n";
+        return EXIT_FAILURE;
+    }
+    // A server started with --trace records every request in one trace
+    if (!options.traceFile.empty()) {
+        err << "Error: Start the server with --trace to trace its compiles\n";
+        return EXIT_FAILURE;
+    }
+    options.cache = &cache;
+    options.directory = directory;
+    if (options.inputFiles.size() > 1) {
+        return compileFiles(options, out, err);
+    }
+    return compileFile(options, out, err);
+}
@@ -0,0 +1,112 @@
+#include "memtrack.hpp"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+    // Constant-initialized, so usable by allocations made before main
+    struct Counters {
+        std::atomic<uint64_t> allocations{0};
+        std::atomic<uint64_t> allocatedBytes{0};
+        std::atomic<uint64_t> liveBytes{0};
+        std::atomic<uint64_t> peakBytes{0};
+    };
+
+    constexpr size_t CATEGORIES = static_cast<size_t>(MemoryCategory::COUNT);
+    // One per category, then the total
+    Counters counters[CATEGORIES + 1];
+
+    MemoryTracker::Usage read(const Counters& entry) {
+        MemoryTracker::Usage usage;
+        usage.allocations = entry.allocations.load(std::memory_order_relaxed);
+        usage.allocatedBytes = entry.allocatedBytes.load(std::memory_order_relaxed);
+        usage.liveBytes = entry.liveBytes.load(std::memory_order_relaxed);
+        usage.peakBytes = entry.peakBytes.load(std::memory_order_relaxed);
+        return usage;
+    }
+
+#ifdef LITHIUM_MEM_TRACKING
+    // Keeps the memory handed out aligned like malloc's
+    struct alignas(alignof(std::max_align_t)) Header {
+        size_t size;
+        MemoryCategory category;
+    };
+
+    void charge(Counters& entry, size_t size) {
+        entry.allocations.fetch_add(1, std::memory_order_relaxed);
+        entry.allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+        uint64_t live = entry.liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+        uint64_t peak = entry.peakBytes.load(std::memory_order_relaxed);
+        while (live > peak && !entry.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+        }
+    }
+#endif
+}
+
+#ifdef LITHIUM_MEM_TRACKING
+thread_local MemoryCategory MemoryTracker::current = MemoryCategory::OTHER;
+
+void* MemoryTracker::allocate(std::size_t size) {
+    auto* header = static_cast<Header*>(std::malloc(sizeof(Header) + size));
+    if (!header) {
+        return nullptr;
+    }
+    header->size = size;
+    header->category = current;
+    charge(counters[static_cast<size_t>(current)], size);
+    charge(counters[CATEGORIES], size);
+    return header + 1;
+}
+
+void MemoryTracker::release(void* memory) {
+    if (!memory) {
+        return;
+    }
+    auto* header = static_cast<Header*>(memory) - 1;
+    counters[static_cast<size_t>(header->category)].liveBytes.fetch_sub(header->size, std::memory_order_relaxed);
+    counters[CATEGORIES].liveBytes.fetch_sub(header->size, std::memory_order_relaxed);
+    std::free(header);
+}
+#endif
+
+const char* MemoryTracker::name(MemoryCategory category) {
+    switch (category) {
+        case MemoryCategory::OTHER: return "other";
+        case MemoryCategory::TOKENS: return "tokens";
+        case MemoryCategory::POSITIONS: return "positions";
+        case MemoryCategory::AST: return "AST";
+        case MemoryCategory::SYMBOLS: return "symbols";
+        case MemoryCategory::TYPES: return "types";
+        case MemoryCategory::PASSES: return "passes";
+        case MemoryCategory::IR: return "IR";
+        case MemoryCategory::CODE: return "code";
+        case MemoryCategory::COUNT: break;
+    }
+    return "?";
+}
+
+MemoryTracker::Usage MemoryTracker::usage(MemoryCategory category) {
+    return read(counters[static_cast<size_t>(category)]);
+}
+
+MemoryTracker::Usage MemoryTracker::total() {
+    return read(counters[CATEGORIES]);
+}
+
+void MemoryTracker::printReport(std::ostream& out) {
+    char line[128];
+    std::snprintf(line, sizeof(line), "%-10s %10s %12s %10s %10s\n", "memory", "allocs", "alloc KB", "live KB",
+                  "peak KB");
+    out << line;
+    auto row = [&](const char* name, const Usage& usage) {
+        std::snprintf(line, sizeof(line), "%-10s %10ju %12.1f %10.1f %10.1f\n", name,
+                      static_cast<uintmax_t>(usage.allocations), static_cast<double>(usage.allocatedBytes) / 1024.0,
+                      static_cast<double>(usage.liveBytes) / 1024.0, static_cast<double>(usage.peakBytes) / 1024.0);
+        out << line;
+    };
+    for (size_t i = 0; i < CATEGORIES; ++i) {
+        auto category = static_cast<MemoryCategory>(i);
+        row(name(category), usage(category));
+    }
+    row("total", total());
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// Where heap memory goes, for --mem-report. In a build configured with
+// -DLITHIUM_MEM_TRACKING=ON every allocation made through operator new is
+// charged to the category of the innermost MemoryScope on its thread and
+// carries a small header so its free is charged back. Without it scopes
+// are empty objects and allocations carry no header; operator new is still
+// the replacement in stats.cpp, which counts allocations for --stats while
+// a CompileStats is alive and otherwise goes straight to malloc.
+enum class MemoryCategory {
+    OTHER,
+    TOKENS,
+    POSITIONS, // filename copies in source positions
+    AST,
+    SYMBOLS,
+    TYPES,
+    PASSES,    // call graph, inlining, specialization and layout
+    IR,
+    CODE,      // machine code, listings and bytecode
+    COUNT
+};
+
+class MemoryTracker {
+public:
+    struct Usage {
+        uint64_t allocations = 0;
+        uint64_t allocatedBytes = 0;
+        uint64_t liveBytes = 0;
+        uint64_t peakBytes = 0; // high-water mark of liveBytes
+    };
+
+#ifdef LITHIUM_MEM_TRACKING
+    static constexpr bool compiledIn = true;
+    static thread_local MemoryCategory current;
+
+    // Called by operator new and delete
+    static void* allocate(std::size_t size);
+    static void release(void* memory);
+#else
+    static constexpr bool compiledIn = false;
+#endif
+
+    static const char* name(MemoryCategory category);
+    static Usage usage(MemoryCategory category);
+    // All categories together; the peak is of the sum
+    static Usage total();
+    static void printReport(std::ostream& out);
+};
+
+// Charges allocations on this thread to `category` until destroyed
+#ifdef LITHIUM_MEM_TRACKING
+class MemoryScope {
+private:
+    MemoryCategory previous;
+
+public:
+    explicit MemoryScope(MemoryCategory category) : previous(MemoryTracker::current) {
+        MemoryTracker::current = category;
+    }
+    ~MemoryScope() { MemoryTracker::current = previous; }
+
+    MemoryScope(const MemoryScope&) = delete;
+    MemoryScope& operator=(const MemoryScope&) = delete;
+};
+#else
+class MemoryScope {
+public:
+    explicit MemoryScope(MemoryCategory) {}
+
+    MemoryScope(const MemoryScope&) = delete;
+    MemoryScope& operator=(const MemoryScope&) = delete;
+};
+#endif
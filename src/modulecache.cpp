@@ -0,0 +1,156 @@
+#include "modulecache.hpp"
+#include <fstream>
+#include <sstream>
+#include "memtrack.hpp"
+#include "stringpool.hpp"
+
+namespace {
+    std::unique_ptr<Expression> copyExpression(const Expression& expr) {
+        std::unique_ptr<Expression> result;
+        if (auto* binary = dynamic_cast<const BinaryOp*>(&expr)) {
+            auto node = std::make_unique<BinaryOp>();
+            node->left = binary->left ? copyExpression(*binary->left) : nullptr;
+            node->operator_ = binary->operator_;
+            node->right = binary->right ? copyExpression(*binary->right) : nullptr;
+            result = std::move(node);
+        } else if (auto* call = dynamic_cast<const FunctionCall*>(&expr)) {
+            auto node = std::make_unique<FunctionCall>();
+            node->functionName = call->functionName;
+            for (const auto& argument : call->arguments) {
+                node->arguments.push_back(copyExpression(*argument));
+            }
+            node->requireTailCall = call->requireTailCall;
+            result = std::move(node);
+        } else if (auto* identifier = dynamic_cast<const Identifier*>(&expr)) {
+            result = std::make_unique<Identifier>(identifier->name);
+        } else if (auto* number = dynamic_cast<const NumberLiteral*>(&expr)) {
+            result = std::make_unique<NumberLiteral>(number->value, number->isFloat);
+        } else if (auto* string = dynamic_cast<const StringLiteral*>(&expr)) {
+            result = std::make_unique<StringLiteral>(string->value);
+        } else {
+            return nullptr;
+        }
+        result->setPosition(expr.getPosition());
+        return result;
+    }
+
+    std::unique_ptr<ASTNode> copyDeclaration(const ASTNode& decl) {
+        std::unique_ptr<ASTNode> result;
+        if (auto* function = dynamic_cast<const FunctionDecl*>(&decl)) {
+            auto node = std::make_unique<FunctionDecl>();
+            node->name = function->name;
+            node->parameters = function->parameters;
+            node->returnType = function->returnType;
+            node->body = function->body ? copyExpression(*function->body) : nullptr;
+            result = std::move(node);
+        } else if (auto* var = dynamic_cast<const VarDecl*>(&decl)) {
+            auto node = std::make_unique<VarDecl>(var->name, var->isConst);
+            node->declaredType = var->declaredType;
+            node->initializer = var->initializer ? copyExpression(*var->initializer) : nullptr;
+            result = std::move(node);
+        } else if (auto* include = dynamic_cast<const IncludeDirective*>(&decl)) {
+            result = std::make_unique<IncludeDirective>(include->filename);
+        } else if (auto* import = dynamic_cast<const ImportStatement*>(&decl)) {
+            result = std::make_unique<ImportStatement>(import->moduleName, import->importedName);
+        } else if (auto* selective = dynamic_cast<const SelectiveImport*>(&decl)) {
+            auto node = std::make_unique<SelectiveImport>();
+            node->importedNames = selective->importedNames;
+            node->moduleName = selective->moduleName;
+            result = std::move(node);
+        } else if (auto* expr = dynamic_cast<const Expression*>(&decl)) {
+            result = copyExpression(*expr);
+            if (!result) return nullptr;
+        } else {
+            return nullptr;
+        }
+        result->setPosition(decl.getPosition());
+        return result;
+    }
+}
+
+std::unique_ptr<ProgramNode> ModuleCache::find(const std::string& filename, std::string& source) {
+    std::error_code error;
+    std::string path = key(filename);
+    auto modified = std::filesystem::last_write_time(path, error);
+    uintmax_t size = error ? 0 : std::filesystem::file_size(path, error);
+    if (error) {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.erase(path);
+        return nullptr;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(path);
+        if (it != entries.end() && it->second.modified == modified && it->second.size == size) {
+            ++stats.hits;
+            return copy(*it->second.program);
+        }
+    }
+
+    // The stamp is taken before reading, so a write in between only makes
+    // the next lookup compare contents again
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return nullptr;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    source = buffer.str();
+    uint64_t hash = StringPool::hash(source);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(path);
+    if (it != entries.end() && it->second.hash == hash) {
+        it->second.modified = modified;
+        it->second.size = size;
+        ++stats.rehashed;
+        return copy(*it->second.program);
+    }
+    pending[path] = {modified, size};
+    return nullptr;
+}
+
+void ModuleCache::store(const std::string& filename, const std::string& source, const ProgramNode& program) {
+    std::string path = key(filename);
+    Entry entry{{}, 0, StringPool::hash(source), copy(program)};
+    std::lock_guard<std::mutex> lock(mutex);
+    auto stamp = pending.find(path);
+    if (stamp == pending.end()) {
+        return;
+    }
+    entry.modified = stamp->second.first;
+    entry.size = stamp->second.second;
+    pending.erase(stamp);
+    entries[path] = std::move(entry);
+    ++stats.parsed;
+}
+
+ModuleCache::Stats ModuleCache::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+size_t ModuleCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+std::unique_ptr<ProgramNode> ModuleCache::copy(const ProgramNode& program) {
+    MemoryScope memory(MemoryCategory::AST);
+    auto result = std::make_unique<ProgramNode>();
+    result->setPosition(program.getPosition());
+    for (const auto& decl : program.declarations) {
+        if (!decl) continue;
+        if (auto node = copyDeclaration(*decl)) {
+            result->declarations.push_back(std::move(node));
+        }
+    }
+    return result;
+}
+
+std::string ModuleCache::key(const std::string& filename) {
+    std::error_code error;
+    auto path = std::filesystem::absolute(filename, error);
+    return error ? filename : path.lexically_normal().string();
+}
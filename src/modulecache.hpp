@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include "ast.hpp"
+
+// Parsed source files kept by a long-running compiler between requests.
+// An entry is current while the file's modification time and size are
+// unchanged; when they differ the file is read again and its contents
+// compared by hash, so touching a file does not cost a parse. Later
+// phases change the program they are given, so callers always get a copy.
+// Safe to use from several threads.
+class ModuleCache {
+public:
+    struct Stats {
+        size_t hits = 0;     // mtime and size unchanged
+        size_t rehashed = 0; // stamp changed, contents did not
+        size_t parsed = 0;   // stored after a fresh parse
+    };
+
+private:
+    struct Entry {
+        std::filesystem::file_time_type modified;
+        uintmax_t size;
+        uint64_t hash;
+        std::unique_ptr<ProgramNode> program;
+    };
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+    // Stamps of files read by find() and not stored yet
+    std::unordered_map<std::string, std::pair<std::filesystem::file_time_type, uintmax_t>> pending;
+    Stats stats;
+
+public:
+    // A copy of the program parsed from `filename` when the entry is
+    // current. Otherwise null, with `source` holding the file's contents
+    // if they had to be read to find out.
+    std::unique_ptr<ProgramNode> find(const std::string& filename, std::string& source);
+
+    // Remembers `program` as the parse of `source`, the contents find()
+    // returned for `filename`
+    void store(const std::string& filename, const std::string& source, const ProgramNode& program);
+
+    Stats getStats() const;
+    size_t size() const;
+
+    // Deep copy of a program, positions included
+    static std::unique_ptr<ProgramNode> copy(const ProgramNode& program);
+
+private:
+    static std::string key(const std::string& filename);
+};
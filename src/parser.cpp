@@ -1,10 +1,15 @@
 #include "parser.hpp"
+#include "memtrack.hpp"
 
 Parser::Parser(std::vector<Token> tokenList, ErrorReporter& reporter) 
     : tokens(std::move(tokenList)), currentToken(0), errorReporter(reporter) {}
 
 std::unique_ptr<ProgramNode> Parser::parseProgram() {
+    MemoryScope memory(MemoryCategory::AST);
     auto program = std::make_unique<ProgramNode>();
+    if (!tokens.empty()) {
+        program->setPosition(Position(tokens.front().position.filename));
+    }
     
     // TODO: Implement
     
@@ -0,0 +1,404 @@
+#include "peephole.hpp"
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+
+namespace {
+    bool isArithmetic(const std::string& op, char type) {
+        return op.size() == 5 && op[3] == '.' && op[4] == type &&
+               (op.compare(0, 3, "add") == 0 || op.compare(0, 3, "sub") == 0 ||
+                op.compare(0, 3, "mul") == 0 || op.compare(0, 3, "div") == 0);
+    }
+
+    bool parseInt(const std::string& text, int64_t& value) {
+        char* end = nullptr;
+        errno = 0;
+        long long parsed = std::strtoll(text.c_str(), &end, 10);
+        if (errno != 0 || end == text.c_str() || *end != '\0') return false;
+        value = parsed;
+        return true;
+    }
+
+    bool parseFloat(const std::string& text, double& value) {
+        char* end = nullptr;
+        value = std::strtod(text.c_str(), &end);
+        return end != text.c_str() && *end == '\0';
+    }
+
+    // Shortest text that reads back as the same double
+    std::string floatText(double value) {
+        char buffer[32];
+        for (int precision = 1; precision <= 17; ++precision) {
+            std::snprintf(buffer, sizeof(buffer), "%.*g", precision, value);
+            if (std::strtod(buffer, nullptr) == value) break;
+        }
+        std::string text = buffer;
+        if (text.find_first_of(".e") == std::string::npos) {
+            text += ".0";
+        }
+        return text;
+    }
+
+    bool intConstant(Peephole& pass, const std::string& operand, int64_t& value) {
+        const Instruction* def = pass.definition(operand);
+        return def && def->opcode == "const.i" && parseInt(def->operands[1], value);
+    }
+
+    bool floatConstant(Peephole& pass, const std::string& operand, double& value) {
+        const Instruction* def = pass.definition(operand);
+        return def && def->opcode == "const.f" && parseFloat(def->operands[1], value);
+    }
+
+    // Nothing runs after a return or a tail call
+    bool deadAfterReturn(Peephole& pass, size_t at) {
+        const std::string& op = pass.at(at).opcode;
+        if (op != "ret" && op != "tailcall") return false;
+        bool changed = false;
+        for (size_t i = at + 1; i < pass.functionEnd(); ++i) {
+            const std::string& next = pass.at(i).opcode;
+            if (pass.isRemoved(i) || next.empty() || next.back() == ':') continue;
+            pass.remove(i);
+            changed = true;
+        }
+        return changed;
+    }
+
+    // Integer arithmetic wraps like the targets do; division that would
+    // trap is left for run time
+    bool foldInt(Peephole& pass, size_t at) {
+        Instruction& inst = pass.at(at);
+        int64_t a, b;
+        if (!isArithmetic(inst.opcode, 'i') || !intConstant(pass, inst.operands[1], a) ||
+            !intConstant(pass, inst.operands[2], b)) {
+            return false;
+        }
+        uint64_t ua = static_cast<uint64_t>(a), ub = static_cast<uint64_t>(b);
+        int64_t result;
+        switch (inst.opcode[0]) {
+            case 'a': result = static_cast<int64_t>(ua + ub); break;
+            case 's': result = static_cast<int64_t>(ua - ub); break;
+            case 'm': result = static_cast<int64_t>(ua * ub); break;
+            default:
+                if (b == 0 || (a == std::numeric_limits<int64_t>::min() && b == -1)) return false;
+                result = a / b;
+        }
+        pass.rewrite(at, "const.i", {inst.operands[0], std::to_string(result)});
+        return true;
+    }
+
+    bool foldFloat(Peephole& pass, size_t at) {
+        Instruction& inst = pass.at(at);
+        double a, b;
+        if (!isArithmetic(inst.opcode, 'f') || !floatConstant(pass, inst.operands[1], a) ||
+            !floatConstant(pass, inst.operands[2], b)) {
+            return false;
+        }
+        double result = inst.opcode[0] == 'a' ? a + b : inst.opcode[0] == 's' ? a - b
+                      : inst.opcode[0] == 'm' ? a * b : a / b;
+        if (!std::isfinite(result)) return false;
+        pass.rewrite(at, "const.f", {inst.operands[0], floatText(result)});
+        return true;
+    }
+
+    bool foldConversion(Peephole& pass, size_t at) {
+        Instruction& inst = pass.at(at);
+        int64_t value;
+        if (inst.opcode != "itof" || !intConstant(pass, inst.operands[1], value)) return false;
+        pass.rewrite(at, "const.f", {inst.operands[0], floatText(static_cast<double>(value))});
+        return true;
+    }
+
+    // x+0, 0+x, x-0, x*1, 1*x and x/1
+    bool intIdentity(Peephole& pass, size_t at) {
+        Instruction& inst = pass.at(at);
+        if (!isArithmetic(inst.opcode, 'i')) return false;
+        int64_t value;
+        char kind = inst.opcode[0];
+        int64_t neutral = kind == 'a' || kind == 's' ? 0 : 1;
+        std::string kept;
+        if (intConstant(pass, inst.operands[2], value) && value == neutral) {
+            kept = inst.operands[1];
+        } else if ((kind == 'a' || kind == 'm') && intConstant(pass, inst.operands[1], value) && value == neutral) {
+            kept = inst.operands[2];
+        } else {
+            return false;
+        }
+        pass.rewrite(at, "mov", {inst.operands[0], kept});
+        return true;
+    }
+
+    bool multiplyByZero(Peephole& pass, size_t at) {
+        Instruction& inst = pass.at(at);
+        int64_t value;
+        if (inst.opcode != "mul.i" || !((intConstant(pass, inst.operands[1], value) && value == 0) ||
+                                        (intConstant(pass, inst.operands[2], value) && value == 0))) {
+            return false;
+        }
+        pass.rewrite(at, "const.i", {inst.operands[0], "0"});
+        return true;
+    }
+
+    // x*1.0, 1.0*x and x/1.0; adding zero is not an identity for -0.0
+    bool floatIdentity(Peephole& pass, size_t at) {
+        Instruction& inst = pass.at(at);
+        if (inst.opcode != "mul.f" && inst.opcode != "div.f") return false;
+        double value;
+        std::string kept;
+        if (floatConstant(pass, inst.operands[2], value) && value == 1.0) {
+            kept = inst.operands[1];
+        } else if (inst.opcode == "mul.f" && floatConstant(pass, inst.operands[1], value) && value == 1.0) {
+            kept = inst.operands[2];
+        } else {
+            return false;
+        }
+        pass.rewrite(at, "mov", {inst.operands[0], kept});
+        return true;
+    }
+
+    // Unboxing what was just boxed as the same type gives back the value
+    bool boxUnbox(Peephole& pass, size_t at) {
+        Instruction& inst = pass.at(at);
+        if (inst.opcode.compare(0, 6, "unbox.") != 0) return false;
+        const Instruction* def = pass.definition(inst.operands[1]);
+        if (!def || def->opcode != "box." + inst.opcode.substr(6)) return false;
+        pass.rewrite(at, "mov", {inst.operands[0], def->operands[1]});
+        return true;
+    }
+
+    // The next instruction within the window that touches global `name`,
+    // as long as everything before it is pure
+    size_t nextAccess(Peephole& pass, size_t at, const std::string& name) {
+        size_t seen = 0;
+        for (size_t i = at + 1; i < pass.functionEnd() && seen < Peephole::WINDOW; ++i) {
+            if (pass.isRemoved(i)) continue;
+            ++seen;
+            const Instruction& inst = pass.at(i);
+            if ((inst.opcode == "load" && inst.operands[1] == name) ||
+                (inst.opcode == "store" && inst.operands[0] == name)) {
+                return i;
+            }
+            if (!Peephole::isPure(inst)) break;
+        }
+        return pass.functionEnd();
+    }
+
+    // store @g t; load u @g  =>  store @g t; mov u t
+    bool storeLoad(Peephole& pass, size_t at) {
+        Instruction& inst = pass.at(at);
+        if (inst.opcode != "store") return false;
+        size_t next = nextAccess(pass, at, inst.operands[0]);
+        if (next == pass.functionEnd() || pass.at(next).opcode != "load") return false;
+        pass.rewrite(next, "mov", {pass.at(next).operands[0], inst.operands[1]});
+        return true;
+    }
+
+    // load t @g; load u @g  =>  load t @g; mov u t
+    bool loadLoad(Peephole& pass, size_t at) {
+        Instruction& inst = pass.at(at);
+        if (inst.opcode != "load") return false;
+        size_t next = nextAccess(pass, at, inst.operands[1]);
+        if (next == pass.functionEnd() || pass.at(next).opcode != "load") return false;
+        pass.rewrite(next, "mov", {pass.at(next).operands[0], inst.operands[0]});
+        return true;
+    }
+
+    // load t @g; store @g t  =>  load t @g
+    bool loadStore(Peephole& pass, size_t at) {
+        Instruction& inst = pass.at(at);
+        if (inst.opcode != "load") return false;
+        size_t next = nextAccess(pass, at, inst.operands[1]);
+        if (next == pass.functionEnd() || pass.at(next).opcode != "store" ||
+            pass.at(next).operands[1] != inst.operands[0]) {
+            return false;
+        }
+        pass.remove(next);
+        return true;
+    }
+
+    // mov u t: later uses of u read t instead
+    bool copyPropagation(Peephole& pass, size_t at) {
+        Instruction& inst = pass.at(at);
+        if (inst.opcode != "mov" || !pass.definition(inst.operands[0]) || !pass.definition(inst.operands[1])) {
+            return false;
+        }
+        std::string from = inst.operands[0];
+        std::string to = inst.operands[1];
+        pass.remove(at);
+        pass.replaceUses(at, from, to);
+        return true;
+    }
+
+    bool deadTemporary(Peephole& pass, size_t at) {
+        Instruction& inst = pass.at(at);
+        int dst = Peephole::destination(inst);
+        if (dst < 0 || !Peephole::isPure(inst) || pass.uses(inst.operands[dst]) != 0) return false;
+        pass.remove(at);
+        return true;
+    }
+}
+
+const std::vector<Peephole::Rule>& Peephole::rules() {
+    static const std::vector<Rule> table = {
+        {"dead-after-return", deadAfterReturn},
+        {"fold-int", foldInt},
+        {"fold-float", foldFloat},
+        {"fold-conversion", foldConversion},
+        {"int-identity", intIdentity},
+        {"multiply-by-zero", multiplyByZero},
+        {"float-identity", floatIdentity},
+        {"box-unbox", boxUnbox},
+        {"store-load", storeLoad},
+        {"load-load", loadLoad},
+        {"load-store", loadStore},
+        {"copy-propagation", copyPropagation},
+        {"dead-temporary", deadTemporary},
+    };
+    return table;
+}
+
+void Peephole::addHits(const std::vector<size_t>& other) {
+    for (size_t i = 0; i < hits.size() && i < other.size(); ++i) {
+        hits[i] += other[i];
+    }
+}
+
+int Peephole::destination(const Instruction& inst) {
+    const std::string& op = inst.opcode;
+    if (inst.operands.empty()) return -1;
+    if (op == "param" || op == "load" || op == "mov" || op == "itof" || op == "concat" || op == "concat.n" ||
+        op == "call" || op.compare(0, 6, "const.") == 0 || op.compare(0, 4, "box.") == 0 ||
+        op.compare(0, 6, "unbox.") == 0 || isArithmetic(op, 'i') || isArithmetic(op, 'f') || isArithmetic(op, 'a')) {
+        return 0;
+    }
+    return -1;
+}
+
+bool Peephole::isPure(const Instruction& inst) {
+    const std::string& op = inst.opcode;
+    return op == "load" || op == "mov" || op == "itof" || op.compare(0, 6, "const.") == 0 ||
+           op.compare(0, 4, "box.") == 0 || isArithmetic(op, 'f') ||
+           op == "add.i" || op == "sub.i" || op == "mul.i";
+}
+
+const Instruction* Peephole::definition(const std::string& temp) const {
+    auto count = definitionCounts.find(temp);
+    if (count == definitionCounts.end() || count->second != 1) return nullptr;
+    return &(*code)[definitions.at(temp)];
+}
+
+size_t Peephole::uses(const std::string& temp) const {
+    auto it = useCounts.find(temp);
+    return it != useCounts.end() ? it->second : 0;
+}
+
+void Peephole::countUses(const Instruction& inst, int delta) {
+    int dst = destination(inst);
+    for (size_t i = 0; i < inst.operands.size(); ++i) {
+        if (static_cast<int>(i) != dst && isTemp(inst.operands[i])) {
+            useCounts[inst.operands[i]] += delta;
+        }
+    }
+}
+
+void Peephole::rewrite(size_t index, const std::string& opcode, std::vector<std::string> operands) {
+    Instruction& inst = at(index);
+    countUses(inst, -1);
+    inst.opcode = opcode;
+    inst.operands = std::move(operands);
+    countUses(inst, 1);
+}
+
+void Peephole::remove(size_t index) {
+    Instruction& inst = at(index);
+    countUses(inst, -1);
+    int dst = destination(inst);
+    if (dst >= 0) {
+        --definitionCounts[inst.operands[dst]];
+    }
+    removed[index] = true;
+}
+
+void Peephole::replaceUses(size_t after, const std::string& from, const std::string& to) {
+    for (size_t i = after + 1; i < end; ++i) {
+        if (removed[i]) continue;
+        Instruction& inst = at(i);
+        int dst = destination(inst);
+        for (size_t k = 0; k < inst.operands.size(); ++k) {
+            if (static_cast<int>(k) != dst && inst.operands[k] == from) {
+                inst.operands[k] = to;
+                --useCounts[from];
+                ++useCounts[to];
+            }
+        }
+    }
+}
+
+void Peephole::run(std::vector<Instruction>& instructions) {
+    code = &instructions;
+    for (size_t i = 0; i < instructions.size(); ++i) {
+        if (instructions[i].opcode == "func" && runFunction(i)) {
+            i = end;
+        }
+    }
+    code = nullptr;
+}
+
+// Returns false when the function has no endfunc
+bool Peephole::runFunction(size_t begin) {
+    auto& instructions = *code;
+    for (int round = 0; round < MAX_ROUNDS; ++round) {
+        end = begin + 1;
+        while (end < instructions.size() && instructions[end].opcode != "endfunc") {
+            ++end;
+        }
+        if (end == instructions.size()) {
+            return false;
+        }
+
+        removed.assign(instructions.size(), false);
+        definitions.clear();
+        definitionCounts.clear();
+        useCounts.clear();
+        for (size_t i = begin + 1; i < end; ++i) {
+            int dst = destination(instructions[i]);
+            if (dst >= 0) {
+                definitions[instructions[i].operands[dst]] = i;
+                ++definitionCounts[instructions[i].operands[dst]];
+            }
+        }
+        for (size_t i = begin + 1; i < end; ++i) {
+            countUses(instructions[i], 1);
+        }
+
+        bool changed = false;
+        const auto& table = rules();
+        for (size_t i = begin + 1; i < end; ++i) {
+            for (size_t r = 0; r < table.size() && !removed[i]; ++r) {
+                if (table[r].apply(*this, i)) {
+                    ++hits[r];
+                    changed = true;
+                }
+            }
+        }
+
+        size_t kept = begin + 1;
+        for (size_t i = begin + 1; i < instructions.size(); ++i) {
+            if (i >= end || !removed[i]) {
+                if (kept != i) instructions[kept] = std::move(instructions[i]);
+                ++kept;
+            }
+        }
+        instructions.erase(instructions.begin() + kept, instructions.end());
+        if (!changed) {
+            break;
+        }
+    }
+    end = begin + 1;
+    while (instructions[end].opcode != "endfunc") {
+        ++end;
+    }
+    return true;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "codegen.hpp"
+
+// Rewrites the IR of each function before any target sees it. Rules are
+// declared together in peephole.cpp; each looks at one instruction, the
+// few that follow it and the definitions of its operands. Temporaries are
+// assigned once, so a definition is known wherever it is used. Sweeps over
+// the code repeat until no rule applies, at most MAX_ROUNDS times.
+class Peephole {
+public:
+    static constexpr int MAX_ROUNDS = 8;
+    // Instructions a rule may look ahead over
+    static constexpr size_t WINDOW = 4;
+
+    struct Rule {
+        const char* name;
+        bool (*apply)(Peephole& pass, size_t at);
+    };
+
+    static const std::vector<Rule>& rules();
+
+private:
+    std::vector<Instruction>* code = nullptr;
+    std::vector<bool> removed;
+    std::unordered_map<std::string, size_t> definitions;
+    std::unordered_map<std::string, size_t> definitionCounts;
+    std::unordered_map<std::string, size_t> useCounts;
+    size_t end = 0;
+    std::vector<size_t> hits;
+
+public:
+    Peephole() : hits(rules().size(), 0) {}
+
+    // Rewrites every function in `instructions` in place
+    void run(std::vector<Instruction>& instructions);
+
+    // Times each rule applied, indexed like rules()
+    const std::vector<size_t>& getHits() const { return hits; }
+    void addHits(const std::vector<size_t>& other);
+
+    // For rules: the code being rewritten and what is known about it
+    Instruction& at(size_t index) { return (*code)[index]; }
+    bool isRemoved(size_t index) const { return removed[index]; }
+    size_t functionEnd() const { return end; }
+    // The instruction defining `temp`, or null unless it has exactly one
+    const Instruction* definition(const std::string& temp) const;
+    size_t uses(const std::string& temp) const;
+    bool isTemp(const std::string& operand) const { return definitionCounts.count(operand) != 0; }
+
+    void rewrite(size_t index, const std::string& opcode, std::vector<std::string> operands);
+    void remove(size_t index);
+    // Makes every later use of `from` refer to `to` instead
+    void replaceUses(size_t after, const std::string& from, const std::string& to);
+
+    // Index of the operand an instruction assigns, or -1
+    static int destination(const Instruction& inst);
+    // No effect beyond assigning its destination, and cannot trap
+    static bool isPure(const Instruction& inst);
+
+private:
+    bool runFunction(size_t begin);
+    void countUses(const Instruction& inst, int delta);
+};
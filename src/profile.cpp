@@ -0,0 +1,186 @@
+#include "profile.hpp"
+#include "codegen.hpp"
+#include "stringpool.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace {
+    template <typename T>
+    void put(std::string& out, T value) {
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        out.append(bytes, sizeof(T));
+    }
+
+    template <typename T>
+    T get(const std::string& bytes, size_t& at) {
+        T value;
+        std::memcpy(&value, bytes.data() + at, sizeof(T));
+        at += sizeof(T);
+        return value;
+    }
+
+    // Spells out an expression so that any edit to it changes the text
+    void describe(const Expression& expr, std::string& out) {
+        if (auto* binary = dynamic_cast<const BinaryOp*>(&expr)) {
+            out += '(';
+            out += binary->operator_;
+            for (auto* side : {binary->left.get(), binary->right.get()}) {
+                out += ' ';
+                if (side) describe(*side, out);
+            }
+            out += ')';
+        } else if (auto* call = dynamic_cast<const FunctionCall*>(&expr)) {
+            out += call->requireTailCall ? "tail " : "";
+            out += call->functionName;
+            out += '(';
+            for (const auto& argument : call->arguments) {
+                describe(*argument, out);
+                out += ',';
+            }
+            out += ')';
+        } else if (auto* identifier = dynamic_cast<const Identifier*>(&expr)) {
+            out += identifier->name;
+        } else if (auto* number = dynamic_cast<const NumberLiteral*>(&expr)) {
+            out += number->value;
+        } else if (auto* string = dynamic_cast<const StringLiteral*>(&expr)) {
+            out += '"';
+            out += string->value;
+            out += '"';
+        }
+    }
+
+    uint64_t callSiteKey(uint64_t callerKey, size_t index) {
+        std::string text;
+        put(text, callerKey);
+        put(text, static_cast<uint64_t>(index));
+        return StringPool::hash(text);
+    }
+}
+
+bool Profile::find(uint64_t key, uint64_t& count) const {
+    auto it = counts.find(key);
+    if (it == counts.end()) {
+        return false;
+    }
+    count = it->second;
+    return true;
+}
+
+std::string Profile::serialize() const {
+    std::vector<std::pair<uint64_t, uint64_t>> entries(counts.begin(), counts.end());
+    std::sort(entries.begin(), entries.end());
+    std::string out;
+    put(out, MAGIC);
+    put(out, VERSION);
+    put(out, static_cast<uint64_t>(entries.size()));
+    for (const auto& [key, count] : entries) {
+        put(out, key);
+        put(out, count);
+    }
+    return out;
+}
+
+bool Profile::deserialize(const std::string& bytes, std::string& error) {
+    size_t at = 0;
+    if (bytes.size() < 16 || get<uint32_t>(bytes, at) != MAGIC || get<uint32_t>(bytes, at) != VERSION) {
+        error = "not a Lithium profile";
+        return false;
+    }
+    uint64_t entries = get<uint64_t>(bytes, at);
+    if ((bytes.size() - at) / 16 != entries || (bytes.size() - at) % 16 != 0) {
+        error = "truncated profile";
+        return false;
+    }
+    for (uint64_t i = 0; i < entries; ++i) {
+        uint64_t key = get<uint64_t>(bytes, at);
+        add(key, get<uint64_t>(bytes, at));
+    }
+    return true;
+}
+
+bool Profile::read(const std::string& path, std::string& error) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        error = "could not open " + path;
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    if (!deserialize(buffer.str(), error)) {
+        error = path + ": " + error;
+        return false;
+    }
+    return true;
+}
+
+bool Profile::write(const std::string& path, std::string& error) const {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    std::string bytes = serialize();
+    if (!file.is_open() || !file.write(bytes.data(), static_cast<std::streamsize>(bytes.size())) || !file.flush()) {
+        error = "could not write " + path;
+        return false;
+    }
+    return true;
+}
+
+uint64_t ProfileSites::functionKey(const FunctionDecl& function) {
+    std::string text = function.name + "(";
+    for (const auto& param : function.parameters) {
+        text += param.name + ":" + param.type + ",";
+    }
+    text += ")" + function.returnType + "=";
+    if (function.body) {
+        describe(*function.body, text);
+    }
+    return StringPool::hash(text);
+}
+
+void ProfileSites::build(const CallGraph& graph) {
+    keys.clear();
+    entries.clear();
+    calls.clear();
+    for (const auto* function : graph.getFunctions()) {
+        uint64_t key = functionKey(*function);
+        entries.emplace(function, keys.size());
+        keys.push_back(key);
+        const auto& sites = graph.getCallSites(function);
+        for (size_t i = 0; i < sites.size(); ++i) {
+            calls.emplace(sites[i].call, keys.size());
+            keys.push_back(callSiteKey(key, i));
+        }
+    }
+    uint64_t initKey = StringPool::hash(CodeGenerator::INIT_FUNCTION);
+    const auto& initializerCalls = graph.getInitializerCalls();
+    for (size_t i = 0; i < initializerCalls.size(); ++i) {
+        calls.emplace(initializerCalls[i].call, keys.size());
+        keys.push_back(callSiteKey(initKey, i));
+    }
+}
+
+void ProfileCounts::build(const ProfileSites& sites, const Profile& profile) {
+    uint64_t count;
+    for (const auto& [function, index] : sites.entries) {
+        if (profile.find(sites.keys[index], count)) {
+            entries.emplace(function, count);
+        }
+    }
+    for (const auto& [call, index] : sites.calls) {
+        if (profile.find(sites.keys[index], count)) {
+            calls.emplace(call, count);
+            hottestCall = std::max(hottestCall, count);
+        }
+    }
+}
+
+bool ProfileCounts::isHot(const FunctionCall* call) const {
+    auto it = calls.find(call);
+    return it != calls.end() && it->second > 0 && it->second >= hottestCall / HOT_RATIO;
+}
+
+bool ProfileCounts::isCold(const FunctionCall* call) const {
+    auto it = calls.find(call);
+    return it != calls.end() && it->second == 0;
+}
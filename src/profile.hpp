@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ast.hpp"
+#include "callgraph.hpp"
+
+// Execution counts written by an instrumented build (`--profile-generate`).
+// Function entries and call sites are keyed by a hash of the function's
+// name and source, so a profile taken before an edit still applies to the
+// functions the edit did not touch and is ignored for the ones it did.
+class Profile {
+public:
+    // File layout, little-endian: MAGIC, VERSION, number of entries, then
+    // key/count pairs of 64 bits each. liblithium_rt writes the same.
+    static constexpr uint32_t MAGIC = 0x46504c48; // "HLPF"
+    static constexpr uint32_t VERSION = 1;
+
+private:
+    std::unordered_map<uint64_t, uint64_t> counts;
+
+public:
+    // Counts for a key already present are added, so runs can be merged
+    void add(uint64_t key, uint64_t count) { counts[key] += count; }
+
+    // False when the profile has nothing for the key
+    bool find(uint64_t key, uint64_t& count) const;
+
+    size_t size() const { return counts.size(); }
+
+    // Entries are written in key order, so equal profiles are equal files
+    std::string serialize() const;
+    bool deserialize(const std::string& bytes, std::string& error);
+
+    bool read(const std::string& path, std::string& error);
+    bool write(const std::string& path, std::string& error) const;
+};
+
+// The counters of an instrumented build, numbered in a fixed order: each
+// function's entry followed by its call sites, then the calls made by
+// global initializers
+struct ProfileSites {
+    std::vector<uint64_t> keys;
+    std::unordered_map<const FunctionDecl*, size_t> entries;
+    std::unordered_map<const FunctionCall*, size_t> calls;
+
+    void build(const CallGraph& graph);
+
+    // Hash of the name, signature and body
+    static uint64_t functionKey(const FunctionDecl& function);
+};
+
+// What a profile says about the program being compiled; functions and
+// calls it has no count for are left out
+struct ProfileCounts {
+    std::unordered_map<const FunctionDecl*, uint64_t> entries;
+    std::unordered_map<const FunctionCall*, uint64_t> calls;
+    uint64_t hottestCall = 0;
+
+    void build(const ProfileSites& sites, const Profile& profile);
+
+    // A call site executed at least 1/HOT_RATIO as often as the hottest one
+    static constexpr uint64_t HOT_RATIO = 20;
+
+    bool isHot(const FunctionCall* call) const;
+    // Known to have never run
+    bool isCold(const FunctionCall* call) const;
+};
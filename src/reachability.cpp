@@ -0,0 +1,92 @@
+#include "reachability.hpp"
+#include "callgraph.hpp"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+void DeadCodeEliminator::run(ProgramNode& program) {
+    std::unordered_map<std::string, FunctionDecl*> resolve;
+    std::vector<std::string> roots;
+    for (auto& decl : program.declarations) {
+        if (auto* function = dynamic_cast<FunctionDecl*>(decl.get())) {
+            resolve.emplace(function->name, function);
+        } else if (auto* import = dynamic_cast<ImportStatement*>(decl.get())) {
+            roots.push_back(import->importedName);
+        } else if (auto* selective = dynamic_cast<SelectiveImport*>(decl.get())) {
+            roots.insert(roots.end(), selective->importedNames.begin(), selective->importedNames.end());
+        }
+    }
+    if (!resolve.count("main")) {
+        return;
+    }
+    roots.push_back("main");
+
+    // Only bodies that turn out to be reachable are walked
+    std::unordered_set<std::string> reachable;
+    std::vector<const FunctionDecl*> work;
+    auto reach = [&](const std::string& name) {
+        auto function = resolve.find(name);
+        if (reachable.insert(name).second && function != resolve.end() && function->second->body) {
+            work.push_back(function->second);
+        }
+    };
+    for (const auto& root : roots) {
+        reach(root);
+    }
+    std::vector<FunctionCall*> calls;
+    for (auto& decl : program.declarations) {
+        auto* var = dynamic_cast<VarDecl*>(decl.get());
+        if (var && var->initializer) {
+            CallGraph::collectCalls(*var->initializer, calls);
+        }
+    }
+    while (true) {
+        for (auto* call : calls) {
+            reach(call->functionName);
+        }
+        calls.clear();
+        if (work.empty()) {
+            break;
+        }
+        const FunctionDecl* function = work.back();
+        work.pop_back();
+        CallGraph::collectCalls(*function->body, calls);
+    }
+
+    std::unordered_set<std::string> usedFiles;
+    for (auto& decl : program.declarations) {
+        // Globals are always kept
+        auto* function = dynamic_cast<FunctionDecl*>(decl.get());
+        if ((function && reachable.count(function->name)) || dynamic_cast<VarDecl*>(decl.get())) {
+            usedFiles.insert(decl->getPosition().filename);
+        }
+    }
+
+    auto removed = std::remove_if(program.declarations.begin(), program.declarations.end(),
+                                  [&](const std::unique_ptr<ASTNode>& decl) {
+        if (auto* function = dynamic_cast<FunctionDecl*>(decl.get())) {
+            if (reachable.count(function->name)) {
+                return false;
+            }
+            ++removedFunctions;
+            if (remarks) {
+                remarks->emplace_back(function->getPosition(), "dce",
+                                      "removed '" + function->name + "': not reachable from 'main'");
+            }
+            return true;
+        }
+        if (auto* include = dynamic_cast<IncludeDirective*>(decl.get())) {
+            if (usedFiles.count(include->filename)) {
+                return false;
+            }
+            ++removedIncludes;
+            if (remarks) {
+                remarks->emplace_back(include->getPosition(), "dce",
+                                      "removed include of '" + include->filename + "': no function in it is used");
+            }
+            return true;
+        }
+        return false;
+    });
+    program.declarations.erase(removed, program.declarations.end());
+}
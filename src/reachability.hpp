@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "ast.hpp"
+#include "error.hpp"
+
+// Removes the functions nothing reachable from `main` calls, before any
+// later phase looks at them. The roots are `main`, every call made by a
+// global initializer and every name an import refers to. An include whose
+// file contributes no reachable function is removed as well. A program
+// without `main` is a library whose every function is exported, so it is
+// left alone.
+class DeadCodeEliminator {
+private:
+    std::vector<Remark>* remarks;
+    size_t removedFunctions;
+    size_t removedIncludes;
+
+public:
+    // Every removal is explained in `remarkSink` when it is given
+    explicit DeadCodeEliminator(std::vector<Remark>* remarkSink = nullptr)
+        : remarks(remarkSink), removedFunctions(0), removedIncludes(0) {}
+
+    void run(ProgramNode& program);
+
+    size_t getRemovedFunctions() const { return removedFunctions; }
+    size_t getRemovedIncludes() const { return removedIncludes; }
+};
@@ -1,4 +1,6 @@
 #include "semantic.hpp"
+#include "memtrack.hpp"
+#include "trace.hpp"
 
 SymbolTable::SymbolTable() {
     enterScope();
@@ -24,6 +26,7 @@ bool SymbolTable::declareSymbol(const std::string& name, std::unique_ptr<Type> t
     }
     
     currentScope[name] = std::make_unique<Symbol>(name, std::move(type), isConst, position);
+    ++declaredCount;
     return true;
 }
 
@@ -42,10 +45,52 @@ bool SymbolTable::isSymbolInCurrentScope(const std::string& name) {
     return scopes.back().find(name) != scopes.back().end();
 }
 
+// Follows the typing rules code generation applies, without reporting
+// anything: an expression that does not type-check is `any` here and an
+// error when it is lowered. A function's symbol carries its return type.
+std::unique_ptr<Type> TypeChecker::inferType(Expression* expr, SymbolTable& symbolTable) {
+    MemoryScope memory(MemoryCategory::TYPES);
+    if (auto* number = dynamic_cast<NumberLiteral*>(expr)) {
+        return std::make_unique<PrimitiveTypeImpl>(number->isFloat ? PrimitiveType::FLOAT : PrimitiveType::INT, true);
+    }
+    if (dynamic_cast<StringLiteral*>(expr)) {
+        return std::make_unique<PrimitiveTypeImpl>(PrimitiveType::STRING, true);
+    }
+    
+    std::string name;
+    if (auto* identifier = dynamic_cast<Identifier*>(expr)) {
+        name = identifier->name;
+    } else if (auto* call = dynamic_cast<FunctionCall*>(expr)) {
+        name = call->functionName;
+    } else if (auto* binary = dynamic_cast<BinaryOp*>(expr)) {
+        if (!binary->left || !binary->right) {
+            return PrimitiveTypeImpl::createAny();
+        }
+        PrimitiveType left = inferType(binary->left.get(), symbolTable)->getPrimitiveType();
+        PrimitiveType right = inferType(binary->right.get(), symbolTable)->getPrimitiveType();
+        PrimitiveType result = PrimitiveType::ANY;
+        if (left == PrimitiveType::INT && right == PrimitiveType::INT) {
+            result = PrimitiveType::INT;
+        } else if (TypeUtils::isNumericType(left) && TypeUtils::isNumericType(right)) {
+            result = PrimitiveType::FLOAT;
+        } else if (binary->operator_ == "+" && left == PrimitiveType::STRING && right == PrimitiveType::STRING) {
+            result = PrimitiveType::STRING;
+        }
+        return std::make_unique<PrimitiveTypeImpl>(result, true);
+    }
+    
+    Symbol* symbol = name.empty() ? nullptr : symbolTable.lookupSymbol(name);
+    if (!symbol || !symbol->type) {
+        return PrimitiveTypeImpl::createAny();
+    }
+    return std::make_unique<PrimitiveTypeImpl>(symbol->type->getPrimitiveType(), true);
+}
+
 SemanticAnalyzer::SemanticAnalyzer(ErrorReporter& reporter) 
     : typeChecker(reporter), errorReporter(reporter) {}
 
 bool SemanticAnalyzer::analyze(ProgramNode* program) {
+    MemoryScope memory(MemoryCategory::SYMBOLS);
     // TODO: Implement actual semantic analysis
     if (program) {
         program->accept(*this);
@@ -54,10 +99,15 @@ bool SemanticAnalyzer::analyze(ProgramNode* program) {
 }
 
 void SemanticAnalyzer::visit(ProgramNode& node) {
-    // TODO: Implement 
+    for (auto& declaration : node.declarations) {
+        if (declaration) {
+            declaration->accept(*this);
+        }
+    }
 }
 
 void SemanticAnalyzer::visit(FunctionDecl& node) {
+    TraceScope trace("semantic", node.name);
     // TODO: Implement 
 }
 
@@ -22,6 +22,7 @@ public:
 class SymbolTable {
 private:
     std::vector<std::unordered_map<std::string, std::unique_ptr<Symbol>>> scopes;
+    size_t declaredCount = 0;
     
 public:
     SymbolTable();
@@ -36,6 +37,8 @@ public:
     bool isSymbolInCurrentScope(const std::string& name);
     
     size_t getCurrentScopeLevel() const { return scopes.size(); }
+    // Symbols declared in any scope so far
+    size_t getDeclaredCount() const { return declaredCount; }
 };
 
 class TypeChecker {
@@ -63,6 +66,7 @@ public:
     explicit SemanticAnalyzer(ErrorReporter& reporter);
     
     bool analyze(ProgramNode* program);
+    size_t getSymbolCount() const { return symbolTable.getDeclaredCount(); }
     
     void visit(ProgramNode& node) override;
     void visit(FunctionDecl& node) override;
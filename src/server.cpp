@@ -0,0 +1,264 @@
+#include "server.hpp"
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+    volatile std::sig_atomic_t stopRequested = 0;
+
+    void requestStop(int) {
+        stopRequested = 1;
+    }
+
+    bool writeAll(int fd, const char* data, size_t length) {
+        while (length > 0) {
+            ssize_t written = ::send(fd, data, length, MSG_NOSIGNAL);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            data += written;
+            length -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    bool readAll(int fd, char* data, size_t length) {
+        while (length > 0) {
+            ssize_t got = ::read(fd, data, length);
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) return false;
+            data += got;
+            length -= static_cast<size_t>(got);
+        }
+        return true;
+    }
+
+    bool sendStrings(int fd, const std::vector<std::string>& strings) {
+        std::string message;
+        auto put = [&](uint32_t value) { message.append(reinterpret_cast<const char*>(&value), sizeof(value)); };
+        put(static_cast<uint32_t>(strings.size()));
+        for (const auto& string : strings) {
+            put(static_cast<uint32_t>(string.size()));
+            message += string;
+        }
+        return message.size() <= CompileServer::MAX_MESSAGE && writeAll(fd, message.data(), message.size());
+    }
+
+    bool receiveStrings(int fd, std::vector<std::string>& strings) {
+        uint32_t count;
+        if (!readAll(fd, reinterpret_cast<char*>(&count), sizeof(count))) return false;
+        size_t total = 0;
+        strings.clear();
+        for (uint32_t i = 0; i < count; ++i) {
+            uint32_t length;
+            if (!readAll(fd, reinterpret_cast<char*>(&length), sizeof(length))) return false;
+            total += length + sizeof(length);
+            if (total > CompileServer::MAX_MESSAGE) return false;
+            std::string string(length, '\0');
+            if (!readAll(fd, string.data(), length)) return false;
+            strings.push_back(std::move(string));
+        }
+        return true;
+    }
+
+    bool socketAddress(const std::string& path, sockaddr_un& address) {
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(address.sun_path)) return false;
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        return true;
+    }
+
+    // Whether the process at the other end runs as this user
+    bool sameUser(int fd) {
+        ucred credentials;
+        socklen_t length = sizeof(credentials);
+        return ::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) == 0 &&
+               credentials.uid == ::geteuid();
+    }
+
+    // The default socket lives in a directory only its user can enter, so
+    // nobody else can reach it or bind its name first. It is created if
+    // missing; one that already exists must be a real directory of ours
+    // with no access for anyone else.
+    bool privateDirectory(const std::string& directory, std::string& error) {
+        if (::mkdir(directory.c_str(), 0700) != 0 && errno != EEXIST) {
+            error = directory + ": " + std::strerror(errno);
+            return false;
+        }
+        struct stat info;
+        if (::lstat(directory.c_str(), &info) != 0 || !S_ISDIR(info.st_mode) || info.st_uid != ::geteuid() ||
+            (info.st_mode & 077) != 0) {
+            error = directory + " must be a directory owned by this user and closed to everyone else";
+            return false;
+        }
+        return true;
+    }
+
+    // Connected socket, or -1
+    int connectTo(const std::string& path) {
+        sockaddr_un address;
+        if (!socketAddress(path, address)) return -1;
+        int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+}
+
+CompileServer::CompileServer(std::string path) : socketPath(std::move(path)), listener(-1) {}
+
+CompileServer::~CompileServer() {
+    if (listener >= 0) {
+        ::close(listener);
+        ::unlink(socketPath.c_str());
+    }
+}
+
+bool CompileServer::listen(std::string& error) {
+    // The socket is unlinked on exit, so its name must not depend on the
+    // working directory
+    std::error_code absoluteError;
+    auto absolute = std::filesystem::absolute(socketPath, absoluteError);
+    if (!absoluteError) {
+        socketPath = absolute.lexically_normal().string();
+    }
+    sockaddr_un address;
+    if (!socketAddress(socketPath, address)) {
+        error = "invalid socket path '" + socketPath + "'";
+        return false;
+    }
+    if (socketPath == std::filesystem::path(defaultSocketPath()).lexically_normal().string() &&
+        !privateDirectory(std::filesystem::path(socketPath).parent_path().string(), error)) {
+        return false;
+    }
+    int running = connectTo(socketPath);
+    if (running >= 0) {
+        ::close(running);
+        error = "a server is already listening on " + socketPath;
+        return false;
+    }
+    ::unlink(socketPath.c_str());
+
+    // Connecting needs write access to the socket file, which only the
+    // owner gets
+    listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    mode_t mask = ::umask(077);
+    bool bound = listener >= 0 && ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+    ::umask(mask);
+    if (!bound || ::listen(listener, 16) != 0) {
+        error = socketPath + ": " + std::strerror(errno);
+        if (listener >= 0) {
+            ::close(listener);
+            listener = -1;
+        }
+        return false;
+    }
+    return true;
+}
+
+void CompileServer::run(const Handler& handler, std::ostream* log) {
+    // Without SA_RESTART, a signal interrupts accept() so the loop can end
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = requestStop;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    while (!stopRequested) {
+        int client = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break;
+        }
+        // A client that stalls must not hold up the ones behind it
+        timeval timeout = {CLIENT_TIMEOUT_SECONDS, 0};
+        ::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        ::setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        std::vector<std::string> request;
+        if (!sameUser(client) || !receiveStrings(client, request) || request.empty()) {
+            ::close(client);
+            continue;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::ostringstream out;
+        std::ostringstream err;
+        int exitCode = EXIT_FAILURE;
+        std::vector<std::string> arguments(request.begin() + 1, request.end());
+        std::error_code directoryError;
+        const std::string& directory = request[0];
+        if (!std::filesystem::path(directory).is_absolute() ||
+            !std::filesystem::is_directory(directory, directoryError)) {
+            err << "Error: " << directory << " is not a directory\n";
+        } else {
+            try {
+                exitCode = handler(directory, arguments, out, err);
+            } catch (const std::exception& e) {
+                err << "Error: " << e.what() << "\n";
+            }
+        }
+        sendStrings(client, {std::to_string(exitCode), out.str(), err.str()});
+        ::close(client);
+
+        if (log) {
+            *log << "[" << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+                 << " ms] exit " << exitCode << ":";
+            for (const auto& argument : arguments) {
+                *log << " " << argument;
+            }
+            *log << std::endl;
+        }
+    }
+}
+
+std::string CompileServer::defaultSocketPath() {
+    const char* runtimeDirectory = std::getenv("XDG_RUNTIME_DIR");
+    if (runtimeDirectory && runtimeDirectory[0] == '/') {
+        return std::string(runtimeDirectory) + "/lithium.sock";
+    }
+    return "/tmp/lithium-" + std::to_string(::geteuid()) + "/server.sock";
+}
+
+bool CompileClient::request(const std::string& socketPath, const std::string& directory,
+                            const std::vector<std::string>& arguments, int& exitCode, std::string& out,
+                            std::string& err) {
+    // Whoever bound the name first gets the working directory and command
+    // line, so only a server running as this user is trusted with them
+    int fd = connectTo(socketPath);
+    if (fd < 0) {
+        return false;
+    }
+    if (!sameUser(fd)) {
+        ::close(fd);
+        return false;
+    }
+    std::vector<std::string> message = {directory};
+    message.insert(message.end(), arguments.begin(), arguments.end());
+    std::vector<std::string> reply;
+    bool answered = sendStrings(fd, message) && receiveStrings(fd, reply) && reply.size() == 3;
+    ::close(fd);
+    if (!answered) {
+        return false;
+    }
+    exitCode = std::atoi(reply[0].c_str());
+    out = std::move(reply[1]);
+    err = std::move(reply[2]);
+    return true;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// A compiler that stays running between builds, so each build skips
+// process start and finds unchanged files already parsed. Clients connect
+// to a Unix domain socket and send their working directory and command
+// line; the reply is the exit code and everything the compile printed.
+// Requests are served one at a time. The server never changes its own
+// working directory: the handler resolves relative paths against the
+// client's. The socket is only usable by the user who started the server:
+// its file is mode 0600 and each side checks that the other runs as the
+// same user.
+//
+// Every message is a list of strings: a 32-bit count, then each string as
+// a 32-bit length and its bytes, in host byte order.
+class CompileServer {
+public:
+    using Handler = std::function<int(const std::string& directory, const std::vector<std::string>& arguments,
+                                      std::ostream& out, std::ostream& err)>;
+
+    // Largest message either side accepts
+    static constexpr size_t MAX_MESSAGE = 64u << 20;
+    // A client that sends its request or reads the reply no faster than
+    // this is dropped
+    static constexpr int CLIENT_TIMEOUT_SECONDS = 5;
+
+private:
+    std::string socketPath;
+    int listener;
+
+public:
+    explicit CompileServer(std::string path);
+    ~CompileServer();
+
+    CompileServer(const CompileServer&) = delete;
+    CompileServer& operator=(const CompileServer&) = delete;
+
+    // Fails if another server already answers on the socket; a stale
+    // socket file left by one that died is replaced. A relative socket
+    // path is made absolute first.
+    bool listen(std::string& error);
+
+    // Serves requests until SIGINT or SIGTERM, then removes the socket.
+    // Each request is noted on `log` when it is given.
+    void run(const Handler& handler, std::ostream* log);
+
+    // $XDG_RUNTIME_DIR/lithium.sock, or /tmp/lithium-<uid>/server.sock,
+    // whose directory listen() creates private to the user
+    static std::string defaultSocketPath();
+};
+
+class CompileClient {
+public:
+    // Has the server compile `arguments` in `directory`. False if no server
+    // of this user answers, in which case the caller should compile by
+    // itself.
+    static bool request(const std::string& socketPath, const std::string& directory,
+                        const std::vector<std::string>& arguments, int& exitCode, std::string& out,
+                        std::string& err);
+};
@@ -0,0 +1,291 @@
+#include "specializer.hpp"
+#include "semantic.hpp"
+#include <algorithm>
+#include <deque>
+
+namespace {
+    std::string signatureText(const std::vector<PrimitiveType>& types) {
+        std::string text = "(";
+        for (size_t i = 0; i < types.size(); ++i) {
+            text += (i ? ", " : "") + TypeUtils::primitiveTypeToString(types[i]);
+        }
+        return text + ")";
+    }
+}
+
+std::string Specializer::specializedName(const FunctionDecl& function, const std::vector<PrimitiveType>& argumentTypes,
+                                         std::vector<PrimitiveType>& parameterTypes) {
+    parameterTypes.clear();
+    bool specialized = false;
+    for (size_t i = 0; i < function.parameters.size(); ++i) {
+        PrimitiveType declared = TypeUtils::stringToPrimitiveType(function.parameters[i].type);
+        if (declared == PrimitiveType::ANY && i < argumentTypes.size() && TypeUtils::isNumericType(argumentTypes[i])) {
+            declared = argumentTypes[i];
+            specialized = true;
+        }
+        parameterTypes.push_back(declared);
+    }
+    if (!specialized) {
+        return "";
+    }
+
+    // Not a valid identifier, so it cannot collide with a user function
+    std::string name = function.name;
+    for (PrimitiveType type : parameterTypes) {
+        name += "." + TypeUtils::primitiveTypeToString(type);
+    }
+    return name;
+}
+
+PrimitiveType Specializer::typeOf(Expression& expr) {
+    return typeChecker.inferType(&expr, symbolTable)->getPrimitiveType();
+}
+
+// Operations the generic version checks at run time must be valid for the
+// concrete types, or the copy would not compile
+bool Specializer::typeChecks(Expression& expr) {
+    if (auto* binary = dynamic_cast<BinaryOp*>(&expr)) {
+        if (!binary->left || !binary->right || !typeChecks(*binary->left) || !typeChecks(*binary->right)) {
+            return false;
+        }
+        PrimitiveType left = typeOf(*binary->left);
+        PrimitiveType right = typeOf(*binary->right);
+        if (TypeUtils::isNumericType(left) && TypeUtils::isNumericType(right)) {
+            return true;
+        }
+        if (binary->operator_ == "+" && left == PrimitiveType::STRING && right == PrimitiveType::STRING) {
+            return true;
+        }
+        return (left == PrimitiveType::ANY || right == PrimitiveType::ANY) && left != PrimitiveType::VOID &&
+               right != PrimitiveType::VOID;
+    }
+    if (auto* call = dynamic_cast<FunctionCall*>(&expr)) {
+        auto callee = functionsByName.find(call->functionName);
+        for (size_t i = 0; i < call->arguments.size(); ++i) {
+            if (!typeChecks(*call->arguments[i])) {
+                return false;
+            }
+            if (callee == functionsByName.end() || i >= callee->second->parameters.size()) {
+                continue;
+            }
+            PrimitiveType parameter = TypeUtils::stringToPrimitiveType(callee->second->parameters[i].type);
+            PrimitiveType argument = typeOf(*call->arguments[i]);
+            if (argument != PrimitiveType::ANY && !TypeUtils::canImplicitlyConvert(argument, parameter)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Checks the body with the copy's parameters in scope
+bool Specializer::typeChecks(const Specialization& copy) {
+    symbolTable.enterScope();
+    declareParameters(*copy.function, copy.parameterTypes);
+    bool valid = typeChecks(*copy.function->body);
+    PrimitiveType returnType = TypeUtils::stringToPrimitiveType(copy.function->returnType);
+    PrimitiveType bodyType = typeOf(*copy.function->body);
+    if (returnType != PrimitiveType::VOID && bodyType != PrimitiveType::ANY &&
+        !TypeUtils::canImplicitlyConvert(bodyType, returnType)) {
+        valid = false;
+    }
+    symbolTable.exitScope();
+    return valid;
+}
+
+void Specializer::declareParameters(const FunctionDecl& function, const std::vector<PrimitiveType>& types) {
+    for (size_t i = 0; i < function.parameters.size(); ++i) {
+        const auto& param = function.parameters[i];
+        symbolTable.declareSymbol(param.name, std::make_unique<PrimitiveTypeImpl>(types[i]), false, param.position);
+    }
+}
+
+// Name of the copy a call would use, or an empty string
+std::string Specializer::signatureAt(const CallSite& site, std::vector<PrimitiveType>& parameterTypes) {
+    FunctionDecl* callee = site.callee;
+    if (!callee || !callee->body || callee->parameters.size() != site.call->arguments.size()) {
+        return "";
+    }
+    std::vector<PrimitiveType> argumentTypes;
+    for (auto& argument : site.call->arguments) {
+        argumentTypes.push_back(typeOf(*argument));
+    }
+    return specializedName(*callee, argumentTypes, parameterTypes);
+}
+
+// Adds up the profile counts of the calls to each signature from the
+// functions as written; calls first seen in a copy count as never run
+std::unordered_map<const FunctionDecl*, std::unordered_set<std::string>> Specializer::hottestSignatures(
+    const CallGraph& graph) {
+    std::unordered_map<const FunctionDecl*, std::unordered_map<std::string, uint64_t>> heat;
+    auto addCalls = [&](const std::vector<CallSite>& sites) {
+        std::vector<PrimitiveType> parameterTypes;
+        for (const auto& site : sites) {
+            std::string name = signatureAt(site, parameterTypes);
+            auto count = profile->calls.find(site.call);
+            if (!name.empty() && count != profile->calls.end()) {
+                heat[site.callee][name] += count->second;
+            }
+        }
+    };
+    addCalls(graph.getInitializerCalls());
+    for (auto* function : graph.getFunctions()) {
+        std::vector<PrimitiveType> declared;
+        for (const auto& param : function->parameters) {
+            declared.push_back(TypeUtils::stringToPrimitiveType(param.type));
+        }
+        symbolTable.enterScope();
+        declareParameters(*function, declared);
+        addCalls(graph.getCallSites(function));
+        symbolTable.exitScope();
+    }
+
+    std::unordered_map<const FunctionDecl*, std::unordered_set<std::string>> hottest;
+    for (auto& [function, signatures] : heat) {
+        if (signatures.size() <= MAX_SPECIALIZATIONS) {
+            continue;
+        }
+        std::vector<std::pair<uint64_t, std::string>> ranked;
+        for (auto& [name, count] : signatures) {
+            ranked.emplace_back(count, name);
+        }
+        std::sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) {
+            return a.first != b.first ? a.first > b.first : a.second < b.second;
+        });
+        auto& kept = hottest[function];
+        for (size_t i = 0; i < MAX_SPECIALIZATIONS; ++i) {
+            kept.insert(ranked[i].second);
+        }
+    }
+    return hottest;
+}
+
+void Specializer::run(const CallGraph& graph, const std::vector<VarDecl*>& variables,
+                      const std::unordered_set<const FunctionCall*>& inlineSites,
+                      std::vector<Specialization>& specializations) {
+    const auto& functions = graph.getFunctions();
+    std::unordered_map<const FunctionDecl*, size_t> sourceIndex;
+    for (size_t i = 0; i < functions.size(); ++i) {
+        sourceIndex.emplace(functions[i], i);
+        functionsByName.emplace(functions[i]->name, functions[i]);
+        symbolTable.declareSymbol(functions[i]->name,
+                                  std::make_unique<PrimitiveTypeImpl>(
+                                      TypeUtils::stringToPrimitiveType(functions[i]->returnType)),
+                                  true, functions[i]->getPosition());
+    }
+    for (auto* var : variables) {
+        std::unique_ptr<Type> type;
+        if (var->declaredType.empty() && var->initializer) {
+            type = typeChecker.inferType(var->initializer.get(), symbolTable);
+        } else {
+            type = std::make_unique<PrimitiveTypeImpl>(TypeUtils::stringToPrimitiveType(var->declaredType));
+        }
+        symbolTable.declareSymbol(var->name, std::move(type), var->isConst, var->getPosition());
+    }
+
+    std::unordered_map<std::string, size_t> created;
+    std::unordered_set<std::string> illTyped;
+    std::unordered_set<std::string> overLimit;
+    std::unordered_map<const FunctionDecl*, size_t> counts;
+    std::deque<Specialization> pending;
+    std::vector<Specialization> found;
+    std::unordered_map<const FunctionDecl*, std::unordered_set<std::string>> hottest;
+    if (profile) {
+        hottest = hottestSignatures(graph);
+    }
+
+    auto refuse = [&](const CallSite& site, const std::vector<PrimitiveType>& types, const std::string& caller,
+                      const std::string& reason) {
+        if (remarks) {
+            remarks->emplace_back(site.call->getPosition(), "specialize",
+                                  "'" + site.callee->name + "' not specialized for " + signatureText(types) + " in '" +
+                                  caller + "': " + reason + ", using the generic version");
+        }
+    };
+
+    auto visitCalls = [&](const std::vector<CallSite>& sites, const std::string& caller) {
+        for (const auto& site : sites) {
+            FunctionDecl* callee = site.callee;
+            std::vector<PrimitiveType> parameterTypes;
+            std::string name = signatureAt(site, parameterTypes);
+            if (name.empty() || illTyped.count(name)) {
+                continue;
+            }
+
+            bool inlined = inlineSites.count(site.call) > 0;
+            auto known = created.find(name);
+            if (known != created.end() && (inlined || !found[known->second].inlinedOnly)) {
+                continue;
+            }
+            if (!inlined && overLimit.count(name)) {
+                continue;
+            }
+            if (!inlined && profile && profile->isCold(site.call)) {
+                refuse(site, parameterTypes, caller, "call never ran in the profile");
+                continue;
+            }
+            auto ranking = hottest.find(callee);
+            if (!inlined && ranking != hottest.end() && !ranking->second.count(name)) {
+                overLimit.insert(name);
+                refuse(site, parameterTypes, caller, "not among the " + std::to_string(MAX_SPECIALIZATIONS) +
+                       " signatures called most in the profile");
+                continue;
+            }
+            if (!inlined && counts[callee] >= MAX_SPECIALIZATIONS) {
+                overLimit.insert(name);
+                refuse(site, parameterTypes, caller, "limit of " + std::to_string(MAX_SPECIALIZATIONS) + " reached");
+                continue;
+            }
+
+            Specialization copy{callee, name, parameterTypes, inlined};
+            if (known == created.end() && !typeChecks(copy)) {
+                illTyped.insert(name);
+                if (!inlined) {
+                    refuse(site, parameterTypes, caller, "body does not type-check");
+                }
+                continue;
+            }
+
+            if (!inlined) {
+                ++counts[callee];
+                if (remarks) {
+                    remarks->emplace_back(site.call->getPosition(), "specialize",
+                                          "specialized '" + callee->name + "' for " + signatureText(parameterTypes) +
+                                          " in '" + caller + "' as '" + name + "'");
+                }
+            }
+            if (known != created.end()) {
+                // Already scanned when it was first expanded inline
+                found[known->second].inlinedOnly = false;
+                continue;
+            }
+            created.emplace(name, found.size());
+            found.push_back(copy);
+            pending.push_back(std::move(copy));
+        }
+    };
+
+    // Functions as written are scanned first, then each copy as it is made
+    visitCalls(graph.getInitializerCalls(), "global initializers");
+    for (auto* function : functions) {
+        pending.push_back({function, function->name, {}, false});
+        for (const auto& param : function->parameters) {
+            pending.back().parameterTypes.push_back(TypeUtils::stringToPrimitiveType(param.type));
+        }
+    }
+
+    while (!pending.empty()) {
+        Specialization version = std::move(pending.front());
+        pending.pop_front();
+
+        symbolTable.enterScope();
+        declareParameters(*version.function, version.parameterTypes);
+        visitCalls(graph.getCallSites(version.function), version.name);
+        symbolTable.exitScope();
+    }
+
+    std::stable_sort(found.begin(), found.end(), [&](const Specialization& a, const Specialization& b) {
+        return sourceIndex[a.function] < sourceIndex[b.function];
+    });
+    specializations.insert(specializations.end(), found.begin(), found.end());
+}
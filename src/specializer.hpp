@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "ast.hpp"
+#include "callgraph.hpp"
+#include "error.hpp"
+#include "profile.hpp"
+#include "semantic.hpp"
+#include "types.hpp"
+
+// A copy of a function whose `any` parameters take the concrete types seen
+// at a call site, so its body is lowered with direct instructions
+struct Specialization {
+    FunctionDecl* function;
+    std::string name;
+    std::vector<PrimitiveType> parameterTypes;
+    bool inlinedOnly; // only expanded at inlined calls, never emitted
+};
+
+// Chooses the specializations to compile. Argument types are inferred at
+// every call site, starting from each function as written and continuing
+// into every copy made, so a specialized caller can specialize its own
+// callees. Each signature is compiled once; past the per-function limit
+// calls keep using the generic version. With a profile, calls that never
+// ran are skipped and a function with more signatures than the limit keeps
+// the ones called most often. Inlined calls expand the body with the
+// concrete types and do not count against the limit. Code generation looks
+// a specialization up by name when it lowers a call.
+class Specializer {
+public:
+    static constexpr size_t MAX_SPECIALIZATIONS = 4;
+
+private:
+    std::vector<Remark>* remarks;
+    const ProfileCounts* profile = nullptr;
+    ErrorReporter inferenceErrors;
+    TypeChecker typeChecker;
+    SymbolTable symbolTable;
+    std::unordered_map<std::string, const FunctionDecl*> functionsByName;
+
+public:
+    explicit Specializer(std::vector<Remark>* remarkSink = nullptr)
+        : remarks(remarkSink), typeChecker(inferenceErrors) {}
+
+    void setProfile(const ProfileCounts* counts) { profile = counts; }
+
+    // Appends the specializations in source order of the functions they copy
+    void run(const CallGraph& graph, const std::vector<VarDecl*>& variables,
+             const std::unordered_set<const FunctionCall*>& inlineSites, std::vector<Specialization>& specializations);
+
+    // Name of the copy of `function` for arguments of the given types, or
+    // an empty string when no `any` parameter would get a concrete type
+    static std::string specializedName(const FunctionDecl& function, const std::vector<PrimitiveType>& argumentTypes,
+                                       std::vector<PrimitiveType>& parameterTypes);
+
+private:
+    PrimitiveType typeOf(Expression& expr);
+    std::string signatureAt(const CallSite& site, std::vector<PrimitiveType>& parameterTypes);
+    void declareParameters(const FunctionDecl& function, const std::vector<PrimitiveType>& types);
+
+    // Signatures of each function to keep when a profile shows more of them
+    // than the limit allows
+    std::unordered_map<const FunctionDecl*, std::unordered_set<std::string>> hottestSignatures(
+        const CallGraph& graph);
+    bool typeChecks(Expression& expr);
+    bool typeChecks(const Specialization& copy);
+};
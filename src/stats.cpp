@@ -0,0 +1,220 @@
+#include "stats.hpp"
+#include "memtrack.hpp"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+
+#include <sys/resource.h>
+
+namespace {
+    // Allocations are only counted while a CompileStats is alive; otherwise
+    // operator new costs one relaxed load more than malloc
+    std::atomic<int> activeCounters{0};
+    std::atomic<uint64_t> allocationCounter{0};
+    std::atomic<uint64_t> byteCounter{0};
+
+    void* allocate(std::size_t size) {
+        if (activeCounters.load(std::memory_order_relaxed) != 0) {
+            allocationCounter.fetch_add(1, std::memory_order_relaxed);
+            byteCounter.fetch_add(size, std::memory_order_relaxed);
+        }
+#ifdef LITHIUM_MEM_TRACKING
+        void* memory = MemoryTracker::allocate(size);
+#else
+        void* memory = std::malloc(size ? size : 1);
+#endif
+        if (!memory) {
+            throw std::bad_alloc();
+        }
+        return memory;
+    }
+
+    void release(void* memory) {
+#ifdef LITHIUM_MEM_TRACKING
+        MemoryTracker::release(memory);
+#else
+        std::free(memory);
+#endif
+    }
+
+    double cpuMillis() {
+        timespec now;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+        return static_cast<double>(now.tv_sec) * 1e3 + static_cast<double>(now.tv_nsec) / 1e6;
+    }
+
+    long peakRssKb() {
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+
+    size_t expressionNodes(const Expression* expr) {
+        if (!expr) return 0;
+        if (auto* binary = dynamic_cast<const BinaryOp*>(expr)) {
+            return 1 + expressionNodes(binary->left.get()) + expressionNodes(binary->right.get());
+        }
+        if (auto* call = dynamic_cast<const FunctionCall*>(expr)) {
+            size_t count = 1;
+            for (const auto& argument : call->arguments) {
+                count += expressionNodes(argument.get());
+            }
+            return count;
+        }
+        return 1;
+    }
+
+    std::string jsonString(const std::string& text) {
+        std::string quoted = "\"";
+        for (char c : text) {
+            if (c == '"' || c == '\\') quoted += '\\';
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+}
+
+void* operator new(std::size_t size) {
+    return allocate(size);
+}
+
+void* operator new[](std::size_t size) {
+    return allocate(size);
+}
+
+void operator delete(void* memory) noexcept {
+    release(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    release(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    release(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+    release(memory);
+}
+
+CompileStats::CompileStats() {
+    activeCounters.fetch_add(1, std::memory_order_relaxed);
+    restart();
+}
+
+CompileStats::~CompileStats() {
+    activeCounters.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void CompileStats::restart() {
+    wallStart = std::chrono::steady_clock::now();
+    cpuStart = cpuMillis();
+    peakRssStart = peakRssKb();
+    allocationsStart = allocationCount();
+    bytesStart = allocatedBytes();
+}
+
+void CompileStats::lap(const char* phase, const char* itemName, size_t items) {
+    auto now = std::chrono::steady_clock::now();
+    double cpu = cpuMillis();
+    long peak = peakRssKb();
+    uint64_t allocations = allocationCount();
+    uint64_t bytes = allocatedBytes();
+
+    Phase* entry = nullptr;
+    for (auto& existing : phases) {
+        if (existing.name == phase) {
+            entry = &existing;
+        }
+    }
+    if (!entry) {
+        phases.emplace_back();
+        entry = &phases.back();
+        entry->name = phase;
+    }
+    entry->wallMs += std::chrono::duration<double, std::milli>(now - wallStart).count();
+    entry->cpuMs += cpu - cpuStart;
+    entry->peakRssKb += peak - peakRssStart;
+    entry->allocations += allocations - allocationsStart;
+    entry->allocatedBytes += bytes - bytesStart;
+    if (itemName) {
+        entry->itemName = itemName;
+        entry->items += items;
+    }
+
+    wallStart = now;
+    cpuStart = cpu;
+    peakRssStart = peak;
+    allocationsStart = allocations;
+    bytesStart = bytes;
+}
+
+void CompileStats::printTable(std::ostream& out) const {
+    Phase total;
+    total.name = "total";
+    char line[160];
+    std::snprintf(line, sizeof(line), "%-14s %10s %10s %12s %10s %12s  %s\n", "phase", "wall ms", "cpu ms",
+                  "peak RSS +KB", "allocs", "alloc KB", "items");
+    out << line;
+    auto row = [&](const Phase& phase) {
+        std::snprintf(line, sizeof(line), "%-14s %10.3f %10.3f %12ld %10ju %12.1f  ", phase.name.c_str(),
+                      phase.wallMs, phase.cpuMs, phase.peakRssKb, static_cast<uintmax_t>(phase.allocations),
+                      static_cast<double>(phase.allocatedBytes) / 1024.0);
+        out << line;
+        if (!phase.itemName.empty()) {
+            out << phase.items << " " << phase.itemName;
+        }
+        out << "\n";
+    };
+    for (const auto& phase : phases) {
+        row(phase);
+        total.wallMs += phase.wallMs;
+        total.cpuMs += phase.cpuMs;
+        total.peakRssKb += phase.peakRssKb;
+        total.allocations += phase.allocations;
+        total.allocatedBytes += phase.allocatedBytes;
+    }
+    row(total);
+}
+
+void CompileStats::printJson(std::ostream& out) const {
+    out << "{\"phases\": [";
+    for (size_t i = 0; i < phases.size(); ++i) {
+        const auto& phase = phases[i];
+        out << (i ? ", " : "") << "{\"name\": " << jsonString(phase.name) << ", \"wall_ms\": " << phase.wallMs
+            << ", \"cpu_ms\": " << phase.cpuMs << ", \"peak_rss_delta_kb\": " << phase.peakRssKb
+            << ", \"allocations\": " << phase.allocations << ", \"allocated_bytes\": " << phase.allocatedBytes;
+        if (!phase.itemName.empty()) {
+            out << ", \"items\": " << phase.items << ", \"item_name\": " << jsonString(phase.itemName);
+        }
+        out << "}";
+    }
+    out << "]}\n";
+}
+
+size_t CompileStats::countNodes(const ProgramNode& program) {
+    size_t count = 1;
+    for (const auto& decl : program.declarations) {
+        if (auto* function = dynamic_cast<const FunctionDecl*>(decl.get())) {
+            count += 1 + expressionNodes(function->body.get());
+        } else if (auto* var = dynamic_cast<const VarDecl*>(decl.get())) {
+            count += 1 + expressionNodes(var->initializer.get());
+        } else if (auto* expr = dynamic_cast<const Expression*>(decl.get())) {
+            count += expressionNodes(expr);
+        } else if (decl) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+uint64_t CompileStats::allocationCount() {
+    return allocationCounter.load(std::memory_order_relaxed);
+}
+
+uint64_t CompileStats::allocatedBytes() {
+    return byteCounter.load(std::memory_order_relaxed);
+}
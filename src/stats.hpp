@@ -0,0 +1,64 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "ast.hpp"
+
+// Measurements of each compiler phase for --stats: wall and CPU time, how
+// much the peak resident set grew, heap allocations made and how many
+// items the phase produced. A phase ends at each lap(); laps with the same
+// name add up, so several files compiled one after another give totals.
+//
+// CPU time and allocations are process-wide, so they include worker
+// threads but would also include other compiles running at the same time.
+class CompileStats {
+public:
+    struct Phase {
+        std::string name;
+        double wallMs = 0;
+        double cpuMs = 0;
+        long peakRssKb = 0; // growth of the peak resident set
+        uint64_t allocations = 0;
+        uint64_t allocatedBytes = 0;
+        std::string itemName;
+        size_t items = 0;
+    };
+
+private:
+    std::vector<Phase> phases;
+    std::chrono::steady_clock::time_point wallStart;
+    double cpuStart;
+    long peakRssStart;
+    uint64_t allocationsStart;
+    uint64_t bytesStart;
+
+public:
+    // Starts counting allocations and the first phase
+    CompileStats();
+    ~CompileStats();
+
+    CompileStats(const CompileStats&) = delete;
+    CompileStats& operator=(const CompileStats&) = delete;
+
+    // Starts the next phase now, leaving out time since the last lap
+    void restart();
+    // Ends the current phase; `itemName` names what `items` counts
+    void lap(const char* phase, const char* itemName = nullptr, size_t items = 0);
+
+    const std::vector<Phase>& getPhases() const { return phases; }
+
+    void printTable(std::ostream& out) const;
+    void printJson(std::ostream& out) const;
+
+    // Nodes in a program's tree, declarations and expressions alike
+    static size_t countNodes(const ProgramNode& program);
+
+    // Heap allocations made through operator new while any CompileStats
+    // exists, summed over all threads
+    static uint64_t allocationCount();
+    static uint64_t allocatedBytes();
+};
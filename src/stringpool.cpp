@@ -0,0 +1,50 @@
+#include "stringpool.hpp"
+
+uint64_t StringPool::hash(const std::string& bytes) {
+    uint64_t value = 0xcbf29ce484222325ULL;
+    for (unsigned char c : bytes) {
+        value = (value ^ c) * 0x100000001b3ULL;
+    }
+    return value;
+}
+
+size_t StringPool::find(const std::string& bytes) const {
+    auto range = byHash.equal_range(hash(bytes));
+    for (auto it = range.first; it != range.second; ++it) {
+        if (entries[it->second].bytes == bytes) {
+            return it->second;
+        }
+    }
+    return NOT_FOUND;
+}
+
+size_t StringPool::intern(const std::string& bytes) {
+    ++stats.literals;
+    stats.literalBytes += bytes.size() + 1;
+
+    uint64_t value = hash(bytes);
+    auto range = byHash.equal_range(value);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (entries[it->second].bytes == bytes) {
+            return it->second;
+        }
+    }
+    entries.push_back({bytes, value, 0});
+    byHash.emplace(value, entries.size() - 1);
+    return entries.size() - 1;
+}
+
+// Entries stay in the order they were interned, which is source order
+void StringPool::layout() {
+    data.clear();
+    for (auto& entry : entries) {
+        data.resize((data.size() + 7) & ~size_t(7), '\0');
+        uint64_t size = entry.bytes.size();
+        for (int i = 0; i < 8; ++i) {
+            data.push_back(static_cast<char>(size >> (8 * i)));
+        }
+        entry.offset = data.size();
+        data += entry.bytes;
+        data.push_back('\0');
+    }
+}
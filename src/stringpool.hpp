@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Every string constant of a compilation, stored once. Identical literals
+// share an entry. Once laid out, each string's bytes follow its length, so
+// native code never scans for the end of a string. That rules out letting
+// a string that ends another one point into its bytes: there would be no
+// room for its length.
+class StringPool {
+public:
+    struct Entry {
+        std::string bytes; // without the terminating NUL
+        uint64_t hash;
+        size_t offset;     // of the bytes in getData(), valid after layout()
+    };
+
+    struct Stats {
+        size_t literals = 0;      // intern() calls
+        size_t literalBytes = 0;  // what storing every literal would take
+        size_t folded = 0;        // `+` chains of literals joined at compile time
+    };
+
+    static constexpr size_t NOT_FOUND = static_cast<size_t>(-1);
+
+private:
+    std::vector<Entry> entries;
+    std::unordered_multimap<uint64_t, size_t> byHash;
+    std::string data;
+    Stats stats;
+
+public:
+    // Index of the entry for `bytes`, which is added if it is new
+    size_t intern(const std::string& bytes);
+    size_t find(const std::string& bytes) const;
+
+    // Counts a literal chain that code generation folds into one constant
+    void noteFolded() { ++stats.folded; }
+
+    // Assigns every entry its offset and builds the data: for each entry a
+    // little-endian uint64_t length at an 8-byte boundary, then the bytes
+    // and a NUL
+    void layout();
+
+    const std::vector<Entry>& getEntries() const { return entries; }
+    const std::string& getData() const { return data; }
+    const Stats& getStats() const { return stats; }
+
+    // FNV-1a
+    static uint64_t hash(const std::string& bytes);
+};
@@ -0,0 +1,96 @@
+#include "threadpool.hpp"
+
+ThreadPool::ThreadPool(unsigned threads)
+    : body(nullptr), count(0), nextIndex(0), pending(0), generation(0), stopping(false) {
+    unsigned total = threads == 0 ? defaultThreadCount() : threads;
+    for (unsigned i = 1; i < total; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+unsigned ThreadPool::defaultThreadCount() {
+    unsigned cores = std::thread::hardware_concurrency();
+    return cores == 0 ? 1 : cores;
+}
+
+void ThreadPool::parallelFor(size_t n, const std::function<void(size_t)>& loopBody) {
+    if (workers.empty() || n <= 1) {
+        for (size_t i = 0; i < n; ++i) {
+            loopBody(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        body = &loopBody;
+        count = n;
+        nextIndex.store(0, std::memory_order_relaxed);
+        pending = workers.size();
+        failure = nullptr;
+        ++generation;
+    }
+    wake.notify_all();
+
+    runIndices(loopBody, n);
+
+    // Every worker checks in once per loop, so none can still be touching it
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return pending == 0; });
+    body = nullptr;
+    if (failure) {
+        std::exception_ptr error = failure;
+        failure = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void ThreadPool::workerLoop() {
+    uint64_t seen = 0;
+    for (;;) {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [&] { return stopping || generation != seen; });
+        if (stopping) {
+            return;
+        }
+        seen = generation;
+        const std::function<void(size_t)>* loopBody = body;
+        size_t n = count;
+        lock.unlock();
+
+        runIndices(*loopBody, n);
+
+        lock.lock();
+        if (--pending == 0) {
+            done.notify_one();
+        }
+    }
+}
+
+void ThreadPool::runIndices(const std::function<void(size_t)>& loopBody, size_t n) {
+    for (;;) {
+        size_t i = nextIndex.fetch_add(1, std::memory_order_relaxed);
+        if (i >= n) {
+            return;
+        }
+        try {
+            loopBody(i);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!failure) {
+                failure = std::current_exception();
+            }
+        }
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data-parallel loops. The calling thread
+// takes part in every loop, so a pool of one thread runs everything inline.
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    // Current loop, published under the mutex
+    const std::function<void(size_t)>* body;
+    size_t count;
+    std::atomic<size_t> nextIndex;
+    size_t pending;
+    uint64_t generation;
+    bool stopping;
+    std::exception_ptr failure;
+
+public:
+    // 0 picks one thread per core
+    explicit ThreadPool(unsigned threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+    // Calls body(i) for every i in [0, n) and returns once all calls are
+    // done. The first exception thrown by body is rethrown here.
+    void parallelFor(size_t n, const std::function<void(size_t)>& loopBody);
+
+    static unsigned defaultThreadCount();
+
+private:
+    void workerLoop();
+    void runIndices(const std::function<void(size_t)>& loopBody, size_t n);
+};
@@ -0,0 +1,104 @@
+#include "trace.hpp"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "utils.hpp"
+
+std::atomic<bool> Trace::active{false};
+
+namespace {
+    struct Event {
+        const char* category;
+        std::string name;
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    // Buffers live until the process exits, so a thread's pointer to its
+    // own stays valid across traces
+    struct ThreadBuffer {
+        size_t thread;
+        std::vector<Event> events;
+    };
+
+    std::mutex registryMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> registry;
+    std::chrono::steady_clock::time_point origin;
+
+    ThreadBuffer& localBuffer() {
+        thread_local ThreadBuffer* buffer = nullptr;
+        if (!buffer) {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            registry.push_back(std::make_unique<ThreadBuffer>());
+            buffer = registry.back().get();
+            buffer->thread = registry.size();
+        }
+        return *buffer;
+    }
+
+    // Trace event times are in microseconds
+    void writeMicros(std::ofstream& out, uint64_t nanos) {
+        out << nanos / 1000 << "." << static_cast<char>('0' + nanos / 100 % 10)
+            << static_cast<char>('0' + nanos / 10 % 10) << static_cast<char>('0' + nanos % 10);
+    }
+}
+
+void Trace::start() {
+    origin = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (auto& buffer : registry) {
+            buffer->events.clear();
+        }
+    }
+    localBuffer();
+    active.store(true, std::memory_order_relaxed);
+}
+
+uint64_t Trace::now() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count());
+}
+
+void Trace::complete(const char* category, const std::string& name, uint64_t begin, uint64_t end) {
+    localBuffer().events.push_back({category, name, begin, end});
+}
+
+bool Trace::finish(const std::string& path, std::string& error) {
+    active.store(false, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        error = path + ": " + std::strerror(errno);
+        return false;
+    }
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first = true;
+    for (const auto& buffer : registry) {
+        if (buffer->events.empty()) continue;
+        out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "
+            << buffer->thread << ", \"args\": {\"name\": \"" << (buffer->thread == 1 ? "main" : "thread ")
+            << (buffer->thread == 1 ? "" : std::to_string(buffer->thread)) << "\"}}";
+        first = false;
+        for (const auto& event : buffer->events) {
+            out << ",\n{\"name\": \"" << CompilerUtils::escapeString(event.name) << "\", \"cat\": \""
+                << event.category << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->thread << ", \"ts\": ";
+            writeMicros(out, event.begin);
+            out << ", \"dur\": ";
+            writeMicros(out, event.end - event.begin);
+            out << "}";
+        }
+        buffer->events.clear();
+    }
+    out << "\n]}\n";
+    out.close();
+    if (!out) {
+        error = path + ": write failed";
+        return false;
+    }
+    return true;
+}
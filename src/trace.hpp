@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Records what the compiler spends its time on as Chrome trace events
+// (--trace), for chrome://tracing or Perfetto. Each thread appends to a
+// buffer of its own, so recording takes no lock; the buffers are written
+// out together by finish(). When tracing is off a TraceScope costs one
+// relaxed load and a branch.
+class Trace {
+private:
+    static std::atomic<bool> active;
+
+public:
+    static bool enabled() { return active.load(std::memory_order_relaxed); }
+
+    // Starts recording; times are measured from here
+    static void start();
+    // Stops recording and writes every thread's events to `path` as trace
+    // event JSON. Must not race with code that records.
+    static bool finish(const std::string& path, std::string& error);
+
+    // Nanoseconds since start()
+    static uint64_t now();
+    // An event that ran from `begin` to `end` on the calling thread
+    static void complete(const char* category, const std::string& name, uint64_t begin, uint64_t end);
+};
+
+// Records the time from construction to destruction as one event. A
+// name given as a std::string must outlive the scope.
+class TraceScope {
+private:
+    const char* category;
+    const char* literalName;
+    const std::string* name;
+    bool recording;
+    uint64_t begin;
+
+public:
+    TraceScope(const char* eventCategory, const char* eventName)
+        : category(eventCategory), literalName(eventName), name(nullptr), recording(Trace::enabled()),
+          begin(recording ? Trace::now() : 0) {}
+    TraceScope(const char* eventCategory, const std::string& eventName)
+        : category(eventCategory), literalName(nullptr), name(&eventName), recording(Trace::enabled()),
+          begin(recording ? Trace::now() : 0) {}
+
+    ~TraceScope() {
+        if (recording) {
+            Trace::complete(category, name ? *name : std::string(literalName), begin, Trace::now());
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+};
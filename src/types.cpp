@@ -0,0 +1,43 @@
+#include "types.hpp"
+
+bool PrimitiveTypeImpl::isCompatibleWith(const Type& other) const {
+    return TypeUtils::canImplicitlyConvert(other.getPrimitiveType(), type);
+}
+
+std::string PrimitiveTypeImpl::toString() const {
+    return TypeUtils::primitiveTypeToString(type);
+}
+
+namespace TypeUtils {
+    std::string primitiveTypeToString(PrimitiveType type) {
+        switch (type) {
+            case PrimitiveType::INT: return "int";
+            case PrimitiveType::FLOAT: return "float";
+            case PrimitiveType::STRING: return "string";
+            case PrimitiveType::BOOL: return "bool";
+            case PrimitiveType::ANY: return "any";
+            case PrimitiveType::VOID: return "void";
+            default: return "unknown";
+        }
+    }
+
+    PrimitiveType stringToPrimitiveType(const std::string& typeStr) {
+        if (typeStr == "int") return PrimitiveType::INT;
+        if (typeStr == "float") return PrimitiveType::FLOAT;
+        if (typeStr == "string") return PrimitiveType::STRING;
+        if (typeStr == "bool") return PrimitiveType::BOOL;
+        if (typeStr == "void") return PrimitiveType::VOID;
+        // Missing or unknown annotations fall back to the dynamic type
+        return PrimitiveType::ANY;
+    }
+
+    bool isNumericType(PrimitiveType type) {
+        return type == PrimitiveType::INT || type == PrimitiveType::FLOAT;
+    }
+
+    bool canImplicitlyConvert(PrimitiveType from, PrimitiveType to) {
+        if (from == to) return true;
+        if (to == PrimitiveType::ANY) return from != PrimitiveType::VOID;
+        return from == PrimitiveType::INT && to == PrimitiveType::FLOAT;
+    }
+}
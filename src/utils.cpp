@@ -76,4 +76,45 @@ namespace DebugUtils {
         // TODO: Implement actual symbol table printing
         std::cout << "Symbol Table (stub)\n";
     }
-}
\ No newline at end of file
+}
+
+namespace CompilerUtils {
+    std::string escapeString(const std::string& str) {
+        std::string result;
+        result.reserve(str.size());
+        for (char c : str) {
+            switch (c) {
+                case '\n': result += "\\n"; break;
+                case '\t': result += "\\t"; break;
+                case '\r': result += "\\r"; break;
+                case '\\': result += "\\\\"; break;
+                case '"': result += "\\\""; break;
+                default: result += c; break;
+            }
+        }
+        return result;
+    }
+    
+    std::string unescapeString(const std::string& str) {
+        std::string result;
+        result.reserve(str.size());
+        for (size_t i = 0; i < str.size(); ++i) {
+            if (str[i] != '\\' || i + 1 == str.size()) {
+                result += str[i];
+                continue;
+            }
+            switch (str[++i]) {
+                case 'n': result += '\n'; break;
+                case 't': result += '\t'; break;
+                case 'r': result += '\r'; break;
+                case '\\': result += '\\'; break;
+                case '"': result += '"'; break;
+                default: 
+                    result += '\\';
+                    result += str[i];
+                    break;
+            }
+        }
+        return result;
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+// Values of type `any` are NaN-boxed into 64 bits so that floats, bools and
+// ints that fit in 48 bits never need an allocation. A float is stored as
+// itself, with NaNs canonicalized; every other type lives in the negative
+// quiet-NaN space with a 16-bit tag above a 48-bit payload. A wider int is
+// boxed as a pointer to an int64_t cell the backend allocates, so every int
+// comes back out of `any` unchanged and never turns into a float.
+namespace NanBox {
+    constexpr unsigned TAG_SHIFT = 48;
+    constexpr uint64_t PAYLOAD_MASK = (uint64_t(1) << TAG_SHIFT) - 1;
+
+    // Tags below FIRST_TAG are floats
+    constexpr uint64_t FIRST_TAG = 0xFFF9;
+    constexpr uint64_t INT_TAG = 0xFFF9;
+    constexpr uint64_t STRING_TAG = 0xFFFA;
+    constexpr uint64_t BOOL_TAG = 0xFFFB;
+    constexpr uint64_t WIDE_INT_TAG = 0xFFFC; // payload points to the int64_t
+
+    constexpr uint64_t CANONICAL_NAN = 0x7FF8000000000000;
+    constexpr int64_t MIN_INT = -(int64_t(1) << (TAG_SHIFT - 1));
+    constexpr int64_t MAX_INT = (int64_t(1) << (TAG_SHIFT - 1)) - 1;
+
+    inline uint64_t tag(uint64_t bits) { return bits >> TAG_SHIFT; }
+    inline bool isFloat(uint64_t bits) { return tag(bits) < FIRST_TAG; }
+    inline bool isInt(uint64_t bits) { return tag(bits) == INT_TAG; }
+    inline bool isString(uint64_t bits) { return tag(bits) == STRING_TAG; }
+    inline bool isBool(uint64_t bits) { return tag(bits) == BOOL_TAG; }
+    inline bool isWideInt(uint64_t bits) { return tag(bits) == WIDE_INT_TAG; }
+
+    inline bool fitsInt(int64_t value) { return value >= MIN_INT && value <= MAX_INT; }
+
+    inline uint64_t boxFloat(double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return isFloat(bits) ? bits : CANONICAL_NAN;
+    }
+
+    // Only for values that pass fitsInt(); wider ones need boxWideInt()
+    inline uint64_t boxInt(int64_t value) {
+        return (INT_TAG << TAG_SHIFT) | (static_cast<uint64_t>(value) & PAYLOAD_MASK);
+    }
+
+    inline uint64_t boxWideInt(const int64_t* cell) {
+        return (WIDE_INT_TAG << TAG_SHIFT) | (reinterpret_cast<uintptr_t>(cell) & PAYLOAD_MASK);
+    }
+
+    inline uint64_t boxPointer(const void* pointer) {
+        return (STRING_TAG << TAG_SHIFT) | (reinterpret_cast<uintptr_t>(pointer) & PAYLOAD_MASK);
+    }
+
+    inline uint64_t boxBool(bool value) {
+        return (BOOL_TAG << TAG_SHIFT) | (value ? 1 : 0);
+    }
+
+    inline double unboxFloat(uint64_t bits) {
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    // Sign-extends the 48-bit payload
+    inline int64_t unboxInt(uint64_t bits) {
+        return static_cast<int64_t>(bits << (64 - TAG_SHIFT)) >> (64 - TAG_SHIFT);
+    }
+
+    inline const void* unboxPointer(uint64_t bits) {
+        return reinterpret_cast<const void*>(static_cast<uintptr_t>(bits & PAYLOAD_MASK));
+    }
+
+    // Either kind of int; false for every other type
+    inline bool unboxAnyInt(uint64_t bits, int64_t& value) {
+        if (isInt(bits)) {
+            value = unboxInt(bits);
+            return true;
+        }
+        if (isWideInt(bits)) {
+            value = *static_cast<const int64_t*>(unboxPointer(bits));
+            return true;
+        }
+        return false;
+    }
+
+    inline bool unboxBool(uint64_t bits) { return (bits & 1) != 0; }
+
+    inline const char* typeName(uint64_t bits) {
+        switch (tag(bits)) {
+            case INT_TAG:
+            case WIDE_INT_TAG: return "int";
+            case STRING_TAG: return "string";
+            case BOOL_TAG: return "bool";
+            default: return "float";
+        }
+    }
+}
@@ -0,0 +1,396 @@
+#include "vm.hpp"
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define LITHIUM_THREADED_DISPATCH 1
+#endif
+
+VirtualMachine::VirtualMachine(const BytecodeModule& bytecode)
+    : module(bytecode), globals(bytecode.numGlobals, Value{0}), registers(4096, Value{0}) {
+    constants.reserve(module.constants.size());
+    for (const auto& constant : module.constants) {
+        Value value{0};
+        switch (constant.kind) {
+            case BytecodeConstant::Kind::INT: value.i = constant.intValue; break;
+            case BytecodeConstant::Kind::FLOAT: value.f = constant.floatValue; break;
+            case BytecodeConstant::Kind::STRING:
+                strings.emplace_back(constant.stringValue);
+                value.s = &strings.back();
+                break;
+        }
+        constants.push_back(value);
+    }
+    for (size_t i = 0; i < module.globalInitializers.size(); ++i) {
+        if (module.globalInitializers[i] != BytecodeModule::NO_CONSTANT) {
+            globals[i] = constants[static_cast<size_t>(module.globalInitializers[i])];
+        }
+    }
+}
+
+int VirtualMachine::runMain() {
+    if (module.initFunction != BytecodeModule::NO_FUNCTION) {
+        call(static_cast<uint32_t>(module.initFunction));
+    }
+    if (module.mainFunction == BytecodeModule::NO_FUNCTION) {
+        throw std::runtime_error("No 'main' function in bytecode");
+    }
+    return static_cast<int>(call(static_cast<uint32_t>(module.mainFunction)).i);
+}
+
+Value VirtualMachine::call(uint32_t function, const std::vector<Value>& args) {
+    const BytecodeFunction* entry = &module.functions.at(function);
+    if (registers.size() < entry->numRegisters) {
+        registers.resize(entry->numRegisters);
+    }
+    for (size_t i = 0; i < args.size() && i < entry->numParams; ++i) {
+        registers[i] = args[i];
+    }
+    frames.clear();
+    return execute(entry, 0);
+}
+
+Value VirtualMachine::execute(const BytecodeFunction* entry, size_t base) {
+    const BytecodeFunction* function = entry;
+    const BytecodeInstruction* ip = function->code.data();
+    const Value* k = constants.data();
+    Value* r = registers.data() + base;
+
+#ifdef LITHIUM_THREADED_DISPATCH
+    // Must list labels in Opcode order
+    static const void* const dispatchTable[] = {
+        &&op_LOADK, &&op_MOV, &&op_GETGLOBAL, &&op_SETGLOBAL,
+        &&op_ADD_II, &&op_SUB_II, &&op_MUL_II, &&op_DIV_II,
+        &&op_ADD_FF, &&op_SUB_FF, &&op_MUL_FF, &&op_DIV_FF,
+        &&op_CONCAT_SS, &&op_CONCAT_N, &&op_ITOF,
+        &&op_BOX_I, &&op_BOX_F, &&op_BOX_S, &&op_BOX_B,
+        &&op_UNBOX_I, &&op_UNBOX_F, &&op_UNBOX_S, &&op_UNBOX_B,
+        &&op_ADD_AA, &&op_SUB_AA, &&op_MUL_AA, &&op_DIV_AA,
+        &&op_CALL, &&op_TAILCALL, &&op_RET, &&op_RET_VOID
+    };
+    static_assert(sizeof(dispatchTable) / sizeof(dispatchTable[0]) == static_cast<size_t>(Opcode::COUNT),
+                  "dispatch table out of sync with Opcode");
+#define VM_CASE(name) op_##name:
+#define VM_DISPATCH() goto *dispatchTable[static_cast<uint16_t>(ip->op)]
+#define VM_NEXT() do { ++ip; VM_DISPATCH(); } while (0)
+    VM_DISPATCH();
+    {
+#else
+#define VM_CASE(name) case Opcode::name:
+#define VM_DISPATCH() continue
+#define VM_NEXT() do { ++ip; continue; } while (0)
+    for (;;) {
+        switch (ip->op) {
+#endif
+
+    VM_CASE(LOADK)
+        r[ip->a] = k[ip->b];
+        VM_NEXT();
+
+    VM_CASE(MOV)
+        r[ip->a] = r[ip->b];
+        VM_NEXT();
+
+    VM_CASE(GETGLOBAL)
+        r[ip->a] = globals[ip->b];
+        VM_NEXT();
+
+    VM_CASE(SETGLOBAL)
+        globals[ip->a] = r[ip->b];
+        VM_NEXT();
+
+    VM_CASE(ADD_II)
+        r[ip->a].i = static_cast<int64_t>(static_cast<uint64_t>(r[ip->b].i) + static_cast<uint64_t>(r[ip->c].i));
+        VM_NEXT();
+
+    VM_CASE(SUB_II)
+        r[ip->a].i = static_cast<int64_t>(static_cast<uint64_t>(r[ip->b].i) - static_cast<uint64_t>(r[ip->c].i));
+        VM_NEXT();
+
+    VM_CASE(MUL_II)
+        r[ip->a].i = static_cast<int64_t>(static_cast<uint64_t>(r[ip->b].i) * static_cast<uint64_t>(r[ip->c].i));
+        VM_NEXT();
+
+    VM_CASE(DIV_II)
+        if (r[ip->c].i == 0) {
+            throw std::runtime_error("Division by zero in " + function->name);
+        }
+        if (r[ip->b].i == LLONG_MIN && r[ip->c].i == -1) {
+            throw std::runtime_error("Integer overflow in division in " + function->name);
+        }
+        r[ip->a].i = r[ip->b].i / r[ip->c].i;
+        VM_NEXT();
+
+    VM_CASE(ADD_FF)
+        r[ip->a].f = r[ip->b].f + r[ip->c].f;
+        VM_NEXT();
+
+    VM_CASE(SUB_FF)
+        r[ip->a].f = r[ip->b].f - r[ip->c].f;
+        VM_NEXT();
+
+    VM_CASE(MUL_FF)
+        r[ip->a].f = r[ip->b].f * r[ip->c].f;
+        VM_NEXT();
+
+    VM_CASE(DIV_FF)
+        r[ip->a].f = r[ip->b].f / r[ip->c].f;
+        VM_NEXT();
+
+    VM_CASE(CONCAT_SS)
+        strings.emplace_back(*r[ip->b].s, *r[ip->c].s);
+        r[ip->a].s = &strings.back();
+        VM_NEXT();
+
+    VM_CASE(CONCAT_N)
+        concatParts.clear();
+        for (uint16_t i = 0; i < ip->c; ++i) {
+            concatParts.push_back(r[ip->b + i].s);
+        }
+        strings.emplace_back(concatParts.data(), concatParts.size());
+        r[ip->a].s = &strings.back();
+        VM_NEXT();
+
+    VM_CASE(ITOF)
+        r[ip->a].f = static_cast<double>(r[ip->b].i);
+        VM_NEXT();
+
+    VM_CASE(BOX_I)
+        r[ip->a].boxed = boxInt(r[ip->b].i);
+        VM_NEXT();
+
+    VM_CASE(BOX_F)
+        r[ip->a].boxed = NanBox::boxFloat(r[ip->b].f);
+        VM_NEXT();
+
+    VM_CASE(BOX_S)
+        r[ip->a].boxed = NanBox::boxPointer(r[ip->b].s);
+        VM_NEXT();
+
+    VM_CASE(BOX_B)
+        r[ip->a].boxed = NanBox::boxBool(r[ip->b].i != 0);
+        VM_NEXT();
+
+    VM_CASE(UNBOX_I)
+        {
+            int64_t value;
+            if (!NanBox::unboxAnyInt(r[ip->b].boxed, value)) {
+                typeError("int", r[ip->b].boxed, function);
+            }
+            r[ip->a].i = value;
+            VM_NEXT();
+        }
+
+    VM_CASE(UNBOX_F)
+        {
+            int64_t value;
+            if (NanBox::isFloat(r[ip->b].boxed)) {
+                r[ip->a].boxed = r[ip->b].boxed;
+            } else if (NanBox::unboxAnyInt(r[ip->b].boxed, value)) {
+                r[ip->a].f = static_cast<double>(value);
+            } else {
+                typeError("float", r[ip->b].boxed, function);
+            }
+            VM_NEXT();
+        }
+
+    VM_CASE(UNBOX_S)
+        if (!NanBox::isString(r[ip->b].boxed)) {
+            typeError("string", r[ip->b].boxed, function);
+        }
+        r[ip->a].s = static_cast<const VmString*>(NanBox::unboxPointer(r[ip->b].boxed));
+        VM_NEXT();
+
+    VM_CASE(UNBOX_B)
+        if (!NanBox::isBool(r[ip->b].boxed)) {
+            typeError("bool", r[ip->b].boxed, function);
+        }
+        r[ip->a].i = NanBox::unboxBool(r[ip->b].boxed);
+        VM_NEXT();
+
+    // Two 48-bit ints take the inline path; they cannot overflow an int64_t
+    // sum or difference, though the result may need a wide box
+    VM_CASE(ADD_AA)
+        if (NanBox::isInt(r[ip->b].boxed) && NanBox::isInt(r[ip->c].boxed)) {
+            r[ip->a].boxed = boxInt(NanBox::unboxInt(r[ip->b].boxed) + NanBox::unboxInt(r[ip->c].boxed));
+        } else {
+            r[ip->a].boxed = anyArithmetic(Opcode::ADD_AA, r[ip->b].boxed, r[ip->c].boxed, function);
+        }
+        VM_NEXT();
+
+    VM_CASE(SUB_AA)
+        if (NanBox::isInt(r[ip->b].boxed) && NanBox::isInt(r[ip->c].boxed)) {
+            r[ip->a].boxed = boxInt(NanBox::unboxInt(r[ip->b].boxed) - NanBox::unboxInt(r[ip->c].boxed));
+        } else {
+            r[ip->a].boxed = anyArithmetic(Opcode::SUB_AA, r[ip->b].boxed, r[ip->c].boxed, function);
+        }
+        VM_NEXT();
+
+    VM_CASE(MUL_AA)
+        {
+            int64_t product;
+            if (NanBox::isInt(r[ip->b].boxed) && NanBox::isInt(r[ip->c].boxed) &&
+                !__builtin_mul_overflow(NanBox::unboxInt(r[ip->b].boxed), NanBox::unboxInt(r[ip->c].boxed), &product)) {
+                r[ip->a].boxed = boxInt(product);
+            } else {
+                r[ip->a].boxed = anyArithmetic(Opcode::MUL_AA, r[ip->b].boxed, r[ip->c].boxed, function);
+            }
+            VM_NEXT();
+        }
+
+    VM_CASE(DIV_AA)
+        r[ip->a].boxed = anyArithmetic(Opcode::DIV_AA, r[ip->b].boxed, r[ip->c].boxed, function);
+        VM_NEXT();
+
+    VM_CASE(CALL)
+        {
+            if (frames.size() >= MAX_CALL_DEPTH) {
+                throw std::runtime_error("Stack overflow in " + function->name);
+            }
+            frames.push_back({function, ip, base});
+            ++callCount;
+            base += ip->c;
+            function = &module.functions[ip->b];
+            if (base + function->numRegisters > registers.size()) {
+                registers.resize(std::max(registers.size() * 2, base + function->numRegisters));
+            }
+            r = registers.data() + base;
+            ip = function->code.data();
+            VM_DISPATCH();
+        }
+
+    VM_CASE(TAILCALL)
+        {
+            // Arguments move down to the bottom of the current frame, which
+            // the callee then takes over; the call stack does not grow
+            const BytecodeFunction* callee = &module.functions[ip->b];
+            const Value* args = r + ip->c;
+            for (uint16_t i = 0; i < callee->numParams; ++i) {
+                r[i] = args[i];
+            }
+            ++callCount;
+            function = callee;
+            if (base + function->numRegisters > registers.size()) {
+                registers.resize(std::max(registers.size() * 2, base + function->numRegisters));
+                r = registers.data() + base;
+            }
+            ip = function->code.data();
+            VM_DISPATCH();
+        }
+
+    VM_CASE(RET)
+        {
+            Value result = r[ip->a];
+            if (frames.empty()) {
+                return result;
+            }
+            const Frame& caller = frames.back();
+            function = caller.function;
+            ip = caller.returnTo;
+            base = caller.base;
+            frames.pop_back();
+            r = registers.data() + base;
+            r[ip->a] = result;
+            VM_NEXT();
+        }
+
+    VM_CASE(RET_VOID)
+        {
+            if (frames.empty()) {
+                return Value{0};
+            }
+            const Frame& caller = frames.back();
+            function = caller.function;
+            ip = caller.returnTo;
+            base = caller.base;
+            frames.pop_back();
+            r = registers.data() + base;
+            r[ip->a].i = 0;
+            VM_NEXT();
+        }
+
+#ifndef LITHIUM_THREADED_DISPATCH
+        default:
+            throw std::runtime_error("Invalid opcode in " + function->name);
+        }
+#endif
+    }
+#ifdef LITHIUM_THREADED_DISPATCH
+    __builtin_unreachable();
+#endif
+
+#undef VM_CASE
+#undef VM_DISPATCH
+#undef VM_NEXT
+}
+
+uint64_t VirtualMachine::boxInt(int64_t value) {
+    if (NanBox::fitsInt(value)) {
+        return NanBox::boxInt(value);
+    }
+    wideInts.push_back(value);
+    return NanBox::boxWideInt(&wideInts.back());
+}
+
+// Ints stay ints, with the wrapping of the typed instructions, except that
+// a product that overflows becomes a float
+uint64_t VirtualMachine::anyArithmetic(Opcode op, uint64_t lhs, uint64_t rhs, const BytecodeFunction* function) {
+    int64_t a;
+    int64_t b;
+    if (NanBox::unboxAnyInt(lhs, a) && NanBox::unboxAnyInt(rhs, b)) {
+        int64_t product;
+        switch (op) {
+            case Opcode::ADD_AA:
+                return boxInt(static_cast<int64_t>(static_cast<uint64_t>(a) + static_cast<uint64_t>(b)));
+            case Opcode::SUB_AA:
+                return boxInt(static_cast<int64_t>(static_cast<uint64_t>(a) - static_cast<uint64_t>(b)));
+            case Opcode::MUL_AA:
+                if (__builtin_mul_overflow(a, b, &product)) {
+                    return NanBox::boxFloat(static_cast<double>(a) * static_cast<double>(b));
+                }
+                return boxInt(product);
+            default:
+                if (b == 0) {
+                    throw std::runtime_error("Division by zero in " + function->name);
+                }
+                if (a == LLONG_MIN && b == -1) {
+                    throw std::runtime_error("Integer overflow in division in " + function->name);
+                }
+                return boxInt(a / b);
+        }
+    }
+
+    if (op == Opcode::ADD_AA && NanBox::isString(lhs) && NanBox::isString(rhs)) {
+        strings.emplace_back(*static_cast<const VmString*>(NanBox::unboxPointer(lhs)),
+                             *static_cast<const VmString*>(NanBox::unboxPointer(rhs)));
+        return NanBox::boxPointer(&strings.back());
+    }
+
+    auto isNumber = [](uint64_t value) {
+        return NanBox::isFloat(value) || NanBox::isInt(value) || NanBox::isWideInt(value);
+    };
+    if (!isNumber(lhs) || !isNumber(rhs)) {
+        static const char* const symbols[] = {"+", "-", "*", "/"};
+        const char* symbol = symbols[static_cast<int>(op) - static_cast<int>(Opcode::ADD_AA)];
+        throw std::runtime_error("Type error in " + function->name + ": operator '" + symbol + "' cannot be applied to '" +
+                                 NanBox::typeName(lhs) + "' and '" + NanBox::typeName(rhs) + "'");
+    }
+    auto toFloat = [](uint64_t value) {
+        int64_t integer;
+        return NanBox::unboxAnyInt(value, integer) ? static_cast<double>(integer) : NanBox::unboxFloat(value);
+    };
+    double x = toFloat(lhs);
+    double y = toFloat(rhs);
+    switch (op) {
+        case Opcode::ADD_AA: return NanBox::boxFloat(x + y);
+        case Opcode::SUB_AA: return NanBox::boxFloat(x - y);
+        case Opcode::MUL_AA: return NanBox::boxFloat(x * y);
+        default: return NanBox::boxFloat(x / y);
+    }
+}
+
+void VirtualMachine::typeError(const std::string& expected, uint64_t value, const BytecodeFunction* function) {
+    throw std::runtime_error("Type error in " + function->name + ": expected " + expected + ", got " +
+                             NanBox::typeName(value));
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+#include "bytecode.hpp"
+#include "value.hpp"
+#include "vmstring.hpp"
+
+// Untagged register value; the specialized opcodes know which member is
+// live. Values of type `any` are NaN-boxed in `boxed`.
+union Value {
+    int64_t i;
+    double f;
+    const VmString* s;
+    uint64_t boxed;
+};
+
+// Interpreter for BytecodeModule. Dispatch is threaded through a table of
+// label addresses when the compiler supports computed goto, and falls back
+// to a switch otherwise. Runtime errors are thrown as std::runtime_error.
+class VirtualMachine {
+private:
+    struct Frame {
+        const BytecodeFunction* function;
+        const BytecodeInstruction* returnTo;
+        size_t base;
+    };
+
+    const BytecodeModule& module;
+    std::vector<Value> constants;
+    std::vector<Value> globals;
+    std::vector<Value> registers;
+    std::vector<Frame> frames;
+    std::deque<VmString> strings;
+    std::deque<int64_t> wideInts; // cells of ints boxed with WIDE_INT_TAG
+    std::vector<const VmString*> concatParts;
+    uint64_t callCount = 0;
+
+public:
+    static constexpr size_t MAX_CALL_DEPTH = 1 << 20;
+
+    explicit VirtualMachine(const BytecodeModule& bytecode);
+
+    // Runs global initializers and main; main's result is the exit code
+    int runMain();
+
+    Value call(uint32_t function, const std::vector<Value>& args = {});
+    
+    // Calls executed by CALL instructions so far
+    uint64_t getCallCount() const { return callCount; }
+
+private:
+    Value execute(const BytecodeFunction* entry, size_t base);
+    
+    // Boxes any int, allocating a cell when it does not fit in 48 bits
+    uint64_t boxInt(int64_t value);
+    // Slow path of the `any` operators, once both operands are not 48-bit ints
+    uint64_t anyArithmetic(Opcode op, uint64_t lhs, uint64_t rhs, const BytecodeFunction* function);
+    [[noreturn]] void typeError(const std::string& expected, uint64_t value, const BytecodeFunction* function);
+};
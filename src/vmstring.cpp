@@ -0,0 +1,78 @@
+#include "vmstring.hpp"
+#include <cstring>
+#include <vector>
+
+VmString::VmString(std::string_view bytes) : length(bytes.size()) {
+    std::memcpy(allocate(), bytes.data(), length);
+}
+
+VmString::VmString(const VmString& left, const VmString& right) : length(left.length + right.length) {
+    if (length <= SMALL_CAPACITY) {
+        char* out = allocate();
+        left.copyTo(out);
+        right.copyTo(out + left.length);
+        return;
+    }
+    kind = Kind::ROPE;
+    storage.rope.left = &left;
+    storage.rope.right = &right;
+}
+
+VmString::VmString(const VmString* const* parts, size_t count) : length(0) {
+    for (size_t i = 0; i < count; ++i) {
+        length += parts[i]->length;
+    }
+    char* out = allocate();
+    for (size_t i = 0; i < count; ++i) {
+        parts[i]->copyTo(out);
+        out += parts[i]->length;
+    }
+}
+
+VmString::~VmString() {
+    if (kind == Kind::FLAT) {
+        delete[] storage.flat;
+    }
+}
+
+char* VmString::allocate() {
+    if (length <= SMALL_CAPACITY) {
+        kind = Kind::SMALL;
+        return storage.small;
+    }
+    kind = Kind::FLAT;
+    storage.flat = new char[length];
+    return storage.flat;
+}
+
+std::string_view VmString::view() const {
+    if (kind == Kind::ROPE) {
+        char* flat = new char[length];
+        copyTo(flat);
+        kind = Kind::FLAT;
+        storage.flat = flat;
+    }
+    return std::string_view(kind == Kind::SMALL ? storage.small : storage.flat, length);
+}
+
+void VmString::copyTo(char* out) const {
+    if (kind != Kind::ROPE) {
+        std::memcpy(out, kind == Kind::SMALL ? storage.small : storage.flat, length);
+        return;
+    }
+    // Concatenation chains nest as deep as they are long, so walk them with
+    // an explicit stack
+    std::vector<const VmString*> pending{this};
+    while (!pending.empty()) {
+        const VmString* string = pending.back();
+        pending.pop_back();
+        if (string->kind == Kind::ROPE) {
+            pending.push_back(string->storage.rope.right);
+            pending.push_back(string->storage.rope.left);
+        } else {
+            std::memcpy(out, string->kind == Kind::SMALL ? string->storage.small : string->storage.flat,
+                        string->length);
+            out += string->length;
+        }
+    }
+}
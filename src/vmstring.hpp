@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// String value of the bytecode interpreter. Up to SMALL_CAPACITY bytes are
+// stored inline. A longer concatenation starts out as a rope node pointing
+// at both operands, which must outlive it, and is flattened into a single
+// buffer the first time its bytes are read.
+class VmString {
+public:
+    static constexpr size_t SMALL_CAPACITY = 24;
+
+    explicit VmString(std::string_view bytes);
+    VmString(const VmString& left, const VmString& right);
+
+    // Joins `count` parts into one buffer of the final size
+    VmString(const VmString* const* parts, size_t count);
+
+    ~VmString();
+    VmString(const VmString&) = delete;
+    VmString& operator=(const VmString&) = delete;
+
+    size_t size() const { return length; }
+    bool isRope() const { return kind == Kind::ROPE; }
+
+    std::string_view view() const;
+    std::string str() const { return std::string(view()); }
+
+private:
+    enum class Kind : uint8_t { SMALL, FLAT, ROPE };
+
+    union Storage {
+        char small[SMALL_CAPACITY];
+        char* flat;
+        struct {
+            const VmString* left;
+            const VmString* right;
+        } rope;
+    };
+
+    size_t length;
+    mutable Kind kind;
+    mutable Storage storage;
+
+    // Space for `length` bytes, inline when they fit
+    char* allocate();
+
+    // Writes the bytes out without flattening any rope on the way
+    void copyTo(char* out) const;
+};
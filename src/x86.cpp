@@ -0,0 +1,1206 @@
+#include "x86.hpp"
+#include "utils.hpp"
+#include "value.hpp"
+#include <algorithm>
+#include <cinttypes>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+static const char* const regNames[] = {
+    "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+    "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"
+};
+
+static const char* const reg32Names[] = {
+    "eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
+    "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d"
+};
+
+static const Reg argumentRegs[] = {
+    Reg::RDI, Reg::RSI, Reg::RDX, Reg::RCX, Reg::R8, Reg::R9
+};
+
+static std::string regName(Reg r) {
+    return regNames[static_cast<int>(r)];
+}
+
+static std::string xmmName(Xmm x) {
+    return "xmm" + std::to_string(static_cast<int>(x));
+}
+
+static std::string memOperand(Reg base, int32_t disp) {
+    std::string result = "qword ptr [" + regName(base);
+    if (disp > 0) result += " + " + std::to_string(disp);
+    if (disp < 0) result += " - " + std::to_string(-static_cast<int64_t>(disp));
+    return result + "]";
+}
+
+const MachineSymbol* MachineModule::findSymbol(const std::string& name) const {
+    for (const auto& symbol : symbols) {
+        if (symbol.name == name) {
+            return &symbol;
+        }
+    }
+    return nullptr;
+}
+
+// X86Assembler implementation
+void X86Assembler::byte(uint8_t b) {
+    code.push_back(static_cast<char>(b));
+}
+
+void X86Assembler::imm32(int32_t value) {
+    char bytes[4];
+    std::memcpy(bytes, &value, 4);
+    code.append(bytes, 4);
+}
+
+void X86Assembler::imm64(int64_t value) {
+    char bytes[8];
+    std::memcpy(bytes, &value, 8);
+    code.append(bytes, 8);
+}
+
+void X86Assembler::rex(bool wide, int reg, int base) {
+    uint8_t prefix = 0x40 | (wide ? 0x08 : 0) | ((reg & 8) ? 0x04 : 0) | ((base & 8) ? 0x01 : 0);
+    if (prefix != 0x40) {
+        byte(prefix);
+    }
+}
+
+void X86Assembler::modrm(int reg, Reg base, int32_t disp) {
+    int b = static_cast<int>(base) & 7;
+    int mod = (disp == 0 && b != 5) ? 0 : (disp >= -128 && disp <= 127 ? 1 : 2);
+    byte(static_cast<uint8_t>((mod << 6) | ((reg & 7) << 3) | b));
+    if (b == 4) {
+        byte(0x24); // SIB: base only, no index
+    }
+    if (mod == 1) {
+        byte(static_cast<uint8_t>(static_cast<int8_t>(disp)));
+    } else if (mod == 2) {
+        imm32(disp);
+    }
+}
+
+void X86Assembler::modrmReg(int reg, int rm) {
+    byte(static_cast<uint8_t>(0xC0 | ((reg & 7) << 3) | (rm & 7)));
+}
+
+void X86Assembler::ripDisp(int reg, const std::string& symbol, RelocKind kind, int32_t offset) {
+    byte(static_cast<uint8_t>(((reg & 7) << 3) | 5));
+    relocations.push_back({SectionKind::TEXT, code.size(), kind, symbol, offset - 4});
+    imm32(0);
+}
+
+void X86Assembler::sse(uint8_t prefix, uint8_t op, int dst, int src, bool wide) {
+    byte(prefix);
+    rex(wide, dst, src);
+    byte(0x0F);
+    byte(op);
+    modrmReg(dst, src);
+}
+
+void X86Assembler::list(const std::string& text) {
+    if (listing) {
+        listing->push_back("    " + text);
+    }
+}
+
+void X86Assembler::label(const std::string& name) {
+    if (listing) {
+        listing->push_back(name + ":");
+    }
+}
+
+void X86Assembler::movLoad(Reg dst, Reg base, int32_t disp) {
+    rex(true, static_cast<int>(dst), static_cast<int>(base));
+    byte(0x8B);
+    modrm(static_cast<int>(dst), base, disp);
+    list("mov " + regName(dst) + ", " + memOperand(base, disp));
+}
+
+void X86Assembler::movStore(Reg base, int32_t disp, Reg src) {
+    rex(true, static_cast<int>(src), static_cast<int>(base));
+    byte(0x89);
+    modrm(static_cast<int>(src), base, disp);
+    list("mov " + memOperand(base, disp) + ", " + regName(src));
+}
+
+void X86Assembler::movImm(Reg dst, int64_t imm) {
+    int r = static_cast<int>(dst);
+    if (imm >= INT32_MIN && imm <= INT32_MAX) {
+        rex(true, 0, r);
+        byte(0xC7);
+        modrmReg(0, r);
+        imm32(static_cast<int32_t>(imm));
+    } else {
+        rex(true, 0, r);
+        byte(static_cast<uint8_t>(0xB8 + (r & 7)));
+        imm64(imm);
+    }
+    list("mov " + regName(dst) + ", " + std::to_string(imm));
+}
+
+void X86Assembler::movReg(Reg dst, Reg src) {
+    rex(true, static_cast<int>(src), static_cast<int>(dst));
+    byte(0x89);
+    modrmReg(static_cast<int>(src), static_cast<int>(dst));
+    list("mov " + regName(dst) + ", " + regName(src));
+}
+
+void X86Assembler::movReg32(Reg dst, Reg src) {
+    rex(false, static_cast<int>(src), static_cast<int>(dst));
+    byte(0x89);
+    modrmReg(static_cast<int>(src), static_cast<int>(dst));
+    list("mov " + std::string(reg32Names[static_cast<int>(dst)]) + ", " + reg32Names[static_cast<int>(src)]);
+}
+
+void X86Assembler::leaRip(Reg dst, const std::string& symbol) {
+    rex(true, static_cast<int>(dst), 0);
+    byte(0x8D);
+    ripDisp(static_cast<int>(dst), symbol, RelocKind::PC32);
+    list("lea " + regName(dst) + ", [rip + " + symbol + "]");
+}
+
+void X86Assembler::loadRip(Reg dst, const std::string& symbol) {
+    rex(true, static_cast<int>(dst), 0);
+    byte(0x8B);
+    ripDisp(static_cast<int>(dst), symbol, RelocKind::PC32);
+    list("mov " + regName(dst) + ", qword ptr [rip + " + symbol + "]");
+}
+
+void X86Assembler::storeRip(const std::string& symbol, Reg src) {
+    rex(true, static_cast<int>(src), 0);
+    byte(0x89);
+    ripDisp(static_cast<int>(src), symbol, RelocKind::PC32);
+    list("mov qword ptr [rip + " + symbol + "], " + regName(src));
+}
+
+void X86Assembler::incRip(const std::string& symbol, int32_t offset) {
+    rex(true, 0, 0);
+    byte(0xFF);
+    ripDisp(0, symbol, RelocKind::PC32, offset);
+    list("inc qword ptr [rip + " + symbol + " + " + std::to_string(offset) + "]");
+}
+
+void X86Assembler::add(Reg dst, Reg src) {
+    rex(true, static_cast<int>(src), static_cast<int>(dst));
+    byte(0x01);
+    modrmReg(static_cast<int>(src), static_cast<int>(dst));
+    list("add " + regName(dst) + ", " + regName(src));
+}
+
+void X86Assembler::sub(Reg dst, Reg src) {
+    rex(true, static_cast<int>(src), static_cast<int>(dst));
+    byte(0x29);
+    modrmReg(static_cast<int>(src), static_cast<int>(dst));
+    list("sub " + regName(dst) + ", " + regName(src));
+}
+
+void X86Assembler::imul(Reg dst, Reg src) {
+    rex(true, static_cast<int>(dst), static_cast<int>(src));
+    byte(0x0F);
+    byte(0xAF);
+    modrmReg(static_cast<int>(dst), static_cast<int>(src));
+    list("imul " + regName(dst) + ", " + regName(src));
+}
+
+void X86Assembler::cqo() {
+    byte(0x48);
+    byte(0x99);
+    list("cqo");
+}
+
+void X86Assembler::idiv(Reg src) {
+    rex(true, 0, static_cast<int>(src));
+    byte(0xF7);
+    modrmReg(7, static_cast<int>(src));
+    list("idiv " + regName(src));
+}
+
+void X86Assembler::xor32(Reg dst, Reg src) {
+    rex(false, static_cast<int>(src), static_cast<int>(dst));
+    byte(0x31);
+    modrmReg(static_cast<int>(src), static_cast<int>(dst));
+    list("xor " + std::string(reg32Names[static_cast<int>(dst)]) + ", " + reg32Names[static_cast<int>(src)]);
+}
+
+void X86Assembler::andReg(Reg dst, Reg src) {
+    rex(true, static_cast<int>(src), static_cast<int>(dst));
+    byte(0x21);
+    modrmReg(static_cast<int>(src), static_cast<int>(dst));
+    list("and " + regName(dst) + ", " + regName(src));
+}
+
+void X86Assembler::orReg(Reg dst, Reg src) {
+    rex(true, static_cast<int>(src), static_cast<int>(dst));
+    byte(0x09);
+    modrmReg(static_cast<int>(src), static_cast<int>(dst));
+    list("or " + regName(dst) + ", " + regName(src));
+}
+
+void X86Assembler::cmp(Reg lhs, Reg rhs) {
+    rex(true, static_cast<int>(rhs), static_cast<int>(lhs));
+    byte(0x39);
+    modrmReg(static_cast<int>(rhs), static_cast<int>(lhs));
+    list("cmp " + regName(lhs) + ", " + regName(rhs));
+}
+
+void X86Assembler::cmpImm(Reg lhs, int32_t imm) {
+    rex(true, 0, static_cast<int>(lhs));
+    byte(0x81);
+    modrmReg(7, static_cast<int>(lhs));
+    imm32(imm);
+    list("cmp " + regName(lhs) + ", " + std::to_string(imm));
+}
+
+void X86Assembler::shiftImm(int extension, const char* mnemonic, Reg dst, uint8_t count) {
+    rex(true, 0, static_cast<int>(dst));
+    byte(0xC1);
+    modrmReg(extension, static_cast<int>(dst));
+    byte(count);
+    list(std::string(mnemonic) + " " + regName(dst) + ", " + std::to_string(count));
+}
+
+void X86Assembler::shlImm(Reg dst, uint8_t count) {
+    shiftImm(4, "shl", dst, count);
+}
+
+void X86Assembler::shrImm(Reg dst, uint8_t count) {
+    shiftImm(5, "shr", dst, count);
+}
+
+void X86Assembler::sarImm(Reg dst, uint8_t count) {
+    shiftImm(7, "sar", dst, count);
+}
+
+size_t X86Assembler::subRsp(int32_t imm) {
+    // Always imm32 so the frame size can be patched once it is known
+    byte(0x48);
+    byte(0x81);
+    modrmReg(5, static_cast<int>(Reg::RSP));
+    size_t at = code.size();
+    imm32(imm);
+    list("sub rsp, " + std::to_string(imm));
+    return at;
+}
+
+void X86Assembler::addRsp(int32_t imm) {
+    byte(0x48);
+    byte(0x81);
+    modrmReg(0, static_cast<int>(Reg::RSP));
+    imm32(imm);
+    list("add rsp, " + std::to_string(imm));
+}
+
+void X86Assembler::patchImm32(size_t at, int32_t value) {
+    std::memcpy(&code[at], &value, 4);
+}
+
+void X86Assembler::movqToXmm(Xmm dst, Reg src) {
+    sse(0x66, 0x6E, static_cast<int>(dst), static_cast<int>(src), true);
+    list("movq " + xmmName(dst) + ", " + regName(src));
+}
+
+void X86Assembler::movqFromXmm(Reg dst, Xmm src) {
+    sse(0x66, 0x7E, static_cast<int>(src), static_cast<int>(dst), true);
+    list("movq " + regName(dst) + ", " + xmmName(src));
+}
+
+void X86Assembler::cvtsi2sd(Xmm dst, Reg src) {
+    sse(0xF2, 0x2A, static_cast<int>(dst), static_cast<int>(src), true);
+    list("cvtsi2sd " + xmmName(dst) + ", " + regName(src));
+}
+
+void X86Assembler::addsd(Xmm dst, Xmm src) {
+    sse(0xF2, 0x58, static_cast<int>(dst), static_cast<int>(src));
+    list("addsd " + xmmName(dst) + ", " + xmmName(src));
+}
+
+void X86Assembler::subsd(Xmm dst, Xmm src) {
+    sse(0xF2, 0x5C, static_cast<int>(dst), static_cast<int>(src));
+    list("subsd " + xmmName(dst) + ", " + xmmName(src));
+}
+
+void X86Assembler::mulsd(Xmm dst, Xmm src) {
+    sse(0xF2, 0x59, static_cast<int>(dst), static_cast<int>(src));
+    list("mulsd " + xmmName(dst) + ", " + xmmName(src));
+}
+
+void X86Assembler::divsd(Xmm dst, Xmm src) {
+    sse(0xF2, 0x5E, static_cast<int>(dst), static_cast<int>(src));
+    list("divsd " + xmmName(dst) + ", " + xmmName(src));
+}
+
+void X86Assembler::push(Reg src) {
+    rex(false, 0, static_cast<int>(src));
+    byte(static_cast<uint8_t>(0x50 + (static_cast<int>(src) & 7)));
+    list("push " + regName(src));
+}
+
+void X86Assembler::pushMem(Reg base, int32_t disp) {
+    rex(false, 0, static_cast<int>(base));
+    byte(0xFF);
+    modrm(6, base, disp);
+    list("push " + memOperand(base, disp));
+}
+
+void X86Assembler::call(const std::string& symbol) {
+    byte(0xE8);
+    relocations.push_back({SectionKind::TEXT, code.size(), RelocKind::PLT32, symbol, -4});
+    imm32(0);
+    list("call " + symbol);
+}
+
+void X86Assembler::jmp(const std::string& symbol) {
+    byte(0xE9);
+    relocations.push_back({SectionKind::TEXT, code.size(), RelocKind::PLT32, symbol, -4});
+    imm32(0);
+    list("jmp " + symbol);
+}
+
+void X86Assembler::jmpTo(size_t target, const std::string& label) {
+    // Backward jump within the code being assembled; no relocation needed
+    byte(0xE9);
+    imm32(static_cast<int32_t>(static_cast<int64_t>(target) - static_cast<int64_t>(code.size() + 4)));
+    list("jmp " + label);
+}
+
+size_t X86Assembler::jcc(Cond cond, const std::string& label) {
+    static const char* const mnemonics[] = {"jo", "jno", "jb", "jae", "je", "jne"};
+    byte(0x0F);
+    byte(static_cast<uint8_t>(0x80 + static_cast<uint8_t>(cond)));
+    size_t at = code.size();
+    imm32(0);
+    list(std::string(mnemonics[static_cast<int>(cond)]) + " " + label);
+    return at;
+}
+
+size_t X86Assembler::jmpForward(const std::string& label) {
+    byte(0xE9);
+    size_t at = code.size();
+    imm32(0);
+    list("jmp " + label);
+    return at;
+}
+
+void X86Assembler::bind(const std::vector<size_t>& fixups, const std::string& label) {
+    for (size_t at : fixups) {
+        patchImm32(at, static_cast<int32_t>(code.size() - (at + 4)));
+    }
+    if (listing) {
+        listing->push_back(label + ":");
+    }
+}
+
+void X86Assembler::leave() {
+    byte(0xC9);
+    list("leave");
+}
+
+void X86Assembler::ret() {
+    byte(0xC3);
+    list("ret");
+}
+
+void X86Assembler::ud2() {
+    byte(0x0F);
+    byte(0x0B);
+    list("ud2");
+}
+
+void X86Assembler::syscall() {
+    byte(0x0F);
+    byte(0x05);
+    list("syscall");
+}
+
+// X86Backend implementation
+X86Backend::X86Backend(ErrorReporter& reporter, const StringPool& pool, bool listing)
+    : errorReporter(reporter), withListing(listing),
+      assembler(machineModule.text, machineModule.relocations, listing ? &textListing : nullptr),
+      strings(&pool), sourceFiles(nullptr),
+      functionStart(0), frameSizeAt(0), frameListingAt(0), bodyStart(0), paramCount(0), bodyLabelListed(false),
+      labelCounter(0), profileSize(0) {}
+
+bool X86Backend::lower(const std::vector<Instruction>& instructions) {
+    for (const auto& inst : instructions) {
+        if (sourceFiles && inst.position) {
+            noteSource(*inst.position);
+        }
+        if (!lowerInstruction(inst)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void X86Backend::noteSource(const Position& position) {
+    auto file = sourceFiles->find(position.filename);
+    if (file == sourceFiles->end() || position.line <= 0) {
+        return;
+    }
+    LineEntry entry{assembler.offset(), file->second, static_cast<uint32_t>(position.line),
+                    static_cast<uint32_t>(std::max(position.column, 0))};
+    auto& lines = machineModule.lines;
+    if (!lines.empty() && lines.back().file == entry.file && lines.back().line == entry.line &&
+        lines.back().column == entry.column) {
+        return;
+    }
+    // An instruction that produced no code gives way to the next one
+    if (!lines.empty() && lines.back().offset == entry.offset) {
+        lines.back() = entry;
+    } else {
+        lines.push_back(entry);
+    }
+    if (withListing) {
+        textListing.push_back("    .loc " + std::to_string(entry.file + 1) + " " + std::to_string(entry.line) + " " +
+                              std::to_string(entry.column));
+    }
+}
+
+void X86Backend::noteNoSource() {
+    auto& lines = machineModule.lines;
+    if (lines.empty() || lines.back().line == 0) {
+        return;
+    }
+    uint32_t file = lines.back().file;
+    if (lines.back().offset == assembler.offset()) {
+        lines.pop_back();
+    } else {
+        lines.push_back({assembler.offset(), file, 0, 0});
+    }
+    if (withListing) {
+        textListing.push_back("    .loc " + std::to_string(file + 1) + " 0");
+    }
+}
+
+std::string X86Backend::symbolName(const std::string& operand) {
+    return (!operand.empty() && operand[0] == '@') ? operand.substr(1) : operand;
+}
+
+bool X86Backend::lowerInstruction(const Instruction& inst) {
+    const std::string& op = inst.opcode;
+    const auto& args = inst.operands;
+
+    if (op.empty()) {
+        return true; // comment
+    }
+
+    if (op == "func") {
+        beginFunction(symbolName(args[0]));
+    } else if (op == "endfunc") {
+        endFunction();
+    } else if (op == "global") {
+        if (args.size() == 3) {
+            defineGlobal(symbolName(args[0]), args[1], args[2]);
+        } else {
+            declareGlobal(symbolName(args[0]));
+        }
+    } else if (op == "param") {
+        size_t index = std::stoul(args[1]);
+        paramCount = std::max(paramCount, index + 1);
+        if (index < 6) {
+            store(args[0], argumentRegs[index]);
+        } else {
+            assembler.movLoad(Reg::RAX, Reg::RBP, static_cast<int32_t>(16 + 8 * (index - 6)));
+            store(args[0], Reg::RAX);
+        }
+    } else if (op == "const.i") {
+        assembler.movImm(Reg::RAX, std::stoll(args[1]));
+        store(args[0], Reg::RAX);
+    } else if (op == "const.f") {
+        double value = std::stod(args[1]);
+        int64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        assembler.movImm(Reg::RAX, bits);
+        store(args[0], Reg::RAX);
+    } else if (op == "const.s") {
+        assembler.leaRip(Reg::RAX, stringLabel(args[1]));
+        store(args[0], Reg::RAX);
+    } else if (op == "load") {
+        assembler.loadRip(Reg::RAX, symbolName(args[1]));
+        store(args[0], Reg::RAX);
+    } else if (op == "store") {
+        load(Reg::RAX, args[1]);
+        assembler.storeRip(symbolName(args[0]), Reg::RAX);
+    } else if (op == "mov") {
+        load(Reg::RAX, args[1]);
+        store(args[0], Reg::RAX);
+    } else if (op == "add.i" || op == "sub.i" || op == "mul.i" || op == "div.i") {
+        load(Reg::RAX, args[1]);
+        load(Reg::RCX, args[2]);
+        if (op == "add.i") {
+            assembler.add(Reg::RAX, Reg::RCX);
+        } else if (op == "sub.i") {
+            assembler.sub(Reg::RAX, Reg::RCX);
+        } else if (op == "mul.i") {
+            assembler.imul(Reg::RAX, Reg::RCX);
+        } else {
+            assembler.cqo();
+            assembler.idiv(Reg::RCX);
+        }
+        store(args[0], Reg::RAX);
+    } else if (op == "add.f" || op == "sub.f" || op == "mul.f" || op == "div.f") {
+        load(Reg::RAX, args[1]);
+        load(Reg::RCX, args[2]);
+        assembler.movqToXmm(Xmm::XMM0, Reg::RAX);
+        assembler.movqToXmm(Xmm::XMM1, Reg::RCX);
+        if (op == "add.f") {
+            assembler.addsd(Xmm::XMM0, Xmm::XMM1);
+        } else if (op == "sub.f") {
+            assembler.subsd(Xmm::XMM0, Xmm::XMM1);
+        } else if (op == "mul.f") {
+            assembler.mulsd(Xmm::XMM0, Xmm::XMM1);
+        } else {
+            assembler.divsd(Xmm::XMM0, Xmm::XMM1);
+        }
+        assembler.movqFromXmm(Reg::RAX, Xmm::XMM0);
+        store(args[0], Reg::RAX);
+    } else if (op == "itof") {
+        load(Reg::RAX, args[1]);
+        assembler.cvtsi2sd(Xmm::XMM0, Reg::RAX);
+        assembler.movqFromXmm(Reg::RAX, Xmm::XMM0);
+        store(args[0], Reg::RAX);
+    } else if (op.compare(0, 4, "box.") == 0) {
+        lowerBox(op, args[0], args[1]);
+    } else if (op.compare(0, 6, "unbox.") == 0) {
+        lowerUnbox(op, args[0], args[1]);
+    } else if (op == "add.a" || op == "sub.a" || op == "mul.a" || op == "div.a") {
+        lowerAnyArithmetic(op, args[0], args[1], args[2]);
+    } else if (op == "concat") {
+        load(Reg::RDI, args[1]);
+        load(Reg::RSI, args[2]);
+        assembler.call(RUNTIME_CONCAT);
+        store(args[0], Reg::RAX);
+    } else if (op == "concat.n") {
+        lowerConcat(args);
+    } else if (op == "arg") {
+        size_t index = std::stoul(args[0]);
+        if (pendingArgs.size() <= index) {
+            pendingArgs.resize(index + 1);
+        }
+        pendingArgs[index] = args[1];
+    } else if (op == "call") {
+        lowerCall(args[0], symbolName(args[1]), std::stoul(args[2]));
+    } else if (op == "tailcall") {
+        lowerTailCall(symbolName(args[0]), std::stoul(args[1]));
+    } else if (op == "count") {
+        assembler.incRip(PROFILE_COUNTERS, static_cast<int32_t>(8 * std::stoul(args[0])));
+    } else if (op == "ret") {
+        if (args.empty()) {
+            assembler.xor32(Reg::RAX, Reg::RAX);
+        } else {
+            load(Reg::RAX, args[0]);
+        }
+        assembler.leave();
+        assembler.ret();
+    } else {
+        errorReporter.reportError(ErrorSeverity::ERROR, ErrorCategory::SEMANTIC, Position(),
+                                  "Native backend does not support IR instruction '" + op + "'",
+                                  "in function " + currentFunction);
+        return false;
+    }
+    return true;
+}
+
+void X86Backend::beginFunction(const std::string& name) {
+    currentFunction = name;
+    functionStart = assembler.offset();
+    slots.clear();
+    pendingArgs.clear();
+
+    if (withListing) {
+        textListing.push_back("");
+        textListing.push_back("    .globl " + name);
+        textListing.push_back("    .type " + name + ", @function");
+    }
+    assembler.label(name);
+    assembler.push(Reg::RBP);
+    assembler.movReg(Reg::RBP, Reg::RSP);
+    frameListingAt = textListing.size();
+    frameSizeAt = assembler.subRsp(0);
+    bodyStart = assembler.offset();
+    paramCount = 0;
+    bodyLabelListed = false;
+    labelCounter = 0;
+    trapFixups.clear();
+    coldBlocks.clear();
+}
+
+void X86Backend::endFunction() {
+    // A cold block may add more, so each is moved out before it runs
+    for (size_t i = 0; i < coldBlocks.size(); ++i) {
+        auto block = std::move(coldBlocks[i]);
+        block();
+    }
+    coldBlocks.clear();
+
+    // Failed `any` type checks land here
+    if (!trapFixups.empty()) {
+        assembler.bind(trapFixups, ".L" + currentFunction + ".trap");
+        assembler.ud2();
+        trapFixups.clear();
+    }
+
+    // Keep rsp 16-byte aligned at call sites
+    int32_t frameSize = static_cast<int32_t>((slots.size() * 8 + 15) & ~size_t(15));
+    assembler.patchImm32(frameSizeAt, frameSize);
+    if (withListing) {
+        textListing[frameListingAt] = "    sub rsp, " + std::to_string(frameSize);
+    }
+
+    machineModule.symbols.push_back({currentFunction, SectionKind::TEXT, functionStart,
+                                     assembler.offset() - functionStart, true, true});
+    if (withListing) {
+        textListing.push_back("    .size " + currentFunction + ", .-" + currentFunction);
+    }
+    if (sourceFiles) {
+        noteNoSource();
+    }
+    currentFunction.clear();
+}
+
+void X86Backend::declareGlobal(const std::string& name) {
+    machineModule.symbols.push_back({name, SectionKind::BSS, machineModule.bssSize, 8, false, false});
+    machineModule.bssSize += 8;
+    if (withListing) {
+        dataListing.push_back("    .lcomm " + name + ", 8");
+    }
+}
+
+// Constant initial values are stored in .data, so nothing runs for them
+// at startup
+void X86Backend::defineGlobal(const std::string& name, const std::string& kind, const std::string& value) {
+    int64_t bits = 0;
+    if (kind == "const.i") {
+        bits = std::stoll(value);
+    } else if (kind == "const.f") {
+        double number = std::stod(value);
+        std::memcpy(&bits, &number, sizeof(bits));
+    } else if (kind != "const.s") {
+        errorReporter.reportError(ErrorSeverity::FATAL, ErrorCategory::SEMANTIC, Position(),
+                                  "Internal error: bad initial value for global '" + name + "'");
+        return;
+    }
+    if (bits == 0 && kind != "const.s") {
+        declareGlobal(name);
+        return;
+    }
+    
+    std::string& data = machineModule.data;
+    data.resize((data.size() + 7) & ~size_t(7), '\0');
+    uint64_t offset = data.size();
+    machineModule.symbols.push_back({name, SectionKind::DATA, offset, 8, false, false});
+    std::string quad;
+    if (kind == "const.s") {
+        std::string label = stringLabel(value);
+        machineModule.relocations.push_back({SectionKind::DATA, offset, RelocKind::ABS64, label, 0});
+        quad = label;
+    } else {
+        quad = std::to_string(bits);
+    }
+    for (int i = 0; i < 8; ++i) {
+        data.push_back(static_cast<char>(static_cast<uint64_t>(bits) >> (8 * i)));
+    }
+    if (withListing) {
+        dataListing.push_back("    .pushsection .data");
+        dataListing.push_back("    .p2align 3");
+        dataListing.push_back(name + ":");
+        dataListing.push_back("    .quad " + quad);
+        dataListing.push_back("    .popsection");
+    }
+}
+
+void X86Backend::emitStart(bool hasInit, bool exitThroughRuntime) {
+    size_t start = assembler.offset();
+    if (withListing) {
+        textListing.push_back("");
+        textListing.push_back("    .globl _start");
+    }
+    assembler.label("_start");
+    assembler.xor32(Reg::RBP, Reg::RBP);
+    if (hasInit) {
+        assembler.call(CodeGenerator::INIT_FUNCTION);
+    }
+    assembler.call("main");
+    if (profileSize) {
+        // rbx keeps main's result while the profile is written
+        assembler.movReg(Reg::RBX, Reg::RAX);
+        assembler.leaRip(Reg::RDI, PROFILE_PATH);
+        assembler.leaRip(Reg::RSI, PROFILE_KEYS);
+        assembler.leaRip(Reg::RDX, PROFILE_COUNTERS);
+        assembler.movImm(Reg::RCX, static_cast<int64_t>(profileSize));
+        assembler.call(RUNTIME_PROFILE_WRITE);
+        assembler.movReg(Reg::RAX, Reg::RBX);
+        exitThroughRuntime = true;
+    }
+    assembler.movReg32(Reg::RDI, Reg::RAX);
+    if (exitThroughRuntime) {
+        assembler.call(RUNTIME_EXIT);
+    } else {
+        assembler.movImm(Reg::RAX, 231); // exit_group
+        assembler.syscall();
+    }
+    machineModule.symbols.push_back({"_start", SectionKind::TEXT, start,
+                                     assembler.offset() - start, true, true});
+}
+
+void X86Backend::append(X86Backend& function, bool cold) {
+    MachineModule& other = function.machineModule;
+    if (!other.rodata.empty() || !other.data.empty() || other.bssSize != 0) {
+        errorReporter.reportError(ErrorSeverity::FATAL, ErrorCategory::SEMANTIC, Position(),
+                                  "Internal error: appended function owns data");
+        return;
+    }
+
+    moveCode(other, cold ? coldModule : machineModule);
+    auto& listing = cold ? coldListing : textListing;
+    listing.insert(listing.end(), std::make_move_iterator(function.textListing.begin()),
+                   std::make_move_iterator(function.textListing.end()));
+    function.textListing.clear();
+}
+
+void X86Backend::placeColdCode() {
+    if (coldModule.text.empty()) {
+        return;
+    }
+    machineModule.coldBytes = coldModule.text.size();
+    moveCode(coldModule, machineModule);
+    if (!coldListing.empty()) {
+        textListing.push_back("    .section .text.cold,\"ax\",@progbits");
+        textListing.insert(textListing.end(), std::make_move_iterator(coldListing.begin()),
+                           std::make_move_iterator(coldListing.end()));
+        textListing.push_back("    .text");
+        coldListing.clear();
+    }
+}
+
+void X86Backend::moveCode(MachineModule& from, MachineModule& to) {
+    size_t base = to.text.size();
+    to.text += from.text;
+    for (auto symbol : from.symbols) {
+        symbol.offset += base;
+        to.symbols.push_back(std::move(symbol));
+    }
+    for (auto relocation : from.relocations) {
+        relocation.offset += base;
+        to.relocations.push_back(std::move(relocation));
+    }
+    for (auto entry : from.lines) {
+        entry.offset += base;
+        to.lines.push_back(entry);
+    }
+    from = MachineModule();
+}
+
+void X86Backend::drainListing(std::vector<std::string>& text, std::vector<std::string>& data) {
+    text.clear();
+    data.clear();
+    textListing.swap(text);
+    dataListing.swap(data);
+}
+
+int32_t X86Backend::slotFor(const std::string& temp) {
+    auto it = slots.find(temp);
+    if (it != slots.end()) {
+        return it->second;
+    }
+    int32_t disp = -8 * static_cast<int32_t>(slots.size() + 1);
+    slots.emplace(temp, disp);
+    return disp;
+}
+
+void X86Backend::load(Reg dst, const std::string& temp) {
+    assembler.movLoad(dst, Reg::RBP, slotFor(temp));
+}
+
+void X86Backend::store(const std::string& temp, Reg src) {
+    assembler.movStore(Reg::RBP, slotFor(temp), src);
+}
+
+std::string X86Backend::stringLabel(const std::string& operand) {
+    // Operands carry the escaped source spelling, quotes included
+    std::string escaped = operand.size() >= 2 ? operand.substr(1, operand.size() - 2) : operand;
+    size_t index = strings->find(CompilerUtils::unescapeString(escaped));
+    if (index == StringPool::NOT_FOUND) {
+        errorReporter.reportError(ErrorSeverity::FATAL, ErrorCategory::SEMANTIC, Position(),
+                                  "Internal error: string constant " + operand + " is not pooled",
+                                  "in function " + currentFunction);
+        return ".Lstr0";
+    }
+    return ".Lstr" + std::to_string(index);
+}
+
+void X86Backend::defineProfile(const std::vector<uint64_t>& keys, const std::string& path) {
+    profileSize = keys.size();
+    machineModule.symbols.push_back({PROFILE_COUNTERS, SectionKind::BSS, machineModule.bssSize, 8 * keys.size(),
+                                     false, false});
+    machineModule.bssSize += 8 * keys.size();
+
+    std::string& rodata = machineModule.rodata;
+    rodata.resize((rodata.size() + 7) & ~size_t(7), '\0');
+    machineModule.symbols.push_back({PROFILE_KEYS, SectionKind::RODATA, rodata.size(), 8 * keys.size(), false, false});
+    for (uint64_t key : keys) {
+        for (int i = 0; i < 8; ++i) {
+            rodata.push_back(static_cast<char>(key >> (8 * i)));
+        }
+    }
+    machineModule.symbols.push_back({PROFILE_PATH, SectionKind::RODATA, rodata.size(), path.size() + 1, false, false});
+    rodata += path;
+    rodata.push_back('\0');
+
+    if (withListing) {
+        dataListing.push_back("    .lcomm " + std::string(PROFILE_COUNTERS) + ", " + std::to_string(8 * keys.size()));
+        dataListing.push_back("    .p2align 3");
+        dataListing.push_back(std::string(PROFILE_KEYS) + ":");
+        char quad[32];
+        for (uint64_t key : keys) {
+            std::snprintf(quad, sizeof(quad), "    .quad 0x%016" PRIx64, key);
+            dataListing.push_back(quad);
+        }
+        dataListing.push_back(std::string(PROFILE_PATH) + ":");
+        dataListing.push_back("    .string \"" + CompilerUtils::escapeString(path) + "\"");
+    }
+}
+
+// Each label is preceded by the string's length; see StringPool::layout()
+void X86Backend::emitStrings() {
+    std::string& rodata = machineModule.rodata;
+    rodata.resize((rodata.size() + 7) & ~size_t(7), '\0');
+    size_t base = rodata.size();
+    rodata += strings->getData();
+
+    const auto& entries = strings->getEntries();
+    for (size_t i = 0; i < entries.size(); ++i) {
+        machineModule.symbols.push_back({".Lstr" + std::to_string(i), SectionKind::RODATA, base + entries[i].offset,
+                                         entries[i].bytes.size() + 1, false, false});
+    }
+    if (!withListing) {
+        return;
+    }
+    for (size_t i = 0; i < entries.size(); ++i) {
+        dataListing.push_back("    .p2align 3");
+        dataListing.push_back("    .quad " + std::to_string(entries[i].bytes.size()));
+        dataListing.push_back(".Lstr" + std::to_string(i) + ":");
+        dataListing.push_back("    .string \"" + CompilerUtils::escapeString(entries[i].bytes) + "\"");
+    }
+}
+
+void X86Backend::lowerCall(const std::string& dst, const std::string& callee, size_t argc) {
+    size_t stackArgs = argc > 6 ? argc - 6 : 0;
+    int32_t padding = (stackArgs % 2) ? 8 : 0;
+
+    if (padding) {
+        assembler.movImm(Reg::RAX, 0);
+        assembler.push(Reg::RAX);
+    }
+    for (size_t i = argc; i-- > 6;) {
+        assembler.pushMem(Reg::RBP, slotFor(pendingArgs[i]));
+    }
+    for (size_t i = 0; i < argc && i < 6; ++i) {
+        load(argumentRegs[i], pendingArgs[i]);
+    }
+
+    assembler.call(callee);
+
+    if (stackArgs > 0) {
+        assembler.addRsp(static_cast<int32_t>(8 * stackArgs) + padding);
+    }
+    store(dst, Reg::RAX);
+    pendingArgs.clear();
+}
+
+// The parts are pushed so they sit in memory in order, and the runtime gets
+// their address and count
+void X86Backend::lowerConcat(const std::vector<std::string>& operands) {
+    size_t count = operands.size() - 1;
+    int32_t padding = (count % 2) ? 8 : 0;
+    if (padding) {
+        assembler.push(Reg::RAX);
+    }
+    for (size_t i = operands.size(); i-- > 1;) {
+        assembler.pushMem(Reg::RBP, slotFor(operands[i]));
+    }
+    assembler.movReg(Reg::RDI, Reg::RSP);
+    assembler.movImm(Reg::RSI, static_cast<int64_t>(count));
+    assembler.call(RUNTIME_CONCAT_N);
+    assembler.addRsp(static_cast<int32_t>(8 * count) + padding);
+    store(operands[0], Reg::RAX);
+}
+
+// Arguments go where the caller's own arguments arrived. A call to the
+// function itself jumps back past the prologue, which makes it a loop;
+// any other callee is entered with the frame already torn down.
+void X86Backend::lowerTailCall(const std::string& callee, size_t argc) {
+    for (size_t i = 6; i < argc; ++i) {
+        load(Reg::RAX, pendingArgs[i]);
+        assembler.movStore(Reg::RBP, static_cast<int32_t>(16 + 8 * (i - 6)), Reg::RAX);
+    }
+    for (size_t i = 0; i < argc && i < 6; ++i) {
+        load(argumentRegs[i], pendingArgs[i]);
+    }
+    pendingArgs.clear();
+
+    if (callee == currentFunction) {
+        std::string label = ".L" + currentFunction + ".body";
+        if (withListing && !bodyLabelListed) {
+            textListing.insert(textListing.begin() + static_cast<std::ptrdiff_t>(frameListingAt) + 1, label + ":");
+            bodyLabelListed = true;
+        }
+        assembler.jmpTo(bodyStart, label);
+    } else {
+        assembler.leave();
+        assembler.jmp(callee);
+    }
+}
+
+std::string X86Backend::newLabel() {
+    return ".L" + currentFunction + "." + std::to_string(labelCounter++);
+}
+
+// Falls through when the NaN-box tag matches and traps otherwise
+void X86Backend::checkTag(Reg value, uint64_t tag) {
+    assembler.movReg(Reg::RDX, value);
+    assembler.shrImm(Reg::RDX, NanBox::TAG_SHIFT);
+    assembler.cmpImm(Reg::RDX, static_cast<int32_t>(tag));
+    trapFixups.push_back(assembler.jcc(Cond::NE, ".L" + currentFunction + ".trap"));
+}
+
+// Marks a point that a cold block jumps back to
+size_t X86Backend::resumeHere(const std::string& label) {
+    assembler.bind({}, label);
+    return assembler.offset();
+}
+
+// Ints that do not survive the round trip through 48 bits are stored in a
+// cell from the runtime allocator. Clobbers the caller-saved registers.
+void X86Backend::boxInt() {
+    std::string wide = newLabel();
+    std::string resume = newLabel();
+    assembler.movReg(Reg::RDX, Reg::RAX);
+    assembler.shlImm(Reg::RDX, 64 - NanBox::TAG_SHIFT);
+    assembler.sarImm(Reg::RDX, 64 - NanBox::TAG_SHIFT);
+    assembler.cmp(Reg::RDX, Reg::RAX);
+    size_t tooWide = assembler.jcc(Cond::NE, wide);
+    assembler.shlImm(Reg::RAX, 64 - NanBox::TAG_SHIFT);
+    assembler.shrImm(Reg::RAX, 64 - NanBox::TAG_SHIFT);
+    assembler.movImm(Reg::RDX, static_cast<int64_t>(NanBox::INT_TAG << NanBox::TAG_SHIFT));
+    assembler.orReg(Reg::RAX, Reg::RDX);
+    size_t resumeAt = resumeHere(resume);
+
+    coldBlocks.push_back([this, tooWide, wide, resume, resumeAt] {
+        assembler.bind({tooWide}, wide);
+        // 16 bytes keep the stack aligned for the call
+        assembler.subRsp(16);
+        assembler.movStore(Reg::RSP, 0, Reg::RAX);
+        assembler.movImm(Reg::RDI, sizeof(int64_t));
+        assembler.call(RUNTIME_ALLOC);
+        assembler.movLoad(Reg::RCX, Reg::RSP, 0);
+        assembler.addRsp(16);
+        assembler.movStore(Reg::RAX, 0, Reg::RCX);
+        assembler.movImm(Reg::RDX, static_cast<int64_t>(NanBox::WIDE_INT_TAG << NanBox::TAG_SHIFT));
+        assembler.orReg(Reg::RAX, Reg::RDX);
+        assembler.jmpTo(resumeAt, resume);
+    });
+}
+
+// Unboxes either kind of int in place; any other type jumps to `label`
+// through the returned fixup
+size_t X86Backend::unboxAnyInt(Reg value, const std::string& label) {
+    std::string narrow = newLabel();
+    std::string done = newLabel();
+    assembler.movReg(Reg::RDX, value);
+    assembler.shrImm(Reg::RDX, NanBox::TAG_SHIFT);
+    assembler.cmpImm(Reg::RDX, static_cast<int32_t>(NanBox::INT_TAG));
+    size_t isNarrow = assembler.jcc(Cond::E, narrow);
+    assembler.cmpImm(Reg::RDX, static_cast<int32_t>(NanBox::WIDE_INT_TAG));
+    size_t notInt = assembler.jcc(Cond::NE, label);
+    assembler.movImm(Reg::RDX, static_cast<int64_t>(NanBox::PAYLOAD_MASK));
+    assembler.andReg(value, Reg::RDX);
+    assembler.movLoad(value, value, 0);
+    size_t wideDone = assembler.jmpForward(done);
+    assembler.bind({isNarrow}, narrow);
+    assembler.shlImm(value, 64 - NanBox::TAG_SHIFT);
+    assembler.sarImm(value, 64 - NanBox::TAG_SHIFT);
+    assembler.bind({wideDone}, done);
+    return notInt;
+}
+
+// Takes back what boxInt() made; every other type traps
+void X86Backend::unboxInt() {
+    std::string wide = newLabel();
+    std::string resume = newLabel();
+    assembler.movReg(Reg::RDX, Reg::RAX);
+    assembler.shrImm(Reg::RDX, NanBox::TAG_SHIFT);
+    assembler.cmpImm(Reg::RDX, static_cast<int32_t>(NanBox::INT_TAG));
+    size_t notNarrow = assembler.jcc(Cond::NE, wide);
+    assembler.shlImm(Reg::RAX, 64 - NanBox::TAG_SHIFT);
+    assembler.sarImm(Reg::RAX, 64 - NanBox::TAG_SHIFT);
+    size_t resumeAt = resumeHere(resume);
+
+    coldBlocks.push_back([this, notNarrow, wide, resume, resumeAt] {
+        assembler.bind({notNarrow}, wide);
+        assembler.cmpImm(Reg::RDX, static_cast<int32_t>(NanBox::WIDE_INT_TAG));
+        trapFixups.push_back(assembler.jcc(Cond::NE, ".L" + currentFunction + ".trap"));
+        assembler.movImm(Reg::RDX, static_cast<int64_t>(NanBox::PAYLOAD_MASK));
+        assembler.andReg(Reg::RAX, Reg::RDX);
+        assembler.movLoad(Reg::RAX, Reg::RAX, 0);
+        assembler.jmpTo(resumeAt, resume);
+    });
+}
+
+// A NaN whose bits fall in the tag space would read back as another type
+void X86Backend::canonicalizeFloat() {
+    std::string done = newLabel();
+    assembler.movReg(Reg::RDX, Reg::RAX);
+    assembler.shrImm(Reg::RDX, NanBox::TAG_SHIFT);
+    assembler.cmpImm(Reg::RDX, static_cast<int32_t>(NanBox::FIRST_TAG));
+    size_t isFloat = assembler.jcc(Cond::B, done);
+    assembler.movImm(Reg::RAX, static_cast<int64_t>(NanBox::CANONICAL_NAN));
+    assembler.bind({isFloat}, done);
+}
+
+// Unboxes an int or a float in rax as a double; anything else traps
+void X86Backend::anyToFloat(Xmm dst) {
+    std::string done = newLabel();
+    assembler.movReg(Reg::RDX, Reg::RAX);
+    assembler.shrImm(Reg::RDX, NanBox::TAG_SHIFT);
+    assembler.cmpImm(Reg::RDX, static_cast<int32_t>(NanBox::FIRST_TAG));
+    size_t isFloat = assembler.jcc(Cond::B, done);
+    trapFixups.push_back(unboxAnyInt(Reg::RAX, ".L" + currentFunction + ".trap"));
+    assembler.cvtsi2sd(Xmm::XMM0, Reg::RAX);
+    assembler.movqFromXmm(Reg::RAX, Xmm::XMM0);
+    assembler.bind({isFloat}, done);
+    assembler.movqToXmm(dst, Reg::RAX);
+}
+
+void X86Backend::lowerBox(const std::string& op, const std::string& dst, const std::string& src) {
+    load(Reg::RAX, src);
+    if (op == "box.i") {
+        boxInt();
+    } else if (op == "box.f") {
+        canonicalizeFloat();
+    } else {
+        uint64_t tag = op == "box.s" ? NanBox::STRING_TAG : NanBox::BOOL_TAG;
+        assembler.movImm(Reg::RDX, static_cast<int64_t>(tag << NanBox::TAG_SHIFT));
+        assembler.orReg(Reg::RAX, Reg::RDX);
+    }
+    store(dst, Reg::RAX);
+}
+
+void X86Backend::lowerUnbox(const std::string& op, const std::string& dst, const std::string& src) {
+    load(Reg::RAX, src);
+    if (op == "unbox.i") {
+        unboxInt();
+    } else if (op == "unbox.f") {
+        anyToFloat(Xmm::XMM0);
+    } else {
+        checkTag(Reg::RAX, op == "unbox.s" ? NanBox::STRING_TAG : NanBox::BOOL_TAG);
+        assembler.movImm(Reg::RDX, static_cast<int64_t>(NanBox::PAYLOAD_MASK));
+        assembler.andReg(Reg::RAX, Reg::RDX);
+    }
+    store(dst, Reg::RAX);
+}
+
+// Two 48-bit ints are handled inline and wide ones out of line; anything
+// else is widened to double, except that `+` of two strings calls the
+// runtime.
+void X86Backend::lowerAnyArithmetic(const std::string& op, const std::string& dst, const std::string& lhs,
+                                    const std::string& rhs) {
+    std::string slow = newLabel();
+    std::string resume = newLabel();
+    std::vector<size_t> toSlow;
+
+    load(Reg::RAX, lhs);
+    load(Reg::RCX, rhs);
+    for (Reg value : {Reg::RAX, Reg::RCX}) {
+        assembler.movReg(Reg::RDX, value);
+        assembler.shrImm(Reg::RDX, NanBox::TAG_SHIFT);
+        assembler.cmpImm(Reg::RDX, static_cast<int32_t>(NanBox::INT_TAG));
+        toSlow.push_back(assembler.jcc(Cond::NE, slow));
+        assembler.shlImm(value, 64 - NanBox::TAG_SHIFT);
+        assembler.sarImm(value, 64 - NanBox::TAG_SHIFT);
+    }
+    if (op == "add.a") {
+        assembler.add(Reg::RAX, Reg::RCX);
+    } else if (op == "sub.a") {
+        assembler.sub(Reg::RAX, Reg::RCX);
+    } else if (op == "mul.a") {
+        assembler.imul(Reg::RAX, Reg::RCX);
+        toSlow.push_back(assembler.jcc(Cond::O, slow));
+    } else {
+        assembler.cqo();
+        assembler.idiv(Reg::RCX);
+    }
+    boxInt();
+    store(dst, Reg::RAX);
+    size_t resumeAt = resumeHere(resume);
+
+    coldBlocks.push_back([this, op, dst, lhs, rhs, toSlow, slow, resume, resumeAt] {
+        assembler.bind(toSlow, slow);
+        if (op == "add.a") {
+            std::string numbers = newLabel();
+            std::vector<size_t> notStrings;
+            for (const std::string* operand : {&lhs, &rhs}) {
+                load(Reg::RDX, *operand);
+                assembler.shrImm(Reg::RDX, NanBox::TAG_SHIFT);
+                assembler.cmpImm(Reg::RDX, static_cast<int32_t>(NanBox::STRING_TAG));
+                notStrings.push_back(assembler.jcc(Cond::NE, numbers));
+            }
+            assembler.movImm(Reg::RDX, static_cast<int64_t>(NanBox::PAYLOAD_MASK));
+            load(Reg::RDI, lhs);
+            assembler.andReg(Reg::RDI, Reg::RDX);
+            load(Reg::RSI, rhs);
+            assembler.andReg(Reg::RSI, Reg::RDX);
+            assembler.call(RUNTIME_CONCAT);
+            assembler.movImm(Reg::RDX, static_cast<int64_t>(NanBox::STRING_TAG << NanBox::TAG_SHIFT));
+            assembler.orReg(Reg::RAX, Reg::RDX);
+            store(dst, Reg::RAX);
+            assembler.jmpTo(resumeAt, resume);
+            assembler.bind(notStrings, numbers);
+        }
+        // At least one int is wide, or a product overflowed
+        std::string floats = newLabel();
+        std::vector<size_t> toFloats;
+        load(Reg::RAX, lhs);
+        toFloats.push_back(unboxAnyInt(Reg::RAX, floats));
+        load(Reg::RCX, rhs);
+        toFloats.push_back(unboxAnyInt(Reg::RCX, floats));
+        if (op == "add.a") {
+            assembler.add(Reg::RAX, Reg::RCX);
+        } else if (op == "sub.a") {
+            assembler.sub(Reg::RAX, Reg::RCX);
+        } else if (op == "mul.a") {
+            assembler.imul(Reg::RAX, Reg::RCX);
+            toFloats.push_back(assembler.jcc(Cond::O, floats));
+        } else {
+            assembler.cqo();
+            assembler.idiv(Reg::RCX);
+        }
+        boxInt();
+        store(dst, Reg::RAX);
+        assembler.jmpTo(resumeAt, resume);
+
+        assembler.bind(toFloats, floats);
+        load(Reg::RAX, lhs);
+        anyToFloat(Xmm::XMM1);
+        load(Reg::RAX, rhs);
+        anyToFloat(Xmm::XMM0);
+        // Operands were loaded in reverse so the result ends up in xmm1
+        if (op == "add.a") {
+            assembler.addsd(Xmm::XMM1, Xmm::XMM0);
+        } else if (op == "sub.a") {
+            assembler.subsd(Xmm::XMM1, Xmm::XMM0);
+        } else if (op == "mul.a") {
+            assembler.mulsd(Xmm::XMM1, Xmm::XMM0);
+        } else {
+            assembler.divsd(Xmm::XMM1, Xmm::XMM0);
+        }
+        assembler.movqFromXmm(Reg::RAX, Xmm::XMM1);
+        canonicalizeFloat();
+        store(dst, Reg::RAX);
+        assembler.jmpTo(resumeAt, resume);
+    });
+}
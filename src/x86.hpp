@@ -0,0 +1,287 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "codegen.hpp"
+#include "error.hpp"
+#include "stringpool.hpp"
+
+enum class Reg : uint8_t {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+enum class Xmm : uint8_t {
+    XMM0, XMM1
+};
+
+// Condition codes, numbered as in the jcc opcode
+enum class Cond : uint8_t {
+    O = 0x0,
+    B = 0x2,
+    AE = 0x3,
+    E = 0x4,
+    NE = 0x5
+};
+
+enum class SectionKind {
+    TEXT,
+    RODATA,
+    DATA,
+    BSS
+};
+
+enum class RelocKind {
+    PC32,   // rip-relative data reference: S + A - P
+    PLT32,  // call/jmp target: S + A - P
+    ABS64   // absolute address: S + A
+};
+
+struct MachineSymbol {
+    std::string name;
+    SectionKind section;
+    uint64_t offset;
+    uint64_t size;
+    bool isGlobal;
+    bool isFunction;
+};
+
+struct Relocation {
+    SectionKind section;
+    uint64_t offset;
+    RelocKind kind;
+    std::string symbol;
+    int64_t addend;
+};
+
+// Code from `offset` in .text up to the next entry comes from this source
+// position; line 0 marks code with no source, such as padding between
+// functions
+struct LineEntry {
+    uint64_t offset;
+    uint32_t file;   // index into MachineModule::sourceFiles
+    uint32_t line;
+    uint32_t column;
+};
+
+// Encoded machine code and data for one compilation unit, with everything
+// needed to place it in an object file, an executable or memory
+class MachineModule {
+public:
+    std::string text;
+    std::string rodata;
+    std::string data;
+    uint64_t bssSize = 0;
+    std::vector<MachineSymbol> symbols;
+    std::vector<Relocation> relocations;
+    std::vector<std::string> initFunctions;
+
+    // Line table, in offset order; empty unless debug info was requested
+    std::vector<std::string> sourceFiles;
+    std::vector<LineEntry> lines;
+
+    // The last coldBytes of text hold the functions that rarely or never
+    // run; executables give them a .text.cold section
+    uint64_t coldBytes = 0;
+
+    const MachineSymbol* findSymbol(const std::string& name) const;
+};
+
+// Encodes x86-64 instructions straight into a byte buffer. When a listing is
+// requested every instruction is also rendered as Intel-syntax GAS text.
+class X86Assembler {
+private:
+    std::string& code;
+    std::vector<Relocation>& relocations;
+    std::vector<std::string>* listing;
+
+public:
+    X86Assembler(std::string& buffer, std::vector<Relocation>& relocs,
+                 std::vector<std::string>* textListing = nullptr)
+        : code(buffer), relocations(relocs), listing(textListing) {}
+
+    size_t offset() const { return code.size(); }
+    void label(const std::string& name);
+
+    void movLoad(Reg dst, Reg base, int32_t disp);
+    void movStore(Reg base, int32_t disp, Reg src);
+    void movImm(Reg dst, int64_t imm);
+    void movReg(Reg dst, Reg src);
+    void movReg32(Reg dst, Reg src);
+    void leaRip(Reg dst, const std::string& symbol);
+    void loadRip(Reg dst, const std::string& symbol);
+    void storeRip(const std::string& symbol, Reg src);
+    void incRip(const std::string& symbol, int32_t offset);
+
+    void add(Reg dst, Reg src);
+    void sub(Reg dst, Reg src);
+    void imul(Reg dst, Reg src);
+    void cqo();
+    void idiv(Reg src);
+    void xor32(Reg dst, Reg src);
+    void andReg(Reg dst, Reg src);
+    void orReg(Reg dst, Reg src);
+    void cmp(Reg lhs, Reg rhs);
+    void cmpImm(Reg lhs, int32_t imm);
+    void shlImm(Reg dst, uint8_t count);
+    void shrImm(Reg dst, uint8_t count);
+    void sarImm(Reg dst, uint8_t count);
+    size_t subRsp(int32_t imm);
+    void addRsp(int32_t imm);
+    void patchImm32(size_t at, int32_t value);
+
+    void movqToXmm(Xmm dst, Reg src);
+    void movqFromXmm(Reg dst, Xmm src);
+    void cvtsi2sd(Xmm dst, Reg src);
+    void addsd(Xmm dst, Xmm src);
+    void subsd(Xmm dst, Xmm src);
+    void mulsd(Xmm dst, Xmm src);
+    void divsd(Xmm dst, Xmm src);
+
+    void push(Reg src);
+    void pushMem(Reg base, int32_t disp);
+    void call(const std::string& symbol);
+    void jmp(const std::string& symbol);
+    void jmpTo(size_t target, const std::string& label);
+
+    // Forward jumps within the code being assembled; each returns the
+    // position to hand to bind() once the target is reached
+    size_t jcc(Cond cond, const std::string& label);
+    size_t jmpForward(const std::string& label);
+    void bind(const std::vector<size_t>& fixups, const std::string& label);
+    void leave();
+    void ret();
+    void syscall();
+    void ud2();
+
+private:
+    void shiftImm(int extension, const char* mnemonic, Reg dst, uint8_t count);
+    void byte(uint8_t b);
+    void imm32(int32_t value);
+    void imm64(int64_t value);
+    void rex(bool wide, int reg, int base);
+    void modrm(int reg, Reg base, int32_t disp);
+    void modrmReg(int reg, int rm);
+    void ripDisp(int reg, const std::string& symbol, RelocKind kind, int32_t offset = 0);
+    void sse(uint8_t prefix, uint8_t op, int dst, int src, bool wide = false);
+    void list(const std::string& text);
+};
+
+// Lowers the IR instruction stream produced by CodeGenerator to x86-64.
+// Temporaries live in rbp-relative stack slots; the first six arguments are
+// passed in the System V integer registers and the result comes back in rax.
+class X86Backend {
+private:
+    ErrorReporter& errorReporter;
+    MachineModule machineModule;
+    bool withListing;
+    std::vector<std::string> textListing;
+    std::vector<std::string> dataListing;
+    X86Assembler assembler;
+
+    // Cold functions wait here until placeColdCode() puts them last
+    MachineModule coldModule;
+    std::vector<std::string> coldListing;
+
+    std::unordered_map<std::string, int32_t> slots;
+    const StringPool* strings;
+    const std::unordered_map<std::string, uint32_t>* sourceFiles;
+    std::vector<std::string> pendingArgs;
+    std::string currentFunction;
+    size_t functionStart;
+    size_t frameSizeAt;
+    size_t frameListingAt;
+    size_t bodyStart;
+    size_t paramCount;
+    bool bodyLabelListed;
+    int labelCounter;
+    std::vector<size_t> trapFixups;
+    size_t profileSize;
+
+    // Rarely taken paths, emitted after the function body so that the
+    // common case falls straight through
+    std::vector<std::function<void()>> coldBlocks;
+
+public:
+    // liblithium_rt entry points the generated code calls
+    static constexpr const char* RUNTIME_ALLOC = "lithium_rt_alloc";
+    static constexpr const char* RUNTIME_CONCAT = "lithium_rt_concat";
+    static constexpr const char* RUNTIME_CONCAT_N = "lithium_rt_concat_n";
+    static constexpr const char* RUNTIME_EXIT = "lithium_rt_exit";
+    static constexpr const char* RUNTIME_PROFILE_WRITE = "lithium_rt_profile_write";
+
+    // Tables of an instrumented build: a 64-bit counter per key in .bss, the
+    // keys and the path of the profile in .rodata
+    static constexpr const char* PROFILE_COUNTERS = "__lithium_profile_counters";
+    static constexpr const char* PROFILE_KEYS = "__lithium_profile_keys";
+    static constexpr const char* PROFILE_PATH = "__lithium_profile_path";
+
+    // Every string constant the IR refers to must be in `pool`, and the
+    // module the functions end up in must have called emitStrings()
+    X86Backend(ErrorReporter& reporter, const StringPool& pool, bool listing = false);
+
+    // Records a line entry wherever the source position of the IR changes;
+    // `files` numbers the source files and must outlive the backend
+    void setLineInfo(const std::unordered_map<std::string, uint32_t>* files) { sourceFiles = files; }
+
+    bool lower(const std::vector<Instruction>& instructions);
+    // Exiting through the runtime writes out its buffered output first
+    void emitStart(bool hasInit, bool exitThroughRuntime);
+
+    // Places the laid-out pool in rodata with a label for every entry
+    void emitStrings();
+
+    // Adds the counter tables; _start then writes the profile after main
+    void defineProfile(const std::vector<uint64_t>& keys, const std::string& path);
+
+    // Moves the code of a function lowered by another backend to the end of
+    // this module, or of its cold code
+    void append(X86Backend& function, bool cold = false);
+
+    // Moves the cold code to the end of the module. Runtime code is linked
+    // first, so the cold code ends up after it.
+    void placeColdCode();
+
+    MachineModule& getModule() { return machineModule; }
+    const MachineModule& getColdModule() const { return coldModule; }
+
+    // Moves out the listing lines produced since the last call
+    void drainListing(std::vector<std::string>& text, std::vector<std::string>& data);
+
+private:
+    bool lowerInstruction(const Instruction& inst);
+    void noteSource(const Position& position);
+    void noteNoSource();
+    void beginFunction(const std::string& name);
+    void endFunction();
+    void declareGlobal(const std::string& name);
+    void defineGlobal(const std::string& name, const std::string& kind, const std::string& value);
+
+    int32_t slotFor(const std::string& temp);
+    void load(Reg dst, const std::string& temp);
+    void store(const std::string& temp, Reg src);
+    std::string stringLabel(const std::string& operand);
+    void lowerCall(const std::string& dst, const std::string& callee, size_t argc);
+    void lowerTailCall(const std::string& callee, size_t argc);
+    void lowerConcat(const std::vector<std::string>& operands);
+
+    // `any` support; every helper works on rax and clobbers rdx
+    std::string newLabel();
+    size_t resumeHere(const std::string& label);
+    void checkTag(Reg value, uint64_t tag);
+    void boxInt();
+    void unboxInt();
+    size_t unboxAnyInt(Reg value, const std::string& label);
+    void canonicalizeFloat();
+    void anyToFloat(Xmm dst);
+    void lowerBox(const std::string& op, const std::string& dst, const std::string& src);
+    void lowerUnbox(const std::string& op, const std::string& dst, const std::string& src);
+    void lowerAnyArithmetic(const std::string& op, const std::string& dst, const std::string& lhs,
+                            const std::string& rhs);
+
+    static std::string symbolName(const std::string& operand);
+    static void moveCode(MachineModule& from, MachineModule& to);
+};